@@ -14,6 +14,21 @@ typedef enum
     TASK_ERROR
 } TaskStatus;
 
+// 传输模式
+typedef enum
+{
+    TASK_MODE_ENCRYPT = 0, // 加密写出 (默认)
+    TASK_MODE_PLAIN        // 明文拷贝：优先使用 reflink / copy_file_range 等内核内拷贝，不累加 CRC32
+} TaskMode;
+
+// 页缓存策略
+typedef enum
+{
+    TASK_CACHE_DEFAULT = 0, // 由系统页缓存自行管理
+    TASK_CACHE_STREAM       // 流式：顺序预读，逐窗口异步回写目标并丢弃已用过的源 / 目标页，内存占用不随文件增长
+                            // (窗口大小见 TransferEngine_SetStreamWindow)
+} TaskCachePolicy;
+
 // 回调函数原型 (UI与逻辑解耦的关键)
 typedef void (*OnProgressCallback)(int taskId, double percentage, double speedMbS);
 typedef void (*OnErrorCallback)(int taskId, int errorCode, const char* errorMsg);
@@ -24,11 +39,14 @@ typedef struct TransferTask
     int id;
     char srcPath[256];
     char destPath[256];
+    TaskMode mode; // 占用路径与 totalSize 之间原有的对齐空隙，结构体大小不变
     uint64_t totalSize;
     uint64_t currentOffset; // 断点续传游标
     int priority; // 优先级
     TaskStatus status;
     uint32_t crc32; // 完整性校验值
+    uint8_t destHash[32]; // 目标文件的树形哈希根 (BLAKE3)，传输完成后写入，全零表示未计算
+    TaskCachePolicy cachePolicy; // 同样占用原有的对齐空隙
 
     // 运行时回调 (不持久化到磁盘)
     OnProgressCallback onProgress;
@@ -8,5 +8,6 @@
 #define ERR_TASK_FULL       -4
 #define ERR_TASK_NOT_FOUND  -5
 #define ERR_MEMORY          -6
+#define ERR_NETWORK         -7
 
 #endif // COMMON_ERROR_CODE_H
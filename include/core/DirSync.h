@@ -0,0 +1,46 @@
+﻿#ifndef CORE_DIR_SYNC_H
+#define CORE_DIR_SYNC_H
+
+#include "core/TaskManager.h"
+#include <stdint.h>
+
+// 增量目录同步：把源目录树同步到目标目录，每个新增或变化的文件作为一个普通任务运行。
+// 上次同步的结果保存在索引中 (见 data/SyncIndex.h)，大小与修改时间都未变的文件不读取、不传输，
+// 不变文件的代价只有一次遍历中的 stat。源目录由多个线程并行遍历 (共享的待遍历目录栈)。
+// 索引只信任自己的记录，不检查目标目录；目标文件被外部改动时需删除索引以完整重传。
+// 符号链接与特殊文件被跳过。仅支持 POSIX 平台；其他平台上返回 ERR_FILE_OPEN
+//
+// 每个传输的文件都是 TaskManager 中持久化的普通任务，与手动添加的任务一样写入日志，
+// 完成后在压缩或下次启动时移入历史文件。因此大目录的首次同步会产生同样多的历史记录；
+// 失败的文件留在活动任务列表中 (可单独续传)，下次同步仍会按索引重新为它创建任务
+
+#define DIRSYNC_INDEX_NAME ".stxindex"
+
+typedef struct DirSyncOptions
+{
+    TaskOptions task;      // 文件任务的模式与缓存策略
+    int jobs;              // 遍历与传输的并行线程数，<= 0 时使用 CPU 数
+    int deleteRemoved;     // 删除源目录中已不存在的文件在目标目录中的副本 (空目录保留)
+    const char* indexPath; // NULL 时为 <destDir>/.stxindex
+} DirSyncOptions;
+
+typedef struct DirSyncStats
+{
+    uint64_t scanned;     // 源目录中的普通文件数
+    uint64_t unchanged;   // 与索引一致而跳过的文件
+    uint64_t transferred; // 新增或变化并成功传输的文件
+    uint64_t failed;      // 无法遍历的目录、路径过长或传输失败的文件
+    uint64_t deleted;     // 删除的目标文件
+    uint64_t bytes;       // 传输的字节数
+} DirSyncStats;
+
+// 每个文件处理后调用，可能在任意线程中；event 为 "transferred" / "failed" / "deleted"，
+// taskId 为文件任务的 ID (没有任务时为 0)
+typedef void (*DirSyncFileCallback)(const char* event, const char* relPath, int taskId, void* user);
+
+// 执行一次同步并写回索引。所有文件都成功时返回 ERR_SUCCESS；有文件失败时返回 ERR_FILE_WRITE，
+// 成功的部分仍记入索引，失败的文件下次重新传输。源目录无法打开返回 ERR_FILE_OPEN
+int DirSync_Run(const char* srcDir, const char* destDir, const DirSyncOptions* options,
+                DirSyncFileCallback onFile, void* user, DirSyncStats* out);
+
+#endif // CORE_DIR_SYNC_H
@@ -0,0 +1,38 @@
+﻿#ifndef CORE_METRICS_H
+#define CORE_METRICS_H
+
+#include <stdint.h>
+
+// 运行指标，按 Prometheus 文本格式导出。
+// 计数器按线程分片：每个线程只写自己的分片 (无锁、无原子读改写)，导出时再汇总，
+// 因此在传输循环中累加计数几乎没有开销。活动/排队任务数和每个任务的速度来自任务快照，
+// 由导出线程定期计算
+
+typedef enum
+{
+    METRIC_BYTES_TRANSFERRED = 0, // 已写入目标的字节数
+    METRIC_CIPHER_NS,             // 加密耗时 (纳秒)
+    METRIC_IO_ERRORS,             // 打开、定位、读写失败的次数
+    METRIC_RESUMES,               // 从非零偏移恢复运行的次数
+    METRIC_TASKS_COMPLETED,       // 完成的任务数
+    METRIC_COUNTER_COUNT
+} MetricCounter;
+
+// 累加当前线程的计数器分片
+void Metrics_Add(MetricCounter counter, uint64_t value);
+
+// 记录一次检查点 (TaskManager_Sync) 的耗时，计入直方图
+void Metrics_ObserveCheckpoint(uint64_t ns);
+
+// 生成当前指标的 Prometheus 文本；返回的字符串由调用者 free，失败返回 NULL
+char* Metrics_Render(void);
+
+// 启动导出线程：每 intervalMs 毫秒刷新速度并原子地重写 textfilePath (供 node_exporter 的
+// textfile collector 读取)；socketPath 非 NULL 时监听该 Unix 域套接字，每个连接收到一份指标后关闭。
+// 两个路径都可为 NULL。成功返回 0
+int Metrics_Start(const char* textfilePath, const char* socketPath, int intervalMs);
+
+// 写出最后一次 textfile，停止线程并删除套接字文件
+void Metrics_Stop(void);
+
+#endif // CORE_METRICS_H
@@ -0,0 +1,36 @@
+﻿#ifndef CORE_NET_TRANSFER_H
+#define CORE_NET_TRANSFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// TCP 传输：发送端把文件切成定长块，用引擎的密钥按绝对偏移加密后，分散到 N 条并行连接上发送，
+// 每块带偏移与 CRC32；接收端按偏移 pwrite 重组，得到与本地 RunTask 相同的密文文件。
+// 单条 TCP 流在高带宽高延迟链路上跑不满时，多条流并行可以充分利用带宽。
+//
+// 断点续传由接收端决定：已落盘的块记录在 <dest>.stxstate 位图中 (先 fdatasync 数据再写位图)，
+// 握手时把位图发给发送端，发送端只发送缺失的块。传输完成后位图文件被删除。
+// 仅支持 POSIX 平台；其他平台上各函数返回 ERR_NETWORK
+
+#define NET_DEFAULT_PORT 7878
+#define NET_DEFAULT_STREAMS 4
+#define NET_DEFAULT_CHUNK (1024 * 1024)
+
+// 进度回调，可能在任意传输线程中调用；done 包含续传跳过的字节，握手后先以已提交的字节数回调一次
+typedef void (*NetProgressCallback)(uint64_t done, uint64_t total, void* user);
+
+typedef struct NetListener NetListener;
+
+// 监听 host:port (host 为 NULL 表示所有地址，port 为 0 时由系统分配)；失败返回 NULL
+NetListener* NetTransfer_Listen(const char* host, int port);
+int NetTransfer_ListenerPort(const NetListener* listener);
+
+// 接收一个文件写入 destPath。返回 ERR_SUCCESS 表示文件完整；连接中断时已收到的块保留，供下次续传
+int NetTransfer_Receive(NetListener* listener, const char* destPath, NetProgressCallback onProgress, void* user);
+void NetTransfer_Close(NetListener* listener);
+
+// 将 srcPath 发送到 host:port，使用 streams 条并行连接、chunkSize 字节的块 (0 表示默认值)
+int NetTransfer_Send(const char* srcPath, const char* host, int port, int streams, size_t chunkSize,
+                     NetProgressCallback onProgress, void* user);
+
+#endif // CORE_NET_TRANSFER_H
@@ -11,21 +11,54 @@ struct CryptoContext;
 // 这里的 ctx 使用 struct CryptoContext* 类型，实现了对具体上下文的引用
 typedef void (*CipherFunc)(uint8_t* data, size_t len, struct CryptoContext* ctx);
 
+// 分段描述：一段缓冲区及其在密钥流中的绝对偏移 (通常即文件偏移)
+typedef struct CipherSegment
+{
+    uint8_t* data;
+    size_t len;
+    uint64_t offset;
+} CipherSegment;
+
+// v2 加密策略接口：无状态、按偏移寻址、批量处理
+// ctx 为只读，多个线程可共享同一个已初始化的上下文；一次调用处理整批分段
+typedef void (*CipherBatchFunc)(const struct CryptoContext* ctx, CipherSegment* segs, size_t count);
+
 // 上下文结构，用于流式加密
 typedef struct CryptoContext
 {
     uint8_t key[32]; // 扩展密钥长度
     size_t keyLen;
-    size_t keyIndex; // 当前密钥流位置
+    size_t keyIndex; // 当前密钥流位置 (仅 v1 接口使用)
+
+    // 预展开的密钥环：keyRing[i] = key[i % keyLen]，供按字处理的内核使用，初始化后只读
+    uint8_t keyRing[64];
 
     // 加密策略接口
     // 允许在运行时动态挂载不同的加密算法 (XOR, AES, etc.)
     CipherFunc algorithm;
+    CipherBatchFunc batchAlgorithm;
 } CryptoContext;
 
+// 已注册的加密算法描述 (供基准测试、诊断等按名称枚举)
+typedef struct CipherAlgorithmInfo
+{
+    const char* name;
+    CipherFunc func;
+    CipherBatchFunc batchFunc;
+} CipherAlgorithmInfo;
+
+// 获取已注册算法列表，count 返回数量
+const CipherAlgorithmInfo* GetCipherAlgorithms(int* count);
+
 void InitSecurity(CryptoContext* ctx, const char* password);
 
-// 流式加密缓冲区
+// 流式加密缓冲区 (v1：从 ctx->keyIndex 处继续，并推进 keyIndex)
 void EncryptBuffer(uint8_t* buffer, size_t len, CryptoContext* ctx);
 
+// 按绝对偏移加密单个缓冲区 (v2：不修改 ctx，可重入)
+void EncryptBufferAt(const CryptoContext* ctx, uint8_t* buffer, size_t len, uint64_t offset);
+
+// 批量加密多个分段 (v2：整批只做一次策略分派)
+void EncryptSegments(const CryptoContext* ctx, CipherSegment* segs, size_t count);
+
 #endif // CORE_SECURITY_H
@@ -0,0 +1,26 @@
+﻿#ifndef CORE_STREAM_TRANSFER_H
+#define CORE_STREAM_TRANSFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 流式加密：在管道、套接字等不可定位的描述符之间顺序处理数据，可作为过滤器使用
+// (pg_dump | safetrix encrypt - | ...)。使用引擎的密钥按流内绝对偏移加密，
+// 输出与对同一数据运行 RunTask 得到的密文一致；算法对称，解密是同一操作。
+//
+// 每次读满一个大缓冲区 (管道每次 read 只返回几十 KB) 后整体加密写出，输出为管道时先放大管道容量。
+// 明文模式下 Linux 上任一端为管道时用 splice 在内核中搬运，数据不经过用户态；
+// 加密数据必须经过用户态，用 read / write (不用 vmsplice，见 stream_transfer.c)
+
+#define STREAM_DEFAULT_BUFFER (4 * 1024 * 1024)
+
+// 进度回调，在调用线程中每处理一个缓冲区调用一次；流的总大小未知，只报告已处理的字节数
+typedef void (*StreamProgressCallback)(uint64_t done, void* user);
+
+// 从 inFd 读到 EOF，加密 (plain 为非零时原样) 写入 outFd。bufferSize 为 0 表示默认值。
+// outBytes 可为 NULL，返回时为已写出的字节数。
+// 返回 ERR_SUCCESS / ERR_FILE_READ / ERR_FILE_WRITE / ERR_MEMORY
+int StreamTransfer_Run(int inFd, int outFd, int plain, size_t bufferSize, StreamProgressCallback onProgress,
+                       void* user, uint64_t* outBytes);
+
+#endif // CORE_STREAM_TRANSFER_H
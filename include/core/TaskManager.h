@@ -3,12 +3,61 @@
 
 #include "common/AppTypes.h"
 
+// 任务持久化后端
+typedef enum
+{
+    TASK_BACKEND_JOURNAL = 0, // 快照 + 追加式日志 (默认)
+    TASK_BACKEND_MMAP         // 内存映射的定长槽位库，检查点原地写入
+} TaskBackend;
+
+// 选择持久化后端，需在 InitTaskManager 之前调用
+void TaskManager_SetBackend(TaskBackend backend);
+
 void InitTaskManager(void);
 int AddTask(const char* src, const char* dest, int priority);
+// 创建任务时的可选设置，全零即 AddTask 的默认值
+typedef struct TaskOptions
+{
+    TaskMode mode;
+    TaskCachePolicy cachePolicy;
+} TaskOptions;
+
+// 按给定设置添加任务；options 为 NULL 时等同于 AddTask
+int AddTaskWithOptions(const char* src, const char* dest, int priority, const TaskOptions* options);
 TransferTask* GetTaskById(int id);
-TransferTask* GetTaskList(int* count);
+
+// 任务表按块分配，返回的 TransferTask* 在下次 InitTaskManager 之前保持有效；按 ID 查找为 O(1)
+int TaskManager_GetTaskCount(void);
+TransferTask* TaskManager_GetTaskAt(int index);
+
+// 已完成的任务在压缩或下次启动时移入历史文件，不再占用活动库；历史在首次查询时才加载。
+// 可在任意线程调用，记录拷贝到 out；返回 ERR_SUCCESS 或 ERR_TASK_NOT_FOUND
+int TaskManager_GetHistoryCount(void);
+int TaskManager_GetHistoryAt(int index, TransferTask* out);
+int TaskManager_FindHistory(int id, TransferTask* out);
+
+// 无锁快照：任务的所属线程每次调用 TaskManager_UpdateTask 时以顺序锁发布一份副本，
+// UI、统计等其他线程读取副本即可得到一致的状态，不会与传输线程争用锁。
+// 副本中的回调指针为 NULL；两者均不可与 InitTaskManager 并发调用
+int TaskManager_SnapshotTask(int id, TransferTask* out); // ERR_SUCCESS 或 ERR_TASK_NOT_FOUND
+// 拷贝所有已发布的任务，*out 由调用者 free；返回任务数，失败返回 ERR_MEMORY
+int TaskManager_SnapshotAll(TransferTask** out);
+
+// 停止请求：任意线程都可以对正在运行的任务发出，传输线程在下一个块之前处理
+typedef enum
+{
+    TASK_STOP_NONE = 0,
+    TASK_STOP_PAUSE, // 保存进度并置为暂停，之后可续传
+    TASK_STOP_CANCEL // 停止并置为异常，不再调度
+} TaskStopRequest;
+
+int TaskManager_RequestStop(int id, TaskStopRequest request); // ERR_SUCCESS 或 ERR_TASK_NOT_FOUND
+// 取走并清除任务上的停止请求，由运行该任务的线程调用
+TaskStopRequest TaskManager_TakeStopRequest(TransferTask* task);
+
 void SetTaskCallbacks(int taskId, OnProgressCallback onProgress, OnErrorCallback onError);
 void TaskManager_Sync(void);
 void TaskManager_UpdateTask(TransferTask* task);
+void TaskManager_Shutdown(void);
 
 #endif // CORE_TASK_MANAGER_H
@@ -2,9 +2,35 @@
 #define CORE_TRANSFER_ENGINE_H
 
 #include "common/AppTypes.h"
+#include "core/Verify.h"
 
 void InitTransferEngine(void);
 int RunTask(TransferTask* task);
+
+// 请求正在运行的任务在下一个块之前停止 (可在任意线程调用)：
+// StopTransfer 保存进度并置为暂停，CancelTransfer 置为异常；RunTask 随后返回 0
 void StopTransfer(int taskId);
+void CancelTransfer(int taskId);
+
+// 设置 RunTask 每次读写的块大小 (字节，限制在 4 KB ~ 64 MB)，对之后启动的任务生效
+void TransferEngine_SetChunkSize(size_t bytes);
+
+// 设置流式缓存策略 (TASK_CACHE_STREAM) 的回写窗口 (字节，限制在 1 MB ~ 1 GB，默认 8 MB)，对之后启动的任务生效。
+// 是否启用流式策略随任务保存 (TaskOptions.cachePolicy)；窗口大小是进程级设置，不随任务持久化，
+// 任务在启动时取当前值，因此可以在启动各任务之前分别设置
+void TransferEngine_SetStreamWindow(size_t bytes);
+
+// 扇出复制：一组源文件与模式相同的任务 (各自一个目标) 一起运行，源文件只读取、加密一次，
+// 每个目标由独立的线程写入并各自提交续传偏移。某个目标拖住其他目标超过容忍时间 (默认 30 秒) 时
+// 将其暂停，之后可单独续传。任务不满足条件时返回 -1 且不做任何修改；有目标失败时返回 -1
+int RunTaskGroup(TransferTask** tasks, int count);
+void TransferEngine_SetFanoutStallTimeout(unsigned int ms);
+
+// 用引擎的密钥初始化加密上下文 (网络传输等不经过 RunTask 的路径使用，输出与 RunTask 一致)
+void TransferEngine_InitCrypto(CryptoContext* ctx);
+
+// 校验任务输出：用引擎的密钥解密目标文件 (明文任务不解密) 并与源文件逐字节比较 (多线程)。
+// 已完成且尚未计算 destHash 的任务 (内核内拷贝) 校验一致后补算目标文件哈希
+int VerifyTask(TransferTask* task, int threads, VerifyResult* out);
 
 #endif // CORE_TRANSFER_ENGINE_H
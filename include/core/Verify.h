@@ -0,0 +1,23 @@
+﻿#ifndef CORE_VERIFY_H
+#define CORE_VERIFY_H
+
+#include <stdint.h>
+#include "core/Security.h"
+
+// 校验结果
+typedef struct VerifyResult
+{
+    int match; // 1 = 内容与长度完全一致
+    uint64_t srcSize;
+    uint64_t destSize;
+    uint64_t bytesCompared;
+    uint64_t firstMismatch; // 第一个不一致字节的偏移 (match 为 0 时有效；长度不同且公共部分一致时为较短文件长度)
+} VerifyResult;
+
+// 校验目标文件与源文件是否一致
+// ctx 为 NULL 时按明文逐字节比较；否则先用 ctx 对目标数据解密 (按绝对偏移) 再与源比较
+// threads <= 0 时使用全部 CPU。返回 ERR_SUCCESS 表示校验已完成 (结果见 out->match)，负数为 I/O 错误码
+int Verify_Files(const char* srcPath, const char* destPath, const CryptoContext* ctx, int threads,
+                 VerifyResult* out);
+
+#endif // CORE_VERIFY_H
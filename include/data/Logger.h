@@ -11,13 +11,17 @@ typedef enum
     LOG_ERROR
 } LogLevel;
 
-// 初始化日志系统
+// 初始化日志系统并启动后台写入线程
 void Logger_Init(const char* logFilePath);
 
-// 记录一条日志
+// 记录一条日志：只格式化消息并放入环形缓冲区，由后台线程成批写入文件。
+// 缓冲区满时丢弃记录 (随后写入一条丢弃计数)；LOG_ERROR 会等待之前的所有记录落盘
 void Logger_Log(LogLevel level, const char* format, ...);
 
-// 关闭日志文件
+// 等待此前记录的日志全部写入并 fflush
+void Logger_Flush(void);
+
+// 写完剩余日志，停止后台线程并关闭日志文件
 void Logger_Close(void);
 
 #endif // DATA_LOGGER_H
@@ -3,11 +3,57 @@
 
 #include "common/AppTypes.h"
 
-// 保存任务列表到数据库文件
-int Persistence_SaveTasks(const char* dbPath, TransferTask* tasks, int count);
+// 保存任务列表到数据库文件 (tasks 为任务指针数组，任务表不要求连续存储)
+int Persistence_SaveTasks(const char* dbPath, const TransferTask* const* tasks, int count);
 
-// 从数据库文件加载任务列表，返回实际加载的任务数量
-int Persistence_LoadTasks(const char* dbPath, TransferTask* outTasks, int maxCount);
+// 从数据库文件加载任务列表，*outTasks 由本函数分配，无论成功与否都由调用方 free
+// 返回实际加载的任务数量，出错返回负数
+int Persistence_LoadTasks(const char* dbPath, TransferTask** outTasks);
+
+// --- 追加式日志 (journal) ---
+// 快照之后的任务变更以小记录追加到日志文件：新增任务写完整记录，进度/状态变化只写增量
+// (offset、status、crc 等)。启动时先加载快照再按顺序重放日志；日志过大时压缩为新快照。
+// 每条记录自带 CRC，断电造成的残缺尾部会在重放时被丢弃。
+
+typedef struct TaskJournal TaskJournal;
+
+// 以追加方式打开日志文件，失败返回 NULL
+TaskJournal* Persistence_OpenJournal(const char* journalPath);
+void Persistence_CloseJournal(TaskJournal* journal);
+
+// 追加新增任务的完整记录
+int Persistence_JournalAdd(TaskJournal* journal, const TransferTask* task);
+
+// 追加任务的增量记录 (进度、状态、校验值)
+int Persistence_JournalDelta(TaskJournal* journal, const TransferTask* task);
+
+// 将缓冲中的记录写入磁盘
+int Persistence_JournalFlush(TaskJournal* journal);
+
+// 日志当前字节数 (用于决定何时压缩)
+uint64_t Persistence_JournalSize(const TaskJournal* journal);
+
+// 重放时按 id 查找任务；create 非 0 且任务不存在时新建一个 (id 已填好)。返回 NULL 表示忽略该记录
+typedef TransferTask* (*TaskLookupFunc)(int id, int create, void* user);
+
+// 将日志重放到已加载的任务上，返回重放的记录数
+int Persistence_ReplayJournal(const char* journalPath, TaskLookupFunc lookup, void* user);
+
+// 压缩：原子地写出新快照 (临时文件 + 重命名)，然后清空日志
+int Persistence_Compact(const char* dbPath, TaskJournal* journal, const TransferTask* const* tasks, int count);
+
+// --- 历史任务 (冷存储) ---
+// 已完成的任务移出活动库，追加到独立的历史文件。启动时只读取历史文件头中的最大任务 ID，
+// 历史记录本身在查询时才加载，活动库大小与历史长度无关。
+
+// 追加已完成的任务，并更新文件头中的最大 ID
+int Persistence_AppendHistory(const char* historyPath, const TransferTask* const* tasks, int count);
+
+// 只读取文件头：历史中的最大任务 ID (无历史时为 0)
+int Persistence_ReadHistoryMaxId(const char* historyPath);
+
+// 加载全部历史任务，*outTasks 由调用方 free；同一 ID 出现多次时保留最后一条。返回任务数量
+int Persistence_LoadHistory(const char* historyPath, TransferTask** outTasks);
 
 #endif // DATA_PERSISTENCE_H
 
@@ -0,0 +1,37 @@
+﻿#ifndef DATA_SLOT_STORE_H
+#define DATA_SLOT_STORE_H
+
+#include "common/AppTypes.h"
+
+// 内存映射的定长槽位任务库 (可选的持久化后端)
+// 每个任务占用一个固定大小的槽位：任务信息只在创建时写入一次，进度检查点直接写入映射内存，
+// 只同步所在的页。槽位内的进度信息有两份交替写入，各带校验和，
+// 写入中途断电只会损坏正在写的那一份，加载时取序号较大的有效副本。
+// 启动时无需解析，直接从映射中读取。
+
+typedef struct SlotStore SlotStore;
+
+// 打开 (必要时创建) 槽位库，至少容纳 minSlots 个槽位。失败返回 NULL
+SlotStore* SlotStore_Open(const char* path, int minSlots);
+
+// 同步全部内容并关闭
+void SlotStore_Close(SlotStore* store);
+
+// 当前槽位总数 (加载时的数量上限)
+int SlotStore_Capacity(const SlotStore* store);
+
+// 读取所有有效槽位，按槽位顺序写入 outTasks，outSlots (可为 NULL) 返回对应的槽位号
+// 返回加载的任务数量
+int SlotStore_Load(SlotStore* store, TransferTask* outTasks, int* outSlots, int maxCount);
+
+// 写入任务的完整记录 (新增任务时使用)，槽位不足时自动扩容
+int SlotStore_Write(SlotStore* store, int slot, const TransferTask* task);
+
+// 释放槽位 (任务已归档)，之后可被新任务重用
+int SlotStore_Release(SlotStore* store, int slot);
+
+// 原地写入进度检查点 (offset、status、crc 等)
+// durable 为非 0 时同步等待该页写入磁盘，否则只提交异步回写
+int SlotStore_Checkpoint(SlotStore* store, int slot, const TransferTask* task, int durable);
+
+#endif // DATA_SLOT_STORE_H
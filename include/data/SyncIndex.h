@@ -0,0 +1,45 @@
+﻿#ifndef DATA_SYNC_INDEX_H
+#define DATA_SYNC_INDEX_H
+
+#include "utils/TreeHash.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// 目录同步的文件索引：记录上次同步时每个源文件的 (相对路径, 大小, 修改时间, 目标哈希)。
+// 再次同步时大小与修改时间都未变的文件直接跳过，不必读取内容。
+//
+// 文件格式 (小端): magic u32 "STXI" | version u16 | reserved u16 | count u64，
+// 之后是按路径排序的记录: 与上一条路径的公共前缀长度 varint | 后缀长度 varint | 后缀 |
+// size varint | mtimeNs varint | hash 32 字节；文件末尾是覆盖之前全部字节的 CRC32。
+// 排序后相邻路径大多共享目录前缀，前缀压缩后每条记录通常只有几十字节
+
+typedef struct SyncIndexEntry
+{
+    const char* path; // 相对源目录，以 '/' 分隔
+    uint64_t size;
+    uint64_t mtimeNs;
+    uint8_t hash[TREEHASH_OUT_LEN]; // 上次写入的目标文件的树形哈希 (任务的 destHash)
+} SyncIndexEntry;
+
+typedef struct SyncIndex
+{
+    SyncIndexEntry* entries; // 按 path 排序
+    size_t count;
+    char* names;     // 所有路径字符串
+    uint32_t* slots; // 开放寻址哈希表，保存 entries 下标 + 1 (0 表示空槽)
+    size_t slotCount;
+} SyncIndex;
+
+// 加载索引；文件不存在时得到空索引。
+// 返回 ERR_SUCCESS，文件损坏返回 ERR_FILE_READ (此时 out 为空索引)，内存不足返回 ERR_MEMORY
+int SyncIndex_Load(const char* path, SyncIndex* out);
+
+// 按相对路径查找，不存在返回 NULL；加载后只读，可在多个线程中并发调用
+const SyncIndexEntry* SyncIndex_Find(const SyncIndex* index, const char* relPath);
+
+// 原子地写出索引 (临时文件 + 重命名)，entries 会被就地按 path 排序
+int SyncIndex_Save(const char* path, SyncIndexEntry* entries, size_t count);
+
+void SyncIndex_Free(SyncIndex* index);
+
+#endif // DATA_SYNC_INDEX_H
@@ -0,0 +1,38 @@
+﻿#ifndef CLI_H
+#define CLI_H
+
+#include "common/AppTypes.h"
+
+// 非交互式批处理命令行，供脚本 / 定时任务调用：
+//   safetrix add <src> <dest> [<dest>...] [--priority N] [--plain] [--cache default|stream] | add --manifest FILE [...]
+//     (每个目标一个任务；run 将源文件与模式相同的任务合并为一组扇出运行，见 RunTaskGroup)
+//   safetrix run [ID...] [--jobs N] [--chunk-size BYTES] [--stream-window BYTES] [--manifest FILE] [--progress-ms MS]
+//   safetrix status [ID...] [--history]
+//   safetrix verify <ID> [--threads N]
+//   safetrix daemon [--socket PATH] [--jobs N]   (见 ui/Daemon.h)
+//   safetrix send <src> <host[:port]> [--streams N] [--chunk-size BYTES]
+//   safetrix receive <dest> [--listen [HOST:]PORT]   (见 core/NetTransfer.h)
+//   safetrix sync <srcDir> <destDir> [--jobs N] [--delete] [--index FILE] [--plain] [--cache default|stream]
+//     (增量目录同步，只传输新增或变化的文件；见 core/DirSync.h)
+//   safetrix encrypt|decrypt [<src>|-] [<dest>|-] [--plain] [--buffer-size BYTES]
+//     (管道过滤器，"-" 表示 stdin / stdout，事件写到 stderr；见 core/StreamTransfer.h)
+// 所有子命令都接受 --backend journal|mmap、导出运行指标的 --metrics-file / --metrics-socket，
+// 以及让 2MB 以上的传输缓冲区使用大页的 --huge-pages。
+// 输出为每行一个 JSON 对象 (NDJSON)，诊断信息写到 stderr
+
+typedef enum
+{
+    CLI_EXIT_OK = 0,
+    CLI_EXIT_TASK_FAILED = 1, // 有任务失败，或校验发现不一致
+    CLI_EXIT_USAGE = 2,       // 参数错误
+    CLI_EXIT_NOT_FOUND = 3,   // 指定的任务不存在
+    CLI_EXIT_IO = 4           // 清单等输入文件无法读取，或任务无法创建
+} CliExitCode;
+
+// 执行命令行 (argv[1] 为子命令)，返回进程退出码
+int Cli_Run(int argc, char* argv[]);
+
+// 将任务格式化为一行 JSON (不含换行)，返回写入的长度；守护进程的事件使用同一格式
+int Cli_FormatTask(char* out, size_t size, const char* event, const TransferTask* t);
+
+#endif // CLI_H
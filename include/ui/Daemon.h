@@ -0,0 +1,18 @@
+﻿#ifndef DAEMON_H
+#define DAEMON_H
+
+// 守护进程模式：独占任务管理器，用一个工作线程池统一调度所有提交方的传输，
+// 通过 Unix 域套接字 (epoll 事件循环) 同时服务多个客户端。
+//
+// 协议按行：每行一条命令，命令字与参数以空格分隔，add 的参数以 TAB 分隔 (路径可含空格)：
+//   add<TAB>src<TAB>dest[<TAB>priority]
+//   list | pause ID | resume ID | cancel ID | subscribe
+// 每条命令先回应一行 {"ok":true,...} 或 {"ok":false,"error":"..."}，list 在回应前输出每个任务。
+// subscribe 之后该连接还会收到 added / progress / done 事件。所有输出都是单行 JSON
+
+#define DAEMON_DEFAULT_SOCKET "data/safetrix.sock"
+
+// 运行守护进程直到收到 SIGINT / SIGTERM；需在 InitTaskManager 之后调用。返回进程退出码
+int Daemon_Run(const char* socketPath, int jobs);
+
+#endif // DAEMON_H
@@ -0,0 +1,17 @@
+﻿#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+// 多任务仪表盘：独立的 UI 线程按固定帧率读取任务快照，重绘每个任务的进度条、速度与剩余时间。
+// 每帧只做一次缓冲写出，用 ANSI 光标控制原地刷新；渲染开销与传输块的完成速度无关
+
+#define DASHBOARD_DEFAULT_FPS 10
+
+typedef struct Dashboard Dashboard;
+
+// 为给定的任务启动仪表盘线程；失败返回 NULL
+Dashboard* Dashboard_Start(const int* taskIds, int count, int fps);
+
+// 绘制最后一帧、停止线程并释放；返回共绘制的帧数
+int Dashboard_Stop(Dashboard* dash);
+
+#endif // DASHBOARD_H
@@ -2,6 +2,7 @@
 #define PROGRESS_BAR_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 // 进度条结构体
 typedef struct
@@ -17,7 +18,10 @@ void ProgressBar_Init(ProgressBar* bar, int id, int width);
 // 更新进度
 void ProgressBar_Update(ProgressBar* bar, float percent);
 
-// 渲染进度条
+// 将进度条格式化到 out (不含换行)，返回写入的字节数
+int ProgressBar_Format(const ProgressBar* bar, char* out, size_t size);
+
+// 渲染进度条 (一次写出整行)
 void ProgressBar_Render(const ProgressBar* bar);
 
 #endif // PROGRESS_BAR_H
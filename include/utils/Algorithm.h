@@ -13,5 +13,12 @@ uint32_t Algorithm_CalculateCRC32(const uint8_t* data, size_t length);
 // 累加计算 CRC32 (用于流式处理大文件)
 uint32_t Algorithm_UpdateCRC32(uint32_t currentCrc, const uint8_t* data, size_t length);
 
+// 合并两段相邻数据的 CRC32：已知 crc(A)、crc(B) 和 B 的长度，返回 crc(A||B)
+// 多个线程各自计算文件分段的 CRC 后，可按顺序合并为整文件 CRC
+uint32_t Algorithm_CombineCRC32(uint32_t crcA, uint32_t crcB, uint64_t lenB);
+
+// 多线程计算内存块的 CRC32 (threads <= 0 时使用全部 CPU)，结果与 Algorithm_CalculateCRC32 一致
+uint32_t Algorithm_CalculateCRC32Parallel(const uint8_t* data, size_t length, int threads);
+
 #endif // UTILS_ALGORITHM_H
 
@@ -0,0 +1,56 @@
+﻿#ifndef UTILS_BUFFER_POOL_H
+#define UTILS_BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Process-wide pool of page-aligned I/O buffers, reused across tasks and threads.
+// Requests are rounded up to a power of two between BUFFER_POOL_MIN_SIZE and BUFFER_POOL_MAX_SIZE.
+// Each thread keeps a few idle buffers per size class, so acquiring and releasing on the same thread
+// takes no lock. The rest go to a shared free list, and idle memory above BUFFER_POOL_IDLE_LIMIT is
+// returned to the OS. Buffers come straight from the OS allocator (mmap / VirtualAlloc) and are
+// aligned to at least BUFFER_POOL_ALIGN. That makes them usable for O_DIRECT, as io_uring registered
+// buffers, and by the cipher kernels.
+
+#define BUFFER_POOL_ALIGN 4096
+#define BUFFER_POOL_MIN_SIZE 4096
+#define BUFFER_POOL_MAX_SIZE (64 * 1024 * 1024) // larger requests are served uncached
+#define BUFFER_POOL_HUGE_SIZE (2 * 1024 * 1024)
+#define BUFFER_POOL_IDLE_LIMIT (256 * 1024 * 1024)
+
+typedef struct BufferPoolStats
+{
+    uint64_t osAllocs;   // buffers obtained from the OS
+    uint64_t reuses;     // acquisitions served from a cache
+    uint64_t hugeAllocs; // OS allocations backed by huge pages (explicit or transparent)
+    uint64_t idleBytes;  // bytes parked in the shared free lists
+} BufferPoolStats;
+
+// Back buffers of BUFFER_POOL_HUGE_SIZE and larger with 2 MB pages: MAP_HUGETLB when the system has
+// reserved huge pages, otherwise madvise(MADV_HUGEPAGE). Off by default; affects later OS allocations
+void BufferPool_SetHugePages(int enabled);
+
+// Get a buffer of at least size bytes (contents undefined); NULL when out of memory
+void* BufferPool_Acquire(size_t size);
+
+// Return a buffer; size must be the value passed to BufferPool_Acquire
+void BufferPool_Release(void* buffer, size_t size);
+
+// Move the calling thread's cached buffers to the shared pool.
+// Threads started with Thread_Create do this automatically when they exit
+void BufferPool_FlushThreadCache(void);
+
+// Free every idle buffer in the shared pool
+void BufferPool_Trim(void);
+
+void BufferPool_GetStats(BufferPoolStats* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UTILS_BUFFER_POOL_H
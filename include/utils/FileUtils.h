@@ -28,6 +28,9 @@ int FileUtils_Mkdir(const char* path);
 // Get file size (used for progress calculation)
 uint64_t FileUtils_GetFileSize(const char* filepath);
 
+// Seek to an absolute 64-bit offset (fseek takes a 32-bit long on Windows)
+int FileUtils_Seek(FILE* fp, uint64_t offset);
+
 #ifdef __cplusplus
 }
 #endif
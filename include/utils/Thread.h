@@ -0,0 +1,62 @@
+﻿#ifndef UTILS_THREAD_H
+#define UTILS_THREAD_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Thin cross-platform wrappers over Win32 threads and pthreads
+
+#ifdef _WIN32
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+typedef void (*ThreadFunc)(void* arg);
+
+// Start a thread running fn(arg); returns 0 on success
+int Thread_Create(Thread* thread, ThreadFunc fn, void* arg);
+
+// Wait for a thread to finish
+void Thread_Join(Thread thread);
+
+// Number of online logical CPUs (at least 1)
+int Thread_GetCpuCount(void);
+
+// Sleep the calling thread
+void Thread_SleepMs(unsigned int ms);
+
+// Monotonic clock in nanoseconds
+uint64_t Thread_NowNs(void);
+
+void Mutex_Init(Mutex* m);
+void Mutex_Lock(Mutex* m);
+void Mutex_Unlock(Mutex* m);
+void Mutex_Destroy(Mutex* m);
+
+void CondVar_Init(CondVar* cv);
+void CondVar_Wait(CondVar* cv, Mutex* m);
+// Returns 0 when signalled, non-zero on timeout
+int CondVar_TimedWait(CondVar* cv, Mutex* m, unsigned int ms);
+void CondVar_Signal(CondVar* cv);
+void CondVar_Broadcast(CondVar* cv);
+void CondVar_Destroy(CondVar* cv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UTILS_THREAD_H
@@ -0,0 +1,48 @@
+﻿#ifndef UTILS_TRACE_H
+#define UTILS_TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lightweight trace spans exported as Chrome trace-event JSON (open in Perfetto or chrome://tracing).
+// Spans are only recorded when built with -DSAFETRIX_ENABLE_TRACE=ON; otherwise the macros expand to
+// nothing and the functions below are no-ops. Each thread appends to its own buffer, so recording a
+// span costs two clock reads and no locks.
+
+typedef struct TraceSpan
+{
+    const char* name; // must be a string literal (stored by pointer, not copied or escaped)
+    uint64_t start;
+} TraceSpan;
+
+#ifdef SAFETRIX_ENABLE_TRACE
+#define TRACE_BEGIN(span, spanName) TraceSpan span = Trace_Begin(spanName)
+#define TRACE_END(span) Trace_End(&span)
+#else
+#define TRACE_BEGIN(span, spanName) ((void)0)
+#define TRACE_END(span) ((void)0)
+#endif
+
+TraceSpan Trace_Begin(const char* name);
+void Trace_End(const TraceSpan* span);
+
+// Record a span whose timing was measured by the caller (nanoseconds from Thread_NowNs)
+void Trace_Record(const char* name, uint64_t startNs, uint64_t endNs);
+
+// Label the calling thread in the exported trace (copied, at most 31 bytes)
+void Trace_SetThreadName(const char* name);
+
+// Non-zero when spans are being recorded
+int Trace_IsEnabled(void);
+
+// Write every recorded span to path. Call while traced threads are idle. Returns 0 on success
+int Trace_WriteChrome(const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UTILS_TRACE_H
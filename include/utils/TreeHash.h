@@ -0,0 +1,84 @@
+﻿#ifndef UTILS_TREE_HASH_H
+#define UTILS_TREE_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// BLAKE3-compatible tree hash (unkeyed, 32-byte output).
+// The input is split into 1 KiB chunks that form a binary Merkle tree; any aligned
+// power-of-two run of chunks is an independent subtree, so files are hashed as
+// fixed-size leaves in parallel and only the leaves touching a modified range
+// need to be re-hashed.
+
+#define TREEHASH_OUT_LEN 32
+#define TREEHASH_CHUNK_LEN 1024
+#define TREEHASH_LEAF_CHUNKS 1024
+#define TREEHASH_LEAF_SIZE ((uint64_t)TREEHASH_CHUNK_LEN * TREEHASH_LEAF_CHUNKS) // 1 MiB
+
+// Per-leaf chaining values of a file, kept to support incremental re-hashing
+typedef struct TreeHashLeaves
+{
+    uint64_t fileSize;
+    uint64_t leafCount;
+    uint8_t (*cvs)[TREEHASH_OUT_LEN];
+} TreeHashLeaves;
+
+// Hash an in-memory buffer
+void TreeHash_Hash(const uint8_t* data, size_t length, uint8_t out[TREEHASH_OUT_LEN]);
+
+// Hash a whole file using up to `threads` workers (<= 0: all CPUs). Returns 0 on success
+int TreeHash_File(const char* path, int threads, uint8_t out[TREEHASH_OUT_LEN]);
+
+// (Re)compute leaf chaining values from firstLeaf to the end of the file.
+// leaves must be zero-initialised on first use; it is (re)allocated when the file size changes,
+// in which case all leaves are recomputed. Returns 0 on success
+int TreeHash_ComputeLeaves(const char* path, uint64_t firstLeaf, int threads, TreeHashLeaves* leaves);
+
+// Derive the root hash from up-to-date leaves (single-leaf files are re-read from path)
+int TreeHash_RootFromLeaves(const char* path, const TreeHashLeaves* leaves, uint8_t out[TREEHASH_OUT_LEN]);
+
+void TreeHash_FreeLeaves(TreeHashLeaves* leaves);
+
+// Incremental hashing of a file while it is written in offset order, so the root is known without
+// reading the file back. Each leaf is hashed as soon as its last byte arrives; the last leaf is
+// finalised by TreeHash_StreamFinish
+typedef struct TreeHashStream
+{
+    TreeHashLeaves leaves; // sized for the whole file by TreeHash_StreamBegin
+    uint64_t done;         // leading leaves whose chaining values are final
+    uint64_t offset;       // bytes fed so far
+    uint8_t* partial;      // bytes of the current leaf that are not hashed yet
+    size_t fill;
+    int failed;
+} TreeHashStream;
+
+// Start hashing a file of `size` bytes. When resuming at a non-zero offset, the leaves before the
+// resume leaf are taken from `checkpoint` (may be NULL) and only the ones missing there are re-hashed
+// from `path`; the written start of the resume leaf is read back from `path`.
+// Returns 0 on success; the stream must be freed either way
+int TreeHash_StreamBegin(TreeHashStream* s, uint64_t size, uint64_t offset, const char* path, const char* checkpoint,
+                         int threads);
+
+// Feed the next bytes of the file. Feeding more than `size` bytes fails the stream
+void TreeHash_StreamUpdate(TreeHashStream* s, const uint8_t* data, size_t len);
+
+// Save the chaining values of the completed leaves for a later TreeHash_StreamBegin. Returns 0 on success
+int TreeHash_StreamSave(const TreeHashStream* s, const char* checkpoint);
+
+// Produce the root once exactly `size` bytes were fed. Returns 0 on success
+int TreeHash_StreamFinish(TreeHashStream* s, uint8_t out[TREEHASH_OUT_LEN]);
+
+void TreeHash_StreamFree(TreeHashStream* s);
+
+// Format a hash as lowercase hex (out must hold 2 * TREEHASH_OUT_LEN + 1 bytes)
+void TreeHash_ToHex(const uint8_t hash[TREEHASH_OUT_LEN], char* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UTILS_TREE_HASH_H
@@ -0,0 +1,263 @@
+﻿// SafeTrix 加密内核微基准
+// 对每个已注册的 CipherFunc / CipherBatchFunc，按缓冲区大小 (64 B ~ 64 MB)、
+// 内存对齐偏移和 keyIndex 相位做扫描，输出 GB/s 与 cycles/byte，并写入 JSON 以便跨机器对比。
+//
+// 用法: SafeTrixCipherBench [--out FILE] [--reps N] [--max-size BYTES] [--quick]
+
+#include "core/Security.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+#define BENCH_MIN_SIZE ((size_t)64)
+#define BENCH_MAX_SIZE ((size_t)64 * 1024 * 1024)
+#define BENCH_BASE_ALIGN 64
+
+static const size_t g_alignments[] = {0, 1, 7};
+static const size_t g_phases[] = {0, 13};
+
+typedef struct BenchResult
+{
+    const char* algorithm;
+    const char* api;
+    size_t size;
+    size_t align;
+    size_t phase;
+    int reps;
+    uint64_t iterations;
+    double bestGBps;
+    double medianGBps;
+    double cyclesPerByte; // < 0 表示平台不支持 TSC
+} BenchResult;
+
+static uint64_t now_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, cnt;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+    return (uint64_t)((double)cnt.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t read_tsc(void)
+{
+#if BENCH_HAS_TSC
+    return (uint64_t)__rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// 运行一次计时样本：iterations 次调用，返回耗时 (ns) 与 TSC 周期
+static void run_sample(const CipherAlgorithmInfo* algo, int useBatch, uint8_t* buf, size_t size, size_t phase,
+                       uint64_t iterations, uint64_t* outNs, uint64_t* outCycles)
+{
+    CryptoContext ctx;
+    InitSecurity(&ctx, "SecretKey123");
+    ctx.algorithm = algo->func;
+    ctx.batchAlgorithm = algo->batchFunc;
+
+    uint64_t t0 = now_ns();
+    uint64_t c0 = read_tsc();
+    for (uint64_t it = 0; it < iterations; ++it)
+    {
+        if (useBatch)
+        {
+            EncryptBufferAt(&ctx, buf, size, phase + it * size);
+        }
+        else
+        {
+            ctx.keyIndex = phase % ctx.keyLen;
+            EncryptBuffer(buf, size, &ctx);
+        }
+    }
+    uint64_t c1 = read_tsc();
+    uint64_t t1 = now_ns();
+
+    *outNs = t1 - t0;
+    *outCycles = c1 - c0;
+}
+
+static void write_json(FILE* out, const BenchResult* results, size_t count, int reps)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"benchmark\": \"SafeTrixCipherBench\",\n");
+#if defined(__VERSION__)
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+#elif defined(_MSC_VER)
+    fprintf(out, "  \"compiler\": \"MSVC %d\",\n", _MSC_VER);
+#endif
+    fprintf(out, "  \"cycles_source\": \"%s\",\n", BENCH_HAS_TSC ? "tsc" : "none");
+    fprintf(out, "  \"reps\": %d,\n", reps);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < count; ++i)
+    {
+        const BenchResult* r = &results[i];
+        fprintf(out, "    {\"algorithm\": \"%s\", \"api\": \"%s\", \"size\": %zu, \"align\": %zu, \"phase\": %zu, "
+                "\"iterations\": %llu, \"best_gbps\": %.4f, \"median_gbps\": %.4f, ",
+                r->algorithm, r->api, r->size, r->align, r->phase,
+                (unsigned long long)r->iterations, r->bestGBps, r->medianGBps);
+        if (r->cyclesPerByte >= 0.0) fprintf(out, "\"cycles_per_byte\": %.4f}", r->cyclesPerByte);
+        else fprintf(out, "\"cycles_per_byte\": null}");
+        fprintf(out, "%s\n", (i + 1 < count) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void print_usage(const char* prog)
+{
+    printf("用法: %s [--out FILE] [--reps N] [--max-size BYTES] [--quick]\n", prog);
+    printf("  --out FILE        JSON 输出路径 (默认 cipher_bench.json)\n");
+    printf("  --reps N          每个配置的计时重复次数 (默认 5)\n");
+    printf("  --max-size BYTES  最大缓冲区大小 (默认 %zu)\n", BENCH_MAX_SIZE);
+    printf("  --quick           减少每个样本的数据量，快速冒烟\n");
+}
+
+int main(int argc, char* argv[])
+{
+    const char* outPath = "cipher_bench.json";
+    int reps = 5;
+    size_t maxSize = BENCH_MAX_SIZE;
+    uint64_t bytesPerSample = 64ull * 1024 * 1024;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) outPath = argv[++i];
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) maxSize = (size_t)strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--quick") == 0) bytesPerSample = 4ull * 1024 * 1024;
+        else
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (reps < 1) reps = 1;
+    if (maxSize < BENCH_MIN_SIZE) maxSize = BENCH_MIN_SIZE;
+    if (maxSize > BENCH_MAX_SIZE) maxSize = BENCH_MAX_SIZE;
+
+    int algoCount = 0;
+    const CipherAlgorithmInfo* algos = GetCipherAlgorithms(&algoCount);
+
+    size_t sizeCount = 0;
+    for (size_t s = BENCH_MIN_SIZE; s <= maxSize; s *= 4) sizeCount++;
+    size_t alignCount = sizeof(g_alignments) / sizeof(g_alignments[0]);
+    size_t phaseCount = sizeof(g_phases) / sizeof(g_phases[0]);
+    size_t maxResults = (size_t)algoCount * 2 * sizeCount * alignCount * phaseCount;
+
+    BenchResult* results = (BenchResult*)calloc(maxResults, sizeof(BenchResult));
+    double* samples = (double*)malloc(sizeof(double) * (size_t)reps);
+    uint8_t* raw = (uint8_t*)malloc(maxSize + 2 * BENCH_BASE_ALIGN);
+    if (!results || !samples || !raw)
+    {
+        fprintf(stderr, "内存分配失败\n");
+        free(results);
+        free(samples);
+        free(raw);
+        return 1;
+    }
+    uint8_t* base = (uint8_t*)(((uintptr_t)raw + BENCH_BASE_ALIGN - 1) & ~(uintptr_t)(BENCH_BASE_ALIGN - 1));
+    for (size_t i = 0; i < maxSize + BENCH_BASE_ALIGN; ++i) base[i] = (uint8_t)(i * 131u + 7u);
+
+    printf("%-8s %-3s %10s %5s %5s %10s %10s %8s\n", "algo", "api", "size", "align", "phase", "best GB/s", "med GB/s",
+           "cyc/B");
+
+    size_t resultCount = 0;
+    for (int a = 0; a < algoCount; ++a)
+    {
+        for (int useBatch = 0; useBatch <= 1; ++useBatch)
+        {
+            for (size_t size = BENCH_MIN_SIZE; size <= maxSize; size *= 4)
+            {
+                uint64_t iterations = bytesPerSample / size;
+                if (iterations < 1) iterations = 1;
+
+                for (size_t ai = 0; ai < alignCount; ++ai)
+                {
+                    for (size_t pi = 0; pi < phaseCount; ++pi)
+                    {
+                        uint8_t* buf = base + g_alignments[ai];
+                        uint64_t ns = 0, cycles = 0, bestCycles = UINT64_MAX;
+
+                        // 预热：触发缺页并填充缓存
+                        run_sample(&algos[a], useBatch, buf, size, g_phases[pi], iterations, &ns, &cycles);
+
+                        for (int r = 0; r < reps; ++r)
+                        {
+                            run_sample(&algos[a], useBatch, buf, size, g_phases[pi], iterations, &ns, &cycles);
+                            if (ns == 0) ns = 1;
+                            samples[r] = (double)size * (double)iterations / (double)ns; // bytes/ns == GB/s
+                            if (cycles < bestCycles) bestCycles = cycles;
+                        }
+                        qsort(samples, (size_t)reps, sizeof(double), compare_double);
+
+                        BenchResult* res = &results[resultCount++];
+                        res->algorithm = algos[a].name;
+                        res->api = useBatch ? "v2" : "v1";
+                        res->size = size;
+                        res->align = g_alignments[ai];
+                        res->phase = g_phases[pi];
+                        res->reps = reps;
+                        res->iterations = iterations;
+                        res->bestGBps = samples[reps - 1];
+                        res->medianGBps = samples[reps / 2];
+                        res->cyclesPerByte = BENCH_HAS_TSC
+                                                 ? (double)bestCycles / ((double)size * (double)iterations)
+                                                 : -1.0;
+
+                        printf("%-8s %-3s %10zu %5zu %5zu %10.3f %10.3f %8.3f\n", res->algorithm, res->api,
+                               res->size, res->align, res->phase, res->bestGBps, res->medianGBps,
+                               res->cyclesPerByte);
+                    }
+                }
+            }
+        }
+    }
+
+    FILE* out = fopen(outPath, "w");
+    if (!out)
+    {
+        fprintf(stderr, "无法写入 JSON 输出: %s\n", outPath);
+    }
+    else
+    {
+        write_json(out, results, resultCount, reps);
+        fclose(out);
+        printf("结果已写入 %s\n", outPath);
+    }
+
+    free(results);
+    free(samples);
+    free(raw);
+    return out ? 0 : 1;
+}
@@ -0,0 +1,441 @@
+﻿#include "core/DirSync.h"
+#include "core/TransferEngine.h"
+#include "common/ErrorCode.h"
+#include "data/Logger.h"
+#include "data/SyncIndex.h"
+#include "utils/FileUtils.h"
+#include "utils/Thread.h"
+#include "utils/Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <stdatomic.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define DIRSYNC_MAX_JOBS 64
+#define DIRSYNC_TASK_PATH 256 // TransferTask 中路径缓冲区的大小
+#define DIRSYNC_PATH_MAX 4096
+
+// 源文件相对于索引的状态，按索引下标记录。每个路径只会被一个线程遍历到，各线程写入不同的字节
+#define SEEN_NONE 0 // 源目录中已不存在
+#define SEEN_UNCHANGED 1
+#define SEEN_CHANGED 2
+
+// 需要传输的文件 (新增或大小 / 修改时间变化)
+typedef struct SyncFile
+{
+    char* rel;
+    uint64_t size;
+    uint64_t mtimeNs;
+    TransferTask* task;
+    int ok;
+} SyncFile;
+
+typedef struct SyncList
+{
+    SyncFile* items;
+    size_t count;
+    size_t cap;
+} SyncList;
+
+// 一个线程遍历一个目录的结果，在锁内一次并入共享状态
+typedef struct WalkBatch
+{
+    SyncList changed;
+    char** dirs;
+    size_t dirCount;
+    size_t dirCap;
+    uint64_t scanned;
+    uint64_t unchanged;
+    uint64_t failed;
+} WalkBatch;
+
+typedef struct DirWalk
+{
+    const char* root;
+    const SyncIndex* index;
+    uint8_t* seen;
+
+    Mutex lock;
+    CondVar more;
+    char** dirs; // 待遍历的相对目录栈，"" 为根目录
+    size_t dirCount;
+    size_t dirCap;
+    int busy; // 正在遍历目录的线程数；为 0 且栈为空时遍历结束
+    SyncList changed;
+    uint64_t scanned;
+    uint64_t unchanged;
+    uint64_t failed;
+} DirWalk;
+
+static int list_push(SyncList* l, const SyncFile* f)
+{
+    if (l->count == l->cap)
+    {
+        size_t cap = l->cap ? l->cap * 2 : 256;
+        SyncFile* items = (SyncFile*)realloc(l->items, sizeof(SyncFile) * cap);
+        if (!items) return -1;
+        l->items = items;
+        l->cap = cap;
+    }
+    l->items[l->count++] = *f;
+    return 0;
+}
+
+static int dirs_push(char*** dirs, size_t* count, size_t* cap, char* dir)
+{
+    if (*count == *cap)
+    {
+        size_t grown = *cap ? *cap * 2 : 64;
+        char** list = (char**)realloc(*dirs, sizeof(char*) * grown);
+        if (!list) return -1;
+        *dirs = list;
+        *cap = grown;
+    }
+    (*dirs)[(*count)++] = dir;
+    return 0;
+}
+
+static uint64_t mtime_ns(const struct stat* st)
+{
+#ifdef __APPLE__
+    return (uint64_t)st->st_mtimespec.tv_sec * 1000000000ull + (uint64_t)st->st_mtimespec.tv_nsec;
+#else
+    return (uint64_t)st->st_mtim.tv_sec * 1000000000ull + (uint64_t)st->st_mtim.tv_nsec;
+#endif
+}
+
+// 遍历一个目录：不变的文件只做一次 fstatat 与索引查找，不分配内存
+static void walk_dir(DirWalk* w, const char* rel, WalkBatch* b)
+{
+    char path[DIRSYNC_PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s%s", w->root, rel[0] ? "/" : "", rel);
+    DIR* d = opendir(path);
+    if (!d)
+    {
+        Logger_Log(LOG_WARNING, "目录同步: 无法遍历 %s", path);
+        b->failed++;
+        return;
+    }
+
+    char relPath[DIRSYNC_PATH_MAX];
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        const char* name = ent->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        int n = snprintf(relPath, sizeof(relPath), "%s%s%s", rel, rel[0] ? "/" : "", name);
+        struct stat st;
+        if (n >= (int)sizeof(relPath) || fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            b->failed++;
+            continue;
+        }
+        if (S_ISDIR(st.st_mode))
+        {
+            char* sub = strdup(relPath);
+            if (!sub || dirs_push(&b->dirs, &b->dirCount, &b->dirCap, sub) != 0)
+            {
+                free(sub);
+                b->failed++;
+            }
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) continue;
+
+        b->scanned++;
+        SyncFile f = {NULL, (uint64_t)st.st_size, mtime_ns(&st), NULL, 0};
+        const SyncIndexEntry* e = SyncIndex_Find(w->index, relPath);
+        int same = e && e->size == f.size && e->mtimeNs == f.mtimeNs;
+        if (e) w->seen[e - w->index->entries] = same ? SEEN_UNCHANGED : SEEN_CHANGED;
+        if (same)
+        {
+            b->unchanged++;
+            continue;
+        }
+        f.rel = strdup(relPath);
+        if (!f.rel || list_push(&b->changed, &f) != 0)
+        {
+            free(f.rel);
+            b->failed++;
+        }
+    }
+    closedir(d);
+}
+
+static void walk_worker(void* arg)
+{
+    DirWalk* w = (DirWalk*)arg;
+    WalkBatch b;
+    memset(&b, 0, sizeof(b));
+
+    Mutex_Lock(&w->lock);
+    for (;;)
+    {
+        while (w->dirCount == 0 && w->busy > 0) CondVar_Wait(&w->more, &w->lock);
+        if (w->dirCount == 0) break;
+        char* rel = w->dirs[--w->dirCount];
+        w->busy++;
+        Mutex_Unlock(&w->lock);
+
+        walk_dir(w, rel, &b);
+        free(rel);
+
+        Mutex_Lock(&w->lock);
+        w->busy--;
+        for (size_t i = 0; i < b.dirCount; ++i)
+        {
+            if (dirs_push(&w->dirs, &w->dirCount, &w->dirCap, b.dirs[i]) != 0)
+            {
+                free(b.dirs[i]);
+                w->failed++;
+            }
+        }
+        for (size_t i = 0; i < b.changed.count; ++i)
+        {
+            if (list_push(&w->changed, &b.changed.items[i]) != 0)
+            {
+                free(b.changed.items[i].rel);
+                w->failed++;
+            }
+        }
+        w->scanned += b.scanned;
+        w->unchanged += b.unchanged;
+        w->failed += b.failed;
+        if (b.dirCount > 0 || w->busy == 0) CondVar_Broadcast(&w->more);
+        b.dirCount = 0;
+        b.changed.count = 0;
+        b.scanned = b.unchanged = b.failed = 0;
+    }
+    CondVar_Broadcast(&w->more);
+    Mutex_Unlock(&w->lock);
+    free(b.dirs);
+    free(b.changed.items);
+}
+
+typedef struct SyncRun
+{
+    SyncFile* files;
+    size_t count;
+    atomic_size_t next;
+    DirSyncFileCallback onFile;
+    void* user;
+} SyncRun;
+
+static void run_worker(void* arg)
+{
+    SyncRun* r = (SyncRun*)arg;
+    for (;;)
+    {
+        size_t i = atomic_fetch_add(&r->next, 1);
+        if (i >= r->count) break;
+        SyncFile* f = &r->files[i];
+        if (!f->task) continue; // 任务未能创建，已报告
+        int rc = RunTask(f->task);
+        f->ok = rc == 0 && f->task->status == TASK_COMPLETED;
+        if (r->onFile) r->onFile(f->ok ? "transferred" : "failed", f->rel, f->task->id, r->user);
+    }
+}
+
+// 在 jobs 个线程上运行 fn (jobs 为 1 时直接在当前线程运行)
+static void run_parallel(ThreadFunc fn, void* arg, int jobs)
+{
+    Thread threads[DIRSYNC_MAX_JOBS];
+    int started = 0;
+    for (int i = 1; i < jobs; ++i)
+    {
+        if (Thread_Create(&threads[started], fn, arg) == 0) started++;
+    }
+    fn(arg);
+    for (int i = 0; i < started; ++i) Thread_Join(threads[i]);
+}
+
+static int compare_files(const void* a, const void* b)
+{
+    return strcmp(((const SyncFile*)a)->rel, ((const SyncFile*)b)->rel);
+}
+
+// 去掉末尾的路径分隔符 ("/" 本身保留)
+static void trim_dir(const char* in, char* out, size_t size)
+{
+    snprintf(out, size, "%s", in);
+    size_t len = strlen(out);
+    while (len > 1 && out[len - 1] == '/') out[--len] = '\0';
+}
+
+int DirSync_Run(const char* srcDir, const char* destDir, const DirSyncOptions* options,
+                DirSyncFileCallback onFile, void* user, DirSyncStats* out)
+{
+    static const DirSyncOptions defaults = {{TASK_MODE_ENCRYPT, TASK_CACHE_DEFAULT}, 0, 0, NULL};
+    if (!options) options = &defaults;
+    DirSyncStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (out) *out = stats;
+
+    char root[DIRSYNC_PATH_MAX];
+    char dest[DIRSYNC_PATH_MAX];
+    char indexPath[DIRSYNC_PATH_MAX];
+    trim_dir(srcDir, root, sizeof(root));
+    trim_dir(destDir, dest, sizeof(dest));
+    if (options->indexPath) snprintf(indexPath, sizeof(indexPath), "%s", options->indexPath);
+    else snprintf(indexPath, sizeof(indexPath), "%s/%s", dest, DIRSYNC_INDEX_NAME);
+
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        Logger_Log(LOG_ERROR, "目录同步: 无法打开源目录 %s", root);
+        return ERR_FILE_OPEN;
+    }
+    int jobs = options->jobs > 0 ? options->jobs : Thread_GetCpuCount();
+    if (jobs > DIRSYNC_MAX_JOBS) jobs = DIRSYNC_MAX_JOBS;
+
+    // 1. 加载上次的索引 (损坏时按空索引处理，相当于完整同步)
+    SyncIndex index;
+    if (SyncIndex_Load(indexPath, &index) == ERR_MEMORY) return ERR_MEMORY;
+
+    // 2. 并行遍历源目录，找出新增或变化的文件
+    TRACE_BEGIN(walkSpan, "DirSync.walk");
+    DirWalk w;
+    memset(&w, 0, sizeof(w));
+    w.root = root;
+    w.index = &index;
+    w.seen = (uint8_t*)calloc(index.count ? index.count : 1, 1);
+    char* top = strdup("");
+    if (!w.seen || !top || dirs_push(&w.dirs, &w.dirCount, &w.dirCap, top) != 0)
+    {
+        free(top);
+        free(w.seen);
+        SyncIndex_Free(&index);
+        return ERR_MEMORY;
+    }
+    Mutex_Init(&w.lock);
+    CondVar_Init(&w.more);
+    run_parallel(walk_worker, &w, jobs);
+    CondVar_Destroy(&w.more);
+    Mutex_Destroy(&w.lock);
+    free(w.dirs);
+    TRACE_END(walkSpan);
+    stats.scanned = w.scanned;
+    stats.unchanged = w.unchanged;
+    stats.failed = w.failed;
+
+    // 3. 为变化的文件创建任务 (按路径排序，任务 ID 顺序稳定)，再并行运行
+    SyncFile* files = w.changed.items;
+    size_t fileCount = w.changed.count;
+    if (fileCount > 1) qsort(files, fileCount, sizeof(SyncFile), compare_files);
+    for (size_t i = 0; i < fileCount; ++i)
+    {
+        char src[DIRSYNC_PATH_MAX];
+        char dst[DIRSYNC_PATH_MAX];
+        int ns = snprintf(src, sizeof(src), "%s/%s", root, files[i].rel);
+        int nd = snprintf(dst, sizeof(dst), "%s/%s", dest, files[i].rel);
+        int id = ns < DIRSYNC_TASK_PATH && nd < DIRSYNC_TASK_PATH
+                     ? AddTaskWithOptions(src, dst, 1, &options->task) : ERR_FILE_OPEN;
+        files[i].task = id > 0 ? GetTaskById(id) : NULL;
+        if (!files[i].task)
+        {
+            Logger_Log(LOG_ERROR, "目录同步: 无法为 %s 创建任务 (%d)", files[i].rel, id);
+            stats.failed++;
+            if (onFile) onFile("failed", files[i].rel, 0, user);
+        }
+    }
+    TRACE_BEGIN(runSpan, "DirSync.transfer");
+    SyncRun run;
+    run.files = files;
+    run.count = fileCount;
+    atomic_init(&run.next, 0);
+    run.onFile = onFile;
+    run.user = user;
+    run_parallel(run_worker, &run, fileCount < (size_t)jobs ? (int)(fileCount ? fileCount : 1) : jobs);
+    TRACE_END(runSpan);
+
+    // 4. 合并出新索引：不变的记录保留，传输成功的文件写入新记录，传输失败的文件保留旧记录；
+    // 源中已不存在的文件按选项删除目标副本 (删除失败的记录保留，下次重试)
+    SyncIndexEntry* entries = (SyncIndexEntry*)malloc(sizeof(SyncIndexEntry) * (index.count + fileCount + 1));
+    size_t count = 0;
+    int rc = entries ? ERR_SUCCESS : ERR_MEMORY;
+    for (size_t i = 0; entries && i < index.count; ++i)
+    {
+        const SyncIndexEntry* e = &index.entries[i];
+        if (w.seen[i] == SEEN_UNCHANGED)
+        {
+            entries[count++] = *e;
+        }
+        else if (w.seen[i] == SEEN_NONE && options->deleteRemoved)
+        {
+            char dst[DIRSYNC_PATH_MAX];
+            snprintf(dst, sizeof(dst), "%s/%s", dest, e->path);
+            if (remove(dst) == 0 || errno == ENOENT)
+            {
+                stats.deleted++;
+                if (onFile) onFile("deleted", e->path, 0, user);
+            }
+            else
+            {
+                Logger_Log(LOG_ERROR, "目录同步: 无法删除 %s", dst);
+                stats.failed++;
+                entries[count++] = *e;
+            }
+        }
+    }
+    for (size_t i = 0; i < fileCount; ++i)
+    {
+        if (!files[i].task || !files[i].ok)
+        {
+            // 旧记录与源文件不一致，下次仍会重传；源文件之后被删除时也还能据此删除目标副本
+            const SyncIndexEntry* old = SyncIndex_Find(&index, files[i].rel);
+            if (old && entries) entries[count++] = *old;
+            if (files[i].task) stats.failed++; // 未能创建任务的已经计入
+            continue;
+        }
+        stats.transferred++;
+        stats.bytes += files[i].task->totalSize;
+        if (!entries) continue;
+        SyncIndexEntry* e = &entries[count++];
+        e->path = files[i].rel;
+        e->size = files[i].size;
+        e->mtimeNs = files[i].mtimeNs;
+        memcpy(e->hash, files[i].task->destHash, TREEHASH_OUT_LEN);
+    }
+    if (entries)
+    {
+        FileUtils_Mkdir(dest); // 没有文件需要传输时目标目录可能还不存在
+        rc = SyncIndex_Save(indexPath, entries, count);
+    }
+    if (rc == ERR_SUCCESS && stats.failed > 0) rc = ERR_FILE_WRITE;
+
+    Logger_Log(rc == ERR_SUCCESS ? LOG_INFO : LOG_WARNING,
+               "目录同步 %s -> %s: 扫描 %llu, 未变 %llu, 传输 %llu, 删除 %llu, 失败 %llu", root, dest,
+               (unsigned long long)stats.scanned, (unsigned long long)stats.unchanged,
+               (unsigned long long)stats.transferred, (unsigned long long)stats.deleted,
+               (unsigned long long)stats.failed);
+    free(entries);
+    for (size_t i = 0; i < fileCount; ++i) free(files[i].rel);
+    free(files);
+    free(w.seen);
+    SyncIndex_Free(&index);
+    if (out) *out = stats;
+    return rc;
+}
+
+#else // _WIN32
+
+int DirSync_Run(const char* srcDir, const char* destDir, const DirSyncOptions* options,
+                DirSyncFileCallback onFile, void* user, DirSyncStats* out)
+{
+    (void)srcDir;
+    (void)destDir;
+    (void)options;
+    (void)onFile;
+    (void)user;
+    if (out) memset(out, 0, sizeof(*out));
+    return ERR_FILE_OPEN;
+}
+
+#endif
@@ -0,0 +1,459 @@
+﻿#include "core/Metrics.h"
+#include "core/TaskManager.h"
+#include "data/Logger.h"
+#include "utils/FileUtils.h"
+#include "utils/Thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#define METRICS_THREAD_LOCAL __declspec(thread)
+#else
+#define METRICS_THREAD_LOCAL _Thread_local
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define METRICS_BUCKETS 10
+#define METRICS_POLL_MS 100 // 停止请求的最长响应时间
+
+// 检查点耗时直方图的桶上限 (纳秒)，最后隐含 +Inf
+static const uint64_t CHECKPOINT_BOUNDS_NS[METRICS_BUCKETS] = {
+    100000ull, 500000ull, 1000000ull, 5000000ull, 10000000ull,
+    50000000ull, 100000000ull, 500000000ull, 1000000000ull, 5000000000ull};
+
+static const char* const COUNTER_NAMES[METRIC_COUNTER_COUNT] = {
+    "safetrix_bytes_transferred_total", "safetrix_cipher_seconds_total", "safetrix_io_errors_total",
+    "safetrix_resumes_total", "safetrix_tasks_completed_total"};
+
+static const char* const COUNTER_HELP[METRIC_COUNTER_COUNT] = {
+    "Bytes written to destination files.", "Time spent encrypting chunks.",
+    "Failed opens, seeks, reads and writes.", "Task runs resumed from a non-zero offset.",
+    "Tasks run to completion."};
+
+// 每个线程一个分片，只有所属线程写入；用 relaxed 的读+写代替原子加，导出线程读到的值可能略旧但不会撕裂。
+// 分片在线程退出后保留，已结束线程的计数仍计入总量
+typedef struct MetricsShard
+{
+    struct MetricsShard* next;
+    _Atomic uint64_t counters[METRIC_COUNTER_COUNT];
+    _Atomic uint64_t buckets[METRICS_BUCKETS + 1];
+    _Atomic uint64_t checkpointNs;
+    char pad[64]; // 避免与相邻分片共享缓存行
+} MetricsShard;
+
+static MetricsShard* _Atomic g_shards = NULL;
+static METRICS_THREAD_LOCAL MetricsShard* t_shard = NULL;
+
+// 导出线程维护的速度表，按任务 ID 排序
+typedef struct TaskRate
+{
+    int id;
+    uint64_t offset;
+    uint64_t ns;
+    double mbps;
+} TaskRate;
+
+static Mutex g_lock;
+static TaskRate* g_rates = NULL;
+static int g_rate_count = 0;
+static int g_active = 0;
+static int g_queued = 0;
+
+static Thread g_thread;
+static atomic_int g_stop;
+static int g_running = 0;
+static int g_interval_ms = 0;
+static char g_textfile[1024];
+static char g_socket_path[108];
+#ifndef _WIN32
+static int g_listen_fd = -1;
+#endif
+
+static MetricsShard* current_shard(void)
+{
+    if (t_shard) return t_shard;
+
+    MetricsShard* shard = (MetricsShard*)calloc(1, sizeof(MetricsShard));
+    if (!shard) return NULL;
+    MetricsShard* head = atomic_load(&g_shards);
+    do
+    {
+        shard->next = head;
+    }
+    while (!atomic_compare_exchange_weak(&g_shards, &head, shard));
+
+    t_shard = shard;
+    return shard;
+}
+
+static void shard_add(_Atomic uint64_t* c, uint64_t value)
+{
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void Metrics_Add(MetricCounter counter, uint64_t value)
+{
+    MetricsShard* shard = current_shard();
+    if (!shard || (unsigned)counter >= METRIC_COUNTER_COUNT) return;
+    shard_add(&shard->counters[counter], value);
+}
+
+void Metrics_ObserveCheckpoint(uint64_t ns)
+{
+    MetricsShard* shard = current_shard();
+    if (!shard) return;
+    int b = 0;
+    while (b < METRICS_BUCKETS && ns > CHECKPOINT_BOUNDS_NS[b]) b++;
+    shard_add(&shard->buckets[b], 1);
+    shard_add(&shard->checkpointNs, ns);
+}
+
+// 可增长的输出缓冲
+typedef struct TextBuf
+{
+    char* data;
+    size_t len;
+    size_t cap;
+    int failed;
+} TextBuf;
+
+static void text_append(TextBuf* b, const char* fmt, ...)
+{
+    for (;;)
+    {
+        if (b->failed) return;
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0)
+        {
+            b->failed = 1;
+            return;
+        }
+        if ((size_t)n < b->cap - b->len)
+        {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap * 2 + (size_t)n;
+        char* grown = (char*)realloc(b->data, cap);
+        if (!grown)
+        {
+            b->failed = 1;
+            return;
+        }
+        b->data = grown;
+        b->cap = cap;
+    }
+}
+
+char* Metrics_Render(void)
+{
+    uint64_t counters[METRIC_COUNTER_COUNT] = {0};
+    uint64_t buckets[METRICS_BUCKETS + 1] = {0};
+    uint64_t checkpointNs = 0;
+    for (MetricsShard* s = atomic_load(&g_shards); s; s = s->next)
+    {
+        for (int i = 0; i < METRIC_COUNTER_COUNT; ++i)
+        {
+            counters[i] += atomic_load_explicit(&s->counters[i], memory_order_relaxed);
+        }
+        for (int i = 0; i <= METRICS_BUCKETS; ++i)
+        {
+            buckets[i] += atomic_load_explicit(&s->buckets[i], memory_order_relaxed);
+        }
+        checkpointNs += atomic_load_explicit(&s->checkpointNs, memory_order_relaxed);
+    }
+
+    TextBuf b = {NULL, 0, 4096, 0};
+    b.data = (char*)malloc(b.cap);
+    if (!b.data) return NULL;
+    b.data[0] = '\0';
+
+    for (int i = 0; i < METRIC_COUNTER_COUNT; ++i)
+    {
+        text_append(&b, "# HELP %s %s\n# TYPE %s counter\n", COUNTER_NAMES[i], COUNTER_HELP[i], COUNTER_NAMES[i]);
+        if (i == METRIC_CIPHER_NS) text_append(&b, "%s %.9f\n", COUNTER_NAMES[i], (double)counters[i] / 1e9);
+        else text_append(&b, "%s %llu\n", COUNTER_NAMES[i], (unsigned long long)counters[i]);
+    }
+
+    text_append(&b, "# HELP safetrix_checkpoint_duration_seconds Time taken by task checkpoints.\n"
+                    "# TYPE safetrix_checkpoint_duration_seconds histogram\n");
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRICS_BUCKETS; ++i)
+    {
+        cumulative += buckets[i];
+        text_append(&b, "safetrix_checkpoint_duration_seconds_bucket{le=\"%g\"} %llu\n",
+                    (double)CHECKPOINT_BOUNDS_NS[i] / 1e9, (unsigned long long)cumulative);
+    }
+    cumulative += buckets[METRICS_BUCKETS];
+    text_append(&b, "safetrix_checkpoint_duration_seconds_bucket{le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+    text_append(&b, "safetrix_checkpoint_duration_seconds_sum %.9f\n", (double)checkpointNs / 1e9);
+    text_append(&b, "safetrix_checkpoint_duration_seconds_count %llu\n", (unsigned long long)cumulative);
+
+    // 任务数与速度只在导出线程运行时维护
+    int running = g_running;
+    if (running) Mutex_Lock(&g_lock);
+    double total = 0.0;
+    text_append(&b, "# HELP safetrix_tasks_active Tasks currently running.\n# TYPE safetrix_tasks_active gauge\n"
+                    "safetrix_tasks_active %d\n", g_active);
+    text_append(&b, "# HELP safetrix_tasks_queued Tasks waiting or paused.\n# TYPE safetrix_tasks_queued gauge\n"
+                    "safetrix_tasks_queued %d\n", g_queued);
+    text_append(&b, "# HELP safetrix_task_throughput_mbps Current transfer rate of each running task.\n"
+                    "# TYPE safetrix_task_throughput_mbps gauge\n");
+    for (int i = 0; i < g_rate_count; ++i)
+    {
+        text_append(&b, "safetrix_task_throughput_mbps{task=\"%d\"} %.3f\n", g_rates[i].id, g_rates[i].mbps);
+        total += g_rates[i].mbps;
+    }
+    if (running) Mutex_Unlock(&g_lock);
+    text_append(&b, "# HELP safetrix_throughput_mbps Current transfer rate of all running tasks.\n"
+                    "# TYPE safetrix_throughput_mbps gauge\nsafetrix_throughput_mbps %.3f\n", total);
+
+    if (b.failed)
+    {
+        free(b.data);
+        return NULL;
+    }
+    return b.data;
+}
+
+static int compare_rate(const void* a, const void* b)
+{
+    int x = ((const TaskRate*)a)->id;
+    int y = ((const TaskRate*)b)->id;
+    return (x > y) - (x < y);
+}
+
+// 从任务快照重新统计任务数，并按两次刷新之间的偏移增量计算运行中任务的速度
+static void update_rates(void)
+{
+    TransferTask* list = NULL;
+    int count = TaskManager_SnapshotAll(&list);
+    if (count < 0) return;
+
+    uint64_t now = Thread_NowNs();
+    int active = 0;
+    int queued = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (list[i].status == TASK_RUNNING) active++;
+        else if (list[i].status == TASK_WAITING || list[i].status == TASK_PAUSED) queued++;
+    }
+
+    TaskRate* rates = active > 0 ? (TaskRate*)malloc(sizeof(TaskRate) * (size_t)active) : NULL;
+    int n = 0;
+    Mutex_Lock(&g_lock);
+    for (int i = 0; rates && i < count; ++i)
+    {
+        if (list[i].status != TASK_RUNNING) continue;
+        TaskRate key;
+        key.id = list[i].id;
+        const TaskRate* prev = g_rate_count > 0
+                                   ? (const TaskRate*)bsearch(&key, g_rates, (size_t)g_rate_count, sizeof(TaskRate),
+                                                              compare_rate)
+                                   : NULL;
+        TaskRate* r = &rates[n++];
+        r->id = list[i].id;
+        r->offset = list[i].currentOffset;
+        r->ns = now;
+        r->mbps = 0.0;
+        if (prev && now > prev->ns && r->offset >= prev->offset)
+        {
+            r->mbps = (double)(r->offset - prev->offset) * 1e9 / (double)(now - prev->ns) / (1024.0 * 1024.0);
+        }
+    }
+    if (n > 1) qsort(rates, (size_t)n, sizeof(TaskRate), compare_rate);
+    free(g_rates);
+    g_rates = rates;
+    g_rate_count = n;
+    g_active = active;
+    g_queued = queued;
+    Mutex_Unlock(&g_lock);
+    free(list);
+}
+
+// 先写临时文件再改名，textfile collector 不会读到写了一半的文件
+static void write_textfile(void)
+{
+    if (g_textfile[0] == '\0') return;
+    char* text = Metrics_Render();
+    if (!text) return;
+
+    char tmpPath[1040];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", g_textfile);
+    FILE* fp = FileUtils_OpenFileUTF8(tmpPath, "w");
+    if (fp)
+    {
+        size_t len = strlen(text);
+        int ok = fwrite(text, 1, len, fp) == len;
+        ok = fclose(fp) == 0 && ok;
+#ifdef _WIN32
+        if (ok) remove(g_textfile); // Windows 下 rename 不会覆盖已存在的文件
+#endif
+        if (!ok || rename(tmpPath, g_textfile) != 0)
+        {
+            remove(tmpPath);
+        }
+    }
+    free(text);
+}
+
+#ifndef _WIN32
+static int open_socket(const char* path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path); // 上次异常退出残留的套接字文件
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 每个连接写出一份完整指标后关闭，例如 socat - UNIX-CONNECT:data/metrics.sock
+static void serve_client(int listenFd)
+{
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) return;
+
+    struct timeval tv = {1, 0}; // 客户端不读时最多阻塞导出线程 1 秒
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    update_rates(); // 任务数与速度按本次读取时刻刷新
+    char* text = Metrics_Render();
+    if (text)
+    {
+        size_t len = strlen(text);
+        size_t off = 0;
+        while (off < len)
+        {
+            ssize_t n = send(fd, text + off, len - off, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            off += (size_t)n;
+        }
+        free(text);
+    }
+    close(fd);
+}
+#endif
+
+static void exporter_thread(void* arg)
+{
+    (void)arg;
+    uint64_t next = Thread_NowNs();
+    while (!atomic_load(&g_stop))
+    {
+        uint64_t now = Thread_NowNs();
+        if (now >= next)
+        {
+            update_rates();
+            write_textfile();
+            next += (uint64_t)g_interval_ms * 1000000ull;
+            if (next < now) next = now;
+        }
+
+        uint64_t waitMs = (next - now) / 1000000ull;
+        if (waitMs > METRICS_POLL_MS) waitMs = METRICS_POLL_MS;
+#ifndef _WIN32
+        if (g_listen_fd >= 0)
+        {
+            struct pollfd pfd = {g_listen_fd, POLLIN, 0};
+            if (poll(&pfd, 1, (int)waitMs) > 0 && (pfd.revents & POLLIN)) serve_client(g_listen_fd);
+            continue;
+        }
+#endif
+        Thread_SleepMs((unsigned int)waitMs);
+    }
+}
+
+int Metrics_Start(const char* textfilePath, const char* socketPath, int intervalMs)
+{
+    if (g_running) return -1;
+
+    Mutex_Init(&g_lock);
+    g_interval_ms = intervalMs > 0 ? intervalMs : 5000;
+    g_textfile[0] = '\0';
+    g_socket_path[0] = '\0';
+    if (textfilePath)
+    {
+        strncpy(g_textfile, textfilePath, sizeof(g_textfile) - 1);
+        g_textfile[sizeof(g_textfile) - 1] = '\0';
+    }
+    if (socketPath)
+    {
+#ifdef _WIN32
+        Logger_Log(LOG_WARNING, "当前平台不支持 Unix 域套接字，指标只写入文件");
+#else
+        g_listen_fd = open_socket(socketPath);
+        if (g_listen_fd < 0)
+        {
+            Logger_Log(LOG_WARNING, "无法监听指标套接字: %s", socketPath);
+        }
+        else
+        {
+            strncpy(g_socket_path, socketPath, sizeof(g_socket_path) - 1);
+            g_socket_path[sizeof(g_socket_path) - 1] = '\0';
+        }
+#endif
+    }
+
+    atomic_store(&g_stop, 0);
+    g_running = 1;
+    if (Thread_Create(&g_thread, exporter_thread, NULL) != 0)
+    {
+        g_running = 0;
+#ifndef _WIN32
+        if (g_listen_fd >= 0)
+        {
+            close(g_listen_fd);
+            g_listen_fd = -1;
+            unlink(g_socket_path);
+        }
+#endif
+        Mutex_Destroy(&g_lock);
+        return -1;
+    }
+    return 0;
+}
+
+void Metrics_Stop(void)
+{
+    if (!g_running) return;
+
+    atomic_store(&g_stop, 1);
+    Thread_Join(g_thread);
+    update_rates();
+    write_textfile();
+
+#ifndef _WIN32
+    if (g_listen_fd >= 0)
+    {
+        close(g_listen_fd);
+        g_listen_fd = -1;
+        unlink(g_socket_path);
+    }
+#endif
+    free(g_rates);
+    g_rates = NULL;
+    g_rate_count = 0;
+    Mutex_Destroy(&g_lock);
+    g_running = 0;
+}
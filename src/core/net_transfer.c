@@ -0,0 +1,725 @@
+﻿#include "core/NetTransfer.h"
+#include "core/TransferEngine.h"
+#include "core/Security.h"
+#include "core/Metrics.h"
+#include "common/ErrorCode.h"
+#include "data/Logger.h"
+#include "utils/Algorithm.h"
+#include "utils/BufferPool.h"
+#include "utils/Thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NET_MAGIC 0x4E585453u   // "STXN"
+#define STATE_MAGIC 0x52585453u // "STXR"
+#define NET_VERSION 1
+#define NET_TYPE_CONTROL 1
+#define NET_TYPE_DATA 2
+#define NET_MAX_STREAMS 64
+#define NET_MIN_CHUNK 4096
+#define NET_MAX_CHUNK (64 * 1024 * 1024)
+#define NET_CONTROL_HELLO_BYTES 24 // magic u32, version u16, type u16, streams u32, chunk u32, size u64
+#define NET_DATA_HELLO_BYTES 16    // magic u32, version u16, type u16, session u32, stream u32
+#define NET_FRAME_BYTES 16         // offset u64, length u32, crc32 u32；length 为 0 表示该流结束
+#define NET_COMMIT_BYTES (64ull * 1024 * 1024) // 接收端每收到这么多数据落盘并提交一次位图
+#define NET_ACCEPT_TIMEOUT_MS 10000
+
+struct NetListener
+{
+    int fd;
+    int port;
+};
+
+// ---------------------------------------------------------------- 编码 (小端)
+
+static void put_u16(uint8_t* p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_u64(uint8_t* p, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint16_t get_u16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+static uint64_t get_u64(const uint8_t* p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+// ---------------------------------------------------------------- 套接字
+
+static int send_all(int fd, const void* data, size_t len, int more)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return ERR_NETWORK;
+        p += n;
+        len -= (size_t)n;
+    }
+    return ERR_SUCCESS;
+}
+
+static int recv_all(int fd, void* data, size_t len)
+{
+    uint8_t* p = (uint8_t*)data;
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return ERR_NETWORK;
+        p += n;
+        len -= (size_t)n;
+    }
+    return ERR_SUCCESS;
+}
+
+static int connect_to(const char* host, int port)
+{
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints;
+    struct addrinfo* list = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, service, &hints, &list) != 0) return -1;
+
+    int fd = -1;
+    for (struct addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    return fd;
+}
+
+static int accept_timeout(int listenFd, int timeoutMs)
+{
+    struct pollfd pfd = {listenFd, POLLIN, 0};
+    int rc;
+    do
+    {
+        rc = poll(&pfd, 1, timeoutMs);
+    }
+    while (rc < 0 && errno == EINTR);
+    return rc > 0 ? accept(listenFd, NULL, NULL) : -1;
+}
+
+NetListener* NetTransfer_Listen(const char* host, int port)
+{
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints;
+    struct addrinfo* list = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host, service, &hints, &list) != 0) return NULL;
+
+    int fd = -1;
+    for (struct addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, NET_MAX_STREAMS + 1) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    if (fd < 0) return NULL;
+
+    NetListener* listener = (NetListener*)calloc(1, sizeof(NetListener));
+    if (!listener)
+    {
+        close(fd);
+        return NULL;
+    }
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    char portText[16] = "0";
+    getnameinfo((struct sockaddr*)&addr, len, NULL, 0, portText, sizeof(portText), NI_NUMERICSERV);
+    listener->fd = fd;
+    listener->port = atoi(portText);
+    return listener;
+}
+
+int NetTransfer_ListenerPort(const NetListener* listener)
+{
+    return listener ? listener->port : 0;
+}
+
+void NetTransfer_Close(NetListener* listener)
+{
+    if (!listener) return;
+    close(listener->fd);
+    free(listener);
+}
+
+// ---------------------------------------------------------------- 接收端
+
+typedef struct Receiver
+{
+    int fd;
+    uint64_t fileSize;
+    uint32_t chunkSize;
+    uint32_t chunkCount;
+    uint8_t* bitmap; // 已写入的块 (提交后才保证已落盘)，由 lock 保护
+    Mutex lock;
+    Mutex commitLock;
+    char statePath[1040];
+    atomic_uint_fast64_t done;
+    atomic_uint_fast64_t sinceCommit;
+    NetProgressCallback onProgress;
+    void* user;
+} Receiver;
+
+typedef struct ReceiveStream
+{
+    Receiver* rx;
+    int fd;
+    int ended; // 收到了结束帧
+} ReceiveStream;
+
+static uint64_t chunk_length(uint64_t fileSize, uint32_t chunkSize, uint32_t index)
+{
+    uint64_t offset = (uint64_t)index * chunkSize;
+    return fileSize - offset < chunkSize ? fileSize - offset : chunkSize;
+}
+
+static size_t bitmap_bytes(uint32_t chunkCount)
+{
+    return ((size_t)chunkCount + 7) / 8;
+}
+
+// 读取上次的提交位图；文件大小或块大小不同时视为全新传输
+static void load_state(Receiver* rx)
+{
+    FILE* fp = fopen(rx->statePath, "rb");
+    if (!fp) return;
+    uint8_t header[24];
+    size_t bytes = bitmap_bytes(rx->chunkCount);
+    if (fread(header, 1, sizeof(header), fp) == sizeof(header) && get_u32(header) == STATE_MAGIC &&
+        get_u64(header + 8) == rx->fileSize && get_u32(header + 16) == rx->chunkSize &&
+        get_u32(header + 20) == rx->chunkCount && fread(rx->bitmap, 1, bytes, fp) != bytes)
+    {
+        memset(rx->bitmap, 0, bytes);
+    }
+    fclose(fp);
+}
+
+// 先把已写入的块落盘，再原子地替换位图文件；位图中的块因此一定已持久化
+static void commit_state(Receiver* rx)
+{
+    size_t bytes = bitmap_bytes(rx->chunkCount);
+    uint8_t* copy = (uint8_t*)malloc(24 + bytes);
+    if (!copy) return;
+
+    Mutex_Lock(&rx->commitLock);
+    Mutex_Lock(&rx->lock);
+    memcpy(copy + 24, rx->bitmap, bytes);
+    Mutex_Unlock(&rx->lock);
+
+    put_u32(copy, STATE_MAGIC);
+    put_u32(copy + 4, NET_VERSION);
+    put_u64(copy + 8, rx->fileSize);
+    put_u32(copy + 16, rx->chunkSize);
+    put_u32(copy + 20, rx->chunkCount);
+
+    char tmpPath[1048];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", rx->statePath);
+    FILE* fp = fdatasync(rx->fd) == 0 ? fopen(tmpPath, "wb") : NULL;
+    if (fp)
+    {
+        int ok = fwrite(copy, 1, 24 + bytes, fp) == 24 + bytes;
+        ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0 && ok;
+        ok = fclose(fp) == 0 && ok;
+        if (!ok || rename(tmpPath, rx->statePath) != 0) remove(tmpPath);
+    }
+    Mutex_Unlock(&rx->commitLock);
+    free(copy);
+}
+
+static void receive_stream(void* arg)
+{
+    ReceiveStream* s = (ReceiveStream*)arg;
+    Receiver* rx = s->rx;
+    uint8_t* buffer = (uint8_t*)BufferPool_Acquire(rx->chunkSize);
+    uint8_t header[NET_FRAME_BYTES];
+    while (buffer && recv_all(s->fd, header, sizeof(header)) == ERR_SUCCESS)
+    {
+        uint64_t offset = get_u64(header);
+        uint32_t len = get_u32(header + 8);
+        if (len == 0)
+        {
+            s->ended = 1;
+            break;
+        }
+
+        // 只接受块边界上的完整块
+        uint32_t index = (uint32_t)(offset / rx->chunkSize);
+        if (offset % rx->chunkSize != 0 || index >= rx->chunkCount ||
+            len != chunk_length(rx->fileSize, rx->chunkSize, index))
+        {
+            Logger_Log(LOG_ERROR, "网络接收: 非法数据帧 (offset %llu, len %u)", (unsigned long long)offset, len);
+            break;
+        }
+        if (recv_all(s->fd, buffer, len) != ERR_SUCCESS) break;
+        if (Algorithm_CalculateCRC32(buffer, len) != get_u32(header + 12))
+        {
+            Logger_Log(LOG_ERROR, "网络接收: 块 %u 校验失败", index);
+            break;
+        }
+
+        size_t written = 0;
+        while (written < len)
+        {
+            ssize_t n = pwrite(rx->fd, buffer + written, len - written, (off_t)(offset + written));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            written += (size_t)n;
+        }
+        if (written < len)
+        {
+            Logger_Log(LOG_ERROR, "网络接收: 写入目标文件失败");
+            break;
+        }
+
+        Mutex_Lock(&rx->lock);
+        rx->bitmap[index >> 3] |= (uint8_t)(1u << (index & 7));
+        Mutex_Unlock(&rx->lock);
+        Metrics_Add(METRIC_BYTES_TRANSFERRED, len);
+
+        uint64_t done = atomic_fetch_add(&rx->done, len) + len;
+        if (rx->onProgress) rx->onProgress(done, rx->fileSize, rx->user);
+        if (atomic_fetch_add(&rx->sinceCommit, len) + len >= NET_COMMIT_BYTES)
+        {
+            atomic_store(&rx->sinceCommit, 0);
+            commit_state(rx);
+        }
+    }
+    BufferPool_Release(buffer, rx->chunkSize);
+}
+
+static uint32_t count_missing(const Receiver* rx)
+{
+    uint32_t missing = 0;
+    for (uint32_t i = 0; i < rx->chunkCount; ++i)
+    {
+        if (!(rx->bitmap[i >> 3] & (1u << (i & 7)))) missing++;
+    }
+    return missing;
+}
+
+static int send_reply(int fd, uint32_t status, uint32_t session, uint32_t chunkCount, const uint8_t* bitmap)
+{
+    uint8_t reply[12];
+    put_u32(reply, status);
+    put_u32(reply + 4, session);
+    put_u32(reply + 8, chunkCount);
+    int rc = send_all(fd, reply, sizeof(reply), bitmap != NULL);
+    if (rc == ERR_SUCCESS && bitmap) rc = send_all(fd, bitmap, bitmap_bytes(chunkCount), 0);
+    return rc;
+}
+
+int NetTransfer_Receive(NetListener* listener, const char* destPath, NetProgressCallback onProgress, void* user)
+{
+    if (!listener || !destPath) return ERR_NETWORK;
+
+    // 1. 控制连接：读取文件信息
+    int ctrl = accept(listener->fd, NULL, NULL);
+    if (ctrl < 0) return ERR_NETWORK;
+    uint8_t hello[NET_CONTROL_HELLO_BYTES];
+    if (recv_all(ctrl, hello, sizeof(hello)) != ERR_SUCCESS || get_u32(hello) != NET_MAGIC ||
+        get_u16(hello + 4) != NET_VERSION || get_u16(hello + 6) != NET_TYPE_CONTROL)
+    {
+        close(ctrl);
+        return ERR_NETWORK;
+    }
+    uint32_t streams = get_u32(hello + 8);
+    uint32_t chunkSize = get_u32(hello + 12);
+    uint64_t fileSize = get_u64(hello + 16);
+    uint64_t chunkCount = chunkSize ? (fileSize + chunkSize - 1) / chunkSize : 0;
+    if (streams == 0 || streams > NET_MAX_STREAMS || chunkSize < NET_MIN_CHUNK || chunkSize > NET_MAX_CHUNK ||
+        chunkCount > UINT32_MAX)
+    {
+        send_reply(ctrl, (uint32_t)-ERR_NETWORK, 0, 0, NULL);
+        close(ctrl);
+        return ERR_NETWORK;
+    }
+
+    Receiver rx;
+    memset(&rx, 0, sizeof(rx));
+    rx.fileSize = fileSize;
+    rx.chunkSize = chunkSize;
+    rx.chunkCount = (uint32_t)chunkCount;
+    rx.onProgress = onProgress;
+    rx.user = user;
+    snprintf(rx.statePath, sizeof(rx.statePath), "%s.stxstate", destPath);
+    // 目标文件不存在或大小不符时，旧位图描述的不是这个文件
+    struct stat st;
+    if (stat(destPath, &st) != 0 || (uint64_t)st.st_size != fileSize) remove(rx.statePath);
+    rx.bitmap = (uint8_t*)calloc(bitmap_bytes(rx.chunkCount) + 1, 1);
+    rx.fd = open(destPath, O_RDWR | O_CREAT, 0644);
+    if (!rx.bitmap || rx.fd < 0 || ftruncate(rx.fd, (off_t)fileSize) != 0)
+    {
+        send_reply(ctrl, (uint32_t)-ERR_FILE_OPEN, 0, 0, NULL);
+        if (rx.fd >= 0) close(rx.fd);
+        free(rx.bitmap);
+        close(ctrl);
+        return ERR_FILE_OPEN;
+    }
+    Mutex_Init(&rx.lock);
+    Mutex_Init(&rx.commitLock);
+
+    // 2. 回复已提交的块，发送端据此只发送缺失部分
+    load_state(&rx);
+    uint64_t resumed = 0;
+    for (uint32_t i = 0; i < rx.chunkCount; ++i)
+    {
+        if (rx.bitmap[i >> 3] & (1u << (i & 7))) resumed += chunk_length(fileSize, chunkSize, i);
+    }
+    atomic_init(&rx.done, resumed);
+    atomic_init(&rx.sinceCommit, 0);
+    uint32_t session = (uint32_t)Thread_NowNs() | 1u;
+    int rc = send_reply(ctrl, 0, session, rx.chunkCount, rx.bitmap);
+    if (resumed > 0) Logger_Log(LOG_INFO, "网络接收: 从已提交的 %llu 字节续传", (unsigned long long)resumed);
+    if (onProgress) onProgress(resumed, fileSize, user);
+
+    // 3. 数据连接：每条连接一个线程
+    ReceiveStream rs[NET_MAX_STREAMS];
+    Thread threads[NET_MAX_STREAMS];
+    int started = 0;
+    memset(rs, 0, sizeof(rs));
+    while (rc == ERR_SUCCESS && started < (int)streams)
+    {
+        int fd = accept_timeout(listener->fd, NET_ACCEPT_TIMEOUT_MS);
+        if (fd < 0)
+        {
+            rc = ERR_NETWORK;
+            break;
+        }
+        uint8_t dataHello[NET_DATA_HELLO_BYTES];
+        if (recv_all(fd, dataHello, sizeof(dataHello)) != ERR_SUCCESS || get_u32(dataHello) != NET_MAGIC ||
+            get_u16(dataHello + 6) != NET_TYPE_DATA || get_u32(dataHello + 8) != session)
+        {
+            close(fd); // 其他会话或无关连接
+            continue;
+        }
+        rs[started].rx = &rx;
+        rs[started].fd = fd;
+        if (Thread_Create(&threads[started], receive_stream, &rs[started]) != 0)
+        {
+            close(fd);
+            rc = ERR_NETWORK;
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; ++i)
+    {
+        Thread_Join(threads[i]);
+        close(rs[i].fd);
+        if (!rs[i].ended) rc = ERR_NETWORK;
+    }
+
+    // 4. 提交并回报结果：完整时删除位图，否则保留供续传
+    commit_state(&rx);
+    uint32_t missing = count_missing(&rx);
+    if (missing == 0)
+    {
+        remove(rx.statePath);
+        rc = ERR_SUCCESS;
+    }
+    else if (rc == ERR_SUCCESS)
+    {
+        rc = ERR_NETWORK;
+    }
+    uint8_t result[8];
+    put_u32(result, (uint32_t)-rc);
+    put_u32(result + 4, missing);
+    send_all(ctrl, result, sizeof(result), 0);
+    close(ctrl);
+
+    Mutex_Destroy(&rx.commitLock);
+    Mutex_Destroy(&rx.lock);
+    close(rx.fd);
+    free(rx.bitmap);
+    return rc;
+}
+
+// ---------------------------------------------------------------- 发送端
+
+typedef struct Sender
+{
+    int fd;
+    const char* host;
+    int port;
+    uint32_t session;
+    uint64_t fileSize;
+    uint32_t chunkSize;
+    const uint32_t* missing; // 待发送的块号
+    uint32_t missingCount;
+    atomic_uint next;
+    atomic_uint_fast64_t done;
+    atomic_int failed;
+    CryptoContext ctx;
+    NetProgressCallback onProgress;
+    void* user;
+} Sender;
+
+typedef struct SendStream
+{
+    Sender* tx;
+    uint32_t index;
+} SendStream;
+
+// 每条流从共享计数器领取下一个缺失的块，快的流自然多发
+static void send_stream(void* arg)
+{
+    SendStream* s = (SendStream*)arg;
+    Sender* tx = s->tx;
+    int fd = connect_to(tx->host, tx->port);
+    uint8_t* buffer = (uint8_t*)BufferPool_Acquire(tx->chunkSize);
+    uint8_t header[NET_FRAME_BYTES];
+    put_u32(header, NET_MAGIC);
+    put_u16(header + 4, NET_VERSION);
+    put_u16(header + 6, NET_TYPE_DATA);
+    put_u32(header + 8, tx->session);
+    put_u32(header + 12, s->index);
+    int rc = fd >= 0 && buffer ? send_all(fd, header, NET_DATA_HELLO_BYTES, 0) : ERR_NETWORK;
+
+    while (rc == ERR_SUCCESS && !atomic_load(&tx->failed))
+    {
+        unsigned int k = atomic_fetch_add(&tx->next, 1);
+        if (k >= tx->missingCount) break;
+        uint32_t index = tx->missing[k];
+        uint64_t offset = (uint64_t)index * tx->chunkSize;
+        size_t len = (size_t)chunk_length(tx->fileSize, tx->chunkSize, index);
+
+        size_t got = 0;
+        while (got < len)
+        {
+            ssize_t n = pread(tx->fd, buffer + got, len - got, (off_t)(offset + got));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            got += (size_t)n;
+        }
+        if (got < len)
+        {
+            rc = ERR_FILE_READ;
+            break;
+        }
+
+        uint64_t cipherStart = Thread_NowNs();
+        EncryptBufferAt(&tx->ctx, buffer, len, offset);
+        Metrics_Add(METRIC_CIPHER_NS, Thread_NowNs() - cipherStart);
+
+        put_u64(header, offset);
+        put_u32(header + 8, (uint32_t)len);
+        put_u32(header + 12, Algorithm_CalculateCRC32(buffer, len));
+        rc = send_all(fd, header, sizeof(header), 1);
+        if (rc == ERR_SUCCESS) rc = send_all(fd, buffer, len, 0);
+        if (rc != ERR_SUCCESS) break;
+
+        Metrics_Add(METRIC_BYTES_TRANSFERRED, len);
+        uint64_t done = atomic_fetch_add(&tx->done, len) + len;
+        if (tx->onProgress) tx->onProgress(done, tx->fileSize, tx->user);
+    }
+
+    if (rc == ERR_SUCCESS)
+    {
+        memset(header, 0, sizeof(header)); // 结束帧
+        rc = send_all(fd, header, sizeof(header), 0);
+    }
+    if (rc != ERR_SUCCESS) atomic_store(&tx->failed, rc);
+    if (fd >= 0) close(fd);
+    BufferPool_Release(buffer, tx->chunkSize);
+}
+
+int NetTransfer_Send(const char* srcPath, const char* host, int port, int streams, size_t chunkSize,
+                     NetProgressCallback onProgress, void* user)
+{
+    if (!srcPath || !host) return ERR_NETWORK;
+    if (streams <= 0) streams = NET_DEFAULT_STREAMS;
+    if (streams > NET_MAX_STREAMS) streams = NET_MAX_STREAMS;
+    if (chunkSize == 0) chunkSize = NET_DEFAULT_CHUNK;
+    if (chunkSize < NET_MIN_CHUNK) chunkSize = NET_MIN_CHUNK;
+    if (chunkSize > NET_MAX_CHUNK) chunkSize = NET_MAX_CHUNK;
+
+    Sender tx;
+    memset(&tx, 0, sizeof(tx));
+    struct stat st;
+    tx.fd = open(srcPath, O_RDONLY);
+    if (tx.fd < 0 || fstat(tx.fd, &st) != 0)
+    {
+        if (tx.fd >= 0) close(tx.fd);
+        return ERR_FILE_OPEN;
+    }
+    tx.host = host;
+    tx.port = port;
+    tx.fileSize = (uint64_t)st.st_size;
+    tx.chunkSize = (uint32_t)chunkSize;
+    tx.onProgress = onProgress;
+    tx.user = user;
+    TransferEngine_InitCrypto(&tx.ctx);
+    posix_fadvise(tx.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // 1. 握手：接收端回复会话号与已提交的块
+    int ctrl = connect_to(host, port);
+    uint8_t hello[NET_CONTROL_HELLO_BYTES];
+    put_u32(hello, NET_MAGIC);
+    put_u16(hello + 4, NET_VERSION);
+    put_u16(hello + 6, NET_TYPE_CONTROL);
+    put_u32(hello + 8, (uint32_t)streams);
+    put_u32(hello + 12, tx.chunkSize);
+    put_u64(hello + 16, tx.fileSize);
+    uint8_t reply[12];
+    uint32_t expected = (uint32_t)((tx.fileSize + tx.chunkSize - 1) / tx.chunkSize);
+    int rc = ctrl >= 0 ? send_all(ctrl, hello, sizeof(hello), 0) : ERR_NETWORK;
+    if (rc == ERR_SUCCESS) rc = recv_all(ctrl, reply, sizeof(reply));
+    if (rc == ERR_SUCCESS && (get_u32(reply) != 0 || get_u32(reply + 8) != expected))
+    {
+        rc = get_u32(reply) != 0 ? -(int)get_u32(reply) : ERR_NETWORK;
+    }
+
+    uint8_t* bitmap = rc == ERR_SUCCESS ? (uint8_t*)calloc(bitmap_bytes(expected) + 1, 1) : NULL;
+    uint32_t* missing = rc == ERR_SUCCESS ? (uint32_t*)malloc(sizeof(uint32_t) * ((size_t)expected + 1)) : NULL;
+    if (rc == ERR_SUCCESS && (!bitmap || !missing)) rc = ERR_MEMORY;
+    if (rc == ERR_SUCCESS) rc = recv_all(ctrl, bitmap, bitmap_bytes(expected));
+
+    if (rc == ERR_SUCCESS)
+    {
+        uint64_t resumed = 0;
+        for (uint32_t i = 0; i < expected; ++i)
+        {
+            if (bitmap[i >> 3] & (1u << (i & 7))) resumed += chunk_length(tx.fileSize, tx.chunkSize, i);
+            else missing[tx.missingCount++] = i;
+        }
+        if (resumed > 0) Metrics_Add(METRIC_RESUMES, 1);
+        tx.session = get_u32(reply + 4);
+        tx.missing = missing;
+        atomic_init(&tx.next, 0);
+        atomic_init(&tx.done, resumed);
+        atomic_init(&tx.failed, 0);
+        if (onProgress) onProgress(resumed, tx.fileSize, user);
+
+        // 2. 并行发送缺失的块
+        SendStream ss[NET_MAX_STREAMS];
+        Thread threads[NET_MAX_STREAMS];
+        int started = 0;
+        for (int i = 0; i < streams; ++i)
+        {
+            ss[i].tx = &tx;
+            ss[i].index = (uint32_t)i;
+            if (Thread_Create(&threads[started], send_stream, &ss[i]) == 0) started++;
+        }
+        for (int i = 0; i < started; ++i) Thread_Join(threads[i]);
+        rc = started == streams ? atomic_load(&tx.failed) : ERR_NETWORK;
+
+        // 3. 接收端在所有流结束后回报结果
+        uint8_t result[8];
+        if (recv_all(ctrl, result, sizeof(result)) != ERR_SUCCESS) rc = ERR_NETWORK;
+        else if (rc == ERR_SUCCESS && get_u32(result) != 0) rc = -(int)get_u32(result);
+        if (rc != ERR_SUCCESS)
+        {
+            Logger_Log(LOG_ERROR, "网络发送失败 (%d): %s -> %s:%d", rc, srcPath, host, port);
+        }
+    }
+
+    free(bitmap);
+    free(missing);
+    if (ctrl >= 0) close(ctrl);
+    close(tx.fd);
+    return rc;
+}
+
+#else // _WIN32
+
+NetListener* NetTransfer_Listen(const char* host, int port)
+{
+    (void)host;
+    (void)port;
+    return NULL;
+}
+
+int NetTransfer_ListenerPort(const NetListener* listener)
+{
+    (void)listener;
+    return 0;
+}
+
+int NetTransfer_Receive(NetListener* listener, const char* destPath, NetProgressCallback onProgress, void* user)
+{
+    (void)listener;
+    (void)destPath;
+    (void)onProgress;
+    (void)user;
+    return ERR_NETWORK;
+}
+
+void NetTransfer_Close(NetListener* listener)
+{
+    (void)listener;
+}
+
+int NetTransfer_Send(const char* srcPath, const char* host, int port, int streams, size_t chunkSize,
+                     NetProgressCallback onProgress, void* user)
+{
+    (void)srcPath;
+    (void)host;
+    (void)port;
+    (void)streams;
+    (void)chunkSize;
+    (void)onProgress;
+    (void)user;
+    return ERR_NETWORK;
+}
+
+#endif // _WIN32
@@ -1,11 +1,85 @@
-﻿#include "core/security.h"
+﻿#include "core/Security.h"
 #include <string.h>
 
+// v2 内核：从绝对偏移 offset 开始，对 buffer 做 XOR
+// 只读取 ctx->keyRing，不修改上下文，因此可被多个线程同时调用
+static void XOR_Kernel(const CryptoContext* ctx, uint8_t* buffer, size_t len, uint64_t offset)
+{
+    const size_t keyLen = ctx->keyLen;
+    size_t phase = (size_t)(offset % keyLen);
+    size_t i = 0;
+
+    if (32 % keyLen == 0)
+    {
+        // 密钥周期整除 32：每个 32 字节块使用同一组密钥字，预取 4 个字后按块处理 (便于编译器向量化)
+        uint64_t k[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            memcpy(&k[j], &ctx->keyRing[(phase + 8 * j) % keyLen], 8);
+        }
+        for (; i + 32 <= len; i += 32)
+        {
+            uint64_t w[4];
+            memcpy(w, buffer + i, 32);
+            w[0] ^= k[0];
+            w[1] ^= k[1];
+            w[2] ^= k[2];
+            w[3] ^= k[3];
+            memcpy(buffer + i, w, 32);
+        }
+    }
+    else
+    {
+        // 通用路径：每 8 字节取一次密钥字，keyRing 保证 phase + 7 不越界
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64_t w, k;
+            memcpy(&w, buffer + i, 8);
+            memcpy(&k, &ctx->keyRing[phase], 8);
+            w ^= k;
+            memcpy(buffer + i, &w, 8);
+            phase = (phase + 8) % keyLen;
+        }
+    }
+
+    // 尾部不足一个字的字节
+    phase = (size_t)((offset + i) % keyLen);
+    for (; i < len; ++i)
+    {
+        buffer[i] ^= ctx->key[phase];
+        if (++phase == keyLen) phase = 0;
+    }
+}
+
 // 具体策略实现：XOR 算法 (隐藏在模块内部)
 static void XOR_Algorithm(uint8_t* buffer, size_t len, CryptoContext* ctx)
 {
     if (!ctx || ctx->keyLen == 0) return;
 
+    // v1 接口保持原有语义：从 keyIndex 处继续，并推进 keyIndex
+    XOR_Kernel(ctx, buffer, len, ctx->keyIndex);
+    ctx->keyIndex = (size_t)((ctx->keyIndex + len) % ctx->keyLen);
+}
+
+// v2 策略实现：一次调用处理整批分段
+static void XOR_BatchAlgorithm(const CryptoContext* ctx, CipherSegment* segs, size_t count)
+{
+    if (!ctx || ctx->keyLen == 0 || !segs) return;
+
+    for (size_t s = 0; s < count; ++s)
+    {
+        if (segs[s].data && segs[s].len > 0)
+        {
+            XOR_Kernel(ctx, segs[s].data, segs[s].len, segs[s].offset);
+        }
+    }
+}
+
+// 参考实现：原始的逐字节 XOR，作为基准对照与正确性基线
+static void XOR_ReferenceAlgorithm(uint8_t* buffer, size_t len, CryptoContext* ctx)
+{
+    if (!ctx || ctx->keyLen == 0) return;
+
     for (size_t i = 0; i < len; ++i)
     {
         buffer[i] ^= ctx->key[ctx->keyIndex];
@@ -13,6 +87,36 @@ static void XOR_Algorithm(uint8_t* buffer, size_t len, CryptoContext* ctx)
     }
 }
 
+static void XOR_ReferenceBatchAlgorithm(const CryptoContext* ctx, CipherSegment* segs, size_t count)
+{
+    if (!ctx || ctx->keyLen == 0 || !segs) return;
+
+    for (size_t s = 0; s < count; ++s)
+    {
+        size_t k = (size_t)(segs[s].offset % ctx->keyLen);
+        for (size_t i = 0; i < segs[s].len; ++i)
+        {
+            segs[s].data[i] ^= ctx->key[k];
+            k = (k + 1) % ctx->keyLen;
+        }
+    }
+}
+
+// 算法注册表：第一个条目为 InitSecurity 默认挂载的策略
+static const CipherAlgorithmInfo g_cipherAlgorithms[] = {
+    {"xor", XOR_Algorithm, XOR_BatchAlgorithm},
+    {"xor-ref", XOR_ReferenceAlgorithm, XOR_ReferenceBatchAlgorithm},
+};
+
+const CipherAlgorithmInfo* GetCipherAlgorithms(int* count)
+{
+    if (count)
+    {
+        *count = (int)(sizeof(g_cipherAlgorithms) / sizeof(g_cipherAlgorithms[0]));
+    }
+    return g_cipherAlgorithms;
+}
+
 void InitSecurity(CryptoContext* ctx, const char* password)
 {
     if (!ctx) return;
@@ -21,7 +125,8 @@ void InitSecurity(CryptoContext* ctx, const char* password)
 
     // 挂载具体的加密策略
     // 此处体现了多态性：ctx 并不关心使用的是什么算法，只管调用 interface
-    ctx->algorithm = XOR_Algorithm;
+    ctx->algorithm = g_cipherAlgorithms[0].func;
+    ctx->batchAlgorithm = g_cipherAlgorithms[0].batchFunc;
 
     if (password && strlen(password) > 0)
     {
@@ -42,6 +147,12 @@ void InitSecurity(CryptoContext* ctx, const char* password)
         ctx->keyLen = 32;
     }
     ctx->keyIndex = 0;
+
+    // 展开密钥环 (key schedule)，之后上下文对 v2 接口而言是不可变的
+    for (size_t i = 0; i < sizeof(ctx->keyRing); ++i)
+    {
+        ctx->keyRing[i] = ctx->key[i % ctx->keyLen];
+    }
 }
 
 // 对外统一接口：将请求委托给当前挂载的策略
@@ -53,3 +164,20 @@ void EncryptBuffer(uint8_t* buffer, size_t len, CryptoContext* ctx)
         ctx->algorithm(buffer, len, ctx);
     }
 }
+
+void EncryptBufferAt(const CryptoContext* ctx, uint8_t* buffer, size_t len, uint64_t offset)
+{
+    CipherSegment seg;
+    seg.data = buffer;
+    seg.len = len;
+    seg.offset = offset;
+    EncryptSegments(ctx, &seg, 1);
+}
+
+void EncryptSegments(const CryptoContext* ctx, CipherSegment* segs, size_t count)
+{
+    if (ctx && ctx->batchAlgorithm && count > 0)
+    {
+        ctx->batchAlgorithm(ctx, segs, count);
+    }
+}
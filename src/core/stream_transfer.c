@@ -0,0 +1,188 @@
+﻿#ifdef __linux__
+#define _GNU_SOURCE // splice / F_SETPIPE_SZ
+#endif
+#include "core/StreamTransfer.h"
+#include "core/TransferEngine.h"
+#include "core/Security.h"
+#include "core/Metrics.h"
+#include "common/ErrorCode.h"
+#include "data/Logger.h"
+#include "utils/BufferPool.h"
+#include "utils/Thread.h"
+#include "utils/Trace.h"
+#include <limits.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#define STREAM_MIN_BUFFER (64 * 1024)
+#define STREAM_MAX_BUFFER (64 * 1024 * 1024)
+#define STREAM_FALLBACK 1 // 零拷贝路径不可用，改走 read / write
+
+// 读满 size 字节或读到 EOF；返回读到的字节数，出错返回 -1
+static long long read_full(int fd, uint8_t* buf, size_t size)
+{
+    size_t got = 0;
+    while (got < size)
+    {
+#ifdef _WIN32
+        size_t want = size - got > INT_MAX ? INT_MAX : size - got;
+        int n = _read(fd, buf + got, (unsigned int)want);
+#else
+        ssize_t n = read(fd, buf + got, size - got);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n < 0) return -1;
+        if (n == 0) break;
+        got += (size_t)n;
+    }
+    return (long long)got;
+}
+
+static int write_all(int fd, const uint8_t* buf, size_t len)
+{
+    while (len > 0)
+    {
+#ifdef _WIN32
+        size_t want = len > INT_MAX ? INT_MAX : len;
+        int n = _write(fd, buf, (unsigned int)want);
+#else
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+#ifdef __linux__
+
+static int is_pipe(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+// 尽量把管道容量放大到一个缓冲区 (超过 /proc/sys/fs/pipe-max-size 时保持原值)，返回当前容量
+static size_t grow_pipe(int fd, size_t want)
+{
+    int size = fcntl(fd, F_GETPIPE_SZ);
+    if (size > 0 && (size_t)size < want && want <= INT_MAX)
+    {
+        int grown = fcntl(fd, F_SETPIPE_SZ, (int)want);
+        if (grown > 0) size = grown;
+    }
+    return size > 0 ? (size_t)size : 0;
+}
+
+// 明文：splice 在内核中把数据从 inFd 搬到 outFd (至少一端为管道)
+static int splice_stream(int inFd, int outFd, size_t chunk, StreamProgressCallback onProgress, void* user,
+                         uint64_t* done)
+{
+    for (;;)
+    {
+        ssize_t n = splice(inFd, NULL, outFd, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n == 0) return ERR_SUCCESS;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            // 这一对描述符不支持 splice (如 O_APPEND 文件)：还没有搬运任何数据时可以整体回退
+            if (*done == 0 && (errno == EINVAL || errno == ENOSYS)) return STREAM_FALLBACK;
+            return errno == EPIPE || errno == ENOSPC || errno == EDQUOT ? ERR_FILE_WRITE : ERR_FILE_READ;
+        }
+        *done += (uint64_t)n;
+        Metrics_Add(METRIC_BYTES_TRANSFERRED, (uint64_t)n);
+        if (onProgress) onProgress(*done, user);
+    }
+}
+
+#endif // __linux__
+
+// 读满缓冲区 -> 按流内偏移加密 -> write 写出。
+// 加密后的数据不用 vmsplice 挂入管道：读端若继续 splice / tee，管道引用的仍是这里的页面，
+// 无法知道何时可以重新写入缓冲区。write 拷贝一次，缓冲区写出后即可复用
+static int buffered_stream(int inFd, int outFd, int plain, size_t bufferSize, StreamProgressCallback onProgress,
+                           void* user, uint64_t* done)
+{
+    CryptoContext ctx;
+    if (!plain) TransferEngine_InitCrypto(&ctx);
+#ifdef __linux__
+    if (is_pipe(outFd)) grow_pipe(outFd, bufferSize); // 更大的管道减少读写两端的切换次数
+#endif
+
+    uint8_t* buf = (uint8_t*)BufferPool_Acquire(bufferSize);
+    if (!buf) return ERR_MEMORY;
+    int rc = ERR_SUCCESS;
+    for (;;)
+    {
+        long long n = read_full(inFd, buf, bufferSize);
+        if (n < 0)
+        {
+            rc = ERR_FILE_READ;
+            break;
+        }
+        if (n == 0) break;
+
+        if (!plain)
+        {
+            uint64_t cipherStart = Thread_NowNs();
+            EncryptBufferAt(&ctx, buf, (size_t)n, *done);
+            Metrics_Add(METRIC_CIPHER_NS, Thread_NowNs() - cipherStart);
+        }
+        if (write_all(outFd, buf, (size_t)n) != 0)
+        {
+            rc = ERR_FILE_WRITE;
+            break;
+        }
+
+        *done += (uint64_t)n;
+        Metrics_Add(METRIC_BYTES_TRANSFERRED, (uint64_t)n);
+        if (onProgress) onProgress(*done, user);
+        if ((size_t)n < bufferSize) break; // EOF
+    }
+    BufferPool_Release(buf, bufferSize);
+    return rc;
+}
+
+int StreamTransfer_Run(int inFd, int outFd, int plain, size_t bufferSize, StreamProgressCallback onProgress,
+                       void* user, uint64_t* outBytes)
+{
+    if (bufferSize == 0) bufferSize = STREAM_DEFAULT_BUFFER;
+    if (bufferSize < STREAM_MIN_BUFFER) bufferSize = STREAM_MIN_BUFFER;
+    if (bufferSize > STREAM_MAX_BUFFER) bufferSize = STREAM_MAX_BUFFER;
+    bufferSize = (bufferSize + BUFFER_POOL_ALIGN - 1) & ~(size_t)(BUFFER_POOL_ALIGN - 1);
+
+    TRACE_BEGIN(span, "Stream.run");
+    uint64_t done = 0;
+    int rc = STREAM_FALLBACK;
+#ifdef __linux__
+    if (plain && (is_pipe(inFd) || is_pipe(outFd)))
+    {
+        if (is_pipe(outFd)) grow_pipe(outFd, bufferSize);
+        rc = splice_stream(inFd, outFd, bufferSize, onProgress, user, &done);
+    }
+#endif
+    if (rc == STREAM_FALLBACK) rc = buffered_stream(inFd, outFd, plain, bufferSize, onProgress, user, &done);
+    TRACE_END(span);
+
+    if (rc != ERR_SUCCESS)
+    {
+        Metrics_Add(METRIC_IO_ERRORS, 1);
+        Logger_Log(LOG_ERROR, "流式%s失败 (%d)，已处理 %llu 字节", plain ? "复制" : "加密", rc,
+                   (unsigned long long)done);
+    }
+    if (outBytes) *outBytes = done;
+    return rc;
+}
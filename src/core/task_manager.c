@@ -1,20 +1,311 @@
 ﻿#include "core/TaskManager.h"
+#include "core/Metrics.h"
 #include "common/AppTypes.h"
 #include "common/ErrorCode.h"
 #include "data/Logger.h"
 #include "data/Persistence.h"
+#include "data/SlotStore.h"
 #include "utils/FileUtils.h"
+#include "utils/Thread.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 
-#define MAX_TASKS 128
+#define DATA_DIR "data"
 #define DB_PATH "data/safetrix.db"
+#define JOURNAL_PATH "data/safetrix.db.journal"
+#define JOURNAL_COMPACT_BYTES (256 * 1024) // 日志超过该大小时压缩为新快照
+#define SLOT_DB_PATH "data/safetrix.slots"
+#define HISTORY_PATH "data/safetrix.history"
 
-static TransferTask g_tasks[MAX_TASKS];
+// 任务表按块分配：块一旦分配就不再移动，TransferTask* 在整个生命周期内保持有效，
+// 扩容只需增长块指针目录
+#define TASK_BLOCK_SHIFT 8
+#define TASK_BLOCK_SIZE (1 << TASK_BLOCK_SHIFT) // 每块 256 个任务
+#define TASK_MAX_GENERATIONS 32 // 目录与索引按倍数扩容，32 代足以覆盖 int 范围
+
+// 任务表中的条目；task 必须是第一个成员，TransferTask* 可直接转换回 TaskEntry*
+typedef struct TaskEntry
+{
+    TransferTask task;
+    int index;           // 在任务表中的下标
+    int slot;            // mmap 后端的槽位号
+    TaskStatus synced;   // 上次落盘时的状态 (mmap 后端据此判断是否需要同步等待)
+    unsigned char archived; // 已写入历史文件，不再出现在活动库中
+    atomic_int dirty;    // 已修改、尚未同步 (传输线程置位，Sync 清除)
+    atomic_int stop;     // 待处理的 TaskStopRequest (任意线程置位，传输线程取走)
+
+    // 顺序锁保护的已发布副本：所属线程在 UpdateTask 中写入，其他线程只读
+    atomic_uint seq;     // 奇数表示正在写入
+    TransferTask shared;
+} TaskEntry;
+
+// 发布给并发读者的 id 索引 (一代)
+typedef struct SharedIndex
+{
+    int cap;
+    int* keys;
+    int* vals;
+} SharedIndex;
+
+static TaskEntry** g_blocks = NULL;
+static int g_block_count = 0;
+static int g_block_cap = 0;
 static int g_task_count = 0;
 static int g_next_task_id = 1;
-static unsigned char g_dirty[MAX_TASKS];
+
+// id -> 下标 的开放寻址哈希表 (键 0 表示空位，任务 ID 从 1 开始)
+static int* g_index_keys = NULL;
+static int* g_index_vals = NULL;
+static int g_index_cap = 0;
+
+// 供并发读者使用的表结构。扩容时旧目录与旧索引不立即释放，而是保留到 ClearTable，
+// 读者拿到的指针在 InitTaskManager 之前始终有效，无需加锁
+static TaskEntry** _Atomic g_shared_blocks = NULL;
+static atomic_int g_shared_count = 0;
+static SharedIndex* _Atomic g_shared_index = NULL;
+static TaskEntry** g_retired_blocks[TASK_MAX_GENERATIONS];
+static int g_retired_block_count = 0;
+static SharedIndex g_index_generations[TASK_MAX_GENERATIONS];
+static int g_index_generation_count = 0;
+
+// 待同步任务的下标列表，Sync 的开销只与变更数量相关
+static int* g_dirty_list = NULL;
+static int g_dirty_count = 0;
+static int g_dirty_cap = 0;
+
+// 多个任务可在各自的线程中并发运行：每个任务只由运行它的线程修改，
+// 共享结构 (待同步列表、任务表、日志/槽位库) 的修改由 g_lock 串行化
+static Mutex g_lock;
+static int g_lock_ready = 0;
+
+static TaskJournal* g_journal = NULL;
+static TaskBackend g_backend = TASK_BACKEND_JOURNAL;
+static SlotStore* g_slots = NULL;
+static int g_next_slot = 0;
+static int* g_free_slots = NULL; // 已释放、可重用的槽位
+static int g_free_slot_count = 0;
+
+// 历史任务缓存：首次查询时才从磁盘加载
+static TransferTask* g_history = NULL;
+static int g_history_count = 0;
+static int g_history_loaded = 0;
+
+static TaskEntry* EntryAt(int index)
+{
+    return &g_blocks[index >> TASK_BLOCK_SHIFT][index & (TASK_BLOCK_SIZE - 1)];
+}
+
+static unsigned int HashId(int id)
+{
+    return (unsigned int)id * 2654435761u;
+}
+
+static void IndexInsert(int id, int index)
+{
+    unsigned int mask = (unsigned int)g_index_cap - 1;
+    unsigned int i = HashId(id) & mask;
+    while (g_index_keys[i] != 0 && g_index_keys[i] != id)
+    {
+        i = (i + 1) & mask;
+    }
+    // 先写值再写键：读者看到键时对应的值已经可见
+    g_index_vals[i] = index;
+    atomic_thread_fence(memory_order_release);
+    g_index_keys[i] = id;
+}
+
+// 保持装载因子不超过 1/2
+static int IndexReserve(int count)
+{
+    if (count * 2 <= g_index_cap)
+    {
+        return 0;
+    }
+
+    int cap = g_index_cap ? g_index_cap : 256;
+    while (count * 2 > cap) cap *= 2;
+    int* keys = (int*)calloc((size_t)cap, sizeof(int));
+    int* vals = (int*)calloc((size_t)cap, sizeof(int));
+    if (!keys || !vals || g_index_generation_count == TASK_MAX_GENERATIONS)
+    {
+        free(keys);
+        free(vals);
+        return ERR_MEMORY;
+    }
+
+    int* oldKeys = g_index_keys;
+    int* oldVals = g_index_vals;
+    int oldCap = g_index_cap;
+    g_index_keys = keys;
+    g_index_vals = vals;
+    g_index_cap = cap;
+    for (int i = 0; i < oldCap; ++i)
+    {
+        if (oldKeys[i] != 0) IndexInsert(oldKeys[i], oldVals[i]);
+    }
+
+    // 旧索引可能仍有读者在访问，保留到 ClearTable 再释放
+    SharedIndex* gen = &g_index_generations[g_index_generation_count++];
+    gen->cap = cap;
+    gen->keys = keys;
+    gen->vals = vals;
+    atomic_store_explicit(&g_shared_index, gen, memory_order_release);
+    return 0;
+}
+
+static TaskEntry* FindEntry(int id)
+{
+    if (id <= 0 || g_index_cap == 0)
+    {
+        return NULL;
+    }
+
+    unsigned int mask = (unsigned int)g_index_cap - 1;
+    for (unsigned int i = HashId(id) & mask; g_index_keys[i] != 0; i = (i + 1) & mask)
+    {
+        if (g_index_keys[i] == id) return EntryAt(g_index_vals[i]);
+    }
+    return NULL;
+}
+
+// 在表尾追加一个空条目 (不写入索引)
+static TaskEntry* AppendEntry(void)
+{
+    if (g_task_count == g_block_count * TASK_BLOCK_SIZE)
+    {
+        if (g_block_count == g_block_cap)
+        {
+            // 目录不用 realloc 原地扩展：旧目录留给可能仍在读取的线程，ClearTable 时释放
+            int cap = g_block_cap ? g_block_cap * 2 : 16;
+            if (g_retired_block_count == TASK_MAX_GENERATIONS) return NULL;
+            TaskEntry** blocks = (TaskEntry**)calloc((size_t)cap, sizeof(TaskEntry*));
+            if (!blocks) return NULL;
+            if (g_blocks)
+            {
+                memcpy(blocks, g_blocks, sizeof(TaskEntry*) * (size_t)g_block_count);
+                g_retired_blocks[g_retired_block_count++] = g_blocks;
+            }
+            g_blocks = blocks;
+            g_block_cap = cap;
+        }
+        TaskEntry* block = (TaskEntry*)calloc(TASK_BLOCK_SIZE, sizeof(TaskEntry));
+        if (!block) return NULL;
+        g_blocks[g_block_count++] = block;
+    }
+    if (IndexReserve(g_task_count + 1) != 0)
+    {
+        return NULL;
+    }
+
+    TaskEntry* e = EntryAt(g_task_count);
+    memset(e, 0, sizeof(TaskEntry));
+    e->index = g_task_count++;
+
+    // 新条目的 seq 为 0、副本 id 为 0，读者在首次发布之前会跳过它
+    atomic_store_explicit(&g_shared_blocks, g_blocks, memory_order_release);
+    atomic_store_explicit(&g_shared_count, g_task_count, memory_order_release);
+    return e;
+}
+
+// 发布任务的一致副本 (顺序锁写端)。只由任务的所属线程调用，读者从不阻塞写者
+static void PublishEntry(TaskEntry* e)
+{
+    unsigned int seq = atomic_load_explicit(&e->seq, memory_order_relaxed);
+    atomic_store_explicit(&e->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    e->shared = e->task;
+    e->shared.onProgress = NULL;
+    e->shared.onError = NULL;
+    atomic_store_explicit(&e->seq, seq + 2, memory_order_release);
+}
+
+// 启动阶段加载、重放或搬移任务之后重新发布整张表
+static void PublishAll(void)
+{
+    for (int i = 0; i < g_task_count; ++i)
+    {
+        PublishEntry(EntryAt(i));
+    }
+    atomic_store_explicit(&g_shared_blocks, g_blocks, memory_order_release);
+    atomic_store_explicit(&g_shared_count, g_task_count, memory_order_release);
+}
+
+// 顺序锁读端：读到的副本在读取前后序号一致且为偶数时才有效，否则重试
+static void ReadEntry(const TaskEntry* e, TransferTask* out)
+{
+    for (;;)
+    {
+        unsigned int before = atomic_load_explicit(&e->seq, memory_order_acquire);
+        if (before & 1u)
+        {
+            continue; // 写端只做一次内存拷贝，自旋等待即可
+        }
+        memcpy(out, &e->shared, sizeof(TransferTask));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&e->seq, memory_order_relaxed) == before)
+        {
+            return;
+        }
+    }
+}
+
+// 释放整个任务表
+static void ClearTable(void)
+{
+    atomic_store(&g_shared_count, 0);
+    atomic_store(&g_shared_blocks, NULL);
+    atomic_store(&g_shared_index, NULL);
+    for (int i = 0; i < g_block_count; ++i)
+    {
+        free(g_blocks[i]);
+    }
+    free(g_blocks);
+    for (int i = 0; i < g_retired_block_count; ++i)
+    {
+        free(g_retired_blocks[i]);
+    }
+    g_retired_block_count = 0;
+    for (int i = 0; i < g_index_generation_count; ++i)
+    {
+        free(g_index_generations[i].keys);
+        free(g_index_generations[i].vals);
+    }
+    g_index_generation_count = 0;
+    free(g_dirty_list);
+    free(g_free_slots);
+    free(g_history);
+    g_free_slots = NULL;
+    g_free_slot_count = 0;
+    g_history = NULL;
+    g_history_count = 0;
+    g_history_loaded = 0;
+    g_blocks = NULL;
+    g_block_count = g_block_cap = 0;
+    g_index_keys = g_index_vals = NULL;
+    g_index_cap = 0;
+    g_dirty_list = NULL;
+    g_dirty_count = g_dirty_cap = 0;
+    g_task_count = 0;
+}
+
+// 追加一个加载得到的任务并建立索引
+static TaskEntry* InsertTask(const TransferTask* task)
+{
+    TaskEntry* e = AppendEntry();
+    if (!e)
+    {
+        return NULL;
+    }
+    e->task = *task;
+    e->task.onProgress = NULL;
+    e->task.onError = NULL;
+    e->synced = task->status;
+    if (e->task.id > 0) IndexInsert(e->task.id, e->index);
+    return e;
+}
 
 // --- 内部辅助函数：重新计算下一个任务 ID ---
 // 遍历当前任务列表，找到最大 ID，然后设置 g_next_task_id 为 maxId + 1
@@ -23,96 +314,516 @@ static void RecalculateNextId(void)
     int maxId = 0;
     for (int i = 0; i < g_task_count; ++i)
     {
-        if (g_tasks[i].id > maxId)
+        if (EntryAt(i)->task.id > maxId)
         {
-            maxId = g_tasks[i].id;
+            maxId = EntryAt(i)->task.id;
         }
     }
+    // 已归档任务不在活动库中，历史文件头记录了它们的最大 ID，避免 ID 被重复使用
+    int historyMax = Persistence_ReadHistoryMaxId(HISTORY_PATH);
+    if (historyMax > maxId)
+    {
+        maxId = historyMax;
+    }
     // 下一个新任务的 ID 应该是当前最大 ID + 1
     g_next_task_id = maxId + 1;
 }
 
-// 将内存中的任务列表同步到磁盘
-void TaskManager_Sync(void)
+// 收集任务副本，供快照写出。completedOnly 为 1 时只收集已完成、尚未归档的任务，
+// 为 0 时收集所有未归档的任务。读取的是已发布的副本，不会读到其他线程写了一半的任务；
+// 指针数组与副本在同一块内存中，调用方 free 一次即可
+static const TransferTask** CollectTasks(int completedOnly, int* outCount)
+{
+    size_t n = (size_t)g_task_count + 1;
+    const TransferTask** list = (const TransferTask**)malloc((sizeof(TransferTask*) + sizeof(TransferTask)) * n);
+    *outCount = 0;
+    if (!list)
+    {
+        return NULL;
+    }
+    TransferTask* copies = (TransferTask*)(list + n);
+    for (int i = 0; i < g_task_count; ++i)
+    {
+        TaskEntry* e = EntryAt(i);
+        if (e->archived) continue;
+        TransferTask* copy = &copies[*outCount];
+        ReadEntry(e, copy);
+        if (completedOnly && copy->status != TASK_COMPLETED) continue;
+        list[(*outCount)++] = copy;
+    }
+    return list;
+}
+
+// 将已完成的任务追加到历史文件并标记为已归档，返回归档数量
+static int ArchiveCompleted(void)
+{
+    int count = 0;
+    const TransferTask** list = CollectTasks(1, &count);
+    if (!list || count == 0 || Persistence_AppendHistory(HISTORY_PATH, list, count) != 0)
+    {
+        free((void*)list);
+        return 0;
+    }
+
+    // 已加载的历史缓存同步追加，未加载时下次读取文件即可
+    TransferTask* grown = g_history_loaded ? (TransferTask*)realloc(
+                              g_history, sizeof(TransferTask) * (size_t)(g_history_count + count)) : NULL;
+    if (grown)
+    {
+        g_history = grown;
+    }
+    else if (g_history_loaded)
+    {
+        g_history_loaded = 0; // 内存不足：丢弃缓存，下次查询时重新读取
+        free(g_history);
+        g_history = NULL;
+        g_history_count = 0;
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        FindEntry(list[i]->id)->archived = 1;
+        if (g_history_loaded)
+        {
+            g_history[g_history_count] = *list[i];
+            g_history[g_history_count].onProgress = NULL;
+            g_history[g_history_count].onError = NULL;
+            g_history_count++;
+        }
+    }
+    free((void*)list);
+    return count;
+}
+
+// 启动时从内存表中移除已归档的任务 (此时没有外部持有的任务指针)
+static void DropArchived(void)
+{
+    int kept = 0;
+    for (int i = 0; i < g_task_count; ++i)
+    {
+        TaskEntry* e = EntryAt(i);
+        if (e->archived) continue;
+        if (kept != i) *EntryAt(kept) = *e;
+        EntryAt(kept)->index = kept;
+        EntryAt(kept)->dirty = 0;
+        kept++;
+    }
+    g_task_count = kept;
+    g_dirty_count = 0;
+
+    memset(g_index_keys, 0, sizeof(int) * (size_t)g_index_cap);
+    for (int i = 0; i < g_task_count; ++i)
+    {
+        if (EntryAt(i)->task.id > 0) IndexInsert(EntryAt(i)->task.id, i);
+    }
+}
+
+// 日志不可用时退回整表重写
+static void SaveSnapshot(void)
 {
-    if (Persistence_SaveTasks(DB_PATH, g_tasks, g_task_count) != 0)
+    int count = 0;
+    const TransferTask** list = CollectTasks(0, &count);
+    if (!list || Persistence_SaveTasks(DB_PATH, list, count) != 0)
     {
         Logger_Log(LOG_ERROR, "保存任务列表失败 -> %s", DB_PATH);
     }
+    free((void*)list);
 }
 
-// 初始化任务管理器：清理内存并从磁盘加载上次保存的任务列表
-void InitTaskManager(void)
+// 将日志压缩为新快照；已完成的任务先移入历史文件，快照只包含活动任务
+static void CompactJournal(void)
 {
-    memset(g_tasks, 0, sizeof(g_tasks));
-    memset(g_dirty, 0, sizeof(g_dirty));
+    ArchiveCompleted();
 
-    int loaded = Persistence_LoadTasks(DB_PATH, g_tasks, MAX_TASKS);
-    if (loaded < 0)
+    int count = 0;
+    const TransferTask** list = CollectTasks(0, &count);
+    if (!list || Persistence_Compact(DB_PATH, g_journal, list, count) != 0)
     {
-        Logger_Log(LOG_WARNING, "任务列表加载异常，启用空任务列表");
-        g_task_count = 0;
+        Logger_Log(LOG_ERROR, "压缩任务日志失败 -> %s", DB_PATH);
     }
-    else
+    free((void*)list);
+}
+
+// 将内存中的任务变更同步到磁盘 (调用方持有 g_lock)
+// 只处理 g_dirty_list 中的任务，开销与变更量成正比而非与队列长度成正比
+static void SyncLocked(void)
+{
+    if (!g_slots && !g_journal)
+    {
+        SaveSnapshot();
+    }
+
+    int written = 0;
+    for (int k = 0; k < g_dirty_count; ++k)
+    {
+        TaskEntry* e = EntryAt(g_dirty_list[k]);
+        // 先清除标记再读取副本：之后的修改会重新进入列表，不会丢失
+        atomic_store(&e->dirty, 0);
+        atomic_thread_fence(memory_order_seq_cst);
+        TransferTask snap;
+        ReadEntry(e, &snap);
+        if (g_slots)
+        {
+            // 原地写入检查点；只有状态变化 (暂停/完成/出错) 时才同步等待落盘
+            int durable = snap.status != TASK_RUNNING && snap.status != e->synced;
+            SlotStore_Checkpoint(g_slots, e->slot, &snap, durable);
+            e->synced = snap.status;
+        }
+        else if (g_journal && Persistence_JournalDelta(g_journal, &snap) == 0)
+        {
+            written++;
+        }
+    }
+    g_dirty_count = 0;
+
+    if (g_journal)
+    {
+        if (written > 0) Persistence_JournalFlush(g_journal);
+        if (Persistence_JournalSize(g_journal) > JOURNAL_COMPACT_BYTES)
+        {
+            CompactJournal();
+        }
+    }
+}
+
+void TaskManager_Sync(void)
+{
+    // 检查点耗时包含等锁时间，即传输线程实际被阻塞的时长
+    uint64_t start = Thread_NowNs();
+    Mutex_Lock(&g_lock);
+    SyncLocked();
+    Mutex_Unlock(&g_lock);
+    Metrics_ObserveCheckpoint(Thread_NowNs() - start);
+}
+
+void TaskManager_SetBackend(TaskBackend backend)
+{
+    g_backend = backend;
+}
+
+// mmap 后端：直接从映射读取槽位，无解析步骤
+static int InitSlotBackend(void)
+{
+    g_slots = SlotStore_Open(SLOT_DB_PATH, TASK_BLOCK_SIZE);
+    if (!g_slots)
+    {
+        Logger_Log(LOG_WARNING, "槽位库不可用，退回日志后端");
+        return -1;
+    }
+
+    int cap = SlotStore_Capacity(g_slots);
+    TransferTask* loaded = (TransferTask*)malloc(sizeof(TransferTask) * (size_t)cap);
+    int* slots = (int*)malloc(sizeof(int) * (size_t)cap);
+    int count = (loaded && slots) ? SlotStore_Load(g_slots, loaded, slots, cap) : 0;
+    for (int i = 0; i < count; ++i)
+    {
+        TaskEntry* e = InsertTask(&loaded[i]);
+        if (!e) break;
+        e->slot = slots[i];
+    }
+    free(loaded);
+    free(slots);
+    PublishAll();
+
+    // 已完成的任务移入历史文件并释放槽位
+    if (ArchiveCompleted() > 0)
+    {
+        for (int i = 0; i < g_task_count; ++i)
+        {
+            if (EntryAt(i)->archived) SlotStore_Release(g_slots, EntryAt(i)->slot);
+        }
+        DropArchived();
+    }
+
+    // 活动任务之间的空槽位留给新任务重用
+    unsigned char* used = (unsigned char*)calloc((size_t)cap + 1, 1);
+    g_free_slots = (int*)malloc(sizeof(int) * ((size_t)cap + 1));
+    g_next_slot = 0;
+    for (int i = 0; used && i < g_task_count; ++i)
+    {
+        used[EntryAt(i)->slot] = 1;
+        if (EntryAt(i)->slot >= g_next_slot) g_next_slot = EntryAt(i)->slot + 1;
+    }
+    for (int s = g_next_slot - 1; used && g_free_slots && s >= 0; --s)
     {
-        g_task_count = loaded;
+        if (!used[s]) g_free_slots[g_free_slot_count++] = s;
     }
+    free(used);
 
     RecalculateNextId();
+    PublishAll();
+    return 0;
 }
 
-// 添加新任务并立即持久化
-int AddTask(const char* src, const char* dest, int priority)
+// 日志重放回调：按 id 查找，必要时新建任务
+static TransferTask* ReplayLookup(int id, int create, void* user)
 {
-    if (!src || !dest)
+    (void)user;
+    TaskEntry* e = FindEntry(id);
+    if (!e && create && id > 0)
     {
-        return ERR_MEMORY; // 使用已有的错误码，避免未定义符号
+        e = AppendEntry();
+        if (e)
+        {
+            e->task.id = id;
+            IndexInsert(id, e->index);
+        }
     }
+    return e ? &e->task : NULL;
+}
 
-    if (g_task_count >= MAX_TASKS)
+// 初始化任务管理器：清理内存并从磁盘加载上次保存的任务列表
+void InitTaskManager(void)
+{
+    if (!g_lock_ready)
+    {
+        Mutex_Init(&g_lock);
+        g_lock_ready = 1;
+    }
+    if (g_journal)
+    {
+        Persistence_CloseJournal(g_journal);
+        g_journal = NULL;
+    }
+    if (g_slots)
     {
-        return ERR_TASK_FULL;
+        SlotStore_Close(g_slots);
+        g_slots = NULL;
     }
+    ClearTable();
 
-    TransferTask* task = &g_tasks[g_task_count];
-    memset(task, 0, sizeof(TransferTask));
+    // 数据库、日志与槽位库都在数据目录下，首次在新的工作目录中运行时先创建它
+    FileUtils_Mkdir(DATA_DIR);
+
+    if (g_backend == TASK_BACKEND_MMAP && InitSlotBackend() == 0)
+    {
+        return;
+    }
+
+    TransferTask* loaded = NULL;
+    int count = Persistence_LoadTasks(DB_PATH, &loaded);
+    if (count < 0)
+    {
+        Logger_Log(LOG_WARNING, "任务列表加载异常，启用空任务列表");
+        count = 0;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (!InsertTask(&loaded[i]))
+        {
+            Logger_Log(LOG_ERROR, "内存不足，仅加载了 %d 个任务", i);
+            break;
+        }
+    }
+    free(loaded);
+
+    // 快照之后的变更记录在日志中，按顺序重放
+    Persistence_ReplayJournal(JOURNAL_PATH, ReplayLookup, NULL);
+    PublishAll();
+
+    // 上次运行中完成的任务移入历史文件，活动库只保留未完成的任务
+    int archived = ArchiveCompleted();
+    if (archived > 0)
+    {
+        DropArchived();
+        Logger_Log(LOG_INFO, "已归档 %d 个已完成任务", archived);
+    }
+
+    g_journal = Persistence_OpenJournal(JOURNAL_PATH);
+    if (!g_journal)
+    {
+        Logger_Log(LOG_WARNING, "任务日志不可用，退回整表保存");
+        if (archived > 0) SaveSnapshot();
+    }
+    else if (Persistence_JournalSize(g_journal) > 0 || archived > 0)
+    {
+        // 启动时合并日志，同时丢弃可能存在的残缺尾部
+        CompactJournal();
+    }
+
+    RecalculateNextId();
+    PublishAll();
+}
+
+static int AddTaskLocked(const char* src, const char* dest, int priority, const TaskOptions* options)
+{
+    TaskEntry* e = AppendEntry();
+    if (!e)
+    {
+        return ERR_MEMORY;
+    }
+    TransferTask* task = &e->task;
 
     task->id = g_next_task_id++; //分配新ID
+    IndexInsert(task->id, e->index);
     // 复制路径到任务结构体中（安全复制）
     strncpy(task->srcPath, src, sizeof(task->srcPath) - 1);
     strncpy(task->destPath, dest, sizeof(task->destPath) - 1);
 
     task->priority = priority;
+    task->mode = options->mode;
+    task->cachePolicy = options->cachePolicy;
     task->status = TASK_WAITING; // 初始状态为等待中
     task->currentOffset = 0;
+    e->synced = TASK_WAITING;
 
     // 尝试获取源文件大小以便显示进度（失败时保留为 0）
     task->totalSize = FileUtils_GetFileSize(src);
+    PublishEntry(e);
 
-    g_task_count++;
-    Persistence_SaveTasks(DB_PATH, g_tasks, g_task_count); // 任务变更立即持久化
+    // 任务变更立即持久化
+    if (g_slots)
+    {
+        e->slot = g_free_slot_count > 0 ? g_free_slots[--g_free_slot_count] : g_next_slot++;
+        if (SlotStore_Write(g_slots, e->slot, task) != 0)
+        {
+            Logger_Log(LOG_ERROR, "写入任务槽位失败 -> %s", SLOT_DB_PATH);
+        }
+    }
+    else if (g_journal && Persistence_JournalAdd(g_journal, task) == 0)
+    {
+        Persistence_JournalFlush(g_journal);
+    }
+    else
+    {
+        SaveSnapshot();
+    }
     return task->id;
 }
 
+// 添加新任务并立即持久化；可与正在运行的任务并发调用
+int AddTask(const char* src, const char* dest, int priority)
+{
+    return AddTaskWithOptions(src, dest, priority, NULL);
+}
+
+int AddTaskWithOptions(const char* src, const char* dest, int priority, const TaskOptions* options)
+{
+    static const TaskOptions defaults = {TASK_MODE_ENCRYPT, TASK_CACHE_DEFAULT};
+    if (!src || !dest)
+    {
+        return ERR_MEMORY; // 使用已有的错误码，避免未定义符号
+    }
+
+    Mutex_Lock(&g_lock);
+    int id = AddTaskLocked(src, dest, priority, options ? options : &defaults);
+    Mutex_Unlock(&g_lock);
+    return id;
+}
+
 TransferTask* GetTaskById(int id)
 {
-    for (int i = 0; i < g_task_count; ++i)
+    TaskEntry* e = FindEntry(id);
+    return e ? &e->task : NULL;
+}
+
+int TaskManager_GetTaskCount(void)
+{
+    return g_task_count;
+}
+
+TransferTask* TaskManager_GetTaskAt(int index)
+{
+    if (index < 0 || index >= g_task_count)
+    {
+        return NULL;
+    }
+    return &EntryAt(index)->task;
+}
+
+// 按下标读取已发布的副本，可在任意线程调用
+static int ReadShared(int index, TransferTask* out)
+{
+    if (index < 0 || index >= atomic_load_explicit(&g_shared_count, memory_order_acquire))
     {
-        if (g_tasks[i].id == id)
+        return ERR_TASK_NOT_FOUND;
+    }
+    TaskEntry** blocks = atomic_load_explicit(&g_shared_blocks, memory_order_acquire);
+    if (!blocks)
+    {
+        return ERR_TASK_NOT_FOUND;
+    }
+    ReadEntry(&blocks[index >> TASK_BLOCK_SHIFT][index & (TASK_BLOCK_SIZE - 1)], out);
+    return out->id > 0 ? ERR_SUCCESS : ERR_TASK_NOT_FOUND;
+}
+
+// 在已发布的索引中查找任务并读取副本，返回任务表下标，未找到返回 -1；可在任意线程调用
+static int FindShared(int id, TransferTask* out)
+{
+    SharedIndex* index = atomic_load_explicit(&g_shared_index, memory_order_acquire);
+    if (id <= 0 || !index)
+    {
+        return -1;
+    }
+
+    unsigned int mask = (unsigned int)index->cap - 1;
+    for (unsigned int i = HashId(id) & mask;; i = (i + 1) & mask)
+    {
+        int key = index->keys[i];
+        if (key == 0)
         {
-            return &g_tasks[i];
+            break;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        // 索引只在启动时重排；副本中的 id 再核对一次，防止读到正在插入的槽位
+        if (key == id && ReadShared(index->vals[i], out) == ERR_SUCCESS && out->id == id)
+        {
+            return index->vals[i];
         }
     }
-    return NULL;
+    return -1;
+}
+
+int TaskManager_SnapshotTask(int id, TransferTask* out)
+{
+    if (!out)
+    {
+        return ERR_TASK_NOT_FOUND;
+    }
+    return FindShared(id, out) >= 0 ? ERR_SUCCESS : ERR_TASK_NOT_FOUND;
+}
+
+int TaskManager_RequestStop(int id, TaskStopRequest request)
+{
+    TransferTask snap;
+    int index = FindShared(id, &snap);
+    if (index < 0)
+    {
+        return ERR_TASK_NOT_FOUND;
+    }
+    TaskEntry** blocks = atomic_load_explicit(&g_shared_blocks, memory_order_acquire);
+    atomic_store(&blocks[index >> TASK_BLOCK_SHIFT][index & (TASK_BLOCK_SIZE - 1)].stop, (int)request);
+    return ERR_SUCCESS;
+}
+
+TaskStopRequest TaskManager_TakeStopRequest(TransferTask* task)
+{
+    TaskEntry* e = (TaskEntry*)task;
+    // 传输热路径每块调用一次：通常只有一次普通读取，有请求时才做原子交换
+    if (!e || atomic_load_explicit(&e->stop, memory_order_relaxed) == TASK_STOP_NONE)
+    {
+        return TASK_STOP_NONE;
+    }
+    return (TaskStopRequest)atomic_exchange(&e->stop, TASK_STOP_NONE);
 }
 
-TransferTask* GetTaskList(int* count)
+int TaskManager_SnapshotAll(TransferTask** out)
 {
-    if (count)
+    *out = NULL;
+    int count = atomic_load_explicit(&g_shared_count, memory_order_acquire);
+    TransferTask* list = (TransferTask*)malloc(sizeof(TransferTask) * (size_t)(count + 1));
+    if (!list)
+    {
+        return ERR_MEMORY;
+    }
+
+    int n = 0;
+    for (int i = 0; i < count; ++i)
     {
-        *count = g_task_count;
+        if (ReadShared(i, &list[n]) == ERR_SUCCESS) n++;
     }
-    return g_tasks;
+    *out = list;
+    return n;
 }
 
 // 为指定任务设置回调（不会持久化回调指针）
@@ -131,12 +842,126 @@ void SetTaskCallbacks(int taskId, OnProgressCallback onProgress, OnErrorCallback
 // 标记任务为已修改（用于延迟或按需持久化）
 void TaskManager_UpdateTask(TransferTask* task)
 {
-    for (int i = 0; i < g_task_count; ++i)
+    if (!task)
+    {
+        return;
+    }
+
+    // 每次修改后都发布新副本，读者看到的进度不会滞后于下一次 Sync
+    TaskEntry* e = (TaskEntry*)task;
+    PublishEntry(e);
+
+    // 已在待同步列表中时无需加锁，传输热路径上通常只有这一次原子操作
+    if (atomic_exchange(&e->dirty, 1) != 0)
+    {
+        return;
+    }
+
+    Mutex_Lock(&g_lock);
+    if (g_dirty_count == g_dirty_cap)
+    {
+        int cap = g_dirty_cap ? g_dirty_cap * 2 : 64;
+        int* list = (int*)realloc(g_dirty_list, sizeof(int) * (size_t)cap);
+        if (!list)
+        {
+            atomic_store(&e->dirty, 0);
+            Mutex_Unlock(&g_lock);
+            return;
+        }
+        g_dirty_list = list;
+        g_dirty_cap = cap;
+    }
+    g_dirty_list[g_dirty_count++] = e->index;
+    Mutex_Unlock(&g_lock);
+}
+
+// 退出前同步剩余变更并压缩日志
+void TaskManager_Shutdown(void)
+{
+    if (g_slots)
+    {
+        TaskManager_Sync();
+        if (ArchiveCompleted() > 0)
+        {
+            for (int i = 0; i < g_task_count; ++i)
+            {
+                if (EntryAt(i)->archived) SlotStore_Release(g_slots, EntryAt(i)->slot);
+            }
+        }
+        SlotStore_Close(g_slots);
+        g_slots = NULL;
+        return;
+    }
+    if (!g_journal)
+    {
+        return;
+    }
+
+    TaskManager_Sync();
+    CompactJournal();
+    Persistence_CloseJournal(g_journal);
+    g_journal = NULL;
+}
+
+// 首次查询历史时从磁盘加载，调用者持有 g_lock
+static void EnsureHistoryLoaded(void)
+{
+    if (g_history_loaded)
+    {
+        return;
+    }
+
+    TransferTask* loaded = NULL;
+    int count = Persistence_LoadHistory(HISTORY_PATH, &loaded);
+    if (count < 0)
+    {
+        Logger_Log(LOG_WARNING, "历史任务加载失败 -> %s", HISTORY_PATH);
+        free(loaded);
+        return;
+    }
+    g_history = loaded;
+    g_history_count = count;
+    g_history_loaded = 1;
+}
+
+// 历史数组会被传输线程上的压缩 (ArchiveCompleted) 追加并重新分配，因此持锁访问并拷贝给调用者
+int TaskManager_GetHistoryCount(void)
+{
+    Mutex_Lock(&g_lock);
+    EnsureHistoryLoaded();
+    int count = g_history_count;
+    Mutex_Unlock(&g_lock);
+    return count;
+}
+
+int TaskManager_GetHistoryAt(int index, TransferTask* out)
+{
+    int rc = ERR_TASK_NOT_FOUND;
+    Mutex_Lock(&g_lock);
+    EnsureHistoryLoaded();
+    if (out && index >= 0 && index < g_history_count)
+    {
+        *out = g_history[index];
+        rc = ERR_SUCCESS;
+    }
+    Mutex_Unlock(&g_lock);
+    return rc;
+}
+
+int TaskManager_FindHistory(int id, TransferTask* out)
+{
+    int rc = ERR_TASK_NOT_FOUND;
+    Mutex_Lock(&g_lock);
+    EnsureHistoryLoaded();
+    for (int i = g_history_count - 1; out && i >= 0; --i)
     {
-        if (&g_tasks[i] == task)
+        if (g_history[i].id == id)
         {
-            g_dirty[i] = 1;
+            *out = g_history[i];
+            rc = ERR_SUCCESS;
             break;
         }
     }
+    Mutex_Unlock(&g_lock);
+    return rc;
 }
@@ -1,8 +1,18 @@
-﻿#include "core/TaskManager.h"
-#include "core/security.h"
+﻿#ifdef __linux__
+#define _GNU_SOURCE // sync_file_range
+#endif
+#include "core/TaskManager.h"
+#include "core/TransferEngine.h"
+#include "core/Security.h"
+#include "core/Metrics.h"
 #include "common/ErrorCode.h"
 #include "data/Logger.h"
 #include "utils/FileUtils.h"
+#include "utils/Algorithm.h"
+#include "utils/BufferPool.h"
+#include "utils/TreeHash.h"
+#include "utils/Thread.h"
+#include "utils/Trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -13,17 +23,48 @@
 #include <windows.h>
 #include <wchar.h>
 #include <conio.h>
+#include <io.h>
 #else
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <linux/fs.h>
 #endif
 
-#define CHUNK_SIZE 4096
+#define CHUNK_SIZE 4096 // 默认块大小
+#define MIN_CHUNK_SIZE 4096
+#define MAX_CHUNK_SIZE (64 * 1024 * 1024)
+#define PLAIN_COPY_STEP (8 * 1024 * 1024) // 内核内拷贝每步的最小字节数，每步之间处理停止请求并汇报进度
+#define SYNC_THRESHOLD (64 * 1024)        // 64KB 更频繁的同步，以便快速恢复
+#define STREAM_WINDOW (8 * 1024 * 1024)   // 流式缓存策略的默认回写窗口
+#define MIN_STREAM_WINDOW (1024 * 1024)
+#define MAX_STREAM_WINDOW (1024 * 1024 * 1024)
+#define FANOUT_SLOTS 8                 // 扇出时读取端最多领先最慢的目标这么多块
+#define FANOUT_MIN_CHUNK (1024 * 1024) // 每块都要在线程间交接，块太小时交接开销占主导
+#define FANOUT_STALL_MS 30000          // 默认的慢目标容忍时间
+#define LEAF_CHECKPOINT_FMT "data/task_%d.leaves"
+
+static size_t g_chunk_size = CHUNK_SIZE;
+static size_t g_stream_window = STREAM_WINDOW;
+static unsigned int g_fanout_stall_ms = FANOUT_STALL_MS;
+
+// 传输使用的密钥 (加密与校验共用)
+static const char* ENGINE_PASSWORD = "SecretKey123";
 
 // Helper: create parent directories recursively for a given path
 static int ensure_parent_dir_exists(const char* path)
 {
     if (!path) return -1;
+    TRACE_BEGIN(span, "mkdir");
 
     char tmp[1024];
     strncpy(tmp, path, sizeof(tmp) - 1);
@@ -36,21 +77,41 @@ static int ensure_parent_dir_exists(const char* path)
         tmp[tlen - 1] = '\0';
         tlen--;
     }
-    if (tlen == 0) return -1;
+    if (tlen == 0)
+    {
+        TRACE_END(span);
+        return -1;
+    }
 
     // Find last separator to get parent directory
     char* last_sep1 = strrchr(tmp, '\\');
     char* last_sep2 = strrchr(tmp, '/');
     char* last_sep = last_sep1 > last_sep2 ? last_sep1 : last_sep2;
-    if (!last_sep) return 0; // no parent directory
+    if (!last_sep)
+    {
+        TRACE_END(span);
+        return 0; // no parent directory
+    }
 
     // Temporarily terminate string at parent dir
     *last_sep = '\0';
 
     // Build and create each component
+#ifdef _WIN32
+    const char* sepStr = "\\";
+#else
+    const char* sepStr = "/";
+#endif
     char accum[1024] = "";
     char* p = tmp;
 
+    // Keep the root of an absolute POSIX path
+    if (tmp[0] == '/')
+    {
+        strcpy(accum, "/");
+        p = tmp + 1;
+    }
+
     // Handle Windows drive letter like "C:\" -> start accum with "C:\"
     if (strlen(tmp) >= 2 && tmp[1] == ':')
     {
@@ -69,9 +130,9 @@ static int ensure_parent_dir_exists(const char* path)
         size_t seglen = sep - p;
 
         // append separator if needed
-        if (accum[0] != '\0' && accum[strlen(accum) - 1] != '\\')
+        if (accum[0] != '\0' && accum[strlen(accum) - 1] != sepStr[0])
         {
-            strncat(accum, "\\", sizeof(accum) - strlen(accum) - 1);
+            strncat(accum, sepStr, sizeof(accum) - strlen(accum) - 1);
         }
 
         // append segment
@@ -84,50 +145,406 @@ static int ensure_parent_dir_exists(const char* path)
         p = sep + 1;
     }
 
+    TRACE_END(span);
     return 0;
 }
 
-int InitTransferEngine(void)
+// 打开目标文件为可读写（以便支持断点续传），若不存在则创建
+// 以续传方式打开目标文件。覆盖比源文件更长的旧文件时截掉多余的尾部，否则旧数据会残留在输出末尾
+static FILE* open_dest(const char* path, uint64_t size)
+{
+    FILE* fp = FileUtils_OpenFileUTF8(path, "r+b");
+    if (!fp)
+    {
+        // 尝试创建父目录后再创建目标文件
+        ensure_parent_dir_exists(path);
+        fp = FileUtils_OpenFileUTF8(path, "r+b");
+        if (!fp) fp = FileUtils_OpenFileUTF8(path, "wb");
+    }
+    if (fp && FileUtils_GetFileSize(path) > size)
+    {
+#ifdef _WIN32
+        int trimmed = _chsize_s(_fileno(fp), (__int64)size) == 0;
+#else
+        int trimmed = ftruncate(fileno(fp), (off_t)size) == 0;
+#endif
+        if (!trimmed)
+        {
+            fclose(fp);
+            return NULL;
+        }
+    }
+    return fp;
+}
+
+// I/O 失败计入指标后交给任务的错误回调
+static void report_io_error(TransferTask* task, const char* msg)
+{
+    Metrics_Add(METRIC_IO_ERRORS, 1);
+    if (task->onError) task->onError(task->id, -1, msg);
+}
+
+void InitTransferEngine(void)
+{
+}
+
+void StopTransfer(int taskId)
+{
+    TaskManager_RequestStop(taskId, TASK_STOP_PAUSE);
+}
+
+void CancelTransfer(int taskId)
+{
+    TaskManager_RequestStop(taskId, TASK_STOP_CANCEL);
+}
+
+void TransferEngine_InitCrypto(CryptoContext* ctx)
+{
+    InitSecurity(ctx, ENGINE_PASSWORD);
+}
+
+void TransferEngine_SetChunkSize(size_t bytes)
+{
+    if (bytes < MIN_CHUNK_SIZE) bytes = MIN_CHUNK_SIZE;
+    if (bytes > MAX_CHUNK_SIZE) bytes = MAX_CHUNK_SIZE;
+    g_chunk_size = bytes;
+}
+
+void TransferEngine_SetStreamWindow(size_t bytes)
+{
+    if (bytes < MIN_STREAM_WINDOW) bytes = MIN_STREAM_WINDOW;
+    if (bytes > MAX_STREAM_WINDOW) bytes = MAX_STREAM_WINDOW;
+    g_stream_window = bytes;
+}
+
+// 流式缓存策略 (TASK_CACHE_STREAM) 的窗口状态。每写满一个窗口：
+// 先对该窗口发起异步回写，再等待上一个窗口回写完成并丢弃其目标页；已读过的源页立即丢弃。
+// 脏页最多保留两个窗口，回写平稳进行，不会在传输结束或内存紧张时集中爆发
+typedef struct StreamWindow
+{
+    int enabled;
+    FILE* fpDest; // 读写循环经 stdio 写出，提交回写前先 fflush
+    int srcFd;
+    int destFd;
+    size_t window;
+    uint64_t windowStart; // 尚未提交回写的窗口起点
+    uint64_t prevStart;   // 已提交、尚未丢弃的上一个窗口起点
+} StreamWindow;
+
+static void stream_begin(StreamWindow* win, const TransferTask* task, FILE* fpSrc, FILE* fpDest)
+{
+    memset(win, 0, sizeof(*win));
+#ifdef __linux__
+    if (task->cachePolicy != TASK_CACHE_STREAM) return;
+    win->enabled = 1;
+    win->fpDest = fpDest;
+    win->srcFd = fileno(fpSrc);
+    win->destFd = fileno(fpDest);
+    win->window = g_stream_window;
+    win->windowStart = win->prevStart = task->currentOffset;
+    posix_fadvise(win->srcFd, (off_t)task->currentOffset, 0, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)task;
+    (void)fpSrc;
+    (void)fpDest;
+#endif
+}
+
+#ifdef __linux__
+// 等待 [prevStart, end) 回写完成后丢弃这段目标页
+static void stream_drop_written(StreamWindow* win, uint64_t end)
+{
+    if (end <= win->prevStart) return;
+    off_t off = (off_t)win->prevStart;
+    off_t len = (off_t)(end - win->prevStart);
+    sync_file_range(win->destFd, off, len,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(win->destFd, off, len, POSIX_FADV_DONTNEED);
+    win->prevStart = end;
+}
+#endif
+
+// 数据写到 offset 之后调用
+static void stream_advance(StreamWindow* win, uint64_t offset)
+{
+#ifdef __linux__
+    if (!win->enabled || offset - win->windowStart < win->window) return;
+    TRACE_BEGIN(span, "RunTask.writeback");
+    fflush(win->fpDest);
+    off_t off = (off_t)win->windowStart;
+    off_t len = (off_t)(offset - win->windowStart);
+    sync_file_range(win->destFd, off, len, SYNC_FILE_RANGE_WRITE);
+    posix_fadvise(win->srcFd, off, len, POSIX_FADV_DONTNEED);
+    stream_drop_written(win, win->windowStart);
+    win->windowStart = offset;
+    TRACE_END(span);
+#else
+    (void)win;
+    (void)offset;
+#endif
+}
+
+// 传输结束时写回并丢弃剩余部分
+static void stream_finish(StreamWindow* win, uint64_t offset)
+{
+#ifdef __linux__
+    if (!win->enabled) return;
+    fflush(win->fpDest);
+    if (offset > win->windowStart)
+    {
+        posix_fadvise(win->srcFd, (off_t)win->windowStart, (off_t)(offset - win->windowStart), POSIX_FADV_DONTNEED);
+    }
+    stream_drop_written(win, offset);
+    win->windowStart = offset;
+#else
+    (void)win;
+    (void)offset;
+#endif
+}
+
+// 处理其他线程发出的暂停 / 取消请求：保存进度并记录日志，调用者随后释放文件句柄并返回 0
+static void apply_stop_request(TransferTask* task, TaskStopRequest stop)
+{
+    task->status = stop == TASK_STOP_PAUSE ? TASK_PAUSED : TASK_ERROR;
+    TaskManager_UpdateTask(task);
+    TaskManager_Sync();
+    Logger_Log(LOG_INFO, "任务 %d 已%s (Offset: %llu)", task->id, stop == TASK_STOP_PAUSE ? "暂停" : "取消",
+               (unsigned long long)task->currentOffset);
+}
+
+// 写入成功后推进偏移、按阈值持久化并回调进度
+static void advance_task(TransferTask* task, size_t bytesWritten, size_t* bytesSinceLastSync)
+{
+    // 更新内存中的偏移量
+    task->currentOffset += bytesWritten;
+    *bytesSinceLastSync += bytesWritten;
+    Metrics_Add(METRIC_BYTES_TRANSFERRED, bytesWritten);
+
+    // 每次写入后标记为已修改，这样 TaskManager 可以按需持久化
+    TaskManager_UpdateTask(task);
+
+    // 根据阈值进行持久化（避免过于频繁的磁盘写入，但仍足够频繁用于断点恢复）
+    if (*bytesSinceLastSync >= SYNC_THRESHOLD)
+    {
+        TRACE_BEGIN(syncSpan, "TaskManager_Sync");
+        TaskManager_Sync();
+        TRACE_END(syncSpan);
+        *bytesSinceLastSync = 0;
+    }
+
+    // 更频繁地更新 UI 回调（每块都回调），便于实时显示
+    //计算current-percent
+    if (task->onProgress)
+    {
+        double percent = 0.0;
+        if (task->totalSize > 0)
+        {
+            percent = (double)task->currentOffset / (double)task->totalSize * 100.0;
+        }
+        task->onProgress(task->id, percent, 0.0);
+    }
+}
+
+// 断点续传时保存已完成叶子的链值，续传只需从断点所在叶子开始重新计算哈希
+static void leaf_checkpoint_path(const TransferTask* task, char* out, size_t size)
 {
+    snprintf(out, size, LEAF_CHECKPOINT_FMT, task->id);
+}
+
+// 保存目标文件哈希，标记完成并持久化。root 为拷贝过程中随写入计算出的树形哈希根；
+// 为 NULL 时 (内核内拷贝、增量哈希失败) 不读回目标文件，destHash 保持全零，由 VerifyTask 按需补算
+static int finish_task(TransferTask* task, const uint8_t* root)
+{
+    char checkpoint[64];
+    leaf_checkpoint_path(task, checkpoint, sizeof(checkpoint));
+    remove(checkpoint);
+
+    if (root) memcpy(task->destHash, root, sizeof(task->destHash));
+    else memset(task->destHash, 0, sizeof(task->destHash));
+
+    // 标记完成、持久化并触发最终进度回调
+    task->status = TASK_COMPLETED;
+    Metrics_Add(METRIC_TASKS_COMPLETED, 1);
+    TaskManager_UpdateTask(task);
+    TRACE_BEGIN(finalSyncSpan, "TaskManager_Sync");
+    TaskManager_Sync();
+    TRACE_END(finalSyncSpan);
+    if (task->onProgress) task->onProgress(task->id, 100.0, 0.0);
+
     return 0;
 }
 
+#ifdef __linux__
+
+typedef enum
+{
+    PLAIN_DONE = 0,
+    PLAIN_STOPPED,  // 已处理停止请求
+    PLAIN_FALLBACK, // 文件系统不支持内核内拷贝且尚未写入任何数据，改用读写循环
+    PLAIN_FAILED
+} PlainResult;
+
+// 不支持该拷贝方式 (跨文件系统、特殊文件、旧内核等) 时的 errno
+static int plain_unsupported(int err)
+{
+    return err == EXDEV || err == EINVAL || err == ENOSYS || err == EOPNOTSUPP || err == ENOTTY ||
+           err == EBADF || err == EPERM || err == ETXTBSY;
+}
+
+// 明文任务的内核内拷贝：整文件 reflink (FICLONE) -> copy_file_range -> sendfile。
+// 每步从 task->currentOffset 续传，步与步之间处理停止请求、持久化进度并回调
+static PlainResult copy_plain_fast(TransferTask* task, int srcFd, int destFd, size_t step, StreamWindow* win)
+{
+    struct stat st;
+    if (fstat(srcFd, &st) != 0)
+    {
+        return PLAIN_FALLBACK;
+    }
+    size_t bytesSinceLastSync = 0;
+
+#ifdef FICLONE
+    // 共享数据块，btrfs / XFS 上与文件大小无关地瞬间完成；只适用于从头开始的任务
+    if (task->currentOffset == 0 && st.st_size > 0)
+    {
+        TRACE_BEGIN(cloneSpan, "RunTask.reflink");
+        int cloned = ioctl(destFd, FICLONE, srcFd) == 0;
+        TRACE_END(cloneSpan);
+        if (cloned)
+        {
+            advance_task(task, (size_t)st.st_size, &bytesSinceLastSync);
+            return PLAIN_DONE;
+        }
+    }
+#endif
+
+    int useSendfile = 0;
+#ifdef SYS_copy_file_range
+    int copied = 0;
+    for (;;)
+    {
+        TaskStopRequest stop = TaskManager_TakeStopRequest(task);
+        if (stop != TASK_STOP_NONE)
+        {
+            apply_stop_request(task, stop);
+            return PLAIN_STOPPED;
+        }
+
+        int64_t inOff = (int64_t)task->currentOffset;
+        int64_t outOff = inOff;
+        TRACE_BEGIN(copySpan, "RunTask.copy_file_range");
+        long n = syscall(SYS_copy_file_range, srcFd, &inOff, destFd, &outOff, step, 0u);
+        TRACE_END(copySpan);
+        if (n == 0) return PLAIN_DONE;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (!copied && plain_unsupported(errno))
+            {
+                useSendfile = 1;
+                break;
+            }
+            return PLAIN_FAILED;
+        }
+        copied = 1;
+        advance_task(task, (size_t)n, &bytesSinceLastSync);
+        stream_advance(win, task->currentOffset);
+    }
+#else
+    useSendfile = 1;
+#endif
+
+    if (!useSendfile || lseek(destFd, (off_t)task->currentOffset, SEEK_SET) < 0)
+    {
+        return PLAIN_FALLBACK;
+    }
+
+    // sendfile 写到目标文件的当前位置，读取位置由 inOff 指定
+    int sent = 0;
+    for (;;)
+    {
+        TaskStopRequest stop = TaskManager_TakeStopRequest(task);
+        if (stop != TASK_STOP_NONE)
+        {
+            apply_stop_request(task, stop);
+            return PLAIN_STOPPED;
+        }
+
+        off_t inOff = (off_t)task->currentOffset;
+        TRACE_BEGIN(sendSpan, "RunTask.sendfile");
+        ssize_t n = sendfile(destFd, srcFd, &inOff, step);
+        TRACE_END(sendSpan);
+        if (n == 0) return PLAIN_DONE;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            return !sent && plain_unsupported(errno) ? PLAIN_FALLBACK : PLAIN_FAILED;
+        }
+        sent = 1;
+        advance_task(task, (size_t)n, &bytesSinceLastSync);
+        stream_advance(win, task->currentOffset);
+    }
+}
+
+#endif // __linux__
+
 int RunTask(TransferTask* task)
 {
     if (!task) return -1;
 
+    // 以下各阶段在启用 SAFETRIX_ENABLE_TRACE 时记录为 trace span，可导出到 Perfetto 查看耗时分布
+    TRACE_BEGIN(openSpan, "RunTask.open");
     FILE* fpSrc = FileUtils_OpenFileUTF8(task->srcPath, "rb");
     if (!fpSrc)
     {
-        if (task->onError) task->onError(task->id, -1, "Cannot open source file");
+        report_io_error(task, "Cannot open source file");
         return -1;
     }
 
-    // 打开目标文件为可读写（以便支持断点续传），若不存在则创建
-    FILE* fpDest = FileUtils_OpenFileUTF8(task->destPath, "r+b");
+    FILE* fpDest = open_dest(task->destPath, task->totalSize);
     if (!fpDest)
     {
-        // 尝试创建父目录后再创建目标文件
-        ensure_parent_dir_exists(task->destPath);
-        fpDest = FileUtils_OpenFileUTF8(task->destPath, "r+b");
-        if (!fpDest)
+        fclose(fpSrc);
+        report_io_error(task, "Cannot create dest file");
+        return -1;
+    }
+    TRACE_END(openSpan);
+
+    StreamWindow win;
+    stream_begin(&win, task, fpSrc, fpDest);
+
+#ifdef __linux__
+    // 明文任务优先走内核内拷贝，数据不经过用户态缓冲区；不支持时退回下面的读写循环
+    if (task->mode == TASK_MODE_PLAIN)
+    {
+        const uint64_t startOffset = task->currentOffset;
+        const size_t step = g_chunk_size > PLAIN_COPY_STEP ? g_chunk_size : PLAIN_COPY_STEP;
+        task->status = TASK_RUNNING;
+        PlainResult rc = copy_plain_fast(task, fileno(fpSrc), fileno(fpDest), step, &win);
+        if (rc != PLAIN_FALLBACK)
         {
-            fpDest = FileUtils_OpenFileUTF8(task->destPath, "wb");
-            if (!fpDest)
-            {
-                fclose(fpSrc);
-                if (task->onError) task->onError(task->id, -1, "Cannot create dest file");
-                return -1;
-            }
+            if (startOffset > 0) Metrics_Add(METRIC_RESUMES, 1);
+            if (rc == PLAIN_DONE) stream_finish(&win, task->currentOffset);
+            fclose(fpSrc);
+            fclose(fpDest);
+            if (rc == PLAIN_DONE) return finish_task(task, NULL);
+            if (rc == PLAIN_STOPPED) return 0;
+
+            task->status = TASK_ERROR;
+            TaskManager_UpdateTask(task);
+            TaskManager_Sync();
+            report_io_error(task, "Kernel copy failed");
+            return -1;
         }
     }
+#endif
 
     // 确保源文件从 task->currentOffset 开始读取
+    TRACE_BEGIN(seekSpan, "RunTask.seek");
     if (fseek(fpSrc, (long)task->currentOffset, SEEK_SET) != 0)
     {
         fclose(fpSrc);
         fclose(fpDest);
-        if (task->onError) task->onError(task->id, -1, "Failed to seek source file");
+        report_io_error(task, "Failed to seek source file");
         return -1;
     }
 
@@ -136,29 +553,62 @@ int RunTask(TransferTask* task)
     {
         fclose(fpSrc);
         fclose(fpDest);
-        if (task->onError) task->onError(task->id, -1, "Failed to seek dest file");
+        report_io_error(task, "Failed to seek dest file");
         return -1;
     }
+    TRACE_END(seekSpan);
 
+    // 密钥流按绝对文件偏移寻址 (v2 接口)，断点续传无需再手动对齐 keyIndex
     CryptoContext ctx;
-    InitSecurity(&ctx, "SecretKey123");
+    InitSecurity(&ctx, ENGINE_PASSWORD);
 
-    // 修复：根据当前文件偏移量，调整密钥流的索引
-    // 否则断点续传时，密钥会从头开始算，导致解密失败
-    if (task->currentOffset > 0 && ctx.keyLen > 0)
+    // 块大小可配置，缓冲区取自进程级缓冲池 (页对齐，跨任务复用)
+    const size_t chunkSize = g_chunk_size;
+    uint8_t* buffer = (uint8_t*)BufferPool_Acquire(chunkSize);
+    if (!buffer)
     {
-        ctx.keyIndex = (int)(task->currentOffset % ctx.keyLen);
+        fclose(fpSrc);
+        fclose(fpDest);
+        if (task->onError) task->onError(task->id, ERR_MEMORY, "Out of memory");
+        return -1;
     }
-
-    uint8_t buffer[CHUNK_SIZE];
     size_t bytesRead;
     task->status = TASK_RUNNING;
+    if (task->currentOffset > 0) Metrics_Add(METRIC_RESUMES, 1);
 
     size_t bytesSinceLastSync = 0;
-    const size_t SYNC_THRESHOLD = 64 * 1024; // 64KB 更频繁的同步，以便快速恢复
 
-    while ((bytesRead = fread(buffer, 1, CHUNK_SIZE, fpSrc)) > 0)
+    // 目标文件的树形哈希随写出的缓冲区逐叶子计算，完成时无需再读回目标文件
+    char checkpoint[64];
+    leaf_checkpoint_path(task, checkpoint, sizeof(checkpoint));
+    TreeHashStream hash;
+    TRACE_BEGIN(resumeHashSpan, "RunTask.hash");
+    if (TreeHash_StreamBegin(&hash, task->totalSize, task->currentOffset, task->destPath, checkpoint, 0) != 0)
+    {
+        Logger_Log(LOG_WARNING, "任务 %d 无法续算目标文件哈希，完成后将重新读取目标文件", task->id);
+    }
+    TRACE_END(resumeHashSpan);
+
+    for (;;)
     {
+        // 处理其他线程发出的暂停 / 取消请求：保存进度后释放文件句柄
+        TaskStopRequest stop = TaskManager_TakeStopRequest(task);
+        if (stop != TASK_STOP_NONE)
+        {
+            apply_stop_request(task, stop);
+            TreeHash_StreamSave(&hash, checkpoint);
+            TreeHash_StreamFree(&hash);
+            fclose(fpSrc);
+            fclose(fpDest);
+            BufferPool_Release(buffer, chunkSize);
+            return 0;
+        }
+
+        TRACE_BEGIN(readSpan, "RunTask.read");
+        bytesRead = fread(buffer, 1, chunkSize, fpSrc);
+        TRACE_END(readSpan);
+        if (bytesRead == 0) break;
+
 #ifdef _WIN32
         // 非阻塞交互检测
         if (_kbhit()) // 检查是否有键盘敲击（不阻塞）
@@ -179,76 +629,495 @@ int RunTask(TransferTask* task)
                 printf("[系统] 文件句柄已释放，您现在可以检查文件内容。\n");
 
                 // D. 必须关闭文件！否则文件被锁死，无法用编辑器查看
+                TreeHash_StreamSave(&hash, checkpoint);
+                TreeHash_StreamFree(&hash);
                 fclose(fpSrc);
                 fclose(fpDest);
+                BufferPool_Release(buffer, chunkSize);
 
                 return 0; // 退出 RunTask，回到主菜单
             }
         }
 #endif
 
-        EncryptBuffer(buffer, (size_t)bytesRead, &ctx);
+        // 明文任务原样写出；内核内拷贝与此循环可能交替续传，因此明文任务统一不累加 CRC32
+        if (task->mode != TASK_MODE_PLAIN)
+        {
+            // 累加源数据 CRC32：与 currentOffset 一起持久化，因此断点续传后可继续累加
+            TRACE_BEGIN(crcSpan, "RunTask.crc32");
+            task->crc32 = Algorithm_UpdateCRC32(task->crc32, buffer, bytesRead);
+            TRACE_END(crcSpan);
 
+            TRACE_BEGIN(encryptSpan, "RunTask.encrypt");
+            uint64_t cipherStart = Thread_NowNs();
+            EncryptBufferAt(&ctx, buffer, (size_t)bytesRead, task->currentOffset);
+            Metrics_Add(METRIC_CIPHER_NS, Thread_NowNs() - cipherStart);
+            TRACE_END(encryptSpan);
+        }
+
+        TRACE_BEGIN(writeSpan, "RunTask.write");
         size_t bytesWritten = fwrite(buffer, 1, bytesRead, fpDest);
+        TRACE_END(writeSpan);
         if (bytesWritten < bytesRead)
         {
             task->status = TASK_ERROR;
             // 立即持久化状态并返回错误
             TaskManager_UpdateTask(task);
             TaskManager_Sync();
-            if (task->onError) task->onError(task->id, -1, "Failed to write dest file");
+            report_io_error(task, "Failed to write dest file");
+            TreeHash_StreamFree(&hash);
             fclose(fpSrc);
             fclose(fpDest);
+            BufferPool_Release(buffer, chunkSize);
             return -1;
         }
 
-        // 更新内存中的偏移量
-        task->currentOffset += bytesWritten;
-        bytesSinceLastSync += bytesWritten;
+        TRACE_BEGIN(hashSpan, "RunTask.hash");
+        TreeHash_StreamUpdate(&hash, buffer, bytesWritten);
+        TRACE_END(hashSpan);
+
+        advance_task(task, bytesWritten, &bytesSinceLastSync);
+        stream_advance(&win, task->currentOffset);
+    }
 
-        // 每次写入后标记为已修改，这样 TaskManager 可以按需持久化
+    // 循环结束后检查是否为正常完成
+    if (!feof(fpSrc))
+    {
+        // 读取出错
+        task->status = TASK_ERROR;
         TaskManager_UpdateTask(task);
+        TaskManager_Sync();
+        report_io_error(task, "Read error on source file");
+        TreeHash_StreamFree(&hash);
+        fclose(fpSrc);
+        fclose(fpDest);
+        BufferPool_Release(buffer, chunkSize);
+        return -1;
+    }
+
+    stream_finish(&win, task->currentOffset);
+    fclose(fpSrc);
+    fclose(fpDest);
+    BufferPool_Release(buffer, chunkSize);
+
+    uint8_t root[TREEHASH_OUT_LEN];
+    int hashed = TreeHash_StreamFinish(&hash, root) == 0;
+    TreeHash_StreamFree(&hash);
+    return finish_task(task, hashed ? root : NULL);
+}
+
+// ---- 扇出复制：同一源文件只读取、加密一次，写入多个目标 ----
+// 读取端把每块放入环形队列，每个目标一个写线程按顺序消费；每块带引用计数，所有目标写完后归还缓冲池。
+// 每个目标仍是独立的任务，自己的 currentOffset / crc32 照常持久化，因此可以各自续传
+
+void TransferEngine_SetFanoutStallTimeout(unsigned int ms)
+{
+    g_fanout_stall_ms = ms > 0 ? ms : FANOUT_STALL_MS;
+}
+
+typedef enum
+{
+    FANOUT_ACTIVE = 0,
+    FANOUT_DETACHED, // 拖慢其他目标过久，由读取端摘除，写完手头的块后暂停
+    FANOUT_STOPPED,  // 处理了该任务自己的暂停 / 取消请求
+    FANOUT_FAILED    // 打开或写入失败
+} FanoutState;
+
+typedef struct FanoutChunk
+{
+    uint8_t* data; // 已加密 (明文任务为原文)
+    size_t len;
+    uint64_t offset;
+    uint32_t crc; // 该块明文的 CRC32，各目标按自身进度合并
+    int refs;     // 尚未写完该块的目标数
+} FanoutChunk;
+
+typedef struct FanoutGroup
+{
+    Mutex lock;
+    CondVar produced; // 发布了新块或读取结束
+    CondVar consumed; // 有目标写完一块或退出
+    FanoutChunk* ring[FANOUT_SLOTS];
+    uint64_t count; // 已发布的块数
+    int finished;   // 读取结束
+    int readFailed;
+    size_t chunkSize;
+    int hashed;                     // 读取端已随读取算出目标文件的树形哈希根，各目标直接使用
+    uint64_t hashSize;
+    uint8_t root[TREEHASH_OUT_LEN];
+} FanoutGroup;
+
+typedef struct FanoutWriter
+{
+    FanoutGroup* group;
+    TransferTask* task;
+    FILE* fp;
+    Thread thread;
+    int started;
+    uint64_t resumeAt; // 开始时的续传偏移，读取端据此切分块边界
+    uint64_t next;     // 下一个要写的块序号
+    int writing;       // 正在锁外写入序号为 next 的块
+    FanoutState state;
+} FanoutWriter;
+
+// 以下均在持有 group->lock 时调用
+static void fanout_release(FanoutGroup* g, FanoutChunk* chunk)
+{
+    if (--chunk->refs > 0) return;
+    BufferPool_Release(chunk->data, g->chunkSize);
+    free(chunk);
+}
+
+// 目标离开 ACTIVE 状态：放弃它尚未开始写的块
+static void fanout_leave(FanoutGroup* g, FanoutWriter* w, FanoutState state)
+{
+    w->state = state;
+    for (uint64_t seq = w->next + (w->writing ? 1 : 0); seq < g->count; ++seq)
+    {
+        fanout_release(g, g->ring[seq % FANOUT_SLOTS]);
+    }
+    CondVar_Broadcast(&g->consumed);
+}
 
-        // 根据阈值进行持久化（避免过于频繁的磁盘写入，但仍足够频繁用于断点恢复）
-        if (bytesSinceLastSync >= SYNC_THRESHOLD)
+static void fanout_writer(void* arg)
+{
+    FanoutWriter* w = (FanoutWriter*)arg;
+    FanoutGroup* g = w->group;
+    TransferTask* task = w->task;
+    size_t bytesSinceLastSync = 0;
+
+    Mutex_Lock(&g->lock);
+    for (;;)
+    {
+        while (w->state == FANOUT_ACTIVE && w->next == g->count && !g->finished)
         {
-            TaskManager_Sync();
-            bytesSinceLastSync = 0;
+            CondVar_Wait(&g->produced, &g->lock);
         }
+        if (w->state != FANOUT_ACTIVE || w->next == g->count) break;
 
-        // 更频繁地更新 UI 回调（每块都回调），便于实时显示
-        //计算current-percent
-        if (task->onProgress)
+        FanoutChunk* chunk = g->ring[w->next % FANOUT_SLOTS];
+        w->writing = 1;
+        Mutex_Unlock(&g->lock);
+
+        // 停止请求在块之间处理；块边界与各目标的续传偏移对齐，已写过的块整块跳过
+        FanoutState outcome = FANOUT_ACTIVE;
+        TaskStopRequest stop = TaskManager_TakeStopRequest(task);
+        if (stop != TASK_STOP_NONE)
+        {
+            apply_stop_request(task, stop);
+            outcome = FANOUT_STOPPED;
+        }
+        else if (chunk->offset >= task->currentOffset)
         {
-            double percent = 0.0;
-            if (task->totalSize > 0)
+            TRACE_BEGIN(writeSpan, "RunTask.write");
+            size_t bytesWritten = fwrite(chunk->data, 1, chunk->len, w->fp);
+            TRACE_END(writeSpan);
+            if (bytesWritten < chunk->len)
+            {
+                outcome = FANOUT_FAILED;
+            }
+            else
             {
-                percent = (double)task->currentOffset / (double)task->totalSize * 100.0;
+                if (task->mode != TASK_MODE_PLAIN)
+                {
+                    task->crc32 = Algorithm_CombineCRC32(task->crc32, chunk->crc, chunk->len);
+                }
+                advance_task(task, bytesWritten, &bytesSinceLastSync);
             }
-            task->onProgress(task->id, percent, 0.0);
         }
+
+        Mutex_Lock(&g->lock);
+        w->writing = 0;
+        fanout_release(g, chunk);
+        w->next++;
+        if (outcome != FANOUT_ACTIVE && w->state == FANOUT_ACTIVE) fanout_leave(g, w, outcome);
+        else if (outcome != FANOUT_ACTIVE) w->state = outcome;
+        CondVar_Broadcast(&g->consumed);
     }
+    FanoutState state = w->state;
+    int readFailed = g->readFailed;
+    int hashed = g->hashed && g->hashSize == task->totalSize;
+    Mutex_Unlock(&g->lock);
 
-    // 循环结束后检查是否为正常完成
-    if (!feof(fpSrc))
+    fclose(w->fp);
+    w->fp = NULL;
+    if (state == FANOUT_ACTIVE && !readFailed)
+    {
+        // 所有目标内容相同，共用读取端算出的哈希根
+        finish_task(task, hashed ? g->root : NULL);
+        return;
+    }
+    if (state == FANOUT_STOPPED) return;
+
+    if (state == FANOUT_DETACHED)
+    {
+        // 慢目标暂停在已提交的偏移上，之后可单独续传
+        task->status = TASK_PAUSED;
+        Logger_Log(LOG_WARNING, "任务 %d 的目标写入过慢，已暂停以免拖住其他目标 (Offset: %llu)", task->id,
+                   (unsigned long long)task->currentOffset);
+    }
+    else
     {
-        // 读取出错
         task->status = TASK_ERROR;
-        TaskManager_UpdateTask(task);
-        TaskManager_Sync();
-        if (task->onError) task->onError(task->id, -1, "Read error on source file");
-        fclose(fpSrc);
-        fclose(fpDest);
+    }
+    TaskManager_UpdateTask(task);
+    TaskManager_Sync();
+    if (state == FANOUT_FAILED) report_io_error(task, "Failed to write dest file");
+    else if (state != FANOUT_DETACHED) report_io_error(task, "Read error on source file");
+}
+
+// 读取端等待环形队列出现空位。最慢的目标让其他目标空等超过 g_fanout_stall_ms 时将其摘除；
+// 所有目标同样慢时继续等待。返回仍在写入的目标数
+static int fanout_wait_slot(FanoutGroup* g, FanoutWriter* writers, int count)
+{
+    uint64_t waitStart = 0;
+    for (;;)
+    {
+        int active = 0;
+        uint64_t minNext = UINT64_MAX;
+        uint64_t maxNext = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            if (writers[i].state != FANOUT_ACTIVE) continue;
+            active++;
+            if (writers[i].next < minNext) minNext = writers[i].next;
+            if (writers[i].next > maxNext) maxNext = writers[i].next;
+        }
+        if (active == 0 || g->count - minNext < FANOUT_SLOTS) return active;
+
+        uint64_t now = Thread_NowNs();
+        if (waitStart == 0) waitStart = now;
+        uint64_t waitedMs = (now - waitStart) / 1000000ull;
+        if (maxNext > minNext && waitedMs >= g_fanout_stall_ms)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                if (writers[i].state == FANOUT_ACTIVE && writers[i].next == minNext)
+                {
+                    fanout_leave(g, &writers[i], FANOUT_DETACHED);
+                }
+            }
+            waitStart = 0;
+            continue;
+        }
+        unsigned int left = waitedMs < g_fanout_stall_ms ? (unsigned int)(g_fanout_stall_ms - waitedMs) : 1;
+        CondVar_TimedWait(&g->consumed, &g->lock, left);
+    }
+}
+
+int RunTaskGroup(TransferTask** tasks, int count)
+{
+    if (!tasks || count <= 0) return -1;
+    for (int i = 1; i < count; ++i)
+    {
+        if (!tasks[i] || strcmp(tasks[i]->srcPath, tasks[0]->srcPath) != 0 || tasks[i]->mode != tasks[0]->mode)
+        {
+            return -1;
+        }
+    }
+    if (count == 1) return RunTask(tasks[0]);
+
+    FILE* fpSrc = FileUtils_OpenFileUTF8(tasks[0]->srcPath, "rb");
+    FanoutWriter* writers = (FanoutWriter*)calloc((size_t)count, sizeof(FanoutWriter));
+    if (!fpSrc || !writers)
+    {
+        for (int i = 0; i < count; ++i) report_io_error(tasks[i], "Cannot open source file");
+        if (fpSrc) fclose(fpSrc);
+        free(writers);
         return -1;
     }
 
-    // 标记完成、持久化并触发最终进度回调
-    task->status = TASK_COMPLETED;
-    TaskManager_UpdateTask(task);
+    FanoutGroup g;
+    memset(&g, 0, sizeof(g));
+    Mutex_Init(&g.lock);
+    CondVar_Init(&g.produced);
+    CondVar_Init(&g.consumed);
+    g.chunkSize = g_chunk_size > FANOUT_MIN_CHUNK ? g_chunk_size : FANOUT_MIN_CHUNK;
+
+    // 打开全部目标；单个目标失败不影响其他目标
+    const int plain = tasks[0]->mode == TASK_MODE_PLAIN;
+    uint64_t pos = UINT64_MAX;
+    TransferTask* first = NULL; // 续传偏移最小的目标，哈希从它的偏移开始续算
+    int rc = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        FanoutWriter* w = &writers[i];
+        TransferTask* task = tasks[i];
+        w->group = &g;
+        w->task = task;
+        w->resumeAt = task->currentOffset;
+        w->fp = open_dest(task->destPath, task->totalSize);
+        if (!w->fp || (task->currentOffset > 0 && FileUtils_Seek(w->fp, task->currentOffset) != 0))
+        {
+            if (w->fp) fclose(w->fp);
+            w->fp = NULL;
+            w->state = FANOUT_FAILED;
+            task->status = TASK_ERROR;
+            TaskManager_UpdateTask(task);
+            report_io_error(task, "Cannot create dest file");
+            rc = -1;
+            continue;
+        }
+        task->status = TASK_RUNNING;
+        if (task->currentOffset > 0) Metrics_Add(METRIC_RESUMES, 1);
+        if (task->currentOffset < pos)
+        {
+            pos = task->currentOffset;
+            first = task;
+        }
+    }
+    if (pos != UINT64_MAX && FileUtils_Seek(fpSrc, pos) != 0)
+    {
+        g.readFailed = 1;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (writers[i].state == FANOUT_ACTIVE && Thread_Create(&writers[i].thread, fanout_writer, &writers[i]) == 0)
+        {
+            writers[i].started = 1;
+        }
+        else if (writers[i].state == FANOUT_ACTIVE)
+        {
+            writers[i].state = FANOUT_FAILED;
+            fclose(writers[i].fp);
+            writers[i].fp = NULL;
+            tasks[i]->status = TASK_ERROR;
+            TaskManager_UpdateTask(tasks[i]);
+            rc = -1;
+        }
+    }
+
+    CryptoContext ctx;
+    InitSecurity(&ctx, ENGINE_PASSWORD);
+
+    // 各目标写入的内容相同，树形哈希由读取端对共享的块只算一次
+    char checkpoint[64];
+    TreeHashStream hash;
+    memset(&hash, 0, sizeof(hash));
+    if (first)
+    {
+        leaf_checkpoint_path(first, checkpoint, sizeof(checkpoint));
+        TRACE_BEGIN(resumeHashSpan, "RunTask.hash");
+        if (TreeHash_StreamBegin(&hash, first->totalSize, pos, first->destPath, checkpoint, 0) != 0)
+        {
+            Logger_Log(LOG_WARNING, "任务 %d 无法续算目标文件哈希，将在校验时计算", first->id);
+        }
+        TRACE_END(resumeHashSpan);
+        g.hashSize = first->totalSize;
+    }
+
+    Mutex_Lock(&g.lock);
+    while (!g.readFailed && fanout_wait_slot(&g, writers, count) > 0)
+    {
+        Mutex_Unlock(&g.lock);
+
+        // 块边界落在每个目标的续传偏移上，各目标对每块要么整块写入、要么整块跳过
+        size_t want = g.chunkSize;
+        for (int i = 0; i < count; ++i)
+        {
+            uint64_t resumeAt = writers[i].resumeAt;
+            if (resumeAt > pos && resumeAt - pos < want) want = (size_t)(resumeAt - pos);
+        }
+
+        uint8_t* data = (uint8_t*)BufferPool_Acquire(g.chunkSize);
+        TRACE_BEGIN(readSpan, "RunTask.read");
+        size_t n = data ? fread(data, 1, want, fpSrc) : 0;
+        TRACE_END(readSpan);
+        FanoutChunk* chunk = n > 0 ? (FanoutChunk*)malloc(sizeof(FanoutChunk)) : NULL;
+        if (!chunk)
+        {
+            BufferPool_Release(data, g.chunkSize);
+            int eof = n == 0 && feof(fpSrc);
+            uint8_t root[TREEHASH_OUT_LEN];
+            int hashed = eof && TreeHash_StreamFinish(&hash, root) == 0;
+            Mutex_Lock(&g.lock);
+            g.readFailed = !eof;
+            if (hashed)
+            {
+                memcpy(g.root, root, sizeof(root));
+                g.hashed = 1;
+            }
+            break;
+        }
+
+        chunk->data = data;
+        chunk->len = n;
+        chunk->offset = pos;
+        chunk->crc = 0;
+        if (!plain)
+        {
+            TRACE_BEGIN(crcSpan, "RunTask.crc32");
+            chunk->crc = Algorithm_CalculateCRC32(data, n);
+            TRACE_END(crcSpan);
+
+            TRACE_BEGIN(encryptSpan, "RunTask.encrypt");
+            uint64_t cipherStart = Thread_NowNs();
+            EncryptBufferAt(&ctx, data, n, pos);
+            Metrics_Add(METRIC_CIPHER_NS, Thread_NowNs() - cipherStart);
+            TRACE_END(encryptSpan);
+        }
+        TRACE_BEGIN(hashSpan, "RunTask.hash");
+        TreeHash_StreamUpdate(&hash, data, n);
+        TRACE_END(hashSpan);
+        pos += n;
+
+        Mutex_Lock(&g.lock);
+        chunk->refs = 0;
+        for (int i = 0; i < count; ++i) chunk->refs += writers[i].state == FANOUT_ACTIVE;
+        if (chunk->refs == 0)
+        {
+            BufferPool_Release(data, g.chunkSize);
+            free(chunk);
+            break;
+        }
+        g.ring[g.count % FANOUT_SLOTS] = chunk;
+        g.count++;
+        CondVar_Broadcast(&g.produced);
+    }
+    g.finished = 1;
+    CondVar_Broadcast(&g.produced);
+    Mutex_Unlock(&g.lock);
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (writers[i].started) Thread_Join(writers[i].thread);
+        if (writers[i].state == FANOUT_FAILED || (writers[i].state == FANOUT_ACTIVE && g.readFailed)) rc = -1;
+
+        // 暂停的目标保存已完成叶子的链值，单独续传时不必重新计算
+        if (tasks[i]->status == TASK_PAUSED)
+        {
+            leaf_checkpoint_path(tasks[i], checkpoint, sizeof(checkpoint));
+            TreeHash_StreamSave(&hash, checkpoint);
+        }
+    }
+    TreeHash_StreamFree(&hash);
     TaskManager_Sync();
-    if (task->onProgress) task->onProgress(task->id, 100.0, 0.0);
 
     fclose(fpSrc);
-    fclose(fpDest);
-    return 0;
+    CondVar_Destroy(&g.consumed);
+    CondVar_Destroy(&g.produced);
+    Mutex_Destroy(&g.lock);
+    free(writers);
+    return rc;
+}
+
+int VerifyTask(TransferTask* task, int threads, VerifyResult* out)
+{
+    if (!task || !out) return ERR_TASK_NOT_FOUND;
+
+    // 明文任务直接逐字节比较
+    CryptoContext ctx;
+    InitSecurity(&ctx, ENGINE_PASSWORD);
+    int rc = Verify_Files(task->srcPath, task->destPath, task->mode == TASK_MODE_PLAIN ? NULL : &ctx, threads, out);
+
+    // 内核内拷贝完成时不读回目标文件，哈希留到校验时补算；仍在任务表中的任务随之持久化
+    static const uint8_t zero[TREEHASH_OUT_LEN] = {0};
+    if (rc == ERR_SUCCESS && out->match && task->status == TASK_COMPLETED &&
+        memcmp(task->destHash, zero, sizeof(zero)) == 0 && TreeHash_File(task->destPath, threads, task->destHash) == 0 &&
+        GetTaskById(task->id) == task)
+    {
+        TaskManager_UpdateTask(task);
+        TaskManager_Sync();
+    }
+    return rc;
 }
@@ -0,0 +1,239 @@
+﻿#include "core/Verify.h"
+#include "common/ErrorCode.h"
+#include "utils/BufferPool.h"
+#include "utils/FileUtils.h"
+#include "utils/Thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define VERIFY_USE_MMAP (sizeof(void*) >= 8) // 32 位地址空间不足以映射大文件，改用分块读取
+#else
+#define VERIFY_USE_MMAP 0
+#endif
+
+#define VERIFY_BLOCK ((uint64_t)8 * 1024 * 1024) // 线程间分配工作的粒度
+#define VERIFY_SUB ((size_t)1024 * 1024)         // 读取/解密/比较的子块大小
+#define VERIFY_MAX_THREADS 64
+#define VERIFY_NO_MISMATCH UINT64_MAX
+
+typedef struct VerifyJob
+{
+    const char* srcPath;
+    const char* destPath;
+    const CryptoContext* ctx;
+    uint64_t length; // 两个文件的公共长度
+    const uint8_t* srcMap;
+    const uint8_t* destMap;
+    atomic_uint_fast64_t nextBlock;
+    atomic_uint_fast64_t firstMismatch;
+    atomic_uint_fast64_t bytesCompared;
+    atomic_int error;
+} VerifyJob;
+
+// 返回 a 与 b 第一个不同字节的下标，完全相同时返回 len
+// memcmp 由 C 库以 SIMD 实现，先按 4KB 粗比较，命中后再逐字节定位
+static size_t find_mismatch(const uint8_t* a, const uint8_t* b, size_t len)
+{
+    const size_t step = 4096;
+    for (size_t pos = 0; pos < len; pos += step)
+    {
+        size_t n = (len - pos < step) ? len - pos : step;
+        if (memcmp(a + pos, b + pos, n) != 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (a[pos + i] != b[pos + i]) return pos + i;
+            }
+        }
+    }
+    return len;
+}
+
+static void record_mismatch(VerifyJob* job, uint64_t offset)
+{
+    uint_fast64_t cur = atomic_load(&job->firstMismatch);
+    while (offset < cur && !atomic_compare_exchange_weak(&job->firstMismatch, &cur, offset))
+    {
+    }
+}
+
+static void verify_worker(void* arg)
+{
+    VerifyJob* job = (VerifyJob*)arg;
+    FILE* fpSrc = NULL;
+    FILE* fpDest = NULL;
+    uint8_t* srcBuf = NULL;
+    uint8_t* destBuf = NULL;
+
+    if (!job->srcMap)
+    {
+        fpSrc = FileUtils_OpenFileUTF8(job->srcPath, "rb");
+        fpDest = FileUtils_OpenFileUTF8(job->destPath, "rb");
+        srcBuf = (uint8_t*)BufferPool_Acquire(VERIFY_SUB);
+        if (!fpSrc || !fpDest || !srcBuf)
+        {
+            atomic_store(&job->error, fpSrc && fpDest ? ERR_MEMORY : ERR_FILE_OPEN);
+            goto done;
+        }
+    }
+    if (!job->destMap || job->ctx)
+    {
+        // 未映射时用作读缓冲；解密模式下映射区只读，需要一块可写的暂存区
+        destBuf = (uint8_t*)BufferPool_Acquire(VERIFY_SUB);
+        if (!destBuf)
+        {
+            atomic_store(&job->error, ERR_MEMORY);
+            goto done;
+        }
+    }
+
+    for (;;)
+    {
+        uint64_t start = (uint64_t)atomic_fetch_add(&job->nextBlock, 1) * VERIFY_BLOCK;
+        if (start >= job->length || atomic_load(&job->error) != ERR_SUCCESS) break;
+        uint64_t end = start + VERIFY_BLOCK < job->length ? start + VERIFY_BLOCK : job->length;
+
+        // 已经在更靠前的位置发现不一致的区块无需再比较
+        if (start >= atomic_load(&job->firstMismatch)) continue;
+
+        if (fpSrc && (FileUtils_Seek(fpSrc, start) != 0 || FileUtils_Seek(fpDest, start) != 0))
+        {
+            atomic_store(&job->error, ERR_FILE_READ);
+            break;
+        }
+
+        for (uint64_t off = start; off < end; off += VERIFY_SUB)
+        {
+            if (off >= atomic_load(&job->firstMismatch)) break;
+            size_t n = (size_t)(end - off < VERIFY_SUB ? end - off : VERIFY_SUB);
+
+            const uint8_t* s;
+            const uint8_t* d;
+            if (job->srcMap)
+            {
+                s = job->srcMap + off;
+                d = job->destMap + off;
+            }
+            else
+            {
+                if (fread(srcBuf, 1, n, fpSrc) != n || fread(destBuf, 1, n, fpDest) != n)
+                {
+                    atomic_store(&job->error, ERR_FILE_READ);
+                    goto done;
+                }
+                s = srcBuf;
+                d = destBuf;
+            }
+
+            if (job->ctx)
+            {
+                if (d != destBuf) memcpy(destBuf, d, n);
+                EncryptBufferAt(job->ctx, destBuf, n, off); // 对称算法：再加密一次即解密
+                d = destBuf;
+            }
+
+            size_t idx = find_mismatch(s, d, n);
+            atomic_fetch_add(&job->bytesCompared, (uint_fast64_t)n);
+            if (idx < n)
+            {
+                record_mismatch(job, off + idx);
+                break;
+            }
+        }
+    }
+
+done:
+    if (fpSrc) fclose(fpSrc);
+    if (fpDest) fclose(fpDest);
+    BufferPool_Release(srcBuf, VERIFY_SUB);
+    BufferPool_Release(destBuf, VERIFY_SUB);
+}
+
+#if !defined(_WIN32)
+static const uint8_t* map_file(const char* path, uint64_t size)
+{
+    if (size == 0) return NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    void* p = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    madvise(p, (size_t)size, MADV_SEQUENTIAL);
+    return (const uint8_t*)p;
+}
+#endif
+
+int Verify_Files(const char* srcPath, const char* destPath, const CryptoContext* ctx, int threads,
+                 VerifyResult* out)
+{
+    if (!srcPath || !destPath || !out) return ERR_MEMORY;
+    memset(out, 0, sizeof(VerifyResult));
+
+    if (!FileUtils_Exists(srcPath) || !FileUtils_Exists(destPath)) return ERR_FILE_OPEN;
+    out->srcSize = FileUtils_GetFileSize(srcPath);
+    out->destSize = FileUtils_GetFileSize(destPath);
+
+    VerifyJob job;
+    memset(&job, 0, sizeof(job));
+    job.srcPath = srcPath;
+    job.destPath = destPath;
+    job.ctx = ctx;
+    job.length = out->srcSize < out->destSize ? out->srcSize : out->destSize;
+    atomic_init(&job.nextBlock, 0);
+    atomic_init(&job.firstMismatch, VERIFY_NO_MISMATCH);
+    atomic_init(&job.bytesCompared, 0);
+    atomic_init(&job.error, ERR_SUCCESS);
+
+#if !defined(_WIN32)
+    if (VERIFY_USE_MMAP)
+    {
+        job.srcMap = map_file(srcPath, job.length);
+        job.destMap = job.srcMap ? map_file(destPath, job.length) : NULL;
+        if (!job.destMap && job.srcMap)
+        {
+            munmap((void*)job.srcMap, (size_t)job.length);
+            job.srcMap = NULL;
+        }
+    }
+#endif
+
+    uint64_t blocks = (job.length + VERIFY_BLOCK - 1) / VERIFY_BLOCK;
+    if (threads <= 0) threads = Thread_GetCpuCount();
+    if (threads > VERIFY_MAX_THREADS) threads = VERIFY_MAX_THREADS;
+    if ((uint64_t)threads > blocks) threads = blocks > 0 ? (int)blocks : 1;
+
+    Thread handles[VERIFY_MAX_THREADS];
+    int created = 0;
+    for (int i = 1; i < threads; ++i)
+    {
+        if (Thread_Create(&handles[created], verify_worker, &job) == 0) created++;
+    }
+    verify_worker(&job);
+    for (int i = 0; i < created; ++i) Thread_Join(handles[i]);
+
+#if !defined(_WIN32)
+    if (job.srcMap)
+    {
+        munmap((void*)job.srcMap, (size_t)job.length);
+        munmap((void*)job.destMap, (size_t)job.length);
+    }
+#endif
+
+    int err = atomic_load(&job.error);
+    if (err != ERR_SUCCESS) return err;
+
+    uint64_t mismatch = atomic_load(&job.firstMismatch);
+    out->bytesCompared = atomic_load(&job.bytesCompared);
+    if (mismatch == VERIFY_NO_MISMATCH && out->srcSize != out->destSize) mismatch = job.length;
+    out->match = mismatch == VERIFY_NO_MISMATCH;
+    out->firstMismatch = out->match ? 0 : mismatch;
+    return ERR_SUCCESS;
+}
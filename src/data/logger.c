@@ -1,52 +1,284 @@
 ﻿#include "data/Logger.h"
 #include "utils/FileUtils.h"
+#include "utils/Thread.h"
+#include "utils/Trace.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <time.h>
 #include <string.h>
+#include <stdatomic.h>
+
+// 异步日志：调用方只把一条记录写入无锁环形缓冲区 (多生产者 / 单消费者)，
+// 时间格式化、写文件与 fflush 由后台线程成批完成，热路径上没有系统调用
+#define LOG_RING_SIZE 2048 // 必须是 2 的幂
+#define LOG_TEXT_MAX 480
+#define LOG_FLUSH_INTERVAL_MS 100 // 后台线程的最长等待间隔
+#define LOG_OUT_BUFFER (64 * 1024)
+
+typedef struct LogRecord
+{
+    atomic_size_t seq; // 槽位序号：等于写入位置时可写，等于写入位置 + 1 时可读
+    time_t time;
+    LogLevel level;
+    char text[LOG_TEXT_MAX];
+} LogRecord;
+
+static LogRecord g_ring[LOG_RING_SIZE];
+static atomic_size_t g_head;     // 下一个写入位置 (生产者竞争)
+static size_t g_tail = 0;        // 下一个读取位置 (仅后台线程)
+static atomic_size_t g_dropped;  // 缓冲区满时丢弃的记录数
+static atomic_int g_wakePending; // 已有生产者请求唤醒，避免重复发信号
 
 static FILE* g_logFile = NULL;
+static Thread g_thread;
+static int g_threadStarted = 0;
+static int g_running = 0;
+static Mutex g_lock;
+static CondVar g_wake;    // 唤醒后台线程
+static CondVar g_flushed; // 后台线程完成一批写入
+static size_t g_flushRequest = 0; // 需要落盘的写入位置
+static size_t g_flushDone = 0;    // 已写入并 fflush 的位置
+
+// 时间戳按秒缓存，同一秒内的记录不重复调用 localtime/strftime
+static time_t g_cachedSecond = (time_t)-1;
+static char g_cachedTime[32];
+
+static const char* level_tag(LogLevel level)
+{
+    if (level == LOG_WARNING) return "[WARN]";
+    if (level == LOG_ERROR) return "[ERR ]";
+    return "[INFO]";
+}
+
+static const char* format_time(time_t now)
+{
+    if (now != g_cachedSecond)
+    {
+        struct tm t;
+#ifdef _WIN32
+        localtime_s(&t, &now);
+#else
+        localtime_r(&now, &t);
+#endif
+        strftime(g_cachedTime, sizeof(g_cachedTime), "%Y-%m-%d %H:%M:%S", &t);
+        g_cachedSecond = now;
+    }
+    return g_cachedTime;
+}
+
+// 将一行追加到输出缓冲区，缓冲区满时先写出
+static void append_line(char* out, size_t* used, time_t when, LogLevel level, const char* text)
+{
+    char line[LOG_TEXT_MAX + 64];
+    int n = snprintf(line, sizeof(line), "%s %s %s\n", format_time(when), level_tag(level), text);
+    if (n <= 0) return;
+    if ((size_t)n >= sizeof(line)) n = (int)sizeof(line) - 1;
+
+    if (*used + (size_t)n > LOG_OUT_BUFFER)
+    {
+        fwrite(out, 1, *used, g_logFile);
+        *used = 0;
+    }
+    memcpy(out + *used, line, (size_t)n);
+    *used += (size_t)n;
+}
+
+// 取出所有已提交的记录并写入文件，返回处理的记录数 (仅后台线程调用)
+static size_t drain(char* out)
+{
+    size_t used = 0;
+    size_t count = 0;
+    for (;;)
+    {
+        LogRecord* rec = &g_ring[g_tail & (LOG_RING_SIZE - 1)];
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != g_tail + 1)
+        {
+            break; // 为空，或下一条记录尚未写完
+        }
+        append_line(out, &used, rec->time, rec->level, rec->text);
+        atomic_store_explicit(&rec->seq, g_tail + LOG_RING_SIZE, memory_order_release);
+        g_tail++;
+        count++;
+    }
+
+    size_t dropped = atomic_exchange(&g_dropped, 0);
+    if (dropped > 0)
+    {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "日志缓冲区已满，丢弃了 %zu 条记录", dropped);
+        append_line(out, &used, time(NULL), LOG_WARNING, msg);
+    }
+
+    if (used > 0)
+    {
+        fwrite(out, 1, used, g_logFile);
+        fflush(g_logFile);
+    }
+    return count;
+}
+
+static void writer_thread(void* arg)
+{
+    (void)arg;
+    static char out[LOG_OUT_BUFFER];
+    Trace_SetThreadName("logger");
+
+    Mutex_Lock(&g_lock);
+    for (;;)
+    {
+        int running = g_running;
+        Mutex_Unlock(&g_lock);
+
+        atomic_store(&g_wakePending, 0);
+        drain(out);
+
+        Mutex_Lock(&g_lock);
+        g_flushDone = g_tail;
+        CondVar_Broadcast(&g_flushed);
+        if (!running && g_tail >= atomic_load(&g_head))
+        {
+            break;
+        }
+        if (g_flushRequest > g_tail || !running)
+        {
+            // 有等待落盘的请求但部分记录仍在写入中，稍后重试
+            CondVar_TimedWait(&g_wake, &g_lock, 1);
+        }
+        else
+        {
+            CondVar_TimedWait(&g_wake, &g_lock, LOG_FLUSH_INTERVAL_MS);
+        }
+    }
+    Mutex_Unlock(&g_lock);
+}
+
+static void wake_writer(void)
+{
+    if (atomic_exchange(&g_wakePending, 1) == 0)
+    {
+        CondVar_Signal(&g_wake);
+    }
+}
 
 void Logger_Init(const char* logFilePath)
 {
-    if (g_logFile) fclose(g_logFile);
+    if (g_logFile) Logger_Close();
     g_logFile = FileUtils_OpenFileUTF8(logFilePath, "a"); // 追加模式
+    if (!g_logFile) return;
+
+    for (size_t i = 0; i < LOG_RING_SIZE; ++i)
+    {
+        atomic_init(&g_ring[i].seq, i);
+    }
+    atomic_store(&g_head, 0);
+    atomic_store(&g_dropped, 0);
+    atomic_store(&g_wakePending, 0);
+    g_tail = 0;
+    g_flushRequest = g_flushDone = 0;
+    g_cachedSecond = (time_t)-1;
+
+    Mutex_Init(&g_lock);
+    CondVar_Init(&g_wake);
+    CondVar_Init(&g_flushed);
+    g_running = 1;
+    g_threadStarted = Thread_Create(&g_thread, writer_thread, NULL) == 0;
 }
 
 void Logger_Log(LogLevel level, const char* format, ...)
 {
     if (!g_logFile) return;
 
-    // 获取时间
-    time_t now;
-    time(&now);
-    struct tm* t = localtime(&now);
-    char timeStr[64];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", t);
-
-    // 等级标签
-    const char* levelStr = "[INFO]";
-    if (level == LOG_WARNING) levelStr = "[WARN]";
-    else if (level == LOG_ERROR) levelStr = "[ERR ]";
-
-    // 写入头部
-    fprintf(g_logFile, "%s %s ", timeStr, levelStr);
+    // 申请一个槽位 (无锁)；缓冲区满时丢弃并计数，不阻塞调用方
+    size_t pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+    LogRecord* rec;
+    for (;;)
+    {
+        rec = &g_ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&g_head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add(&g_dropped, 1);
+            wake_writer();
+            return;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+        }
+    }
 
-    // 写入内容
+    rec->time = time(NULL);
+    rec->level = level;
     va_list args;
     va_start(args, format);
-    vfprintf(g_logFile, format, args);
+    vsnprintf(rec->text, sizeof(rec->text), format, args);
     va_end(args);
+    atomic_store_explicit(&rec->seq, pos + 1, memory_order_release);
 
-    fprintf(g_logFile, "\n");
-    fflush(g_logFile); // 确保立即写入磁盘
+    if (!g_threadStarted)
+    {
+        // 后台线程不可用时退回同步写入
+        Mutex_Lock(&g_lock);
+        static char out[LOG_OUT_BUFFER];
+        drain(out);
+        Mutex_Unlock(&g_lock);
+        return;
+    }
+
+    // 错误日志立即落盘；每写入半个缓冲区的记录提前唤醒一次后台线程
+    if (level == LOG_ERROR)
+    {
+        Logger_Flush();
+    }
+    else if ((pos & (LOG_RING_SIZE / 2 - 1)) == LOG_RING_SIZE / 2 - 1)
+    {
+        wake_writer();
+    }
+}
+
+void Logger_Flush(void)
+{
+    if (!g_logFile || !g_threadStarted) return;
+
+    size_t target = atomic_load(&g_head);
+    Mutex_Lock(&g_lock);
+    if (target > g_flushRequest) g_flushRequest = target;
+    CondVar_Signal(&g_wake);
+    while (g_flushDone < target)
+    {
+        CondVar_Wait(&g_flushed, &g_lock);
+    }
+    Mutex_Unlock(&g_lock);
 }
 
 void Logger_Close(void)
 {
-    if (g_logFile)
+    if (!g_logFile) return;
+
+    if (g_threadStarted)
     {
-        fclose(g_logFile);
-        g_logFile = NULL;
+        // 后台线程退出前会写完缓冲区中剩余的记录
+        Mutex_Lock(&g_lock);
+        g_running = 0;
+        CondVar_Signal(&g_wake);
+        Mutex_Unlock(&g_lock);
+        Thread_Join(g_thread);
+        g_threadStarted = 0;
     }
+    CondVar_Destroy(&g_wake);
+    CondVar_Destroy(&g_flushed);
+    Mutex_Destroy(&g_lock);
+
+    fclose(g_logFile);
+    g_logFile = NULL;
 }
@@ -1,13 +1,565 @@
 ﻿#include "data/Persistence.h"
 #include "data/Logger.h"
 #include "utils/FileUtils.h"
+#include "utils/Algorithm.h"
+#include "utils/Trace.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 // 文件头标识，用于校验文件格式是否合法
-static const uint32_t DB_MAGIC = 0x53465458; // ASCII "SFTX"
+static const uint32_t DB_MAGIC = 0x53465458;    // ASCII "SFTX"：v1，TransferTask 结构体原样写入
+static const uint32_t DB_MAGIC_V2 = 0x32585453; // ASCII "STX2"：v2，带版本与校验的记录格式
+
+// v2 格式
+// 文件头: magic u32 | version u16 | compatVersion u16 | taskCount u32 | headerCrc u32
+// 之后是连续的记录: type u16 | reserved u16 | length u32 | payload | crc u32 (覆盖 type 起的全部字节)
+// 任务记录的负载是一串字段: tag u16 | length u16 | value，读取时忽略未知 tag。
+// 路径拆分为目录与文件名两部分，各自作为字符串记录去重，任务中只保存字符串编号。
+// 所有整数按小端序写入，与平台字节序无关。
+#define DB_VERSION 2
+#define DB_COMPAT_VERSION 2 // 只有不兼容的格式变化才提高该值；新增字段或记录类型不需要
+#define DB_HEADER_SIZE 16
+#define DB_RECORD_OVERHEAD 12
+
+// 历史文件: 文件头 magic u32 | version u16 | compatVersion u16 | maxId u32 | headerCrc u32
+// 之后是追加写入的任务记录 (与快照相同的记录格式，路径内联)。maxId 在每次追加后原地更新，
+// 启动时只需读取文件头即可避免重复使用已归档任务的 ID
+static const uint32_t HISTORY_MAGIC = 0x48585453; // ASCII "STXH"
+
+#define DB_REC_STRING 1 // 负载: UTF-8 字符串 (编号按出现顺序从 0 递增)
+#define DB_REC_TASK 2   // 负载: 字段序列
+
+#define FIELD_ID 1
+#define FIELD_SRC_DIR 2  // 字符串编号
+#define FIELD_SRC_NAME 3 // 字符串编号
+#define FIELD_DEST_DIR 4
+#define FIELD_DEST_NAME 5
+#define FIELD_TOTAL_SIZE 6
+#define FIELD_OFFSET 7
+#define FIELD_PRIORITY 8
+#define FIELD_STATUS 9
+#define FIELD_CRC32 10
+#define FIELD_DEST_HASH 11
+#define FIELD_SRC_PATH 12  // 内联完整路径 (日志记录使用，无字符串表)
+#define FIELD_DEST_PATH 13
+#define FIELD_MODE 14 // 仅非默认模式写入
+#define FIELD_CACHE_POLICY 15 // 仅非默认策略写入
+
+// 旧版记录布局 (无 destHash 字段)，用于兼容读取升级前保存的数据库
+typedef struct LegacyTransferTask
+{
+    int id;
+    char srcPath[256];
+    char destPath[256];
+    uint64_t totalSize;
+    uint64_t currentOffset;
+    int priority;
+    TaskStatus status;
+    uint32_t crc32;
+    void* onProgress;
+    void* onError;
+} LegacyTransferTask;
+
+// 日志记录类型
+#define JOURNAL_REC_ADD 1   // 新增任务：完整 TransferTask (旧日志)
+#define JOURNAL_REC_DELTA 2 // 任务增量
+#define JOURNAL_REC_TASK 3  // 新增任务：v2 字段序列，路径内联
+
+// 日志记录: type u8 | reserved u8[3] | length u32 | crc u32 (覆盖 type 与负载) | payload
+// 增量记录负载只包含传输过程中会变化的字段:
+// id u32 | status u32 | currentOffset u64 | totalSize u64 | crc32 u32 | reserved u32 | destHash[32]
+// 与快照一样按小端序编码，小端平台上与早期直接写出结构体的日志逐字节相同
+#define JOURNAL_HEADER_SIZE 12
+#define JOURNAL_DELTA_SIZE 64
+
+struct TaskJournal
+{
+    FILE* fp;
+    uint64_t size;
+    char path[260];
+};
+
+// --- 编码辅助 ---
+
+typedef struct ByteBuf
+{
+    uint8_t* data;
+    size_t len;
+    size_t cap;
+    int failed;
+} ByteBuf;
+
+static void buf_put(ByteBuf* b, const void* src, size_t n)
+{
+    if (b->failed) return;
+    if (b->len + n > b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 4096;
+        while (cap < b->len + n) cap *= 2;
+        uint8_t* p = (uint8_t*)realloc(b->data, cap);
+        if (!p)
+        {
+            b->failed = 1;
+            return;
+        }
+        b->data = p;
+        b->cap = cap;
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+static void put_le(uint8_t* p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t* p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; --i) v = (v << 8) | p[i];
+    return v;
+}
+
+static void buf_le(ByteBuf* b, uint64_t v, int bytes)
+{
+    uint8_t tmp[8];
+    put_le(tmp, v, bytes);
+    buf_put(b, tmp, (size_t)bytes);
+}
+
+static void put_field(ByteBuf* b, uint16_t tag, const void* value, uint16_t len)
+{
+    buf_le(b, tag, 2);
+    buf_le(b, len, 2);
+    buf_put(b, value, len);
+}
+
+static void put_field_int(ByteBuf* b, uint16_t tag, uint64_t v, int bytes)
+{
+    uint8_t tmp[8];
+    put_le(tmp, v, bytes);
+    put_field(b, tag, tmp, (uint16_t)bytes);
+}
+
+// 写入一条记录，返回负载起始位置
+static size_t begin_record(ByteBuf* b, uint16_t type)
+{
+    buf_le(b, type, 2);
+    buf_le(b, 0, 2);
+    buf_le(b, 0, 4); // 长度稍后回填
+    return b->len;
+}
+
+static void end_record(ByteBuf* b, size_t payloadStart)
+{
+    if (b->failed) return;
+    size_t recStart = payloadStart - 8;
+    put_le(b->data + recStart + 4, (uint64_t)(b->len - payloadStart), 4);
+    buf_le(b, Algorithm_CalculateCRC32(b->data + recStart, b->len - recStart), 4);
+}
+
+// 路径拆分为 目录 (含末尾分隔符) + 文件名，拼接即可还原
+static size_t split_path(const char* path)
+{
+    size_t cut = 0;
+    for (size_t i = 0; path[i]; ++i)
+    {
+        if (path[i] == '/' || path[i] == '\\') cut = i + 1;
+    }
+    return cut;
+}
+
+// 保存时的字符串驻留表 (开放寻址)
+typedef struct InternTable
+{
+    const char** strs; // 指向任务中的路径，不复制
+    uint16_t* lens;
+    uint32_t* slots;   // 0 表示空，否则为 编号 + 1
+    uint32_t count;
+    uint32_t mask;
+} InternTable;
+
+static uint32_t hash_str(const char* s, size_t n)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < n; ++i) h = (h ^ (uint8_t)s[i]) * 16777619u;
+    return h;
+}
+
+// 返回字符串编号；首次出现时同时写出字符串记录
+static uint32_t intern(InternTable* t, ByteBuf* b, const char* s, size_t n)
+{
+    uint32_t i = hash_str(s, n) & t->mask;
+    while (t->slots[i])
+    {
+        uint32_t id = t->slots[i] - 1;
+        if (t->lens[id] == n && memcmp(t->strs[id], s, n) == 0) return id;
+        i = (i + 1) & t->mask;
+    }
+    uint32_t id = t->count++;
+    t->strs[id] = s;
+    t->lens[id] = (uint16_t)n;
+    t->slots[i] = id + 1;
+
+    size_t rec = begin_record(b, DB_REC_STRING);
+    buf_put(b, s, n);
+    end_record(b, rec);
+    return id;
+}
+
+// 进度、状态等通用字段
+static void put_common_fields(ByteBuf* b, const TransferTask* task)
+{
+    put_field_int(b, FIELD_ID, (uint32_t)task->id, 4);
+    put_field_int(b, FIELD_TOTAL_SIZE, task->totalSize, 8);
+    put_field_int(b, FIELD_OFFSET, task->currentOffset, 8);
+    put_field_int(b, FIELD_PRIORITY, (uint32_t)task->priority, 4);
+    put_field_int(b, FIELD_STATUS, (uint32_t)task->status, 4);
+    put_field_int(b, FIELD_CRC32, task->crc32, 4);
+    if (task->mode != TASK_MODE_ENCRYPT)
+    {
+        put_field_int(b, FIELD_MODE, (uint32_t)task->mode, 4);
+    }
+    if (task->cachePolicy != TASK_CACHE_DEFAULT)
+    {
+        put_field_int(b, FIELD_CACHE_POLICY, (uint32_t)task->cachePolicy, 4);
+    }
+
+    static const uint8_t zero[32] = {0};
+    if (memcmp(task->destHash, zero, sizeof(zero)) != 0)
+    {
+        put_field(b, FIELD_DEST_HASH, task->destHash, sizeof(task->destHash));
+    }
+}
+
+static size_t bounded_len(const char* s, size_t max)
+{
+    size_t n = 0;
+    while (n < max && s[n]) n++;
+    return n;
+}
+
+// 编码完整快照 (v2)
+static int encode_snapshot(ByteBuf* b, const TransferTask* const* tasks, int count)
+{
+    uint8_t hdr[DB_HEADER_SIZE];
+    put_le(hdr, DB_MAGIC_V2, 4);
+    put_le(hdr + 4, DB_VERSION, 2);
+    put_le(hdr + 6, DB_COMPAT_VERSION, 2);
+    put_le(hdr + 8, (uint32_t)count, 4);
+    put_le(hdr + 12, Algorithm_CalculateCRC32(hdr, 12), 4);
+    buf_put(b, hdr, sizeof(hdr));
+
+    uint32_t cap = 16;
+    while (cap < (uint32_t)count * 8) cap *= 2;
+    InternTable t;
+    memset(&t, 0, sizeof(t));
+    t.strs = (const char**)malloc(sizeof(char*) * (size_t)count * 4 + sizeof(char*));
+    t.lens = (uint16_t*)malloc(sizeof(uint16_t) * (size_t)count * 4 + sizeof(uint16_t));
+    t.slots = (uint32_t*)calloc(cap, sizeof(uint32_t));
+    t.mask = cap - 1;
+    if (!t.strs || !t.lens || !t.slots) b->failed = 1;
+
+    for (int i = 0; i < count && !b->failed; ++i)
+    {
+        const TransferTask* task = tasks[i];
+        size_t srcLen = bounded_len(task->srcPath, sizeof(task->srcPath));
+        size_t destLen = bounded_len(task->destPath, sizeof(task->destPath));
+        size_t srcCut = split_path(task->srcPath);
+        size_t destCut = split_path(task->destPath);
+
+        // 字符串记录必须出现在引用它的任务之前，以便单遍加载
+        uint32_t ids[4];
+        ids[0] = intern(&t, b, task->srcPath, srcCut);
+        ids[1] = intern(&t, b, task->srcPath + srcCut, srcLen - srcCut);
+        ids[2] = intern(&t, b, task->destPath, destCut);
+        ids[3] = intern(&t, b, task->destPath + destCut, destLen - destCut);
+
+        size_t rec = begin_record(b, DB_REC_TASK);
+        put_common_fields(b, task);
+        put_field_int(b, FIELD_SRC_DIR, ids[0], 4);
+        put_field_int(b, FIELD_SRC_NAME, ids[1], 4);
+        put_field_int(b, FIELD_DEST_DIR, ids[2], 4);
+        put_field_int(b, FIELD_DEST_NAME, ids[3], 4);
+        end_record(b, rec);
+    }
+
+    free((void*)t.strs);
+    free(t.lens);
+    free(t.slots);
+    return b->failed ? -1 : 0;
+}
+
+// 加载时的字符串表：指向文件缓冲区
+typedef struct StringRef
+{
+    const char* s;
+    uint32_t len;
+} StringRef;
+
+static int join_path(char* out, size_t cap, const StringRef* dir, const StringRef* name)
+{
+    if ((size_t)dir->len + name->len >= cap) return -1;
+    memcpy(out, dir->s, dir->len);
+    memcpy(out + dir->len, name->s, name->len);
+    out[dir->len + name->len] = '\0';
+    return 0;
+}
+
+// 解码任务字段；strings 为 NULL 时只接受内联路径
+static int decode_task(const uint8_t* p, size_t len, const StringRef* strings, uint32_t stringCount,
+                       TransferTask* t)
+{
+    memset(t, 0, sizeof(TransferTask));
+    uint32_t ids[4] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+    int haveId = 0;
+
+    size_t pos = 0;
+    while (pos + 4 <= len)
+    {
+        uint16_t tag = (uint16_t)get_le(p + pos, 2);
+        uint16_t n = (uint16_t)get_le(p + pos + 2, 2);
+        const uint8_t* v = p + pos + 4;
+        pos += 4;
+        if (pos + n > len) return -1;
+        pos += n;
+
+        switch (tag)
+        {
+        case FIELD_ID:
+            if (n != 4) return -1;
+            t->id = (int)(int32_t)get_le(v, 4);
+            haveId = 1;
+            break;
+        case FIELD_SRC_DIR:
+        case FIELD_SRC_NAME:
+        case FIELD_DEST_DIR:
+        case FIELD_DEST_NAME:
+            if (n != 4) return -1;
+            ids[tag - FIELD_SRC_DIR] = (uint32_t)get_le(v, 4);
+            break;
+        case FIELD_TOTAL_SIZE:
+            if (n != 8) return -1;
+            t->totalSize = get_le(v, 8);
+            break;
+        case FIELD_OFFSET:
+            if (n != 8) return -1;
+            t->currentOffset = get_le(v, 8);
+            break;
+        case FIELD_PRIORITY:
+            if (n != 4) return -1;
+            t->priority = (int)(int32_t)get_le(v, 4);
+            break;
+        case FIELD_STATUS:
+            if (n != 4) return -1;
+            t->status = (TaskStatus)(int32_t)get_le(v, 4);
+            break;
+        case FIELD_CRC32:
+            if (n != 4) return -1;
+            t->crc32 = (uint32_t)get_le(v, 4);
+            break;
+        case FIELD_DEST_HASH:
+            if (n != sizeof(t->destHash)) return -1;
+            memcpy(t->destHash, v, n);
+            break;
+        case FIELD_MODE:
+            if (n != 4) return -1;
+            t->mode = (TaskMode)(int32_t)get_le(v, 4);
+            break;
+        case FIELD_CACHE_POLICY:
+            if (n != 4) return -1;
+            t->cachePolicy = (TaskCachePolicy)(int32_t)get_le(v, 4);
+            break;
+        case FIELD_SRC_PATH:
+        case FIELD_DEST_PATH:
+        {
+            char* dst = tag == FIELD_SRC_PATH ? t->srcPath : t->destPath;
+            if (n >= sizeof(t->srcPath)) return -1;
+            memcpy(dst, v, n);
+            dst[n] = '\0';
+            break;
+        }
+        default:
+            break; // 新版本写入的未知字段
+        }
+    }
+    if (!haveId) return -1;
+
+    if (strings && ids[0] != UINT32_MAX)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            if (ids[k] >= stringCount) return -1;
+        }
+        if (join_path(t->srcPath, sizeof(t->srcPath), &strings[ids[0]], &strings[ids[1]]) != 0 ||
+            join_path(t->destPath, sizeof(t->destPath), &strings[ids[2]], &strings[ids[3]]) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 单遍解析 v2 快照
+static int decode_snapshot(const uint8_t* data, size_t size, TransferTask** out)
+{
+    if (size < DB_HEADER_SIZE || get_le(data + 12, 4) != Algorithm_CalculateCRC32(data, 12))
+    {
+        Logger_Log(LOG_WARNING, "任务数据库文件头损坏，已忽略");
+        return 0;
+    }
+    uint32_t compat = (uint32_t)get_le(data + 6, 2);
+    if (compat > DB_VERSION)
+    {
+        Logger_Log(LOG_WARNING, "任务数据库由更新的版本写入 (兼容版本 %u)，无法读取", compat);
+        return 0;
+    }
+
+    // 文件头中的任务数用于一次性分配；每条任务记录至少占一个记录头，以此限制上限
+    uint64_t headerCount = get_le(data + 8, 4);
+    int maxCount = (int)(headerCount < size / DB_RECORD_OVERHEAD ? headerCount : size / DB_RECORD_OVERHEAD);
+    TransferTask* outTasks = (TransferTask*)malloc(sizeof(TransferTask) * (size_t)(maxCount > 0 ? maxCount : 1));
+    if (!outTasks) return -1;
+    *out = outTasks;
+
+    // 字符串数量不超过记录数量，按文件大小估算上限
+    size_t maxStrings = size / DB_RECORD_OVERHEAD + 1;
+    StringRef* strings = (StringRef*)malloc(sizeof(StringRef) * maxStrings);
+    if (!strings) return -1; // outTasks 由调用方释放
+    uint32_t stringCount = 0;
+
+    int loaded = 0;
+    int bad = 0;
+    size_t pos = DB_HEADER_SIZE;
+    while (pos + DB_RECORD_OVERHEAD <= size)
+    {
+        uint16_t type = (uint16_t)get_le(data + pos, 2);
+        uint32_t len = (uint32_t)get_le(data + pos + 4, 4);
+        if (len > size - pos - DB_RECORD_OVERHEAD) break; // 截断的尾部
+        const uint8_t* payload = data + pos + 8;
+        uint32_t crc = (uint32_t)get_le(payload + len, 4);
+        int valid = Algorithm_CalculateCRC32(data + pos, 8 + (size_t)len) == crc;
+        pos += DB_RECORD_OVERHEAD + len;
+
+        if (type == DB_REC_STRING)
+        {
+            // 损坏的字符串仍占用编号，引用它的任务会被判为无效
+            strings[stringCount].s = valid ? (const char*)payload : "";
+            strings[stringCount].len = valid ? len : UINT32_MAX;
+            stringCount++;
+            if (!valid) bad++;
+        }
+        else if (type == DB_REC_TASK)
+        {
+            if (!valid)
+            {
+                bad++;
+                continue;
+            }
+            if (loaded >= maxCount) continue;
+            if (decode_task(payload, len, strings, stringCount, &outTasks[loaded]) != 0)
+            {
+                bad++;
+                continue;
+            }
+            loaded++;
+        }
+        // 其他记录类型来自更新的版本，跳过
+    }
+
+    free(strings);
+    if (bad > 0) Logger_Log(LOG_WARNING, "任务数据库中有 %d 条记录校验失败，已跳过", bad);
+    return loaded;
+}
+
+// 读取旧版 (v1) 数据库：结构体原样存储
+static int decode_legacy(const uint8_t* data, size_t size, TransferTask** out)
+{
+    if (size < 8) return 0;
+
+    int count = 0;
+    memcpy(&count, data + 4, sizeof(int));
+    const uint8_t* p = data + 8;
+    size_t dataLen = size - 8;
+    if (count < 0) count = 0;
+
+    size_t fit = dataLen / (sizeof(LegacyTransferTask) < sizeof(TransferTask) ? sizeof(LegacyTransferTask)
+                                                                              : sizeof(TransferTask));
+    int maxCount = (size_t)count < fit ? count : (int)fit;
+    TransferTask* outTasks = (TransferTask*)malloc(sizeof(TransferTask) * (size_t)(maxCount > 0 ? maxCount : 1));
+    if (!outTasks) return -1;
+    *out = outTasks;
+
+    // 根据剩余长度判断记录布局：当前结构体，或升级前的旧结构体
+    int loaded = 0;
+    if (dataLen == sizeof(LegacyTransferTask) * (size_t)count && sizeof(LegacyTransferTask) != sizeof(TransferTask))
+    {
+        for (; loaded < count && loaded < maxCount; ++loaded)
+        {
+            LegacyTransferTask legacy;
+            memcpy(&legacy, p + sizeof(legacy) * (size_t)loaded, sizeof(legacy));
+            TransferTask* t = &outTasks[loaded];
+            memset(t, 0, sizeof(TransferTask));
+            t->id = legacy.id;
+            memcpy(t->srcPath, legacy.srcPath, sizeof(t->srcPath));
+            memcpy(t->destPath, legacy.destPath, sizeof(t->destPath));
+            t->totalSize = legacy.totalSize;
+            t->currentOffset = legacy.currentOffset;
+            t->priority = legacy.priority;
+            t->status = legacy.status;
+            t->crc32 = legacy.crc32;
+        }
+    }
+    else
+    {
+        size_t avail = dataLen / sizeof(TransferTask);
+        for (; loaded < count && loaded < maxCount && (size_t)loaded < avail; ++loaded)
+        {
+            memcpy(&outTasks[loaded], p + sizeof(TransferTask) * (size_t)loaded, sizeof(TransferTask));
+        }
+    }
+
+    // 结构体中的函数指针 (onProgress, onError) 保存的是上次运行时的内存地址
+    for (int i = 0; i < loaded; ++i)
+    {
+        outTasks[i].onProgress = NULL;
+        outTasks[i].onError = NULL;
+    }
+    Logger_Log(LOG_INFO, "已从旧版任务数据库格式升级 %d 条任务", loaded);
+    return loaded;
+}
+
+// 写出快照内容 (v2)
+static int write_snapshot(FILE* fp, const TransferTask* const* tasks, int count)
+{
+    ByteBuf b;
+    memset(&b, 0, sizeof(b));
+    int rc = encode_snapshot(&b, tasks, count);
+    if (rc == 0 && fwrite(b.data, 1, b.len, fp) != b.len) rc = -1;
+    free(b.data);
+    return rc;
+}
 
-int Persistence_SaveTasks(const char* dbPath, TransferTask* tasks, int count)
+// 读入整个文件，调用方 free；失败返回 NULL
+static uint8_t* read_whole_file(const char* path, size_t* outSize)
+{
+    FILE* fp = FileUtils_OpenFileUTF8(path, "rb");
+    if (!fp) return NULL;
+
+    uint64_t size = FileUtils_GetFileSize(path);
+    uint8_t* data = (uint8_t*)malloc(size > 0 ? (size_t)size : 1);
+    if (data) *outSize = fread(data, 1, (size_t)size, fp);
+    fclose(fp);
+    return data;
+}
+
+int Persistence_SaveTasks(const char* dbPath, const TransferTask* const* tasks, int count)
 {
     if (!dbPath)
     {
@@ -15,69 +567,443 @@ int Persistence_SaveTasks(const char* dbPath, TransferTask* tasks, int count)
         return -1;
     }
     //覆盖写入
+    TRACE_BEGIN(span, "Persistence_SaveTasks");
     FILE* fp = FileUtils_OpenFileUTF8(dbPath, "wb");
     if (!fp)
     {
         Logger_Log(LOG_ERROR, "无法打开任务数据库: %s", dbPath);
+        TRACE_END(span);
+        return -1;
+    }
+
+    int rc = write_snapshot(fp, tasks, count);
+    fclose(fp);
+    TRACE_END(span);
+    return rc;
+}
+
+int Persistence_LoadTasks(const char* dbPath, TransferTask** outTasks)
+{
+    if (!dbPath || !outTasks)
+    {
+        Logger_Log(LOG_ERROR, "Persistence_LoadTasks: dbPath 为空");
+        return -1;
+    }
+    *outTasks = NULL;
+
+    // 整个文件一次读入，之后线性解析
+    size_t got = 0;
+    uint8_t* data = read_whole_file(dbPath, &got);
+    if (!data) return FileUtils_Exists(dbPath) ? -1 : 0; // 文件不存在视为无任务
+
+    int loaded = 0;
+    uint32_t magic = got >= 4 ? (uint32_t)get_le(data, 4) : 0;
+    if (magic == DB_MAGIC_V2)
+    {
+        loaded = decode_snapshot(data, got, outTasks);
+    }
+    else if (magic == DB_MAGIC)
+    {
+        loaded = decode_legacy(data, got, outTasks);
+    }
+    else
+    {
+        Logger_Log(LOG_WARNING, "任务数据库格式不正确，已忽略");
+    }
+
+    free(data);
+    return loaded;
+}
+
+// --- 追加式日志 ---
+
+static uint32_t journal_crc(uint8_t type, const void* payload, uint32_t length)
+{
+    uint32_t crc = Algorithm_CalculateCRC32(&type, 1);
+    return Algorithm_UpdateCRC32(crc, (const uint8_t*)payload, length);
+}
+
+static int journal_append(TaskJournal* journal, uint8_t type, const void* payload, uint32_t length)
+{
+    if (!journal || !journal->fp) return -1;
+
+    uint8_t hdr[JOURNAL_HEADER_SIZE];
+    memset(hdr, 0, sizeof(hdr));
+    hdr[0] = type;
+    put_le(hdr + 4, length, 4);
+    put_le(hdr + 8, journal_crc(type, payload, length), 4);
+
+    if (fwrite(hdr, 1, sizeof(hdr), journal->fp) != sizeof(hdr) || fwrite(payload, 1, length, journal->fp) != length)
+    {
+        Logger_Log(LOG_ERROR, "写入任务日志失败: %s", journal->path);
         return -1;
     }
+    journal->size += sizeof(hdr) + length;
+    return 0;
+}
 
-    // 1. 写入魔数
-    fwrite(&DB_MAGIC, sizeof(uint32_t), 1, fp);
+TaskJournal* Persistence_OpenJournal(const char* journalPath)
+{
+    if (!journalPath) return NULL;
 
-    // 2. 写入任务数量
-    fwrite(&count, sizeof(int), 1, fp);
+    TaskJournal* journal = (TaskJournal*)calloc(1, sizeof(TaskJournal));
+    if (!journal) return NULL;
+    strncpy(journal->path, journalPath, sizeof(journal->path) - 1);
 
-    // 3. 写入任务数据（回调指针不参与持久化）
-    if (count > 0 && tasks)
+    journal->fp = FileUtils_OpenFileUTF8(journalPath, "ab");
+    if (!journal->fp)
     {
-        fwrite(tasks, sizeof(TransferTask), count, fp);
+        Logger_Log(LOG_ERROR, "无法打开任务日志: %s", journalPath);
+        free(journal);
+        return NULL;
     }
+    journal->size = FileUtils_GetFileSize(journalPath);
+    return journal;
+}
+
+void Persistence_CloseJournal(TaskJournal* journal)
+{
+    if (!journal) return;
+    if (journal->fp) fclose(journal->fp);
+    free(journal);
+}
+
+int Persistence_JournalAdd(TaskJournal* journal, const TransferTask* task)
+{
+    if (!task) return -1;
+
+    ByteBuf b;
+    memset(&b, 0, sizeof(b));
+    put_common_fields(&b, task);
+    put_field(&b, FIELD_SRC_PATH, task->srcPath, (uint16_t)bounded_len(task->srcPath, sizeof(task->srcPath)));
+    put_field(&b, FIELD_DEST_PATH, task->destPath, (uint16_t)bounded_len(task->destPath, sizeof(task->destPath)));
+
+    int rc = b.failed ? -1 : journal_append(journal, JOURNAL_REC_TASK, b.data, (uint32_t)b.len);
+    free(b.data);
+    return rc;
+}
+
+int Persistence_JournalDelta(TaskJournal* journal, const TransferTask* task)
+{
+    if (!task) return -1;
+
+    uint8_t d[JOURNAL_DELTA_SIZE];
+    put_le(d, (uint32_t)task->id, 4);
+    put_le(d + 4, (uint32_t)task->status, 4);
+    put_le(d + 8, task->currentOffset, 8);
+    put_le(d + 16, task->totalSize, 8);
+    put_le(d + 24, task->crc32, 4);
+    put_le(d + 28, 0, 4);
+    memcpy(d + 32, task->destHash, sizeof(task->destHash));
+    return journal_append(journal, JOURNAL_REC_DELTA, d, sizeof(d));
+}
+
+int Persistence_JournalFlush(TaskJournal* journal)
+{
+    if (!journal || !journal->fp) return -1;
+    return fflush(journal->fp) == 0 ? 0 : -1;
+}
+
+uint64_t Persistence_JournalSize(const TaskJournal* journal)
+{
+    return journal ? journal->size : 0;
+}
+
+int Persistence_ReplayJournal(const char* journalPath, TaskLookupFunc lookup, void* user)
+{
+    if (!journalPath || !lookup) return 0;
+
+    FILE* fp = FileUtils_OpenFileUTF8(journalPath, "rb");
+    if (!fp) return 0; // 没有日志：快照即最新状态
+
+    union
+    {
+        TransferTask task;
+        uint8_t raw[2048];
+    } payload;
+
+    int records = 0;
+    int torn = 0;
+    uint8_t hdr[JOURNAL_HEADER_SIZE];
+    while (fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr))
+    {
+        uint8_t type = hdr[0];
+        uint32_t length = (uint32_t)get_le(hdr + 4, 4);
+        uint32_t expect = type == JOURNAL_REC_ADD     ? (uint32_t)sizeof(TransferTask)
+                          : type == JOURNAL_REC_DELTA ? JOURNAL_DELTA_SIZE
+                          : type == JOURNAL_REC_TASK  ? length
+                                                      : 0;
+        if (expect == 0 || length != expect || expect > sizeof(payload) || fread(&payload, 1, expect, fp) != expect ||
+            journal_crc(type, &payload, expect) != (uint32_t)get_le(hdr + 8, 4))
+        {
+            torn = 1; // 残缺或损坏的尾部：之后的记录不可信
+            break;
+        }
+
+        if (type == JOURNAL_REC_ADD || type == JOURNAL_REC_TASK)
+        {
+            TransferTask added;
+            if (type == JOURNAL_REC_ADD)
+            {
+                added = payload.task;
+            }
+            else if (decode_task(payload.raw, expect, NULL, 0, &added) != 0)
+            {
+                torn = 1;
+                break;
+            }
 
+            TransferTask* t = lookup(added.id, 1, user);
+            if (t)
+            {
+                *t = added;
+                t->onProgress = NULL;
+                t->onError = NULL;
+            }
+        }
+        else
+        {
+            const uint8_t* d = payload.raw;
+            TransferTask* t = lookup((int)(int32_t)get_le(d, 4), 0, user);
+            if (t)
+            {
+                t->status = (TaskStatus)(int32_t)get_le(d + 4, 4);
+                t->currentOffset = get_le(d + 8, 8);
+                t->totalSize = get_le(d + 16, 8);
+                t->crc32 = (uint32_t)get_le(d + 24, 4);
+                memcpy(t->destHash, d + 32, sizeof(t->destHash));
+            }
+        }
+        records++;
+    }
     fclose(fp);
+
+    if (records > 0) Logger_Log(LOG_INFO, "已重放任务日志 %d 条记录", records);
+    if (torn) Logger_Log(LOG_WARNING, "任务日志尾部不完整，已丢弃: %s", journalPath);
+    return records;
+}
+
+static int compact_snapshot(const char* dbPath, TaskJournal* journal, const TransferTask* const* tasks, int count)
+{
+
+    // 1. 新快照写入临时文件并落盘，再替换旧快照，避免中途断电丢失数据库
+    char tmpPath[300];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", dbPath);
+    FILE* fp = FileUtils_OpenFileUTF8(tmpPath, "wb");
+    if (!fp)
+    {
+        Logger_Log(LOG_ERROR, "无法创建快照文件: %s", tmpPath);
+        return -1;
+    }
+    int rc = write_snapshot(fp, tasks, count);
+    if (rc == 0) rc = fflush(fp) == 0 ? 0 : -1;
+#ifndef _WIN32
+    if (rc == 0) fsync(fileno(fp));
+#endif
+    fclose(fp);
+    if (rc != 0)
+    {
+        Logger_Log(LOG_ERROR, "写入快照失败: %s", tmpPath);
+        remove(tmpPath);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(dbPath); // Windows 下 rename 不会覆盖已存在的文件
+#endif
+    if (rename(tmpPath, dbPath) != 0)
+    {
+        Logger_Log(LOG_ERROR, "替换任务数据库失败: %s", dbPath);
+        return -1;
+    }
+
+    // 2. 快照已包含日志中的全部变更，清空日志
+    // (若在此之前断电，重放旧日志也是幂等的：增量记录保存的是绝对值)
+    if (journal)
+    {
+        if (journal->fp) fclose(journal->fp);
+        FILE* trunc = FileUtils_OpenFileUTF8(journal->path, "wb");
+        if (trunc) fclose(trunc);
+        journal->fp = FileUtils_OpenFileUTF8(journal->path, "ab");
+        journal->size = 0;
+        if (!journal->fp)
+        {
+            Logger_Log(LOG_ERROR, "无法重新打开任务日志: %s", journal->path);
+            return -1;
+        }
+    }
     return 0;
 }
 
-int Persistence_LoadTasks(const char* dbPath, TransferTask* outTasks, int maxCount)
+int Persistence_Compact(const char* dbPath, TaskJournal* journal, const TransferTask* const* tasks, int count)
 {
-    if (!dbPath)
+    if (!dbPath) return -1;
+
+    TRACE_BEGIN(span, "Persistence_Compact");
+    int rc = compact_snapshot(dbPath, journal, tasks, count);
+    TRACE_END(span);
+    return rc;
+}
+
+// --- 历史任务 ---
+
+static void encode_history_header(uint8_t hdr[DB_HEADER_SIZE], uint32_t maxId)
+{
+    put_le(hdr, HISTORY_MAGIC, 4);
+    put_le(hdr + 4, DB_VERSION, 2);
+    put_le(hdr + 6, DB_COMPAT_VERSION, 2);
+    put_le(hdr + 8, maxId, 4);
+    put_le(hdr + 12, Algorithm_CalculateCRC32(hdr, 12), 4);
+}
+
+// 校验历史文件头，返回 maxId；无效时返回 -1
+static int64_t decode_history_header(const uint8_t* hdr, size_t size)
+{
+    if (size < DB_HEADER_SIZE || get_le(hdr, 4) != HISTORY_MAGIC ||
+        get_le(hdr + 12, 4) != Algorithm_CalculateCRC32(hdr, 12) || get_le(hdr + 6, 2) > DB_VERSION)
     {
-        Logger_Log(LOG_ERROR, "Persistence_LoadTasks: dbPath 为空");
         return -1;
     }
+    return (int64_t)get_le(hdr + 8, 4);
+}
 
-    FILE* fp = FileUtils_OpenFileUTF8(dbPath, "rb");
-    if (!fp) return 0; // 文件不存在视为无任务
+int Persistence_AppendHistory(const char* historyPath, const TransferTask* const* tasks, int count)
+{
+    if (!historyPath || !tasks || count <= 0) return 0;
 
-    // 1. 校验魔数
-    uint32_t magic;
-    if (fread(&magic, sizeof(uint32_t), 1, fp) != 1 || magic != DB_MAGIC)
+    uint8_t hdr[DB_HEADER_SIZE];
+    int64_t maxId = 0;
+    FILE* fp = FileUtils_OpenFileUTF8(historyPath, "r+b");
+    if (fp)
     {
-        fclose(fp);
-        Logger_Log(LOG_WARNING, "任务数据库格式不正确，已忽略");
+        maxId = fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr) ? decode_history_header(hdr, sizeof(hdr)) : -1;
+        if (maxId < 0)
+        {
+            fclose(fp);
+            Logger_Log(LOG_ERROR, "历史任务文件格式不正确，拒绝追加: %s", historyPath);
+            return -1;
+        }
+    }
+    else
+    {
+        fp = FileUtils_OpenFileUTF8(historyPath, "w+b");
+        if (!fp)
+        {
+            Logger_Log(LOG_ERROR, "无法创建历史任务文件: %s", historyPath);
+            return -1;
+        }
+        encode_history_header(hdr, 0);
+        fwrite(hdr, 1, sizeof(hdr), fp);
+    }
+
+    ByteBuf b;
+    memset(&b, 0, sizeof(b));
+    for (int i = 0; i < count; ++i)
+    {
+        const TransferTask* task = tasks[i];
+        size_t rec = begin_record(&b, DB_REC_TASK);
+        put_common_fields(&b, task);
+        put_field(&b, FIELD_SRC_PATH, task->srcPath, (uint16_t)bounded_len(task->srcPath, sizeof(task->srcPath)));
+        put_field(&b, FIELD_DEST_PATH, task->destPath,
+                  (uint16_t)bounded_len(task->destPath, sizeof(task->destPath)));
+        end_record(&b, rec);
+        if (task->id > maxId) maxId = task->id;
+    }
+
+    // 先追加记录，再更新文件头：中途断电时文件头的 maxId 只会偏小，记录本身仍可读
+    int rc = b.failed ? -1 : 0;
+    if (rc == 0 && (fseek(fp, 0, SEEK_END) != 0 || fwrite(b.data, 1, b.len, fp) != b.len)) rc = -1;
+    if (rc == 0)
+    {
+        fflush(fp);
+        encode_history_header(hdr, (uint32_t)maxId);
+        if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) rc = -1;
+    }
+    if (rc == 0) rc = fflush(fp) == 0 ? 0 : -1;
+#ifndef _WIN32
+    if (rc == 0) fsync(fileno(fp));
+#endif
+    fclose(fp);
+    free(b.data);
+
+    if (rc != 0) Logger_Log(LOG_ERROR, "写入历史任务失败: %s", historyPath);
+    return rc;
+}
+
+int Persistence_ReadHistoryMaxId(const char* historyPath)
+{
+    FILE* fp = historyPath ? FileUtils_OpenFileUTF8(historyPath, "rb") : NULL;
+    if (!fp) return 0;
+
+    uint8_t hdr[DB_HEADER_SIZE];
+    int64_t maxId = fread(hdr, 1, sizeof(hdr), fp) == sizeof(hdr) ? decode_history_header(hdr, sizeof(hdr)) : -1;
+    fclose(fp);
+    return maxId > 0 ? (int)maxId : 0;
+}
+
+int Persistence_LoadHistory(const char* historyPath, TransferTask** outTasks)
+{
+    if (!historyPath || !outTasks) return -1;
+    *outTasks = NULL;
+
+    size_t size = 0;
+    uint8_t* data = read_whole_file(historyPath, &size);
+    if (!data) return FileUtils_Exists(historyPath) ? -1 : 0;
+    if (decode_history_header(data, size) < 0)
+    {
+        free(data);
+        Logger_Log(LOG_WARNING, "历史任务文件格式不正确，已忽略: %s", historyPath);
         return 0;
     }
 
-    // 2. 读取数量
-    int count = 0;
-    fread(&count, sizeof(int), 1, fp);
-    if (count > maxCount) count = maxCount;
+    int cap = (int)(size / DB_RECORD_OVERHEAD) + 1;
+    TransferTask* tasks = (TransferTask*)malloc(sizeof(TransferTask) * (size_t)cap);
+    if (!tasks)
+    {
+        free(data);
+        return -1;
+    }
 
-    // 3. 读取任务数据
-    int loaded = 0;
-    if (count > 0 && outTasks)
+    int count = 0;
+    size_t pos = DB_HEADER_SIZE;
+    while (pos + DB_RECORD_OVERHEAD <= size)
     {
-        loaded = (int)fread(outTasks, sizeof(TransferTask), count, fp);
+        uint16_t type = (uint16_t)get_le(data + pos, 2);
+        uint32_t len = (uint32_t)get_le(data + pos + 4, 4);
+        if (len > size - pos - DB_RECORD_OVERHEAD) break; // 截断的尾部
+        const uint8_t* payload = data + pos + 8;
+        if (Algorithm_CalculateCRC32(data + pos, 8 + (size_t)len) != (uint32_t)get_le(payload + len, 4)) break;
+        pos += DB_RECORD_OVERHEAD + len;
+
+        if (type == DB_REC_TASK && decode_task(payload, len, NULL, 0, &tasks[count]) == 0)
+        {
+            count++;
+        }
     }
+    free(data);
 
-    // 4. 清理回调指针
-    // 结构体中的函数指针 (onProgress, onError) 保存的是上次运行时的内存地址。
-    for (int i = 0; i < loaded; ++i)
+    // 归档后、活动库写出前断电会导致同一任务被归档两次：从后往前扫描，只保留每个 ID 的最后一条
+    uint32_t cap2 = 16;
+    while (cap2 < (uint32_t)count * 2) cap2 *= 2;
+    int* seen = (int*)calloc(cap2, sizeof(int));
+    int kept = count;
+    if (seen)
     {
-        outTasks[i].onProgress = NULL;
-        outTasks[i].onError = NULL;
+        for (int i = count - 1; i >= 0; --i)
+        {
+            uint32_t h = ((uint32_t)tasks[i].id * 2654435761u) & (cap2 - 1);
+            while (seen[h] != 0 && seen[h] != tasks[i].id) h = (h + 1) & (cap2 - 1);
+            if (seen[h] == tasks[i].id && tasks[i].id != 0) tasks[i].id = 0; // 已有更新的记录
+            else seen[h] = tasks[i].id;
+        }
+        free(seen);
+
+        kept = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            if (tasks[i].id != 0) tasks[kept++] = tasks[i];
+        }
     }
 
-    fclose(fp);
-    return loaded;
+    *outTasks = tasks;
+    return kept;
 }
@@ -0,0 +1,347 @@
+﻿#include "data/SlotStore.h"
+#include "data/Logger.h"
+#include "utils/Algorithm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SLOT_MAGIC 0x53465453 // ASCII "SFTS"
+#define SLOT_VERSION 1
+#define SLOT_HEADER_SIZE 4096 // 文件头独占一页，槽位从页边界开始
+#define SLOT_SIZE 1024        // 页大小的约数：每个槽位都落在单独一页内，检查点只需同步一页
+
+typedef struct SlotFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint32_t taskSize; // sizeof(TransferTask)，布局变化时拒绝打开
+    uint32_t slotCount;
+} SlotFileHeader;
+
+// 进度副本：check 为本结构 (check 字段置 0) 的 CRC32
+typedef struct SlotProgress
+{
+    uint32_t seq; // 0 表示从未写入
+    int32_t status;
+    uint64_t currentOffset;
+    uint64_t totalSize;
+    uint32_t crc32;
+    uint32_t check;
+    uint8_t destHash[32];
+} SlotProgress;
+
+typedef struct TaskSlot
+{
+    uint32_t used;
+    uint32_t check; // task 的 CRC32
+    TransferTask task;
+    SlotProgress progress[2]; // 交替写入
+} TaskSlot;
+
+struct SlotStore
+{
+    uint8_t* base;
+    uint64_t mapSize;
+    int slotCount;
+    size_t pageSize;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+static uint32_t progress_check(const SlotProgress* p)
+{
+    SlotProgress tmp = *p;
+    tmp.check = 0;
+    return Algorithm_CalculateCRC32((const uint8_t*)&tmp, sizeof(tmp));
+}
+
+static int progress_valid(const SlotProgress* p)
+{
+    return p->seq != 0 && progress_check(p) == p->check;
+}
+
+static TaskSlot* slot_at(SlotStore* store, int slot)
+{
+    return (TaskSlot*)(store->base + SLOT_HEADER_SIZE + (uint64_t)slot * SLOT_SIZE);
+}
+
+static uint64_t file_size_for(int slots)
+{
+    return SLOT_HEADER_SIZE + (uint64_t)slots * SLOT_SIZE;
+}
+
+// 同步 [addr, addr + len) 所在的页
+static void flush_range(SlotStore* store, void* addr, size_t len, int durable)
+{
+#ifdef _WIN32
+    FlushViewOfFile(addr, len);
+    if (durable) FlushFileBuffers(store->file);
+#else
+    uintptr_t start = (uintptr_t)addr & ~(uintptr_t)(store->pageSize - 1);
+    uintptr_t end = (uintptr_t)addr + len;
+    msync((void*)start, (size_t)(end - start), durable ? MS_SYNC : MS_ASYNC);
+#endif
+}
+
+static void unmap(SlotStore* store)
+{
+    if (!store->base) return;
+#ifdef _WIN32
+    FlushViewOfFile(store->base, 0);
+    UnmapViewOfFile(store->base);
+    CloseHandle(store->mapping);
+    store->mapping = NULL;
+#else
+    msync(store->base, (size_t)store->mapSize, MS_SYNC);
+    munmap(store->base, (size_t)store->mapSize);
+#endif
+    store->base = NULL;
+}
+
+// 将文件扩展到 size 字节并重新映射
+static int map(SlotStore* store, uint64_t size)
+{
+#ifdef _WIN32
+    store->mapping = CreateFileMappingW(store->file, NULL, PAGE_READWRITE, (DWORD)(size >> 32),
+                                        (DWORD)(size & 0xFFFFFFFFu), NULL);
+    if (!store->mapping) return -1;
+    store->base = (uint8_t*)MapViewOfFile(store->mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+    if (!store->base)
+    {
+        CloseHandle(store->mapping);
+        store->mapping = NULL;
+        return -1;
+    }
+#else
+    struct stat st;
+    if (fstat(store->fd, &st) != 0) return -1;
+    if ((uint64_t)st.st_size < size && ftruncate(store->fd, (off_t)size) != 0) return -1;
+    void* p = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if (p == MAP_FAILED) return -1;
+    store->base = (uint8_t*)p;
+#endif
+    store->mapSize = size;
+    store->slotCount = (int)((size - SLOT_HEADER_SIZE) / SLOT_SIZE);
+    ((SlotFileHeader*)store->base)->slotCount = (uint32_t)store->slotCount;
+    return 0;
+}
+
+static int grow(SlotStore* store, int minSlots)
+{
+    int slots = store->slotCount > 0 ? store->slotCount : 16;
+    while (slots < minSlots) slots *= 2;
+    unmap(store);
+    if (map(store, file_size_for(slots)) != 0)
+    {
+        Logger_Log(LOG_ERROR, "槽位库扩容失败 (%d 槽位)", slots);
+        return -1;
+    }
+    return 0;
+}
+
+SlotStore* SlotStore_Open(const char* path, int minSlots)
+{
+    if (!path) return NULL;
+    if (sizeof(TaskSlot) > SLOT_SIZE)
+    {
+        Logger_Log(LOG_ERROR, "任务结构体超出槽位大小 (%u > %d)", (unsigned)sizeof(TaskSlot), SLOT_SIZE);
+        return NULL;
+    }
+    if (minSlots < 1) minSlots = 1;
+
+    SlotStore* store = (SlotStore*)calloc(1, sizeof(SlotStore));
+    if (!store) return NULL;
+
+    uint64_t existing = 0;
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    store->pageSize = si.dwPageSize;
+
+    wchar_t wpath[MAX_PATH];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, MAX_PATH);
+    store->file = CreateFileW(wpath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (store->file == INVALID_HANDLE_VALUE)
+    {
+        Logger_Log(LOG_ERROR, "无法打开槽位库: %s", path);
+        free(store);
+        return NULL;
+    }
+    LARGE_INTEGER sz;
+    if (GetFileSizeEx(store->file, &sz)) existing = (uint64_t)sz.QuadPart;
+#else
+    store->pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0)
+    {
+        Logger_Log(LOG_ERROR, "无法打开槽位库: %s", path);
+        free(store);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(store->fd, &st) == 0) existing = (uint64_t)st.st_size;
+#endif
+
+    int fresh = existing < SLOT_HEADER_SIZE;
+    int slots = fresh ? minSlots : (int)((existing - SLOT_HEADER_SIZE) / SLOT_SIZE);
+    if (slots < minSlots) slots = minSlots;
+
+    if (map(store, file_size_for(slots)) != 0)
+    {
+        Logger_Log(LOG_ERROR, "无法映射槽位库: %s", path);
+        SlotStore_Close(store);
+        return NULL;
+    }
+
+    SlotFileHeader* hdr = (SlotFileHeader*)store->base;
+    if (fresh)
+    {
+        hdr->magic = SLOT_MAGIC;
+        hdr->version = SLOT_VERSION;
+        hdr->slotSize = SLOT_SIZE;
+        hdr->taskSize = (uint32_t)sizeof(TransferTask);
+        hdr->slotCount = (uint32_t)store->slotCount;
+        flush_range(store, hdr, sizeof(*hdr), 1);
+    }
+    else if (hdr->magic != SLOT_MAGIC || hdr->version != SLOT_VERSION || hdr->slotSize != SLOT_SIZE ||
+             hdr->taskSize != sizeof(TransferTask))
+    {
+        Logger_Log(LOG_ERROR, "槽位库格式不兼容: %s", path);
+        SlotStore_Close(store);
+        return NULL;
+    }
+    return store;
+}
+
+void SlotStore_Close(SlotStore* store)
+{
+    if (!store) return;
+    unmap(store);
+#ifdef _WIN32
+    if (store->file && store->file != INVALID_HANDLE_VALUE) CloseHandle(store->file);
+#else
+    if (store->fd >= 0) close(store->fd);
+#endif
+    free(store);
+}
+
+int SlotStore_Capacity(const SlotStore* store)
+{
+    return store ? store->slotCount : 0;
+}
+
+int SlotStore_Load(SlotStore* store, TransferTask* outTasks, int* outSlots, int maxCount)
+{
+    if (!store || !outTasks) return 0;
+
+    int loaded = 0;
+    int torn = 0;
+    for (int i = 0; i < store->slotCount && loaded < maxCount; ++i)
+    {
+        const TaskSlot* s = slot_at(store, i);
+        if (s->used != 1) continue;
+        if (Algorithm_CalculateCRC32((const uint8_t*)&s->task, sizeof(TransferTask)) != s->check)
+        {
+            torn++;
+            continue;
+        }
+
+        TransferTask* t = &outTasks[loaded];
+        *t = s->task;
+        t->onProgress = NULL;
+        t->onError = NULL;
+
+        // 取序号较大的有效进度副本
+        const SlotProgress* best = NULL;
+        for (int k = 0; k < 2; ++k)
+        {
+            if (progress_valid(&s->progress[k]) && (!best || s->progress[k].seq > best->seq))
+            {
+                best = &s->progress[k];
+            }
+        }
+        if (best)
+        {
+            t->status = (TaskStatus)best->status;
+            t->currentOffset = best->currentOffset;
+            t->totalSize = best->totalSize;
+            t->crc32 = best->crc32;
+            memcpy(t->destHash, best->destHash, sizeof(t->destHash));
+        }
+
+        if (outSlots) outSlots[loaded] = i;
+        loaded++;
+    }
+
+    if (torn > 0) Logger_Log(LOG_WARNING, "槽位库中有 %d 个损坏的任务记录已跳过", torn);
+    return loaded;
+}
+
+int SlotStore_Write(SlotStore* store, int slot, const TransferTask* task)
+{
+    if (!store || !task || slot < 0) return -1;
+    if (slot >= store->slotCount && grow(store, slot + 1) != 0) return -1;
+
+    TaskSlot* s = slot_at(store, slot);
+    s->used = 0; // 写入完成前标记为无效
+    s->task = *task;
+    s->task.onProgress = NULL;
+    s->task.onError = NULL;
+    s->check = Algorithm_CalculateCRC32((const uint8_t*)&s->task, sizeof(TransferTask));
+    memset(s->progress, 0, sizeof(s->progress));
+    s->used = 1;
+
+    flush_range(store, s, sizeof(TaskSlot), 1);
+    return 0;
+}
+
+int SlotStore_Release(SlotStore* store, int slot)
+{
+    if (!store || slot < 0 || slot >= store->slotCount) return -1;
+
+    // 不必等待落盘：若断电后槽位重新出现，任务会被再次归档，历史加载时按 ID 去重
+    slot_at(store, slot)->used = 0;
+    return 0;
+}
+
+int SlotStore_Checkpoint(SlotStore* store, int slot, const TransferTask* task, int durable)
+{
+    if (!store || !task || slot < 0 || slot >= store->slotCount) return -1;
+
+    TaskSlot* s = slot_at(store, slot);
+    if (s->used != 1) return -1;
+
+    // 覆盖较旧 (或无效) 的那一份，另一份在写入期间保持完整
+    uint32_t seq0 = progress_valid(&s->progress[0]) ? s->progress[0].seq : 0;
+    uint32_t seq1 = progress_valid(&s->progress[1]) ? s->progress[1].seq : 0;
+    int target = seq0 <= seq1 ? 0 : 1;
+
+    SlotProgress p;
+    memset(&p, 0, sizeof(p));
+    p.seq = (seq0 > seq1 ? seq0 : seq1) + 1;
+    p.status = (int32_t)task->status;
+    p.currentOffset = task->currentOffset;
+    p.totalSize = task->totalSize;
+    p.crc32 = task->crc32;
+    memcpy(p.destHash, task->destHash, sizeof(p.destHash));
+    p.check = progress_check(&p);
+
+    s->progress[target] = p;
+    flush_range(store, &s->progress[target], sizeof(SlotProgress), durable);
+    return 0;
+}
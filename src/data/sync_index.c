@@ -0,0 +1,304 @@
+﻿#include "data/SyncIndex.h"
+#include "data/Logger.h"
+#include "common/ErrorCode.h"
+#include "utils/Algorithm.h"
+#include "utils/FileUtils.h"
+#include "utils/Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+static const uint32_t INDEX_MAGIC = 0x49585453; // ASCII "STXI"
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 16
+#define INDEX_WRITE_BUFFER (64 * 1024)
+
+static void put_le(uint8_t* p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t get_le(const uint8_t* p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static int get_varint(const uint8_t* data, size_t end, size_t* pos, uint64_t* out)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && *pos < end; shift += 7)
+    {
+        uint8_t b = data[(*pos)++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+        {
+            *out = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static uint32_t hash_path(const char* s)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (; *s; ++s) h = (h ^ (uint8_t)*s) * 16777619u;
+    return h;
+}
+
+static void clear_index(SyncIndex* index)
+{
+    memset(index, 0, sizeof(*index));
+}
+
+// 校验并解析记录。names 为 NULL 时只计算路径总字节数
+static int parse_records(const uint8_t* data, size_t end, size_t count, SyncIndexEntry* entries, char* names,
+                         size_t* namesSize)
+{
+    size_t pos = INDEX_HEADER_SIZE;
+    size_t used = 0;
+    size_t prevLen = 0;
+    const char* prev = NULL;
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint64_t shared, suffix, size, mtime;
+        if (get_varint(data, end, &pos, &shared) != 0 || get_varint(data, end, &pos, &suffix) != 0) return -1;
+        if (shared > prevLen || suffix > end - pos) return -1;
+        size_t len = (size_t)(shared + suffix);
+        if (names)
+        {
+            char* name = names + used;
+            if (shared > 0) memcpy(name, prev, (size_t)shared);
+            memcpy(name + shared, data + pos, (size_t)suffix);
+            name[len] = '\0';
+            entries[i].path = name;
+            prev = name;
+        }
+        pos += (size_t)suffix;
+        if (get_varint(data, end, &pos, &size) != 0 || get_varint(data, end, &pos, &mtime) != 0) return -1;
+        if (end - pos < TREEHASH_OUT_LEN) return -1;
+        if (names)
+        {
+            entries[i].size = size;
+            entries[i].mtimeNs = mtime;
+            memcpy(entries[i].hash, data + pos, TREEHASH_OUT_LEN);
+        }
+        pos += TREEHASH_OUT_LEN;
+        used += len + 1;
+        prevLen = len;
+    }
+    *namesSize = used;
+    return pos == end ? 0 : -1;
+}
+
+static int build_slots(SyncIndex* index)
+{
+    size_t slots = 16;
+    while (slots < index->count * 2) slots <<= 1;
+    index->slots = (uint32_t*)calloc(slots, sizeof(uint32_t));
+    if (!index->slots) return -1;
+    index->slotCount = slots;
+    for (size_t i = 0; i < index->count; ++i)
+    {
+        size_t s = hash_path(index->entries[i].path) & (slots - 1);
+        while (index->slots[s] != 0) s = (s + 1) & (slots - 1);
+        index->slots[s] = (uint32_t)(i + 1);
+    }
+    return 0;
+}
+
+int SyncIndex_Load(const char* path, SyncIndex* out)
+{
+    clear_index(out);
+    if (!FileUtils_Exists(path)) return build_slots(out) == 0 ? ERR_SUCCESS : ERR_MEMORY;
+
+    TRACE_BEGIN(span, "SyncIndex.load");
+    size_t size = (size_t)FileUtils_GetFileSize(path);
+    uint8_t* data = size > 0 ? (uint8_t*)malloc(size) : NULL;
+    FILE* fp = data ? FileUtils_OpenFileUTF8(path, "rb") : NULL;
+    int loaded = fp && fread(data, 1, size, fp) == size;
+    if (fp) fclose(fp);
+
+    int rc = ERR_FILE_READ;
+    size_t end = size >= 4 ? size - 4 : 0;
+    size_t namesSize = 0;
+    if (loaded && size >= INDEX_HEADER_SIZE + 4 && get_le(data, 4) == INDEX_MAGIC &&
+        get_le(data + 4, 2) <= INDEX_VERSION && get_le(data + end, 4) == Algorithm_CalculateCRC32(data, end))
+    {
+        uint64_t count = get_le(data + 8, 8);
+        // 每条记录至少 2 + 2 + 32 字节，据此拒绝损坏的计数
+        if (count <= (end - INDEX_HEADER_SIZE) / (4 + TREEHASH_OUT_LEN) &&
+            parse_records(data, end, (size_t)count, NULL, NULL, &namesSize) == 0)
+        {
+            out->entries = (SyncIndexEntry*)malloc(sizeof(SyncIndexEntry) * (size_t)(count ? count : 1));
+            out->names = (char*)malloc(namesSize ? namesSize : 1);
+            if (out->entries && out->names)
+            {
+                out->count = (size_t)count;
+                parse_records(data, end, out->count, out->entries, out->names, &namesSize);
+                rc = ERR_SUCCESS;
+            }
+            else
+            {
+                rc = ERR_MEMORY;
+            }
+        }
+    }
+    free(data);
+    if (rc != ERR_SUCCESS)
+    {
+        if (rc == ERR_FILE_READ) Logger_Log(LOG_WARNING, "同步索引损坏，已忽略: %s", path);
+        SyncIndex_Free(out);
+    }
+    if (build_slots(out) != 0 && rc == ERR_SUCCESS) rc = ERR_MEMORY;
+    TRACE_END(span);
+    return rc;
+}
+
+const SyncIndexEntry* SyncIndex_Find(const SyncIndex* index, const char* relPath)
+{
+    if (!index->slots) return NULL;
+    size_t mask = index->slotCount - 1;
+    for (size_t s = hash_path(relPath) & mask; index->slots[s] != 0; s = (s + 1) & mask)
+    {
+        const SyncIndexEntry* e = &index->entries[index->slots[s] - 1];
+        if (strcmp(e->path, relPath) == 0) return e;
+    }
+    return NULL;
+}
+
+void SyncIndex_Free(SyncIndex* index)
+{
+    if (!index) return;
+    free(index->entries);
+    free(index->names);
+    free(index->slots);
+    clear_index(index);
+}
+
+// 带缓冲的写出，同时累计 CRC
+typedef struct IndexWriter
+{
+    FILE* fp;
+    uint32_t crc;
+    size_t len;
+    int failed;
+    uint8_t buf[INDEX_WRITE_BUFFER];
+} IndexWriter;
+
+static void writer_flush(IndexWriter* w)
+{
+    if (w->len == 0) return;
+    w->crc = Algorithm_UpdateCRC32(w->crc, w->buf, w->len);
+    if (fwrite(w->buf, 1, w->len, w->fp) != w->len) w->failed = 1;
+    w->len = 0;
+}
+
+static void writer_put(IndexWriter* w, const void* data, size_t len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0)
+    {
+        if (w->len == sizeof(w->buf)) writer_flush(w);
+        size_t n = sizeof(w->buf) - w->len < len ? sizeof(w->buf) - w->len : len;
+        memcpy(w->buf + w->len, p, n);
+        w->len += n;
+        p += n;
+        len -= n;
+    }
+}
+
+static void writer_varint(IndexWriter* w, uint64_t v)
+{
+    uint8_t tmp[10];
+    int n = 0;
+    do
+    {
+        tmp[n] = (uint8_t)(v & 0x7F);
+        v >>= 7;
+        if (v) tmp[n] |= 0x80;
+        n++;
+    }
+    while (v);
+    writer_put(w, tmp, (size_t)n);
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+    return strcmp(((const SyncIndexEntry*)a)->path, ((const SyncIndexEntry*)b)->path);
+}
+
+int SyncIndex_Save(const char* path, SyncIndexEntry* entries, size_t count)
+{
+    TRACE_BEGIN(span, "SyncIndex.save");
+    if (count > 1) qsort(entries, count, sizeof(SyncIndexEntry), compare_entries);
+
+    char tmpPath[1100];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    IndexWriter* w = (IndexWriter*)malloc(sizeof(IndexWriter));
+    FILE* fp = w ? FileUtils_OpenFileUTF8(tmpPath, "wb") : NULL;
+    if (!fp)
+    {
+        free(w);
+        Logger_Log(LOG_ERROR, "无法创建同步索引: %s", tmpPath);
+        TRACE_END(span);
+        return ERR_FILE_OPEN;
+    }
+    w->fp = fp;
+    w->crc = 0;
+    w->len = 0;
+    w->failed = 0;
+
+    uint8_t hdr[INDEX_HEADER_SIZE];
+    put_le(hdr, INDEX_MAGIC, 4);
+    put_le(hdr + 4, INDEX_VERSION, 2);
+    put_le(hdr + 6, 0, 2);
+    put_le(hdr + 8, count, 8);
+    writer_put(w, hdr, sizeof(hdr));
+
+    const char* prev = "";
+    for (size_t i = 0; i < count; ++i)
+    {
+        const SyncIndexEntry* e = &entries[i];
+        size_t shared = 0;
+        while (prev[shared] && prev[shared] == e->path[shared]) shared++;
+        size_t suffix = strlen(e->path + shared);
+        writer_varint(w, shared);
+        writer_varint(w, suffix);
+        writer_put(w, e->path + shared, suffix);
+        writer_varint(w, e->size);
+        writer_varint(w, e->mtimeNs);
+        writer_put(w, e->hash, TREEHASH_OUT_LEN);
+        prev = e->path;
+    }
+    writer_flush(w);
+    uint8_t crc[4];
+    put_le(crc, w->crc, 4);
+    int rc = w->failed || fwrite(crc, 1, sizeof(crc), fp) != sizeof(crc) || fflush(fp) != 0 ? -1 : 0;
+#ifndef _WIN32
+    if (rc == 0) fsync(fileno(fp));
+#endif
+    fclose(fp);
+    free(w);
+
+    if (rc != 0)
+    {
+        Logger_Log(LOG_ERROR, "写入同步索引失败: %s", tmpPath);
+        remove(tmpPath);
+        TRACE_END(span);
+        return ERR_FILE_WRITE;
+    }
+#ifdef _WIN32
+    remove(path); // Windows 下 rename 不会覆盖已存在的文件
+#endif
+    rc = rename(tmpPath, path) == 0 ? ERR_SUCCESS : ERR_FILE_WRITE;
+    if (rc != ERR_SUCCESS) Logger_Log(LOG_ERROR, "替换同步索引失败: %s", path);
+    TRACE_END(span);
+    return rc;
+}
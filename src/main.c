@@ -3,8 +3,10 @@
 #include <windows.h>
 #endif
 #include "ui/MainWindow.h"
+#include "ui/Cli.h"
 #include "data/Logger.h"      // 新增
 #include "utils/Algorithm.h"  // 新增
+#include "utils/Trace.h"
 #include "../include/ui/startup.h"
 
 int main(int argc, char* argv[])
@@ -15,11 +17,29 @@ int main(int argc, char* argv[])
     SetConsoleOutputCP(65001);
 #endif
 
+    // 带子命令时以批处理模式运行：无菜单、无弹窗，输出 NDJSON，退出码反映结果
+    if (argc > 1)
+    {
+        Logger_Init("data/app.log");
+        Trace_SetThreadName("main");
+        Algorithm_InitCRC32();
+        int rc = Cli_Run(argc, argv);
+        Logger_Close();
+
+        // 同样导出 trace；stdout 只输出 NDJSON，提示写到 stderr
+        if (Trace_IsEnabled() && Trace_WriteChrome("data/trace.json") == 0)
+        {
+            fprintf(stderr, "Trace 已写入 data/trace.json\n");
+        }
+        return rc;
+    }
+
     /* 显示启动版权信息（控制台 + Windows 弹窗） */
     Startup_ShowCopyright();
 
     // 1. 初始化基础服务
     Logger_Init("data/app.log");
+    Trace_SetThreadName("main");
     Algorithm_InitCRC32();
 
     Logger_Log(LOG_INFO, "System Booting...");
@@ -40,5 +60,11 @@ int main(int argc, char* argv[])
     Logger_Log(LOG_INFO, "System Shutdown.");
     Logger_Close();
 
+    // 启用 SAFETRIX_ENABLE_TRACE 构建时导出本次运行的 trace，可直接用 Perfetto 打开
+    if (Trace_IsEnabled() && Trace_WriteChrome("data/trace.json") == 0)
+    {
+        printf("Trace 已写入 data/trace.json\n");
+    }
+
     return 0;
 }
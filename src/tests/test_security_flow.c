@@ -1,16 +1,47 @@
+﻿#ifdef __linux__
+#define _GNU_SOURCE // splice (管道流式加密测试中的中继)
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdatomic.h>
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #endif
 
 #include "common/AppTypes.h"
+#include "common/ErrorCode.h"
 #include "core/TaskManager.h"
 #include "core/TransferEngine.h"
+#include "core/Security.h"
+#include "core/Verify.h"
+#include "core/Metrics.h"
+#include "core/NetTransfer.h"
+#include "core/StreamTransfer.h"
+#include "core/DirSync.h"
+#include "data/Persistence.h"
+#include "data/SlotStore.h"
+#include "data/SyncIndex.h"
+#include "data/Logger.h"
 #include "utils/FileUtils.h"
+#include "utils/Algorithm.h"
+#include "utils/BufferPool.h"
+#include "utils/TreeHash.h"
+#include "utils/Thread.h"
+#include "utils/Trace.h"
+#include "ui/Cli.h"
+#include "ui/Daemon.h"
+#include "ui/Dashboard.h"
 
 // TransferEngine.c 实现了 RunTask，但没有在头文件暴露（项目中直接调用）。
 // 在测试中我们声明一下以便链接。
@@ -51,6 +82,1409 @@ static int create_dummy_file(const char* path, size_t sizeMB)
     return 0;
 }
 
+// 校验 v2 (按偏移寻址、批量) 加密接口与 v1 流式接口结果一致
+static int check_cipher_v2(void)
+{
+    enum { LEN = 1000 };
+    uint8_t ref[LEN], out[LEN];
+    for (size_t i = 0; i < LEN; ++i) ref[i] = out[i] = (uint8_t)(i * 7 + 3);
+
+    CryptoContext ctx;
+    InitSecurity(&ctx, "SecretKey123");
+    EncryptBuffer(ref, LEN, &ctx); // v1：一次性整段
+
+    // v2：乱序、非对齐切分为多个分段，一次批量调用
+    CipherSegment segs[4] = {
+        {out + 517, LEN - 517, 517},
+        {out, 5, 0},
+        {out + 133, 384, 133},
+        {out + 5, 128, 5},
+    };
+    EncryptSegments(&ctx, segs, 4);
+
+    return memcmp(ref, out, LEN) == 0 ? 0 : -1;
+}
+
+// 校验 slicing-by-16 CRC32、分段合并与多线程计算的一致性
+static int check_crc32(void)
+{
+    const char* vec = "123456789";
+    if (Algorithm_CalculateCRC32((const uint8_t*)vec, 9) != 0xCBF43926u) return -1;
+
+    const size_t len = 4 * 1024 * 1024 + 37;
+    uint8_t* data = (uint8_t*)malloc(len);
+    if (!data) return -1;
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < len; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+
+    // 逐字节参考实现
+    uint32_t ref = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i)
+    {
+        ref ^= data[i];
+        for (int k = 0; k < 8; ++k) ref = (ref & 1) ? (ref >> 1) ^ 0xEDB88320u : ref >> 1;
+    }
+    ref ^= 0xFFFFFFFFu;
+
+    int ok = Algorithm_CalculateCRC32(data, len) == ref;
+
+    // 覆盖硬件折叠与查表路径的各个长度边界和非对齐起点
+    static const size_t lens[] = {0, 1, 15, 16, 17, 63, 64, 65, 127, 128, 129, 1000, 4099};
+    for (size_t li = 0; ok && li < sizeof(lens) / sizeof(lens[0]); ++li)
+    {
+        for (size_t off = 0; ok && off < 4; ++off)
+        {
+            uint32_t r = 0xFFFFFFFFu;
+            for (size_t i = 0; i < lens[li]; ++i)
+            {
+                r ^= data[off + i];
+                for (int k = 0; k < 8; ++k) r = (r & 1) ? (r >> 1) ^ 0xEDB88320u : r >> 1;
+            }
+            ok = Algorithm_CalculateCRC32(data + off, lens[li]) == (r ^ 0xFFFFFFFFu);
+        }
+    }
+    size_t split = 1000003;
+    uint32_t a = Algorithm_CalculateCRC32(data, split);
+    uint32_t b = Algorithm_CalculateCRC32(data + split, len - split);
+    ok = ok && Algorithm_CombineCRC32(a, b, len - split) == ref;
+    ok = ok && Algorithm_CombineCRC32(ref, 0, 0) == ref;
+    ok = ok && Algorithm_CalculateCRC32Parallel(data, len, 4) == ref;
+
+    free(data);
+    return ok ? 0 : -1;
+}
+
+// 校验树形哈希：已知向量、内存与多线程文件哈希一致、按叶子增量重算
+static int check_tree_hash(void)
+{
+    static const uint8_t abcHash[TREEHASH_OUT_LEN] = {
+        0x64, 0x37, 0xb3, 0xac, 0x38, 0x46, 0x51, 0x33, 0xff, 0xb6, 0x3b, 0x75, 0x27, 0x3a, 0x8d, 0xb5,
+        0x48, 0xc5, 0x58, 0x46, 0x5d, 0x79, 0xdb, 0x03, 0xfd, 0x35, 0x9c, 0x6c, 0xd5, 0xbd, 0x9d, 0x85
+    };
+    uint8_t h[TREEHASH_OUT_LEN], hf[TREEHASH_OUT_LEN];
+    TreeHash_Hash((const uint8_t*)"abc", 3, h);
+    if (memcmp(h, abcHash, sizeof(h)) != 0) return -1;
+
+    const char* path = "test_treehash.dat";
+    const size_t len = 3 * 1024 * 1024 + 4097;
+    uint8_t* data = (uint8_t*)malloc(len);
+    if (!data) return -1;
+    for (size_t i = 0; i < len; ++i) data[i] = (uint8_t)((i * 31) ^ (i >> 9));
+
+    FILE* f = FileUtils_OpenFileUTF8(path, "wb");
+    int ok = f && fwrite(data, 1, len, f) == len;
+    if (f) fclose(f);
+
+    TreeHash_Hash(data, len, h);
+    ok = ok && TreeHash_File(path, 4, hf) == 0 && memcmp(h, hf, sizeof(h)) == 0;
+
+    // 修改最后一个叶子后，只重算受影响的叶子即可得到新的根
+    TreeHashLeaves leaves;
+    memset(&leaves, 0, sizeof(leaves));
+    ok = ok && TreeHash_ComputeLeaves(path, 0, 2, &leaves) == 0;
+    data[len - 10] ^= 0xFF;
+    f = FileUtils_OpenFileUTF8(path, "wb");
+    ok = ok && f && fwrite(data, 1, len, f) == len;
+    if (f) fclose(f);
+    TreeHash_Hash(data, len, h);
+    ok = ok && TreeHash_ComputeLeaves(path, (len - 10) / TREEHASH_LEAF_SIZE, 2, &leaves) == 0;
+    ok = ok && TreeHash_RootFromLeaves(path, &leaves, hf) == 0 && memcmp(h, hf, sizeof(h)) == 0;
+
+    TreeHash_FreeLeaves(&leaves);
+
+    // 随写入增量计算：不对齐叶子的分段输入与一次性哈希一致；
+    // 中途保存检查点后续算，以及没有检查点时从文件补算前缀，结果都不变
+    const char* checkpoint = "test_treehash.leaves";
+    const size_t cut = 2 * 1024 * 1024 + 777;
+    TreeHashStream st;
+    ok = ok && TreeHash_StreamBegin(&st, len, 0, NULL, NULL, 0) == 0;
+    for (size_t off = 0, step = 1000; off < len; off += step, step = step * 3 + 1)
+    {
+        TreeHash_StreamUpdate(&st, data + off, off + step < len ? step : len - off);
+        if (off + step >= len) break;
+        if (off < cut && off + step >= cut) ok = ok && TreeHash_StreamSave(&st, checkpoint) == 0;
+    }
+    ok = ok && TreeHash_StreamFinish(&st, hf) == 0 && memcmp(h, hf, sizeof(h)) == 0;
+    TreeHash_StreamFree(&st);
+
+    ok = ok && TreeHash_StreamBegin(&st, len, 0, NULL, NULL, 0) == 0;
+    TreeHash_StreamUpdate(&st, data, cut);
+    ok = ok && TreeHash_StreamSave(&st, checkpoint) == 0;
+    TreeHash_StreamFree(&st);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        ok = ok && TreeHash_StreamBegin(&st, len, cut, path, pass == 0 ? checkpoint : NULL, 2) == 0;
+        TreeHash_StreamUpdate(&st, data + cut, len - cut);
+        ok = ok && TreeHash_StreamFinish(&st, hf) == 0 && memcmp(h, hf, sizeof(h)) == 0;
+        TreeHash_StreamFree(&st);
+    }
+
+    // 恰好一个叶子时根节点需要带 ROOT 标志
+    TreeHash_Hash(data, (size_t)TREEHASH_LEAF_SIZE, h);
+    ok = ok && TreeHash_StreamBegin(&st, TREEHASH_LEAF_SIZE, 0, NULL, NULL, 0) == 0;
+    TreeHash_StreamUpdate(&st, data, (size_t)TREEHASH_LEAF_SIZE);
+    ok = ok && TreeHash_StreamFinish(&st, hf) == 0 && memcmp(h, hf, sizeof(h)) == 0;
+    TreeHash_StreamFree(&st);
+
+    free(data);
+    remove(path);
+    remove(checkpoint);
+    return ok ? 0 : -1;
+}
+
+// 校验槽位库：扩容、交替写入检查点后重新打开，状态保持最新
+static int check_slot_store(void)
+{
+    const char* path = "test_slots.db";
+    const int n = 20;
+    remove(path);
+
+    SlotStore* store = SlotStore_Open(path, 4);
+    if (!store) return -1;
+    int ok = 1;
+    for (int i = 0; i < n && ok; ++i)
+    {
+        TransferTask t;
+        memset(&t, 0, sizeof(t));
+        t.id = i + 1;
+        snprintf(t.srcPath, sizeof(t.srcPath), "src_%d.dat", i);
+        t.totalSize = 1000;
+        ok = SlotStore_Write(store, i, &t) == 0;
+        for (int k = 1; k <= i % 3 + 1 && ok; ++k)
+        {
+            t.currentOffset = (uint64_t)k * 100;
+            t.status = k == 3 ? TASK_COMPLETED : TASK_RUNNING;
+            ok = SlotStore_Checkpoint(store, i, &t, k == 3) == 0;
+        }
+    }
+    SlotStore_Close(store);
+
+    TransferTask loaded[32];
+    int slots[32];
+    store = SlotStore_Open(path, 4);
+    int count = store ? SlotStore_Load(store, loaded, slots, 32) : -1;
+    ok = ok && count == n;
+    for (int i = 0; ok && i < n; ++i)
+    {
+        int steps = i % 3 + 1;
+        ok = slots[i] == i && loaded[i].id == i + 1 && loaded[i].currentOffset == (uint64_t)steps * 100 &&
+             loaded[i].status == (steps == 3 ? TASK_COMPLETED : TASK_RUNNING);
+    }
+    SlotStore_Close(store);
+    remove(path);
+    return ok ? 0 : -1;
+}
+
+#define LOG_TEST_THREADS 4
+#define LOG_TEST_PER_THREAD 400
+
+static void log_producer(void* arg)
+{
+    int t = (int)(intptr_t)arg;
+    for (int i = 0; i < LOG_TEST_PER_THREAD; ++i)
+    {
+        Logger_Log(LOG_INFO, "producer %d seq %d", t, i);
+    }
+}
+
+static void pool_worker(void* arg)
+{
+    void** out = (void**)arg;
+    *out = BufferPool_Acquire(3 * 1024 * 1024);
+    if (*out) memset(*out, 0x5A, 3 * 1024 * 1024);
+    BufferPool_Release(*out, 3 * 1024 * 1024);
+}
+
+// 校验缓冲池：页对齐；同线程释放后立即复用；线程退出后其缓存的缓冲区可被其他线程取到
+static int check_buffer_pool(void)
+{
+    BufferPoolStats before, after;
+    BufferPool_GetStats(&before);
+
+    void* a = BufferPool_Acquire(1000 * 1000);
+    int ok = a && (uintptr_t)a % BUFFER_POOL_ALIGN == 0;
+    BufferPool_Release(a, 1000 * 1000);
+    void* b = BufferPool_Acquire(1024 * 1024);
+    ok = ok && b == a;
+    BufferPool_Release(b, 1024 * 1024);
+
+    void* fromThread = NULL;
+    Thread th;
+    if (Thread_Create(&th, pool_worker, &fromThread) != 0) return -1;
+    Thread_Join(th);
+    void* c = BufferPool_Acquire(4 * 1024 * 1024);
+    ok = ok && fromThread && c == fromThread && ((uint8_t*)c)[12345] == 0x5A;
+    BufferPool_Release(c, 4 * 1024 * 1024);
+
+    // 大页不可用时退回普通页，仍应得到可用的对齐缓冲区
+    BufferPool_SetHugePages(1);
+    void* h = BufferPool_Acquire(64 * 1024 * 1024);
+    ok = ok && h && (uintptr_t)h % BUFFER_POOL_ALIGN == 0;
+    if (h) memset(h, 1, 64 * 1024 * 1024);
+    BufferPool_Release(h, 64 * 1024 * 1024);
+    BufferPool_SetHugePages(0);
+
+    BufferPool_GetStats(&after);
+    ok = ok && after.reuses >= before.reuses + 2;
+    return ok ? 0 : -1;
+}
+
+// 校验异步日志：多线程写入的记录在关闭后全部落盘，且每个线程内保持顺序；错误日志返回前已写入
+static int check_async_logger(void)
+{
+    const char* path = "test_async.log";
+    remove(path);
+    Logger_Init(path);
+
+    Thread th[LOG_TEST_THREADS];
+    int started = 0;
+    for (int t = 0; t < LOG_TEST_THREADS; ++t)
+    {
+        if (Thread_Create(&th[started], log_producer, (void*)(intptr_t)t) == 0) started++;
+    }
+    for (int t = 0; t < started; ++t) Thread_Join(th[t]);
+
+    Logger_Log(LOG_ERROR, "flush marker");
+    uint64_t sizeAfterError = FileUtils_GetFileSize(path);
+    Logger_Close();
+
+    int next[LOG_TEST_THREADS] = {0};
+    int ok = started == LOG_TEST_THREADS && sizeAfterError == FileUtils_GetFileSize(path);
+    char line[256];
+    FILE* f = FileUtils_OpenFileUTF8(path, "r");
+    while (ok && f && fgets(line, sizeof(line), f))
+    {
+        int t = -1, i = -1;
+        const char* msg = strstr(line, "producer ");
+        if (!msg) continue;
+        ok = sscanf(msg, "producer %d seq %d", &t, &i) == 2 && t >= 0 && t < LOG_TEST_THREADS && next[t]++ == i;
+    }
+    if (f) fclose(f);
+    for (int t = 0; ok && t < LOG_TEST_THREADS; ++t) ok = next[t] == LOG_TEST_PER_THREAD;
+    remove(path);
+    return ok ? 0 : -1;
+}
+
+static TransferTask* lookup_replayed(int id, int create, void* user)
+{
+    TransferTask* t = (TransferTask*)user;
+    return id == 107 && !create ? t : NULL;
+}
+
+// 校验 v2 任务数据库：往返一致，路径去重后文件远小于结构体原样存储；日志记录为固定的小端布局
+static int check_task_db(void)
+{
+    const char* path = "test_tasks.db";
+    TransferTask tasks[8];
+    const TransferTask* ptrs[8];
+    TransferTask* loaded = NULL;
+    memset(tasks, 0, sizeof(tasks));
+    for (int i = 0; i < 8; ++i)
+    {
+        tasks[i].id = 100 + i;
+        snprintf(tasks[i].srcPath, sizeof(tasks[i].srcPath), "/data/incoming/batch/file_%d.bin", i % 3);
+        snprintf(tasks[i].destPath, sizeof(tasks[i].destPath), "D:\\backup\\file_%d.bin", i % 3);
+        tasks[i].totalSize = 1000000u + (uint64_t)i;
+        tasks[i].currentOffset = (uint64_t)i * 4096;
+        tasks[i].priority = i;
+        tasks[i].mode = (TaskMode)(i % 2);
+        tasks[i].cachePolicy = (TaskCachePolicy)(i / 4);
+        tasks[i].status = (TaskStatus)(i % 4);
+        tasks[i].crc32 = 0xA5A5A5A5u ^ (uint32_t)i;
+        tasks[i].destHash[i] = (uint8_t)(i + 1);
+    }
+
+    for (int i = 0; i < 8; ++i) ptrs[i] = &tasks[i];
+
+    int ok = Persistence_SaveTasks(path, ptrs, 8) == 0;
+    ok = ok && FileUtils_GetFileSize(path) * 3 < sizeof(tasks);
+    ok = ok && Persistence_LoadTasks(path, &loaded) == 8;
+    for (int i = 0; ok && i < 8; ++i)
+    {
+        ok = memcmp(&loaded[i], &tasks[i], sizeof(TransferTask)) == 0;
+    }
+    free(loaded);
+    remove(path);
+
+    // 日志增量记录按小端序编码，字节布局固定，重放后字段一致
+    const char* journalPath = "test_tasks.db.journal";
+    remove(journalPath);
+    TaskJournal* journal = Persistence_OpenJournal(journalPath);
+    ok = ok && journal && Persistence_JournalDelta(journal, &tasks[7]) == 0;
+    Persistence_CloseJournal(journal);
+    uint8_t rec[12 + 64];
+    FILE* fj = FileUtils_OpenFileUTF8(journalPath, "rb");
+    ok = ok && fj && fread(rec, 1, sizeof(rec), fj) == sizeof(rec) && fgetc(fj) == EOF;
+    if (fj) fclose(fj);
+    ok = ok && rec[0] == 2 && rec[4] == 64 && rec[5] == 0 && rec[12] == 107 && rec[13] == 0 &&
+         rec[12 + 9] == 0x70 && rec[12 + 16] == 0x47 && rec[12 + 18] == 0x0F && rec[12 + 24] == 0xA2 &&
+         rec[12 + 27] == 0xA5 && rec[12 + 32 + 7] == 8;
+    TransferTask replayed;
+    memset(&replayed, 0, sizeof(replayed));
+    ok = ok && Persistence_ReplayJournal(journalPath, lookup_replayed, &replayed) == 1 &&
+         replayed.status == tasks[7].status && replayed.currentOffset == tasks[7].currentOffset &&
+         replayed.totalSize == tasks[7].totalSize && replayed.crc32 == tasks[7].crc32 &&
+         memcmp(replayed.destHash, tasks[7].destHash, sizeof(replayed.destHash)) == 0;
+    remove(journalPath);
+    return ok ? 0 : -1;
+}
+
+typedef struct RunJob
+{
+    TransferTask* task;
+    int result;
+    atomic_int finished;
+} RunJob;
+
+static void run_task_thread(void* arg)
+{
+    RunJob* job = (RunJob*)arg;
+    job->result = RunTask(job->task);
+    atomic_store(&job->finished, 1);
+}
+
+// 在后台线程运行任务，同时在当前线程反复读取快照：
+// 路径不被撕裂、进度单调不减且不超过总大小，结束后快照与任务一致
+static int run_with_snapshot_reader(TransferTask* task, int* outResult, int* outReads)
+{
+    RunJob job;
+    job.task = task;
+    job.result = -1;
+    atomic_init(&job.finished, 0);
+    Thread th;
+    if (Thread_Create(&th, run_task_thread, &job) != 0) return -1;
+
+    TransferTask snap;
+    uint64_t lastOffset = 0;
+    int bad = 0, reads = 0;
+    while (!atomic_load(&job.finished))
+    {
+        if (TaskManager_SnapshotTask(task->id, &snap) != 0) continue;
+        reads++;
+        if (strcmp(snap.srcPath, "test_source.dat") != 0 || snap.currentOffset < lastOffset ||
+            snap.currentOffset > snap.totalSize || snap.onProgress != NULL)
+        {
+            bad = 1;
+        }
+        lastOffset = snap.currentOffset;
+    }
+    Thread_Join(th);
+
+    if (TaskManager_SnapshotTask(task->id, &snap) != 0 || snap.status != task->status ||
+        snap.currentOffset != task->currentOffset || snap.crc32 != task->crc32)
+    {
+        bad = 1;
+    }
+    *outResult = job.result;
+    *outReads = reads;
+    return bad ? -1 : 0;
+}
+
+static void run_task_plain(void* arg)
+{
+    RunTask((TransferTask*)arg);
+}
+
+// 多个任务在各自的线程中同时运行，仪表盘线程同时读取快照绘制；结束后每个输出都应能通过校验
+static int check_concurrent_runs(const char* src, int* outFrames)
+{
+    enum { N = 3 };
+    int ids[N];
+    Thread th[N];
+    int started = 0;
+    for (int i = 0; i < N; ++i)
+    {
+        char dest[64];
+        snprintf(dest, sizeof(dest), "test_parallel_%d.dat", i);
+        remove(dest);
+        ids[i] = AddTask(src, dest, 1);
+        if (ids[i] <= 0) return -1;
+    }
+    for (int i = 0; i < N; ++i)
+    {
+        if (Thread_Create(&th[started], run_task_plain, GetTaskById(ids[i])) == 0) started++;
+    }
+    Dashboard* dash = Dashboard_Start(ids, N, 30);
+    for (int i = 0; i < started; ++i) Thread_Join(th[i]);
+    *outFrames = Dashboard_Stop(dash);
+
+    int ok = started == N && dash != NULL;
+    for (int i = 0; ok && i < N; ++i)
+    {
+        VerifyResult vr;
+        TransferTask* t = GetTaskById(ids[i]);
+        ok = t && t->status == TASK_COMPLETED && VerifyTask(t, 0, &vr) == 0 && vr.match;
+        if (t) remove(t->destPath);
+    }
+    return ok ? 0 : -1;
+}
+
+#define METRIC_TEST_THREADS 4
+#define METRIC_TEST_PER_THREAD 100000
+
+// 从 Prometheus 文本中取出某个无标签指标的值
+static double metric_value(const char* text, const char* name)
+{
+    size_t len = strlen(name);
+    for (const char* p = text; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : NULL)
+    {
+        if (strncmp(p, name, len) == 0 && p[len] == ' ') return atof(p + len + 1);
+    }
+    return -1.0;
+}
+
+static void metric_producer(void* arg)
+{
+    (void)arg;
+    for (int i = 0; i < METRIC_TEST_PER_THREAD; ++i) Metrics_Add(METRIC_RESUMES, 1);
+}
+
+// 校验指标：分片计数汇总无丢失，传输与检查点已被计入，textfile 与套接字都能取到指标
+static int check_metrics(uint64_t minBytes)
+{
+    char* text = Metrics_Render();
+    double before = text ? metric_value(text, "safetrix_resumes_total") : -1.0;
+    free(text);
+
+    Thread th[METRIC_TEST_THREADS];
+    int started = 0;
+    for (int t = 0; t < METRIC_TEST_THREADS; ++t)
+    {
+        if (Thread_Create(&th[started], metric_producer, NULL) == 0) started++;
+    }
+    for (int t = 0; t < started; ++t) Thread_Join(th[t]);
+
+    const char* prom = "test_metrics.prom";
+    const char* sock = "test_metrics.sock";
+    remove(prom);
+    if (Metrics_Start(prom, sock, 50) != 0) return -1;
+
+    text = Metrics_Render();
+    int ok = text && started == METRIC_TEST_THREADS &&
+             metric_value(text, "safetrix_resumes_total") - before ==
+                 (double)METRIC_TEST_THREADS * METRIC_TEST_PER_THREAD &&
+             metric_value(text, "safetrix_bytes_transferred_total") >= (double)minBytes &&
+             metric_value(text, "safetrix_tasks_completed_total") >= 3 &&
+             metric_value(text, "safetrix_checkpoint_duration_seconds_count") > 0;
+    free(text);
+
+#ifndef _WIN32
+    // 套接字每个连接返回一份完整指标
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sock);
+    char reply[8192];
+    size_t got = 0;
+    if (ok && fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+    {
+        ssize_t n;
+        while (got < sizeof(reply) - 1 && (n = read(fd, reply + got, sizeof(reply) - 1 - got)) > 0) got += (size_t)n;
+    }
+    reply[got] = '\0';
+    if (fd >= 0) close(fd);
+    ok = ok && metric_value(reply, "safetrix_tasks_active") == 0.0;
+#endif
+
+    Metrics_Stop();
+    ok = ok && FileUtils_Exists(prom) && !FileUtils_Exists(sock);
+    remove(prom);
+    return ok ? 0 : -1;
+}
+
+// 停止请求：暂停保存进度并可续传，取消置为异常；请求在下一个块之前生效
+static int check_stop_requests(const char* src)
+{
+    const char* dest = "test_stop.dat";
+    remove(dest);
+    int id = AddTask(src, dest, 1);
+    TransferTask* t = GetTaskById(id);
+    if (!t) return -1;
+
+    StopTransfer(id);
+    int ok = RunTask(t) == 0 && t->status == TASK_PAUSED && t->currentOffset == 0;
+    CancelTransfer(id);
+    ok = ok && RunTask(t) == 0 && t->status == TASK_ERROR;
+    ok = ok && TaskManager_RequestStop(id + 1000000, TASK_STOP_PAUSE) == ERR_TASK_NOT_FOUND;
+
+    VerifyResult vr;
+    ok = ok && RunTask(t) == 0 && t->status == TASK_COMPLETED && VerifyTask(t, 0, &vr) == 0 && vr.match;
+    remove(dest);
+    return ok ? 0 : -1;
+}
+
+static void pause_on_progress(int taskId, double percentage, double speedMbS)
+{
+    (void)speedMbS;
+    if (percentage >= 40.0 && percentage < 100.0) StopTransfer(taskId);
+}
+
+// 中途暂停后续传：目标哈希随写入计算，续传从断点所在叶子接着算，结果应与完整读取目标文件一致
+static int check_resume_hash(void)
+{
+    const char* src = "test_resume_src.dat";
+    const char* dest = "test_resume.dat";
+    const size_t len = 3 * 1024 * 1024 + 5000;
+    FILE* f = FileUtils_OpenFileUTF8(src, "wb");
+    int ok = f != NULL;
+    for (size_t i = 0; ok && i < len; ++i) ok = fputc((int)((i * 7) ^ (i >> 11)) & 0xFF, f) != EOF;
+    if (f) fclose(f);
+    remove(dest);
+
+    TransferEngine_SetChunkSize(12288);
+    int id = ok ? AddTask(src, dest, 1) : -1;
+    TransferTask* t = GetTaskById(id);
+    if (t) SetTaskCallbacks(id, pause_on_progress, NULL);
+    ok = ok && t && RunTask(t) == 0 && t->status == TASK_PAUSED && t->currentOffset > 0 &&
+         t->currentOffset < len && t->currentOffset % TREEHASH_LEAF_SIZE != 0;
+    // 暂停时保存已完成叶子的链值，完成后删除
+    char checkpoint[64];
+    snprintf(checkpoint, sizeof(checkpoint), "data/task_%d.leaves", id);
+    ok = ok && FileUtils_Exists(checkpoint);
+
+    SetTaskCallbacks(id, NULL, NULL);
+    uint8_t h[TREEHASH_OUT_LEN];
+    VerifyResult vr;
+    ok = ok && RunTask(t) == 0 && t->status == TASK_COMPLETED && VerifyTask(t, 0, &vr) == 0 && vr.match;
+    ok = ok && TreeHash_File(dest, 0, h) == 0 && memcmp(h, t->destHash, sizeof(h)) == 0 &&
+         !FileUtils_Exists(checkpoint);
+    TransferEngine_SetChunkSize(1024 * 1024);
+
+    remove(src);
+    remove(dest);
+    return ok ? 0 : -1;
+}
+
+// 复制文件的前 bytes 字节，用于构造中断后的目标文件
+static void copy_prefix(const char* from, const char* to, uint64_t bytes)
+{
+    FILE* in = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    char buf[4096];
+    for (uint64_t done = 0; in && out && done < bytes;)
+    {
+        size_t want = bytes - done < sizeof(buf) ? (size_t)(bytes - done) : sizeof(buf);
+        size_t n = fread(buf, 1, want, in);
+        if (n == 0 || fwrite(buf, 1, n, out) != n) break;
+        done += n;
+    }
+    if (in) fclose(in);
+    if (out) fclose(out);
+}
+
+// 流式缓存策略：1MB 窗口下逐窗口回写并丢弃页缓存，输出仍应能通过解密校验
+static int check_stream_cache(const char* src)
+{
+    const char* dest = "test_stream.dat";
+    remove(dest);
+    TaskOptions options = {TASK_MODE_ENCRYPT, TASK_CACHE_STREAM};
+    TransferEngine_SetStreamWindow(1024 * 1024);
+    int id = AddTaskWithOptions(src, dest, 1, &options);
+    TransferTask* t = GetTaskById(id);
+    VerifyResult vr;
+    int ok = t && t->cachePolicy == TASK_CACHE_STREAM && RunTask(t) == 0 && t->status == TASK_COMPLETED &&
+             VerifyTask(t, 0, &vr) == 0 && vr.match;
+    remove(dest);
+    return ok ? 0 : -1;
+}
+
+// 进程累计读取的字节数 (read / sendfile / copy_file_range 等)，不支持时返回 0
+static uint64_t process_read_bytes(void)
+{
+    unsigned long long rchar = 0;
+#ifdef __linux__
+    FILE* f = fopen("/proc/self/io", "r");
+    char line[128];
+    while (f && fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "rchar: %llu", &rchar) == 1) break;
+    }
+    if (f) fclose(f);
+#endif
+    return (uint64_t)rchar;
+}
+
+static uint64_t g_readAtCopyEnd;
+
+// 拷贝进度到达 100% (完成收尾之前) 时记下进程读取量
+static void note_copy_end(int taskId, double percentage, double speedMbS)
+{
+    (void)taskId;
+    (void)speedMbS;
+    if (percentage >= 100.0 && g_readAtCopyEnd == 0) g_readAtCopyEnd = process_read_bytes();
+}
+
+// 明文任务：完整拷贝一次，再从一半处按流式缓存策略续传一次，两次输出都应与源文件逐字节一致。
+// 内核内拷贝完成后不再读回目标文件计算哈希，收尾阶段几乎没有读取；哈希在校验时补算
+static int check_plain_copy(const char* src)
+{
+    const char* dest = "test_plain.dat";
+    remove(dest);
+    TaskOptions options = {TASK_MODE_PLAIN, TASK_CACHE_DEFAULT};
+    int id = AddTaskWithOptions(src, dest, 1, &options);
+    TransferTask* t = GetTaskById(id);
+    static const uint8_t zero[TREEHASH_OUT_LEN] = {0};
+    uint8_t h[TREEHASH_OUT_LEN];
+    VerifyResult vr;
+    g_readAtCopyEnd = 0;
+    if (t) SetTaskCallbacks(id, note_copy_end, NULL);
+    int ok = t && t->mode == TASK_MODE_PLAIN && RunTask(t) == 0 && t->status == TASK_COMPLETED &&
+             t->currentOffset == t->totalSize && memcmp(t->destHash, zero, sizeof(zero)) == 0;
+    ok = ok && (g_readAtCopyEnd == 0 || process_read_bytes() - g_readAtCopyEnd < t->totalSize / 4);
+    ok = ok && VerifyTask(t, 0, &vr) == 0 && vr.match;
+    ok = ok && TreeHash_File(dest, 0, h) == 0 && memcmp(h, t->destHash, sizeof(h)) == 0;
+    remove(dest);
+    if (!ok) return -1;
+
+    // 预先写入前一半内容，模拟中断后的续传
+    uint64_t half = t->totalSize / 2;
+    copy_prefix(src, dest, half);
+
+    options.cachePolicy = TASK_CACHE_STREAM;
+    id = AddTaskWithOptions(src, dest, 1, &options);
+    t = GetTaskById(id);
+    ok = t != NULL;
+    if (ok) t->currentOffset = half;
+    ok = ok && RunTask(t) == 0 && t->status == TASK_COMPLETED && VerifyTask(t, 0, &vr) == 0 && vr.match;
+    remove(dest);
+    return ok ? 0 : -1;
+}
+
+typedef struct GroupJob
+{
+    TransferTask** tasks;
+    int count;
+    int result;
+    atomic_int finished;
+} GroupJob;
+
+static void run_group_thread(void* arg)
+{
+    GroupJob* job = (GroupJob*)arg;
+    job->result = RunTaskGroup(job->tasks, job->count);
+    atomic_store(&job->finished, 1);
+}
+
+// 扇出复制：一个全新目标、一个从中途 (非块边界) 续传的目标，以及一个无人读取的管道 (模拟卡住的慢目标)。
+// 慢目标应在容忍时间后被暂停，其余两个目标照常完成，CRC32 与目标哈希都与单独运行的任务一致
+static int check_fanout(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    const char* src = "test_fanout_src.dat";
+    const char* ref = "test_fanout_ref.dat";
+    const char* dests[3] = {"test_fanout_a.dat", "test_fanout_b.dat", "test_fanout_slow.fifo"};
+    remove(ref);
+    remove(dests[0]);
+    remove(dests[2]);
+    if (create_dummy_file(src, 12) != 0 || mkfifo(dests[2], 0600) != 0) return -1;
+
+    TransferTask* refTask = GetTaskById(AddTask(src, ref, 1));
+    int ok = refTask && RunTask(refTask) == 0 && refTask->status == TASK_COMPLETED;
+
+    uint64_t half = 6 * 1024 * 1024 + 12345;
+    uint8_t* prefix = (uint8_t*)malloc((size_t)half);
+    FILE* fp = fopen(src, "rb");
+    ok = ok && prefix && fp && fread(prefix, 1, (size_t)half, fp) == half;
+    if (fp) fclose(fp);
+    copy_prefix(ref, dests[1], half);
+
+    TransferTask* tasks[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        tasks[i] = GetTaskById(AddTask(src, dests[i], 1));
+        ok = ok && tasks[i];
+    }
+    if (ok)
+    {
+        tasks[1]->currentOffset = half;
+        tasks[1]->crc32 = Algorithm_CalculateCRC32(prefix, (size_t)half);
+    }
+    free(prefix);
+
+    GroupJob job = {tasks, 3, -1, 0};
+    atomic_init(&job.finished, 0);
+    Thread th;
+    TransferEngine_SetFanoutStallTimeout(200);
+    if (!ok || Thread_Create(&th, run_group_thread, &job) != 0)
+    {
+        remove(dests[2]);
+        return -1;
+    }
+
+    // 另外两个目标完成后才开始读取管道，让卡住的写入返回
+    TransferTask snap;
+    for (int i = 0; i < 2; ++i)
+    {
+        for (int waited = 0; waited < 60000; waited += 10)
+        {
+            if (TaskManager_SnapshotTask(tasks[i]->id, &snap) == 0 && snap.status == TASK_COMPLETED) break;
+            Thread_SleepMs(10);
+        }
+    }
+    int fd = open(dests[2], O_RDONLY | O_NONBLOCK);
+    char buf[65536];
+    while (!atomic_load(&job.finished))
+    {
+        if (fd < 0 || read(fd, buf, sizeof(buf)) <= 0) Thread_SleepMs(1);
+    }
+    Thread_Join(th);
+    if (fd >= 0) close(fd);
+    TransferEngine_SetFanoutStallTimeout(0);
+
+    VerifyResult vr;
+    for (int i = 0; i < 2; ++i)
+    {
+        ok = ok && tasks[i]->status == TASK_COMPLETED && tasks[i]->crc32 == refTask->crc32 &&
+             memcmp(tasks[i]->destHash, refTask->destHash, sizeof(refTask->destHash)) == 0 &&
+             VerifyTask(tasks[i], 0, &vr) == 0 && vr.match;
+    }
+    ok = ok && job.result == 0 && tasks[2]->status == TASK_PAUSED && tasks[2]->currentOffset < tasks[2]->totalSize;
+
+    remove(src);
+    remove(ref);
+    for (int i = 0; i < 3; ++i) remove(dests[i]);
+    return ok ? 0 : -1;
+#endif
+}
+
+typedef struct NetReceiveJob
+{
+    NetListener* listener;
+    const char* dest;
+    int result;
+} NetReceiveJob;
+
+static void net_receive_thread(void* arg)
+{
+    NetReceiveJob* job = (NetReceiveJob*)arg;
+    job->result = NetTransfer_Receive(job->listener, job->dest, NULL, NULL);
+}
+
+// 回环网络传输：4 条流、64KB 块，接收端重组的密文应能用引擎密钥解密还原
+static int check_net_transfer(const char* src)
+{
+#ifdef _WIN32
+    (void)src;
+    return 0;
+#else
+    NetReceiveJob job = {NetTransfer_Listen("127.0.0.1", 0), "test_net.dat", -1};
+    if (!job.listener) return -1;
+    remove(job.dest);
+
+    Thread th;
+    if (Thread_Create(&th, net_receive_thread, &job) != 0)
+    {
+        NetTransfer_Close(job.listener);
+        return -1;
+    }
+    int rc = NetTransfer_Send(src, "127.0.0.1", NetTransfer_ListenerPort(job.listener), 4, 64 * 1024, NULL, NULL);
+    Thread_Join(th);
+    NetTransfer_Close(job.listener);
+
+    CryptoContext ctx;
+    VerifyResult vr;
+    TransferEngine_InitCrypto(&ctx);
+    int ok = rc == ERR_SUCCESS && job.result == ERR_SUCCESS && Verify_Files(src, job.dest, &ctx, 0, &vr) == 0 &&
+             vr.match && !FileUtils_Exists("test_net.dat.stxstate");
+    remove(job.dest);
+    return ok ? 0 : -1;
+#endif
+}
+
+typedef struct PipeJob
+{
+    int fd;
+    uint8_t* data;
+    size_t size;
+    size_t done;
+    unsigned int delayMs; // 读端推迟开始读取的时间
+} PipeJob;
+
+#ifndef _WIN32
+// 以不规则的小块写入管道，模拟 pg_dump 之类的生产者
+static void pipe_writer(void* arg)
+{
+    PipeJob* job = (PipeJob*)arg;
+    while (job->done < job->size)
+    {
+        size_t n = job->size - job->done < 10007 ? job->size - job->done : 10007;
+        ssize_t w = write(job->fd, job->data + job->done, n);
+        if (w <= 0) break;
+        job->done += (size_t)w;
+    }
+    close(job->fd);
+}
+
+static void pipe_reader(void* arg)
+{
+    PipeJob* job = (PipeJob*)arg;
+    if (job->delayMs) Thread_SleepMs(job->delayMs);
+    for (;;)
+    {
+        ssize_t r = read(job->fd, job->data + job->done, job->size - job->done);
+        if (r <= 0) break;
+        job->done += (size_t)r;
+        if (job->done == job->size) break;
+    }
+}
+
+static void count_progress(uint64_t done, void* user)
+{
+    *(uint64_t*)user = done;
+}
+
+#ifdef __linux__
+typedef struct PipeRelay
+{
+    int from;
+    int to;
+} PipeRelay;
+
+// 像 pv 一样用 splice 把管道缓冲区原样转到下一个管道，不拷贝数据
+static void pipe_relay(void* arg)
+{
+    PipeRelay* relay = (PipeRelay*)arg;
+    while (splice(relay->from, NULL, relay->to, NULL, 64 * 1024, SPLICE_F_MOVE) > 0)
+    {
+    }
+    close(relay->to);
+}
+#endif
+
+// 管道 -> StreamTransfer -> 管道：输出应与按绝对偏移加密的结果一致 (明文模式原样)。
+// relay 为非零时输出先经 splice 转入第二个管道，读端延迟开始读取，
+// 数据在管道中停留期间 StreamTransfer 继续处理后面的数据，不能影响已写出的内容
+static int pipe_round_trip(const uint8_t* data, size_t size, int plain, int relay)
+{
+    int in[2], out[2];
+    if (pipe(in) != 0) return -1;
+    if (pipe(out) != 0)
+    {
+        close(in[0]);
+        close(in[1]);
+        return -1;
+    }
+    uint8_t* got = (uint8_t*)calloc(1, size + 1);
+    PipeJob writer = {in[1], (uint8_t*)data, size, 0, 0};
+    PipeJob reader = {out[0], got, size + 1, 0, 0};
+    Thread tw, tr;
+#ifdef __linux__
+    Thread trelay;
+    int mid[2] = {-1, -1};
+    PipeRelay pr;
+    if (relay && pipe(mid) == 0)
+    {
+        fcntl(mid[1], F_SETPIPE_SZ, 1024 * 1024);
+        pr.from = out[0];
+        pr.to = mid[1];
+        reader.fd = mid[0];
+        reader.delayMs = 200;
+        Thread_Create(&trelay, pipe_relay, &pr);
+    }
+    else
+    {
+        relay = 0;
+    }
+#else
+    relay = 0;
+#endif
+    Thread_Create(&tw, pipe_writer, &writer);
+    Thread_Create(&tr, pipe_reader, &reader);
+
+    uint64_t progress = 0, bytes = 0;
+    int rc = StreamTransfer_Run(in[0], out[1], plain, 64 * 1024, count_progress, &progress, &bytes);
+    close(out[1]);
+    Thread_Join(tw);
+    Thread_Join(tr);
+#ifdef __linux__
+    if (relay)
+    {
+        Thread_Join(trelay);
+        close(mid[0]);
+    }
+#endif
+    close(in[0]);
+    close(out[0]);
+
+    uint8_t* expect = (uint8_t*)malloc(size);
+    memcpy(expect, data, size);
+    if (!plain)
+    {
+        CryptoContext ctx;
+        TransferEngine_InitCrypto(&ctx);
+        EncryptBufferAt(&ctx, expect, size, 0);
+    }
+    int ok = rc == ERR_SUCCESS && bytes == size && progress == size && reader.done == size &&
+             memcmp(got, expect, size) == 0;
+    free(expect);
+    free(got);
+    return ok ? 0 : -1;
+}
+#endif
+
+// 测试数据用伪随机内容：测试源文件以 256 字节为周期，复用错的缓冲区也可能恰好得到相同的输出
+static int check_pipe_stream(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    const size_t size = 1024 * 1024 + 4321;
+    uint8_t* data = (uint8_t*)malloc(size);
+    if (!data) return -1;
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < size; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (uint8_t)x;
+    }
+    int ok = 1;
+    for (int relay = 0; relay < 2; ++relay)
+    {
+        ok = ok && pipe_round_trip(data, size, 0, relay) == 0 && pipe_round_trip(data, size, 1, relay) == 0;
+    }
+    free(data);
+    return ok ? 0 : -1;
+#endif
+}
+
+static int write_text(const char* path, const char* text)
+{
+    FILE* f = FileUtils_OpenFileUTF8(path, "wb");
+    if (!f) return -1;
+    fputs(text, f);
+    return fclose(f);
+}
+
+// 增量目录同步：首次全部传输，再次同步全部跳过；修改、新增、删除各一个文件后只处理这三个
+static int check_dir_sync(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    static const char* files[] = {"test_sync_src/a.txt", "test_sync_src/sub/b.txt", "test_sync_src/sub/deep/c.txt"};
+    mkdir("test_sync_src", 0755);
+    mkdir("test_sync_src/sub", 0755);
+    mkdir("test_sync_src/sub/deep", 0755);
+    for (int i = 0; i < 3; ++i)
+    {
+        if (write_text(files[i], files[i]) != 0) return -1;
+    }
+
+    DirSyncOptions options = {{TASK_MODE_ENCRYPT, TASK_CACHE_DEFAULT}, 4, 1, NULL};
+    DirSyncStats first, second, third;
+    int ok = DirSync_Run("test_sync_src", "test_sync_dst/", &options, NULL, NULL, &first) == ERR_SUCCESS &&
+             first.scanned == 3 && first.transferred == 3 && FileUtils_Exists("test_sync_dst/.stxindex") &&
+             DirSync_Run("test_sync_src", "test_sync_dst", &options, NULL, NULL, &second) == ERR_SUCCESS &&
+             second.unchanged == 3 && second.transferred == 0;
+
+    // 改变大小 (修改时间的精度可能不足以区分同一秒内的两次写入)
+    ok = ok && write_text(files[1], "changed contents") == 0 && write_text("test_sync_src/sub/new.txt", "new") == 0 &&
+         remove(files[2]) == 0;
+    ok = ok && DirSync_Run("test_sync_src", "test_sync_dst", &options, NULL, NULL, &third) == ERR_SUCCESS &&
+         third.scanned == 3 && third.unchanged == 1 && third.transferred == 2 && third.deleted == 1 &&
+         !FileUtils_Exists("test_sync_dst/sub/deep/c.txt");
+
+    CryptoContext ctx;
+    VerifyResult vr;
+    TransferEngine_InitCrypto(&ctx);
+    ok = ok && Verify_Files(files[1], "test_sync_dst/sub/b.txt", &ctx, 1, &vr) == 0 && vr.match;
+
+    // 传输失败 (目标位置被目录占用) 时保留旧的索引记录，源文件随后被删除时仍会删除目标副本
+    DirSyncStats fourth, fifth;
+    SyncIndex index;
+    ok = ok && write_text(files[0], "a changed") == 0 && remove("test_sync_dst/a.txt") == 0 &&
+         mkdir("test_sync_dst/a.txt", 0755) == 0;
+    ok = ok && DirSync_Run("test_sync_src", "test_sync_dst", &options, NULL, NULL, &fourth) == ERR_FILE_WRITE &&
+         fourth.failed == 1 && fourth.transferred == 0;
+    ok = ok && SyncIndex_Load("test_sync_dst/.stxindex", &index) == ERR_SUCCESS;
+    const SyncIndexEntry* kept = ok ? SyncIndex_Find(&index, "a.txt") : NULL;
+    ok = ok && kept && kept->size == strlen(files[0]);
+    SyncIndex_Free(&index);
+    ok = ok && rmdir("test_sync_dst/a.txt") == 0 && write_text("test_sync_dst/a.txt", "stale") == 0 &&
+         remove(files[0]) == 0;
+    ok = ok && DirSync_Run("test_sync_src", "test_sync_dst", &options, NULL, NULL, &fifth) == ERR_SUCCESS &&
+         fifth.deleted == 1 && !FileUtils_Exists("test_sync_dst/a.txt");
+
+    static const char* cleanup[] = {"test_sync_src/a.txt", "test_sync_src/sub/b.txt", "test_sync_src/sub/new.txt",
+                                    "test_sync_dst/a.txt", "test_sync_dst/sub/b.txt", "test_sync_dst/sub/new.txt",
+                                    "test_sync_dst/.stxindex"};
+    for (size_t i = 0; i < sizeof(cleanup) / sizeof(cleanup[0]); ++i) remove(cleanup[i]);
+    static const char* dirs[] = {"test_sync_src/sub/deep", "test_sync_src/sub", "test_sync_src",
+                                 "test_sync_dst/sub/deep", "test_sync_dst/sub", "test_sync_dst"};
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) rmdir(dirs[i]);
+    return ok ? 0 : -1;
+#endif
+}
+
+#ifndef _WIN32
+// 执行一条命令行，stdout 上的 NDJSON 事件写到 outPath
+static int run_cli_captured(int argc, char* argv[], const char* outPath)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int fd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (saved < 0 || fd < 0 || dup2(fd, STDOUT_FILENO) < 0)
+    {
+        if (saved >= 0) close(saved);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(fd);
+    int rc = Cli_Run(argc, argv);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    return rc;
+}
+
+// 统计同时包含 a 和 b 的输出行数
+static int count_lines(const char* path, const char* a, const char* b)
+{
+    FILE* f = FileUtils_OpenFileUTF8(path, "rb");
+    if (!f) return -1;
+    char line[4096];
+    int n = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strstr(line, a) && (!b || strstr(line, b))) n++;
+    }
+    fclose(f);
+    return n;
+}
+#endif
+
+// 命令行批处理：add 输出 added 事件；run 不带 ID 时运行所有未完成的任务，
+// 包括上次进程被中断时仍处于运行中的任务，每个任务输出 done 事件并以 summary 结尾。
+// 在独立的工作目录中运行，不受前面各步留下的任务影响
+static int check_cli_run(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    static const char* dataFiles[] = {"data/safetrix.db", "data/safetrix.db.journal", "data/safetrix.history",
+                                      "data/safetrix.slots"};
+    mkdir("test_cli", 0755);
+    if (chdir("test_cli") != 0) return -1;
+    for (size_t i = 0; i < sizeof(dataFiles) / sizeof(dataFiles[0]); ++i) remove(dataFiles[i]);
+
+    const char* out = "cli_out.ndjson";
+    char* addArgs[] = {"safetrix", "add", "../test_source.dat", "cli_a.dat", "cli_b.dat"};
+    int ok = run_cli_captured(5, addArgs, out) == CLI_EXIT_OK &&
+             count_lines(out, "\"event\":\"added\"", "\"status\":\"waiting\"") == 2;
+
+    // 模拟崩溃：把其中一个任务以运行中状态留在任务库里
+    InitTaskManager();
+    TransferTask* interrupted = NULL;
+    for (int i = 0; i < TaskManager_GetTaskCount(); ++i)
+    {
+        TransferTask* t = TaskManager_GetTaskAt(i);
+        if (t && strcmp(t->destPath, "cli_b.dat") == 0) interrupted = t;
+    }
+    if (interrupted)
+    {
+        interrupted->status = TASK_RUNNING;
+        TaskManager_UpdateTask(interrupted);
+    }
+    TaskManager_Shutdown();
+    ok = ok && interrupted && TaskManager_GetTaskCount() == 2;
+
+    char* runArgs[] = {"safetrix", "run", "--progress-ms", "0"};
+    ok = ok && run_cli_captured(4, runArgs, out) == CLI_EXIT_OK &&
+         count_lines(out, "\"event\":\"done\"", "\"status\":\"completed\"") == 2 &&
+         count_lines(out, "\"dest\":\"cli_b.dat\"", "\"status\":\"completed\"") == 1 &&
+         count_lines(out, "\"event\":\"summary\"", "\"tasks\":2,\"completed\":2,\"failed\":0") == 1;
+
+    CryptoContext ctx;
+    VerifyResult vr;
+    TransferEngine_InitCrypto(&ctx);
+    ok = ok && Verify_Files("../test_source.dat", "cli_b.dat", &ctx, 1, &vr) == 0 && vr.match;
+
+    char* missingArgs[] = {"safetrix", "run", "999999"};
+    ok = ok && run_cli_captured(3, missingArgs, out) == CLI_EXIT_NOT_FOUND;
+
+    static const char* cleanup[] = {"cli_out.ndjson", "cli_a.dat", "cli_b.dat"};
+    for (size_t i = 0; i < sizeof(cleanup) / sizeof(cleanup[0]); ++i) remove(cleanup[i]);
+    for (size_t i = 0; i < sizeof(dataFiles) / sizeof(dataFiles[0]); ++i) remove(dataFiles[i]);
+    rmdir("data");
+    ok = chdir("..") == 0 && ok;
+    rmdir("test_cli");
+
+    // Cli_Run 退出时关闭了任务库，恢复上层目录的任务库供后续步骤使用
+    InitTaskManager();
+    return ok ? 0 : -1;
+#endif
+}
+
+#ifdef __linux__
+typedef struct DaemonRun
+{
+    const char* socketPath;
+    int rc;
+} DaemonRun;
+
+static void daemon_thread(void* arg)
+{
+    DaemonRun* run = (DaemonRun*)arg;
+    run->rc = Daemon_Run(run->socketPath, 1);
+}
+
+// 测试用客户端：按行读取守护进程的输出
+typedef struct DaemonClient
+{
+    int fd;
+    char buf[8192];
+    size_t len;
+} DaemonClient;
+
+static int daemon_connect(DaemonClient* c, const char* path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    c->len = 0;
+    // 守护进程在另一个线程中启动，套接字就绪前重试
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        c->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (c->fd < 0) return -1;
+        if (connect(c->fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) return 0;
+        close(c->fd);
+        Thread_SleepMs(10);
+    }
+    c->fd = -1;
+    return -1;
+}
+
+static int daemon_send(DaemonClient* c, const char* line)
+{
+    size_t len = strlen(line);
+    return write(c->fd, line, len) == (ssize_t)len && write(c->fd, "\n", 1) == 1 ? 0 : -1;
+}
+
+// 读取下一行到 line (去掉换行)，10 秒内没有输出视为失败
+static int daemon_read_line(DaemonClient* c, char* line, size_t size)
+{
+    for (;;)
+    {
+        char* nl = memchr(c->buf, '\n', c->len);
+        if (nl)
+        {
+            size_t n = (size_t)(nl - c->buf);
+            if (n >= size) return -1;
+            memcpy(line, c->buf, n);
+            line[n] = '\0';
+            memmove(c->buf, nl + 1, c->len - n - 1);
+            c->len -= n + 1;
+            return 0;
+        }
+        struct pollfd pfd = {c->fd, POLLIN, 0};
+        if (c->len == sizeof(c->buf) || poll(&pfd, 1, 10000) <= 0) return -1;
+        ssize_t got = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+        if (got <= 0) return -1;
+        c->len += (size_t)got;
+    }
+}
+
+// 跳过其他输出 (如订阅后的 progress 事件)，直到读到同时包含 a 和 b 的一行
+static int daemon_expect(DaemonClient* c, const char* a, const char* b, char* line, size_t size)
+{
+    while (daemon_read_line(c, line, size) == 0)
+    {
+        if (strstr(line, a) && (!b || strstr(line, b))) return 0;
+    }
+    return -1;
+}
+
+static int daemon_add(DaemonClient* c, const char* src, const char* dest)
+{
+    char line[4096];
+    snprintf(line, sizeof(line), "add\t%s\t%s", src, dest);
+    int id = 0;
+    if (daemon_send(c, line) != 0 || daemon_expect(c, "\"ok\":true,\"id\":", NULL, line, sizeof(line)) != 0 ||
+        sscanf(strstr(line, "\"id\":"), "\"id\":%d", &id) != 1)
+    {
+        return -1;
+    }
+    char added[64];
+    snprintf(added, sizeof(added), "\"event\":\"added\",\"id\":%d,", id);
+    return daemon_expect(c, added, NULL, line, sizeof(line)) == 0 ? id : -1;
+}
+
+// 发送 pause / resume / cancel 等命令并检查回应 (回应之前可能夹着推送的事件)
+static int daemon_command(DaemonClient* c, const char* cmd, int id, const char* reply)
+{
+    char line[4096];
+    snprintf(line, sizeof(line), "%s %d", cmd, id);
+    return daemon_send(c, line) == 0 && daemon_expect(c, "{\"ok\":", NULL, line, sizeof(line)) == 0 &&
+                   strstr(line, reply)
+               ? 0
+               : -1;
+}
+
+// 用 list 轮询，直到任务进入给定状态
+static int daemon_wait_status(DaemonClient* c, int id, const char* status)
+{
+    char want[96];
+    char line[4096];
+    snprintf(want, sizeof(want), "\"id\":%d,\"status\":\"%s\"", id, status);
+    for (int attempt = 0; attempt < 200; ++attempt)
+    {
+        int found = 0;
+        if (daemon_send(c, "list") != 0) return -1;
+        while (daemon_read_line(c, line, sizeof(line)) == 0 && !strstr(line, "\"ok\":true,\"count\":"))
+        {
+            if (strstr(line, want)) found = 1;
+        }
+        if (found) return 0;
+        Thread_SleepMs(50);
+    }
+    return -1;
+}
+
+// 工作线程领取任务后、RunTask 打开源文件之前状态仍是等待中；
+// 对运行中的任务 resume 会被拒绝，以此确认任务已被工作线程领取 (排队中的任务回应 already queued)
+static int daemon_wait_running(DaemonClient* c, int id)
+{
+    for (int attempt = 0; attempt < 200; ++attempt)
+    {
+        if (daemon_command(c, "resume", id, "\"error\":\"task is running\"") == 0) return 0;
+        Thread_SleepMs(50);
+    }
+    return -1;
+}
+
+// 从 FIFO 读取的任务在 RunTask 打开源文件时阻塞，占住唯一的工作线程，后面提交的任务确定处于排队状态；
+// 打开写端再关闭即放行
+static void release_fifo(const char* path)
+{
+    int fd = open(path, O_WRONLY);
+    if (fd >= 0) close(fd);
+}
+#endif
+
+// 守护进程：在独立的工作目录中用一个工作线程运行，通过套接字提交、控制任务并订阅事件；
+// 崩溃时仍在运行的任务和退出时尚在排队的任务在下次启动时重新排队
+static int check_daemon(void)
+{
+#ifndef __linux__
+    return 0;
+#else
+    static const char* dataFiles[] = {"data/safetrix.db", "data/safetrix.db.journal", "data/safetrix.history",
+                                      "data/safetrix.slots"};
+    const char* sock = "dmn.sock";
+    const char* fifo = "dmn.fifo";
+    const char* src = "../test_source.dat";
+    mkdir("test_daemon", 0755);
+    if (chdir("test_daemon") != 0) return -1;
+    for (size_t i = 0; i < sizeof(dataFiles) / sizeof(dataFiles[0]); ++i) remove(dataFiles[i]);
+    remove(fifo);
+
+    // 模拟上次崩溃时留下的运行中任务
+    InitTaskManager();
+    int crashed = AddTask(src, "dmn_a.dat", 1);
+    TransferTask* t = crashed > 0 ? GetTaskById(crashed) : NULL;
+    if (t)
+    {
+        t->status = TASK_RUNNING;
+        TaskManager_UpdateTask(t);
+        TaskManager_Sync();
+    }
+    int ok = t && mkfifo(fifo, 0600) == 0;
+
+    DaemonRun run = {sock, -1};
+    Thread th;
+    DaemonClient c = {-1, {0}, 0};
+    char line[4096];
+    char want[96];
+    ok = ok && Thread_Create(&th, daemon_thread, &run) == 0;
+    int started = ok;
+    ok = ok && daemon_connect(&c, sock) == 0 && daemon_send(&c, "subscribe") == 0 &&
+         daemon_read_line(&c, line, sizeof(line)) == 0 && strcmp(line, "{\"ok\":true}") == 0;
+    ok = ok && daemon_wait_status(&c, crashed, "completed") == 0;
+
+    // 阻塞的任务运行时，后提交的任务留在队列中：暂停、继续、取消都直接生效
+    int blocker = ok ? daemon_add(&c, fifo, "dmn_fifo.dat") : -1;
+    int queued = blocker > 0 ? daemon_add(&c, src, "dmn_b.dat") : -1;
+    int dropped = queued > 0 ? daemon_add(&c, src, "dmn_c.dat") : -1;
+    ok = ok && dropped > 0 && daemon_wait_running(&c, blocker) == 0;
+    snprintf(want, sizeof(want), "{\"ok\":true,\"id\":%d}", queued);
+    ok = ok && daemon_command(&c, "pause", queued, want) == 0 &&
+         daemon_expect(&c, "\"event\":\"state\"", "\"status\":\"paused\"", line, sizeof(line)) == 0 &&
+         daemon_command(&c, "pause", queued, "\"error\":\"task is not queued or running\"") == 0 &&
+         daemon_command(&c, "resume", queued, want) == 0 &&
+         daemon_expect(&c, "\"event\":\"state\"", "\"status\":\"waiting\"", line, sizeof(line)) == 0 &&
+         daemon_command(&c, "resume", queued, "\"error\":\"task is already queued\"") == 0;
+    snprintf(want, sizeof(want), "{\"ok\":true,\"id\":%d}", dropped);
+    ok = ok && daemon_command(&c, "cancel", dropped, want) == 0 &&
+         daemon_expect(&c, "\"event\":\"state\"", "\"status\":\"error\"", line, sizeof(line)) == 0 &&
+         daemon_command(&c, "pause", 999999, "\"error\":\"task not found\"") == 0;
+
+    // 放行后阻塞的任务结束，排队的任务随即运行并推送 done 事件
+    if (started) release_fifo(fifo);
+    snprintf(want, sizeof(want), "\"event\":\"done\",\"id\":%d,", blocker);
+    ok = ok && daemon_expect(&c, want, NULL, line, sizeof(line)) == 0;
+    snprintf(want, sizeof(want), "\"event\":\"done\",\"id\":%d,", queued);
+    ok = ok && daemon_expect(&c, want, "\"status\":\"completed\"", line, sizeof(line)) == 0;
+
+    // 退出时仍在排队的任务保持等待状态
+    int blocker2 = ok ? daemon_add(&c, fifo, "dmn_fifo2.dat") : -1;
+    int pending = blocker2 > 0 ? daemon_add(&c, src, "dmn_d.dat") : -1;
+    ok = ok && pending > 0 && daemon_wait_running(&c, blocker2) == 0;
+    if (started)
+    {
+        // 守护进程的信号处理函数只唤醒事件循环；退出时等待工作线程，先放行阻塞的任务
+        raise(SIGTERM);
+        release_fifo(fifo);
+        Thread_Join(th);
+    }
+    if (c.fd >= 0) close(c.fd);
+    ok = ok && run.rc == 0;
+    remove(fifo);
+
+    // 重新加载后排队的任务仍为等待状态，再次启动时自动运行
+    TaskManager_Shutdown();
+    InitTaskManager();
+    t = pending > 0 ? GetTaskById(pending) : NULL;
+    ok = ok && t && t->status == TASK_WAITING;
+    run.rc = -1;
+    started = ok && Thread_Create(&th, daemon_thread, &run) == 0;
+    ok = started && daemon_connect(&c, sock) == 0 && daemon_wait_status(&c, pending, "completed") == 0;
+    if (started)
+    {
+        raise(SIGTERM);
+        Thread_Join(th);
+    }
+    if (c.fd >= 0) close(c.fd);
+    ok = ok && run.rc == 0;
+
+    CryptoContext ctx;
+    VerifyResult vr;
+    TransferEngine_InitCrypto(&ctx);
+    ok = ok && Verify_Files(src, "dmn_d.dat", &ctx, 1, &vr) == 0 && vr.match;
+
+    TaskManager_Shutdown();
+    static const char* cleanup[] = {"dmn_a.dat", "dmn_b.dat", "dmn_c.dat", "dmn_d.dat", "dmn_fifo.dat",
+                                    "dmn_fifo2.dat"};
+    for (size_t i = 0; i < sizeof(cleanup) / sizeof(cleanup[0]); ++i) remove(cleanup[i]);
+    for (size_t i = 0; i < sizeof(dataFiles) / sizeof(dataFiles[0]); ++i) remove(dataFiles[i]);
+    rmdir("data");
+    ok = chdir("..") == 0 && ok;
+    rmdir("test_daemon");
+    InitTaskManager();
+    return ok ? 0 : -1;
+#endif
+}
+
 int main(void)
 {
 #ifdef _WIN32
@@ -60,6 +1494,62 @@ int main(void)
 
     printf("=== SafeTrix 测试流程演示 ===\n");
 
+    printf("0) 校验分段加密接口 ... ");
+    if (check_cipher_v2() != 0)
+    {
+        printf("失败：v2 分段加密结果与流式加密不一致。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
+    printf("0) 校验 CRC32 (slicing-by-16 / 合并 / 多线程) ... ");
+    if (check_crc32() != 0)
+    {
+        printf("失败：CRC32 结果与参考实现不一致。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
+    printf("0) 校验树形哈希 (BLAKE3 / 多线程 / 增量) ... ");
+    if (check_tree_hash() != 0)
+    {
+        printf("失败：树形哈希结果不一致。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
+    printf("0) 校验任务数据库格式 (v2 / 字符串驻留 / 记录校验) ... ");
+    if (check_task_db() != 0)
+    {
+        printf("失败：保存后重新加载的任务不一致。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
+    printf("0) 校验槽位库 (mmap / 检查点 / 扩容) ... ");
+    if (check_slot_store() != 0)
+    {
+        printf("失败：重新打开后的任务状态不一致。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
+    printf("0) 校验缓冲池 (页对齐 / 线程缓存 / 跨线程复用) ... ");
+    if (check_buffer_pool() != 0)
+    {
+        printf("失败：缓冲区未对齐或未被复用。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
+    printf("0) 校验异步日志 (多线程写入 / 错误即时落盘) ... ");
+    if (check_async_logger() != 0)
+    {
+        printf("失败：日志记录丢失或乱序。\n");
+        return 1;
+    }
+    printf("通过。\n");
+
     // 初始化 TaskManager（会尝试从磁盘加载历史任务）
     InitTaskManager();
 
@@ -88,17 +1578,18 @@ int main(void)
     SetTaskCallbacks(id, test_on_progress, test_on_error);
 
     // 3) 查看任务列表
-    int count = 0;
-    TransferTask* list = GetTaskList(&count);
+    int count = TaskManager_GetTaskCount();
     printf("3) 当前任务数: %d\n", count);
     for (int i = 0; i < count; ++i)
     {
+        const TransferTask* t = TaskManager_GetTaskAt(i);
         printf("  ID=%d 状态=%d 进度=%llu/%llu 源=%s 目标=%s\n",
-               list[i].id, (int)list[i].status, list[i].currentOffset, list[i].totalSize,
-               list[i].srcPath, list[i].destPath);
+               t->id, (int)t->status, t->currentOffset, t->totalSize, t->srcPath, t->destPath);
     }
 
     // 4) 运行任务（阻塞调用 RunTask）
+    TransferTask done;
+    int archived = 0;
     TransferTask* task = GetTaskById(id);
     if (!task)
     {
@@ -109,7 +1600,13 @@ int main(void)
     printf("4) 启动任务 %d（阻塞运行，直到完成）...\n", id);
     // InitTransferEngine 若需要在 RunTask 前被调用，确保初始化
     InitTransferEngine();
-    int r = RunTask(task);
+    int r = -1, reads = 0;
+    if (run_with_snapshot_reader(task, &r, &reads) != 0)
+    {
+        printf("并发读取的任务快照不一致。\n");
+        return 1;
+    }
+    printf("传输期间读取快照 %d 次，均一致。\n", reads);
     if (r != 0)
     {
         printf("RunTask 返回错误: %d\n", r);
@@ -117,16 +1614,60 @@ int main(void)
     else
     {
         printf("任务 %d 运行完成。\n", id);
+
+        // 任务中保存的目标哈希应与重新计算的结果一致
+        uint8_t h[TREEHASH_OUT_LEN];
+        char hex[2 * TREEHASH_OUT_LEN + 1];
+        if (TreeHash_File(dest, 0, h) != 0 || memcmp(h, task->destHash, sizeof(h)) != 0)
+        {
+            printf("目标文件哈希与任务记录不一致。\n");
+            return 1;
+        }
+        TreeHash_ToHex(task->destHash, hex);
+        printf("目标文件哈希: %s\n", hex);
+
+        // 启用 trace 的构建中，传输各阶段应出现在导出的 Chrome trace 中
+        if (Trace_IsEnabled())
+        {
+            const char* tracePath = "test_trace.json";
+            FILE* ft = Trace_WriteChrome(tracePath) == 0 ? FileUtils_OpenFileUTF8(tracePath, "rb") : NULL;
+            char* json = ft ? (char*)calloc(1, (size_t)FileUtils_GetFileSize(tracePath) + 1) : NULL;
+            if (json) fread(json, 1, (size_t)FileUtils_GetFileSize(tracePath), ft);
+            if (ft) fclose(ft);
+            int traced = json && strstr(json, "\"RunTask.encrypt\"") && strstr(json, "\"RunTask.write\"") &&
+                         strstr(json, "\"traceEvents\"");
+            free(json);
+            remove(tracePath);
+            if (!traced)
+            {
+                printf("trace 导出缺少传输阶段。\n");
+                return 1;
+            }
+            printf("trace 导出校验通过。\n");
+        }
+
+        // 重新加载 (快照 + 日志重放) 后，已完成的任务应移入历史且状态与内存中一致
+        TransferTask before = *task;
+        InitTaskManager();
+        archived = TaskManager_FindHistory(id, &done) == ERR_SUCCESS;
+        if (GetTaskById(id) != NULL || !archived || done.status != before.status ||
+            done.currentOffset != before.currentOffset || done.crc32 != before.crc32 ||
+            memcmp(done.destHash, before.destHash, sizeof(h)) != 0)
+        {
+            printf("重新加载后任务状态与日志记录不一致。\n");
+            return 1;
+        }
+        printf("任务日志重放与归档校验通过 (历史任务数: %d)。\n", TaskManager_GetHistoryCount());
     }
 
     // 显示最终状态
-    list = GetTaskList(&count);
+    count = TaskManager_GetTaskCount();
     printf("最终任务列表 (%d):\n", count);
     for (int i = 0; i < count; ++i)
     {
+        const TransferTask* t = TaskManager_GetTaskAt(i);
         printf("  ID=%d 状态=%d 进度=%llu/%llu 源=%s 目标=%s\n",
-               list[i].id, (int)list[i].status, list[i].currentOffset, list[i].totalSize,
-               list[i].srcPath, list[i].destPath);
+               t->id, (int)t->status, t->currentOffset, t->totalSize, t->srcPath, t->destPath);
     }
 
     // 5) 解密（直接对密文做一次传输，使用相同的密钥 -> 应还原原始内容）
@@ -157,62 +1698,135 @@ int main(void)
             {
                 printf("解密完成，开始校验输出是否与原文件一致...\n");
 
-                // 比较文件内容
-                FILE* f1 = FileUtils_OpenFileUTF8(src, "rb");
-                FILE* f2 = FileUtils_OpenFileUTF8(recovered, "rb");
-                if (!f1 || !f2)
+                // 明文比较：还原文件与原始文件
+                VerifyResult vr;
+                int vrc = Verify_Files(src, recovered, NULL, 0, &vr);
+                if (vrc != 0)
+                {
+                    printf("校验出错，错误码: %d\n", vrc);
+                }
+                else if (vr.match)
                 {
-                    printf("无法打开文件进行比较。\n");
+                    printf("校验通过：解密后文件与原始文件一致。\n");
                 }
                 else
                 {
-                    // 获取大小
-                    fseek(f1, 0, SEEK_END);
-                    long s1 = ftell(f1);
-                    fseek(f1, 0, SEEK_SET);
-                    fseek(f2, 0, SEEK_END);
-                    long s2 = ftell(f2);
-                    fseek(f2, 0, SEEK_SET);
-                    if (s1 != s2)
-                    {
-                        printf("校验失败：大小不匹配，src=%ld, recovered=%ld\n", s1, s2);
-                    }
-                    else
-                    {
-                        int same = 1;
-                        const size_t bufSz = 4096;
-                        unsigned char* b1 = (unsigned char*)malloc(bufSz);
-                        unsigned char* b2 = (unsigned char*)malloc(bufSz);
-                        if (!b1 || !b2)
-                        {
-                            printf("内存分配失败，无法完成比较。\n");
-                            same = 0;
-                        }
-                        else
-                        {
-                            size_t rcount;
-                            while ((rcount = fread(b1, 1, bufSz, f1)) > 0)
-                            {
-                                size_t r2c = fread(b2, 1, bufSz, f2);
-                                if (r2c != rcount || memcmp(b1, b2, rcount) != 0)
-                                {
-                                    same = 0;
-                                    break;
-                                }
-                            }
-                        }
-                        if (b1) free(b1);
-                        if (b2) free(b2);
-                        if (same) printf("校验通过：解密后文件与原始文件一致。\n");
-                        else printf("校验失败：文件内容不同。\n");
-                    }
-                    fclose(f1);
-                    fclose(f2);
+                    printf("校验失败：文件内容不同，首个差异偏移 %llu (src=%llu, recovered=%llu)\n",
+                           (unsigned long long)vr.firstMismatch, (unsigned long long)vr.srcSize,
+                           (unsigned long long)vr.destSize);
                 }
+
+                // 解密比较：直接校验加密任务的输出
+                vrc = archived ? VerifyTask(&done, 0, &vr) : -1;
+                printf("加密输出校验: %s\n", (vrc == 0 && vr.match) ? "通过" : "失败");
+
+                // 篡改一个字节后应准确报告其偏移
+                const uint64_t tamperAt = 777777;
+                FILE* ft = FileUtils_OpenFileUTF8(recovered, "r+b");
+                if (ft && FileUtils_Seek(ft, tamperAt) == 0)
+                {
+                    int ch = fgetc(ft);
+                    FileUtils_Seek(ft, tamperAt);
+                    fputc(ch ^ 0x5A, ft);
+                }
+                if (ft) fclose(ft);
+                vrc = Verify_Files(src, recovered, NULL, 0, &vr);
+                printf("篡改检测: %s\n",
+                       (vrc == 0 && !vr.match && vr.firstMismatch == tamperAt) ? "通过" : "失败");
             }
         }
     }
 
+    printf("\n6) 并发运行 3 个任务 (仪表盘显示，1MB 块) ...\n");
+    TransferEngine_SetChunkSize(1024 * 1024);
+    int frames = 0;
+    if (check_concurrent_runs(src, &frames) != 0)
+    {
+        printf("并发任务结果校验失败。\n");
+        return 1;
+    }
+    printf("并发任务全部完成并通过校验 (仪表盘绘制 %d 帧)。\n", frames);
+
+    printf("\n7) 校验暂停 / 取消请求 / 续传哈希 ... ");
+    if (check_stop_requests(src) != 0 || check_resume_hash() != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n8) 回环网络传输 (4 条流) ... ");
+    if (check_net_transfer(src) != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n9) 明文快速拷贝与续传 ... ");
+    if (check_plain_copy(src) != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n10) 流式缓存策略 (逐窗口回写 / 丢弃页缓存) ... ");
+    if (check_stream_cache(src) != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n11) 扇出复制 (一次读取加密、三个目标、慢目标暂停) ... ");
+    if (check_fanout() != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n12) 管道流式加密 (不可定位的输入输出 / 明文 splice) ... ");
+    if (check_pipe_stream() != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n13) 增量目录同步 (索引 / 并行遍历 / 删除传播) ... ");
+    if (check_dir_sync() != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n14) 校验运行指标导出 ... ");
+    if (check_metrics(3 * FileUtils_GetFileSize(src)) != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n15) 命令行批处理 (add / run / 续跑中断的任务) ... ");
+    if (check_cli_run() != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
+    printf("\n16) 守护进程 (套接字命令 / 事件订阅 / 重启后重新排队) ... ");
+    if (check_daemon() != 0)
+    {
+        printf("失败\n");
+        return 1;
+    }
+    printf("通过\n");
+
     printf("测试结束。\n");
     return 0;
 }
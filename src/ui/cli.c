@@ -0,0 +1,968 @@
+﻿#include "ui/Cli.h"
+#include "core/TaskManager.h"
+#include "core/TransferEngine.h"
+#include "core/Metrics.h"
+#include "core/NetTransfer.h"
+#include "core/StreamTransfer.h"
+#include "core/DirSync.h"
+#include "ui/Daemon.h"
+#include "common/ErrorCode.h"
+#include "utils/BufferPool.h"
+#include "utils/FileUtils.h"
+#include "utils/Thread.h"
+#include "utils/TreeHash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#define CLI_MAX_JOBS 64
+#define CLI_MAX_DESTS 16 // add 一次最多指定的目标数
+#define CLI_LINE_MAX 4096
+#define CLI_DEFAULT_PROGRESS_MS 1000
+
+// 多个工作线程同时输出事件，每行在锁内一次写出，保证行不交错
+static Mutex g_out_lock;
+static FILE* g_out; // 事件输出；encrypt / decrypt 的 stdout 是数据流，事件改写到 stderr
+
+static void emit(const char* fmt, ...)
+{
+    char line[CLI_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if (n > (int)sizeof(line) - 2) n = (int)sizeof(line) - 2;
+    line[n++] = '\n';
+
+    Mutex_Lock(&g_out_lock);
+    fwrite(line, 1, (size_t)n, g_out);
+    fflush(g_out);
+    Mutex_Unlock(&g_out_lock);
+}
+
+// 将字符串转义为 JSON 字符串内容 (Windows 路径中的反斜杠等)
+static const char* json_escape(const char* in, char* out, size_t size)
+{
+    size_t o = 0;
+    for (const unsigned char* p = (const unsigned char*)in; *p && o + 7 < size; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            out[o++] = '\\';
+            out[o++] = (char)*p;
+        }
+        else if (*p < 0x20)
+        {
+            o += (size_t)snprintf(out + o, size - o, "\\u%04x", *p);
+        }
+        else
+        {
+            out[o++] = (char)*p;
+        }
+    }
+    out[o] = '\0';
+    return out;
+}
+
+static const char* status_name(TaskStatus status)
+{
+    switch (status)
+    {
+    case TASK_WAITING: return "waiting";
+    case TASK_RUNNING: return "running";
+    case TASK_PAUSED: return "paused";
+    case TASK_COMPLETED: return "completed";
+    case TASK_ERROR: return "error";
+    }
+    return "unknown";
+}
+
+int Cli_FormatTask(char* out, size_t size, const char* event, const TransferTask* t)
+{
+    char src[1024];
+    char dest[1024];
+    char hash[2 * TREEHASH_OUT_LEN + 1];
+    TreeHash_ToHex(t->destHash, hash);
+    int n = snprintf(out, size,
+                     "{\"event\":\"%s\",\"id\":%d,\"status\":\"%s\",\"offset\":%llu,\"total\":%llu,"
+                     "\"priority\":%d,\"mode\":\"%s\",\"cache\":\"%s\",\"crc32\":\"%08x\",\"hash\":\"%s\","
+                     "\"src\":\"%s\",\"dest\":\"%s\"}",
+                     event, t->id, status_name(t->status), (unsigned long long)t->currentOffset,
+                     (unsigned long long)t->totalSize, t->priority, t->mode == TASK_MODE_PLAIN ? "plain" : "encrypt",
+                     t->cachePolicy == TASK_CACHE_STREAM ? "stream" : "default", (unsigned int)t->crc32, hash,
+                     json_escape(t->srcPath, src, sizeof(src)), json_escape(t->destPath, dest, sizeof(dest)));
+    if (n < 0) return 0;
+    return n < (int)size ? n : (int)size - 1;
+}
+
+static void emit_task(const char* event, const TransferTask* t)
+{
+    char line[CLI_LINE_MAX];
+    Cli_FormatTask(line, sizeof(line), event, t);
+    emit("%s", line);
+}
+
+static void cli_error(int taskId, int errorCode, const char* msg)
+{
+    char text[512];
+    emit("{\"event\":\"error\",\"id\":%d,\"code\":%d,\"message\":\"%s\"}", taskId, errorCode,
+         json_escape(msg ? msg : "", text, sizeof(text)));
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "用法:\n"
+            "  safetrix add <src> <dest> [<dest>...] [--priority N] [--plain] [--cache default|stream]\n"
+            "  safetrix add --manifest FILE [--plain] [--cache default|stream]\n"
+            "  safetrix run [ID...] [--jobs N] [--chunk-size BYTES[K|M]] [--stream-window BYTES[K|M]] [--manifest FILE]\n"
+            "               [--progress-ms MS]\n"
+            "  safetrix status [ID...] [--history]\n"
+            "  safetrix verify <ID> [--threads N]\n"
+            "  safetrix daemon [--socket PATH] [--jobs N]\n"
+            "  safetrix send <src> <host[:port]> [--streams N] [--chunk-size BYTES] [--progress-ms MS]\n"
+            "  safetrix receive <dest> [--listen [HOST:]PORT] [--progress-ms MS]\n"
+            "  safetrix sync <srcDir> <destDir> [--jobs N] [--delete] [--index FILE] [--plain] [--cache default|stream]\n"
+            "  safetrix encrypt|decrypt [<src>|-] [<dest>|-] [--plain] [--buffer-size BYTES] [--progress-ms MS]\n"
+            "通用选项: --backend journal|mmap  --metrics-file PATH  --metrics-socket PATH  --huge-pages\n"
+            "清单文件每行一个任务: 源路径<TAB>目标路径[<TAB>优先级]，# 开头为注释\n"
+            "退出码: 0 成功, 1 任务失败/校验不一致, 2 参数错误, 3 任务不存在, 4 输入文件错误\n");
+}
+
+// 解析带 K/M/G 后缀的字节数
+static size_t parse_size(const char* text)
+{
+    char* end = NULL;
+    unsigned long long v = strtoull(text, &end, 10);
+    if (end && (*end == 'k' || *end == 'K')) v <<= 10;
+    else if (end && (*end == 'm' || *end == 'M')) v <<= 20;
+    else if (end && (*end == 'g' || *end == 'G')) v <<= 30;
+    return (size_t)v;
+}
+
+// 按清单添加任务，ids 由调用方 free；返回任务数，清单无法读取或任务创建失败时返回负数
+static int add_manifest(const char* path, const TaskOptions* options, int** outIds)
+{
+    *outIds = NULL;
+    FILE* fp = FileUtils_OpenFileUTF8(path, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "无法读取清单: %s\n", path);
+        return -1;
+    }
+
+    int count = 0;
+    int cap = 0;
+    int* ids = NULL;
+    char line[CLI_LINE_MAX];
+    int lineNo = 0;
+    int rc = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineNo++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        char* src = line;
+        char* dest = strchr(src, '\t');
+        if (!dest)
+        {
+            fprintf(stderr, "%s:%d: 缺少目标路径 (以 TAB 分隔)\n", path, lineNo);
+            rc = -1;
+            break;
+        }
+        *dest++ = '\0';
+        char* prio = strchr(dest, '\t');
+        if (prio) *prio++ = '\0';
+
+        int id = AddTaskWithOptions(src, dest, prio ? atoi(prio) : 1, options);
+        if (id <= 0)
+        {
+            fprintf(stderr, "%s:%d: 添加任务失败 (%d)\n", path, lineNo, id);
+            rc = -1;
+            break;
+        }
+        if (count == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            int* grown = (int*)realloc(ids, sizeof(int) * (size_t)cap);
+            if (!grown)
+            {
+                rc = -1;
+                break;
+            }
+            ids = grown;
+        }
+        ids[count++] = id;
+        emit_task("added", GetTaskById(id));
+    }
+    fclose(fp);
+
+    if (rc != 0)
+    {
+        free(ids);
+        return -1;
+    }
+    *outIds = ids;
+    return count;
+}
+
+static int parse_cache_policy(const char* text, TaskCachePolicy* out)
+{
+    if (strcmp(text, "stream") == 0) *out = TASK_CACHE_STREAM;
+    else if (strcmp(text, "default") == 0) *out = TASK_CACHE_DEFAULT;
+    else return -1;
+    return 0;
+}
+
+static int cmd_add(int argc, char* argv[])
+{
+    const char* manifest = NULL;
+    const char* pos[CLI_MAX_DESTS + 1] = {NULL};
+    int npos = 0;
+    int priority = 1;
+    TaskOptions options = {TASK_MODE_ENCRYPT, TASK_CACHE_DEFAULT};
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) manifest = argv[++i];
+        else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) priority = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--plain") == 0) options.mode = TASK_MODE_PLAIN;
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            if (parse_cache_policy(argv[++i], &options.cachePolicy) != 0) return CLI_EXIT_USAGE;
+        }
+        else if (argv[i][0] != '-' && npos < CLI_MAX_DESTS + 1) pos[npos++] = argv[i];
+        else return CLI_EXIT_USAGE;
+    }
+
+    if (manifest)
+    {
+        int* ids = NULL;
+        int count = add_manifest(manifest, &options, &ids);
+        free(ids);
+        return count < 0 ? CLI_EXIT_IO : CLI_EXIT_OK;
+    }
+    if (npos < 2) return CLI_EXIT_USAGE;
+
+    // 多个目标时每个目标一个任务；run 会把同源任务合并为一组，源文件只读取、加密一次
+    for (int i = 1; i < npos; ++i)
+    {
+        int id = AddTaskWithOptions(pos[0], pos[i], priority, &options);
+        if (id <= 0)
+        {
+            fprintf(stderr, "添加任务失败 (%d)\n", id);
+            return CLI_EXIT_IO;
+        }
+        emit_task("added", GetTaskById(id));
+    }
+    return CLI_EXIT_OK;
+}
+
+// run 子命令的工作队列：工作线程按下标领取一组同源任务
+typedef struct RunQueue
+{
+    const int* ids;
+    int count;
+    const int* groups; // 第 g 组为 ids[groups[g]] .. ids[groups[g + 1] - 1]
+    int groupCount;
+    atomic_int next;
+    atomic_int finished;
+    atomic_int failed;
+    atomic_uint_fast64_t bytes;
+} RunQueue;
+
+static void run_worker(void* arg)
+{
+    RunQueue* q = (RunQueue*)arg;
+    for (;;)
+    {
+        int g = atomic_fetch_add(&q->next, 1);
+        if (g >= q->groupCount) break;
+
+        int first = q->groups[g];
+        int n = q->groups[g + 1] - first;
+        TransferTask** tasks = (TransferTask**)malloc(sizeof(TransferTask*) * (size_t)n);
+        uint64_t* startOffsets = (uint64_t*)malloc(sizeof(uint64_t) * (size_t)n);
+        if (!tasks || !startOffsets)
+        {
+            free(tasks);
+            free(startOffsets);
+            atomic_fetch_add(&q->failed, n);
+            atomic_fetch_add(&q->finished, n);
+            continue;
+        }
+        for (int k = 0; k < n; ++k)
+        {
+            TransferTask* task = GetTaskById(q->ids[first + k]);
+            tasks[k] = task;
+            startOffsets[k] = task->currentOffset;
+            emit("{\"event\":\"start\",\"id\":%d,\"offset\":%llu,\"total\":%llu}", task->id,
+                 (unsigned long long)task->currentOffset, (unsigned long long)task->totalSize);
+        }
+
+        int rc = n == 1 ? RunTask(tasks[0]) : RunTaskGroup(tasks, n);
+        for (int k = 0; k < n; ++k)
+        {
+            TransferTask snap;
+            TaskManager_SnapshotTask(tasks[k]->id, &snap);
+            if ((n == 1 && rc != 0) || snap.status != TASK_COMPLETED) atomic_fetch_add(&q->failed, 1);
+            if (snap.currentOffset > startOffsets[k])
+            {
+                atomic_fetch_add(&q->bytes, snap.currentOffset - startOffsets[k]);
+            }
+            emit_task("done", &snap);
+            atomic_fetch_add(&q->finished, 1);
+        }
+        free(tasks);
+        free(startOffsets);
+    }
+}
+
+typedef struct RunEntry
+{
+    const TransferTask* task;
+    int order;
+} RunEntry;
+
+static int compare_source(const TransferTask* x, const TransferTask* y)
+{
+    int c = strcmp(x->srcPath, y->srcPath);
+    return c != 0 ? c : (x->mode > y->mode) - (x->mode < y->mode);
+}
+
+static int compare_run_entry(const void* a, const void* b)
+{
+    const RunEntry* x = (const RunEntry*)a;
+    const RunEntry* y = (const RunEntry*)b;
+    int c = compare_source(x->task, y->task);
+    return c != 0 ? c : (x->order > y->order) - (x->order < y->order);
+}
+
+// 将源文件与模式相同的任务排到一起并分组 (groups 需容纳 count + 1 项)，返回组数；
+// 同组任务由一个工作线程以扇出方式运行
+static int group_by_source(int* ids, int count, int* groups)
+{
+    RunEntry* entries = (RunEntry*)malloc(sizeof(RunEntry) * (size_t)(count + 1));
+    if (!entries) return -1;
+    for (int i = 0; i < count; ++i)
+    {
+        entries[i].task = GetTaskById(ids[i]);
+        entries[i].order = i;
+    }
+    qsort(entries, (size_t)count, sizeof(RunEntry), compare_run_entry);
+
+    int groupCount = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        ids[i] = entries[i].task->id;
+        if (i == 0 || compare_source(entries[i].task, entries[i - 1].task) != 0) groups[groupCount++] = i;
+    }
+    groups[groupCount] = count;
+    free(entries);
+    return groupCount;
+}
+
+static int compare_int(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// 同一任务不能被两个工作线程同时运行
+static int has_duplicates(const int* ids, int count)
+{
+    int* sorted = (int*)malloc(sizeof(int) * (size_t)(count + 1));
+    if (!sorted) return 1;
+    memcpy(sorted, ids, sizeof(int) * (size_t)count);
+    qsort(sorted, (size_t)count, sizeof(int), compare_int);
+    int dup = 0;
+    for (int i = 1; i < count && !dup; ++i) dup = sorted[i] == sorted[i - 1];
+    free(sorted);
+    return dup;
+}
+
+static int cmd_run(int argc, char* argv[])
+{
+    int jobs = Thread_GetCpuCount();
+    int progressMs = CLI_DEFAULT_PROGRESS_MS;
+    const char* manifest = NULL;
+    int* ids = (int*)malloc(sizeof(int) * (size_t)(argc + 1));
+    int count = 0;
+    if (!ids) return CLI_EXIT_IO;
+
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) TransferEngine_SetChunkSize(parse_size(argv[++i]));
+        else if (strcmp(argv[i], "--stream-window") == 0 && i + 1 < argc) TransferEngine_SetStreamWindow(parse_size(argv[++i]));
+        else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) manifest = argv[++i];
+        else if (strcmp(argv[i], "--progress-ms") == 0 && i + 1 < argc) progressMs = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && atoi(argv[i]) > 0) ids[count++] = atoi(argv[i]);
+        else
+        {
+            free(ids);
+            return CLI_EXIT_USAGE;
+        }
+    }
+
+    // 清单中的任务先加入任务库，再与命令行指定的 ID 一起运行
+    if (manifest)
+    {
+        int* added = NULL;
+        int n = add_manifest(manifest, NULL, &added);
+        int* grown = n > 0 ? (int*)realloc(ids, sizeof(int) * (size_t)(count + n + 1)) : ids;
+        if (n < 0 || !grown)
+        {
+            free(added);
+            free(ids);
+            return CLI_EXIT_IO;
+        }
+        ids = grown;
+        memcpy(ids + count, added, sizeof(int) * (size_t)n);
+        count += n;
+        free(added);
+    }
+    else if (count == 0)
+    {
+        // 未指定任务时运行所有等待中、已暂停的任务，以及上次进程崩溃或被中断时仍处于运行中的任务
+        // (与守护进程启动时重新排队的范围一致，见 Daemon_Run)
+        TransferTask* list = NULL;
+        int total = TaskManager_SnapshotAll(&list);
+        int* grown = total > 0 ? (int*)realloc(ids, sizeof(int) * (size_t)total) : ids;
+        if (grown) ids = grown;
+        for (int i = 0; grown && i < total; ++i)
+        {
+            TaskStatus st = list[i].status;
+            if (st == TASK_WAITING || st == TASK_PAUSED || st == TASK_RUNNING) ids[count++] = list[i].id;
+        }
+        free(list);
+    }
+
+    if (has_duplicates(ids, count))
+    {
+        fprintf(stderr, "任务 ID 重复\n");
+        free(ids);
+        return CLI_EXIT_USAGE;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        TransferTask* task = GetTaskById(ids[i]);
+        if (!task)
+        {
+            fprintf(stderr, "任务不存在: %d\n", ids[i]);
+            free(ids);
+            return CLI_EXIT_NOT_FOUND;
+        }
+        // 进度由本线程读取快照输出，不需要逐块回调
+        SetTaskCallbacks(task->id, NULL, cli_error);
+    }
+
+    int* groups = (int*)malloc(sizeof(int) * (size_t)(count + 1));
+    int groupCount = groups ? group_by_source(ids, count, groups) : -1;
+    if (groupCount < 0)
+    {
+        free(groups);
+        free(ids);
+        return CLI_EXIT_IO;
+    }
+
+    if (jobs < 1) jobs = 1;
+    if (jobs > CLI_MAX_JOBS) jobs = CLI_MAX_JOBS;
+    if (jobs > groupCount) jobs = groupCount > 0 ? groupCount : 1;
+
+    RunQueue q;
+    q.ids = ids;
+    q.count = count;
+    q.groups = groups;
+    q.groupCount = groupCount;
+    atomic_init(&q.next, 0);
+    atomic_init(&q.finished, 0);
+    atomic_init(&q.failed, 0);
+    atomic_init(&q.bytes, 0);
+
+    uint64_t t0 = Thread_NowNs();
+    Thread threads[CLI_MAX_JOBS];
+    int started = 0;
+    // 需要输出进度时当前线程只负责汇报，否则当前线程也作为一个工作线程
+    int workers = progressMs > 0 ? jobs : jobs - 1;
+    for (int i = 0; i < workers; ++i)
+    {
+        if (Thread_Create(&threads[started], run_worker, &q) == 0) started++;
+    }
+
+    if (started == 0 || progressMs <= 0)
+    {
+        run_worker(&q);
+    }
+    else
+    {
+        // 当前线程定期输出运行中任务的进度 (来自快照，与传输线程无锁竞争)
+        while (atomic_load(&q.finished) < count)
+        {
+            Thread_SleepMs((unsigned int)progressMs);
+            for (int i = 0; i < count; ++i)
+            {
+                TransferTask snap;
+                if (TaskManager_SnapshotTask(ids[i], &snap) == 0 && snap.status == TASK_RUNNING)
+                {
+                    emit("{\"event\":\"progress\",\"id\":%d,\"offset\":%llu,\"total\":%llu}", snap.id,
+                         (unsigned long long)snap.currentOffset, (unsigned long long)snap.totalSize);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < started; ++i) Thread_Join(threads[i]);
+
+    double seconds = (double)(Thread_NowNs() - t0) / 1e9;
+    unsigned long long bytes = (unsigned long long)atomic_load(&q.bytes);
+    int failed = atomic_load(&q.failed);
+    emit("{\"event\":\"summary\",\"tasks\":%d,\"completed\":%d,\"failed\":%d,\"jobs\":%d,\"bytes\":%llu,"
+         "\"seconds\":%.3f,\"mb_per_s\":%.2f}",
+         count, count - failed, failed, progressMs > 0 && started > 0 ? started : started + 1, bytes, seconds,
+         seconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / seconds : 0.0);
+
+    free(groups);
+    free(ids);
+    return failed > 0 ? CLI_EXIT_TASK_FAILED : CLI_EXIT_OK;
+}
+
+static int cmd_status(int argc, char* argv[])
+{
+    int history = 0;
+    int filtered = 0;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--history") == 0) history = 1;
+        else if (argv[i][0] != '-' && atoi(argv[i]) > 0) filtered = 1;
+        else return CLI_EXIT_USAGE;
+    }
+
+    if (filtered)
+    {
+        int rc = CLI_EXIT_OK;
+        for (int i = 0; i < argc; ++i)
+        {
+            int id = atoi(argv[i]);
+            if (id <= 0) continue;
+            TransferTask snap;
+            if (TaskManager_SnapshotTask(id, &snap) == 0) emit_task("task", &snap);
+            else if (TaskManager_FindHistory(id, &snap) == 0) emit_task("history", &snap);
+            else rc = CLI_EXIT_NOT_FOUND;
+        }
+        return rc;
+    }
+
+    TransferTask* list = NULL;
+    int count = TaskManager_SnapshotAll(&list);
+    for (int i = 0; i < count; ++i) emit_task("task", &list[i]);
+    free(list);
+
+    if (history)
+    {
+        int n = TaskManager_GetHistoryCount();
+        TransferTask done;
+        for (int i = 0; i < n; ++i)
+        {
+            if (TaskManager_GetHistoryAt(i, &done) == 0) emit_task("history", &done);
+        }
+    }
+    return CLI_EXIT_OK;
+}
+
+static int cmd_verify(int argc, char* argv[])
+{
+    int id = 0;
+    int threads = 0;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && id == 0) id = atoi(argv[i]);
+        else return CLI_EXIT_USAGE;
+    }
+    if (id <= 0) return CLI_EXIT_USAGE;
+
+    // 历史任务校验其副本 (补算的哈希不写回历史文件)
+    TransferTask archived;
+    TransferTask* task = GetTaskById(id);
+    if (!task && TaskManager_FindHistory(id, &archived) == 0) task = &archived;
+    if (!task)
+    {
+        fprintf(stderr, "任务不存在: %d\n", id);
+        return CLI_EXIT_NOT_FOUND;
+    }
+
+    VerifyResult vr;
+    uint64_t t0 = Thread_NowNs();
+    int rc = VerifyTask(task, threads, &vr);
+    double seconds = (double)(Thread_NowNs() - t0) / 1e9;
+    if (rc != ERR_SUCCESS)
+    {
+        emit("{\"event\":\"verify\",\"id\":%d,\"error\":%d}", id, rc);
+        return CLI_EXIT_TASK_FAILED;
+    }
+    char hash[2 * TREEHASH_OUT_LEN + 1];
+    TreeHash_ToHex(task->destHash, hash);
+    emit("{\"event\":\"verify\",\"id\":%d,\"match\":%s,\"src_size\":%llu,\"dest_size\":%llu,"
+         "\"first_mismatch\":%llu,\"hash\":\"%s\",\"seconds\":%.3f}",
+         id, vr.match ? "true" : "false", (unsigned long long)vr.srcSize, (unsigned long long)vr.destSize,
+         (unsigned long long)vr.firstMismatch, hash, seconds);
+    return vr.match ? CLI_EXIT_OK : CLI_EXIT_TASK_FAILED;
+}
+
+static int cmd_daemon(int argc, char* argv[])
+{
+    const char* socketPath = DAEMON_DEFAULT_SOCKET;
+    int jobs = Thread_GetCpuCount();
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) socketPath = argv[++i];
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else return CLI_EXIT_USAGE;
+    }
+    return Daemon_Run(socketPath, jobs) == 0 ? CLI_EXIT_OK : CLI_EXIT_IO;
+}
+
+// 网络传输的进度输出：各流线程都会回调，按时间间隔节流
+typedef struct NetReport
+{
+    atomic_uint_fast64_t lastNs;
+    uint64_t intervalNs;
+    atomic_uint_fast64_t resumed; // 第一次回调的进度，即续传跳过的字节
+    atomic_uint_fast64_t done;
+    atomic_uint_fast64_t total;
+} NetReport;
+
+static void net_report_init(NetReport* r, int progressMs)
+{
+    atomic_init(&r->lastNs, 0);
+    r->intervalNs = progressMs > 0 ? (uint64_t)progressMs * 1000000ull : 0;
+    atomic_init(&r->resumed, UINT64_MAX);
+    atomic_init(&r->done, 0);
+    atomic_init(&r->total, 0);
+}
+
+static void net_progress(uint64_t done, uint64_t total, void* user)
+{
+    NetReport* r = (NetReport*)user;
+    uint_fast64_t unset = UINT64_MAX;
+    atomic_compare_exchange_strong(&r->resumed, &unset, done);
+    uint_fast64_t seen = atomic_load(&r->done);
+    while (done > seen && !atomic_compare_exchange_weak(&r->done, &seen, done))
+    {
+    }
+    atomic_store(&r->total, total);
+
+    uint64_t now = Thread_NowNs();
+    uint_fast64_t last = atomic_load(&r->lastNs);
+    if (r->intervalNs == 0 || (now - last < r->intervalNs && done < total)) return;
+    if (!atomic_compare_exchange_strong(&r->lastNs, &last, now)) return;
+    emit("{\"event\":\"progress\",\"offset\":%llu,\"total\":%llu}", (unsigned long long)done,
+         (unsigned long long)total);
+}
+
+// 解析 host:port / [v6]:port / :port；没有端口时保留 *port
+static void parse_endpoint(const char* text, char* host, size_t size, int* port)
+{
+    const char* colon = strrchr(text, ':');
+    if (text[0] == '[')
+    {
+        const char* end = strchr(text, ']');
+        colon = end && end[1] == ':' ? end + 1 : NULL;
+        text++;
+        if (!end) end = text + strlen(text);
+        snprintf(host, size, "%.*s", (int)(end - text), text);
+    }
+    else
+    {
+        snprintf(host, size, "%.*s", colon ? (int)(colon - text) : (int)strlen(text), text);
+    }
+    if (colon) *port = atoi(colon + 1);
+}
+
+static int net_exit_code(int rc)
+{
+    if (rc == ERR_SUCCESS) return CLI_EXIT_OK;
+    return rc == ERR_FILE_OPEN ? CLI_EXIT_IO : CLI_EXIT_TASK_FAILED;
+}
+
+// bytes 为本次实际传输的字节，不含续传跳过的部分
+static void emit_net_summary(const char* event, const char* path, int rc, uint64_t t0, NetReport* r)
+{
+    char escaped[1024];
+    double seconds = (double)(Thread_NowNs() - t0) / 1e9;
+    uint64_t resumed = atomic_load(&r->resumed);
+    if (resumed == UINT64_MAX) resumed = 0;
+    uint64_t bytes = atomic_load(&r->done) - resumed;
+    emit("{\"event\":\"%s\",\"code\":%d,\"bytes\":%llu,\"resumed\":%llu,\"total\":%llu,\"seconds\":%.3f,"
+         "\"mb_per_s\":%.2f,\"path\":\"%s\"}",
+         event, rc, (unsigned long long)bytes, (unsigned long long)resumed, (unsigned long long)atomic_load(&r->total), seconds,
+         seconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / seconds : 0.0, json_escape(path, escaped, sizeof(escaped)));
+}
+
+static int cmd_send(int argc, char* argv[])
+{
+    const char* pos[2] = {NULL, NULL};
+    int npos = 0;
+    int streams = NET_DEFAULT_STREAMS;
+    size_t chunkSize = NET_DEFAULT_CHUNK;
+    int progressMs = CLI_DEFAULT_PROGRESS_MS;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) streams = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) chunkSize = parse_size(argv[++i]);
+        else if (strcmp(argv[i], "--progress-ms") == 0 && i + 1 < argc) progressMs = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && npos < 2) pos[npos++] = argv[i];
+        else return CLI_EXIT_USAGE;
+    }
+    if (npos != 2) return CLI_EXIT_USAGE;
+
+    char host[256];
+    int port = NET_DEFAULT_PORT;
+    parse_endpoint(pos[1], host, sizeof(host), &port);
+    NetReport report;
+    net_report_init(&report, progressMs);
+
+    uint64_t t0 = Thread_NowNs();
+    int rc = NetTransfer_Send(pos[0], host, port, streams, chunkSize, net_progress, &report);
+    emit_net_summary("sent", pos[0], rc, t0, &report);
+    return net_exit_code(rc);
+}
+
+static int cmd_receive(int argc, char* argv[])
+{
+    const char* dest = NULL;
+    const char* listen = NULL;
+    int progressMs = CLI_DEFAULT_PROGRESS_MS;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--listen") == 0 && i + 1 < argc) listen = argv[++i];
+        else if (strcmp(argv[i], "--progress-ms") == 0 && i + 1 < argc) progressMs = atoi(argv[++i]);
+        else if (argv[i][0] != '-' && !dest) dest = argv[i];
+        else return CLI_EXIT_USAGE;
+    }
+    if (!dest) return CLI_EXIT_USAGE;
+
+    char host[256] = "";
+    int port = NET_DEFAULT_PORT;
+    if (listen) parse_endpoint(listen, host, sizeof(host), &port);
+    NetListener* listener = NetTransfer_Listen(host[0] ? host : NULL, port);
+    if (!listener)
+    {
+        fprintf(stderr, "无法监听端口 %d\n", port);
+        return CLI_EXIT_IO;
+    }
+    emit("{\"event\":\"listening\",\"port\":%d}", NetTransfer_ListenerPort(listener));
+
+    NetReport report;
+    net_report_init(&report, progressMs);
+    uint64_t t0 = Thread_NowNs();
+    int rc = NetTransfer_Receive(listener, dest, net_progress, &report);
+    NetTransfer_Close(listener);
+    emit_net_summary("received", dest, rc, t0, &report);
+    return net_exit_code(rc);
+}
+
+static void sync_file_event(const char* event, const char* relPath, int taskId, void* user)
+{
+    (void)user;
+    char escaped[1024];
+    emit("{\"event\":\"%s\",\"id\":%d,\"path\":\"%s\"}", event, taskId,
+         json_escape(relPath, escaped, sizeof(escaped)));
+}
+
+static int cmd_sync(int argc, char* argv[])
+{
+    const char* pos[2] = {NULL, NULL};
+    int npos = 0;
+    DirSyncOptions options = {{TASK_MODE_ENCRYPT, TASK_CACHE_DEFAULT}, 0, 0, NULL};
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) options.jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--delete") == 0) options.deleteRemoved = 1;
+        else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) options.indexPath = argv[++i];
+        else if (strcmp(argv[i], "--plain") == 0) options.task.mode = TASK_MODE_PLAIN;
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            if (parse_cache_policy(argv[++i], &options.task.cachePolicy) != 0) return CLI_EXIT_USAGE;
+        }
+        else if (argv[i][0] != '-' && npos < 2) pos[npos++] = argv[i];
+        else return CLI_EXIT_USAGE;
+    }
+    if (npos != 2) return CLI_EXIT_USAGE;
+    if (options.jobs > CLI_MAX_JOBS) options.jobs = CLI_MAX_JOBS;
+
+    DirSyncStats stats;
+    uint64_t t0 = Thread_NowNs();
+    int rc = DirSync_Run(pos[0], pos[1], &options, sync_file_event, NULL, &stats);
+    emit("{\"event\":\"synced\",\"code\":%d,\"scanned\":%llu,\"unchanged\":%llu,\"transferred\":%llu,"
+         "\"deleted\":%llu,\"failed\":%llu,\"bytes\":%llu,\"seconds\":%.3f}",
+         rc, (unsigned long long)stats.scanned, (unsigned long long)stats.unchanged,
+         (unsigned long long)stats.transferred, (unsigned long long)stats.deleted, (unsigned long long)stats.failed,
+         (unsigned long long)stats.bytes, (double)(Thread_NowNs() - t0) / 1e9);
+    if (rc == ERR_FILE_OPEN) return CLI_EXIT_IO;
+    return rc == ERR_SUCCESS ? CLI_EXIT_OK : CLI_EXIT_TASK_FAILED;
+}
+
+typedef struct StreamReport
+{
+    uint64_t t0;
+    uint64_t lastNs;
+    uint64_t intervalNs;
+} StreamReport;
+
+static double stream_rate(uint64_t bytes, uint64_t t0)
+{
+    double seconds = (double)(Thread_NowNs() - t0) / 1e9;
+    return seconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+// 流的总大小未知，进度只有已处理的字节数与平均速度
+static void stream_progress(uint64_t done, void* user)
+{
+    StreamReport* r = (StreamReport*)user;
+    uint64_t now = Thread_NowNs();
+    if (r->intervalNs == 0 || now - r->lastNs < r->intervalNs) return;
+    r->lastNs = now;
+    emit("{\"event\":\"progress\",\"offset\":%llu,\"mb_per_s\":%.2f}", (unsigned long long)done,
+         stream_rate(done, r->t0));
+}
+
+// 打开流的一端，"-" 表示 stdin / stdout；失败返回 -1
+static int open_stream(const char* path, int output, FILE** fp)
+{
+    *fp = NULL;
+    if (strcmp(path, "-") == 0)
+    {
+        FILE* std = output ? stdout : stdin;
+#ifdef _WIN32
+        _setmode(_fileno(std), _O_BINARY);
+#endif
+        return fileno(std);
+    }
+    *fp = FileUtils_OpenFileUTF8(path, output ? "wb" : "rb");
+    return *fp ? fileno(*fp) : -1;
+}
+
+// encrypt 与 decrypt 是同一操作 (加密算法对称)，分成两个子命令只是让脚本读起来清楚
+static int cmd_stream(int argc, char* argv[])
+{
+    const char* pos[2] = {"-", "-"};
+    int npos = 0;
+    int plain = 0;
+    size_t bufferSize = 0;
+    int progressMs = CLI_DEFAULT_PROGRESS_MS;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--plain") == 0) plain = 1;
+        else if (strcmp(argv[i], "--buffer-size") == 0 && i + 1 < argc) bufferSize = parse_size(argv[++i]);
+        else if (strcmp(argv[i], "--progress-ms") == 0 && i + 1 < argc) progressMs = atoi(argv[++i]);
+        else if ((argv[i][0] != '-' || strcmp(argv[i], "-") == 0) && npos < 2) pos[npos++] = argv[i];
+        else return CLI_EXIT_USAGE;
+    }
+
+    g_out = stderr;
+    FILE* inFp;
+    FILE* outFp = NULL;
+    int inFd = open_stream(pos[0], 0, &inFp);
+    int outFd = inFd >= 0 ? open_stream(pos[1], 1, &outFp) : -1;
+    if (inFd < 0 || outFd < 0)
+    {
+        fprintf(stderr, "无法打开 %s\n", inFd < 0 ? pos[0] : pos[1]);
+        if (inFp) fclose(inFp);
+        return CLI_EXIT_IO;
+    }
+
+    StreamReport report;
+    report.t0 = Thread_NowNs();
+    report.lastNs = report.t0;
+    report.intervalNs = progressMs > 0 ? (uint64_t)progressMs * 1000000ull : 0;
+    uint64_t bytes = 0;
+    int rc = StreamTransfer_Run(inFd, outFd, plain, bufferSize, stream_progress, &report, &bytes);
+    if (inFp) fclose(inFp);
+    if (outFp && fclose(outFp) != 0 && rc == ERR_SUCCESS) rc = ERR_FILE_WRITE;
+
+    emit("{\"event\":\"streamed\",\"code\":%d,\"bytes\":%llu,\"seconds\":%.3f,\"mb_per_s\":%.2f,\"mode\":\"%s\"}",
+         rc, (unsigned long long)bytes, (double)(Thread_NowNs() - report.t0) / 1e9, stream_rate(bytes, report.t0),
+         plain ? "plain" : "encrypt");
+    return rc == ERR_SUCCESS ? CLI_EXIT_OK : CLI_EXIT_TASK_FAILED;
+}
+
+int Cli_Run(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        usage();
+        return CLI_EXIT_USAGE;
+    }
+
+    // 先取出通用选项，其余参数交给子命令
+    char** rest = (char**)malloc(sizeof(char*) * (size_t)argc);
+    int nrest = 0;
+    const char* metricsFile = NULL;
+    const char* metricsSocket = NULL;
+    if (!rest) return CLI_EXIT_IO;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc) metricsFile = argv[++i];
+        else if (strcmp(argv[i], "--metrics-socket") == 0 && i + 1 < argc) metricsSocket = argv[++i];
+        else if (strcmp(argv[i], "--huge-pages") == 0) BufferPool_SetHugePages(1);
+        else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc)
+        {
+            const char* name = argv[++i];
+            if (strcmp(name, "mmap") == 0) TaskManager_SetBackend(TASK_BACKEND_MMAP);
+            else if (strcmp(name, "journal") == 0) TaskManager_SetBackend(TASK_BACKEND_JOURNAL);
+            else
+            {
+                free(rest);
+                usage();
+                return CLI_EXIT_USAGE;
+            }
+        }
+        else
+        {
+            rest[nrest++] = argv[i];
+        }
+    }
+
+    typedef int (*CommandFunc)(int argc, char* argv[]);
+    CommandFunc cmd = NULL;
+    if (strcmp(argv[1], "add") == 0) cmd = cmd_add;
+    else if (strcmp(argv[1], "run") == 0) cmd = cmd_run;
+    else if (strcmp(argv[1], "status") == 0) cmd = cmd_status;
+    else if (strcmp(argv[1], "verify") == 0) cmd = cmd_verify;
+    else if (strcmp(argv[1], "daemon") == 0) cmd = cmd_daemon;
+    else if (strcmp(argv[1], "send") == 0) cmd = cmd_send;
+    else if (strcmp(argv[1], "receive") == 0) cmd = cmd_receive;
+    else if (strcmp(argv[1], "sync") == 0) cmd = cmd_sync;
+    else if (strcmp(argv[1], "encrypt") == 0 || strcmp(argv[1], "decrypt") == 0) cmd = cmd_stream;
+    if (!cmd)
+    {
+        free(rest);
+        usage();
+        return CLI_EXIT_USAGE;
+    }
+
+    Mutex_Init(&g_out_lock);
+    g_out = stdout;
+    InitTaskManager();
+    InitTransferEngine();
+    int metrics = (metricsFile || metricsSocket) && Metrics_Start(metricsFile, metricsSocket, 1000) == 0;
+
+    int rc = cmd(nrest, rest);
+    if (rc == CLI_EXIT_USAGE) usage();
+
+    if (metrics) Metrics_Stop();
+    TaskManager_Shutdown();
+    Mutex_Destroy(&g_out_lock);
+    free(rest);
+    return rc;
+}
@@ -0,0 +1,734 @@
+﻿#include "ui/Daemon.h"
+#include "ui/Cli.h"
+#include "core/TaskManager.h"
+#include "core/TransferEngine.h"
+#include "common/ErrorCode.h"
+#include "data/Logger.h"
+#include "utils/Thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define DAEMON_LINE_MAX 4096
+#define DAEMON_MAX_JOBS 64
+#define DAEMON_MAX_EVENTS 64
+#define DAEMON_PROGRESS_MS 500
+#define DAEMON_OUT_LIMIT (8 * 1024 * 1024) // 客户端不读取、积压超过此值时断开
+
+typedef struct Client
+{
+    int fd;
+    char in[DAEMON_LINE_MAX];
+    size_t inLen;
+    char* out;
+    size_t outLen;
+    size_t outCap;
+    int subscribed;
+    int closing;   // 对端已关闭写端：写完积压后关闭
+    int dead;      // 出错，立即关闭
+    unsigned int events; // 当前在 epoll 中注册的事件
+    struct Client* prev;
+    struct Client* next;
+} Client;
+
+typedef struct Daemon Daemon;
+
+typedef struct Worker
+{
+    Daemon* daemon;
+    int slot;
+} Worker;
+
+struct Daemon
+{
+    int epfd;
+    int listenFd;
+    int wakeFd;   // 工作线程完成任务后通知事件循环
+    int signalFd; // SIGINT / SIGTERM 经信号处理函数写入的 eventfd
+    Client* clients;
+
+    // 以下由 lock 保护
+    Mutex lock;
+    CondVar ready;
+    TransferTask** queue; // 等待调度的任务，按提交顺序
+    int queueCount;
+    int queueCap;
+    int running[DAEMON_MAX_JOBS]; // 每个工作线程正在运行的任务 ID，0 表示空闲
+    int* finished;                // 已结束、尚未通知订阅者的任务 ID
+    int finishedCount;
+    int finishedCap;
+    int stopping;
+
+    int jobs;
+    Thread threads[DAEMON_MAX_JOBS];
+    Worker workers[DAEMON_MAX_JOBS];
+};
+
+static int g_signal_fd = -1;
+
+// 信号可能投递到任意线程 (日志、指标线程在守护进程启动前就已创建)，处理函数只做异步信号安全的 write
+static void on_signal(int sig)
+{
+    (void)sig;
+    uint64_t one = 1;
+    ssize_t rc = write(g_signal_fd, &one, sizeof(one));
+    (void)rc;
+}
+
+// ---------------------------------------------------------------- 调度
+
+static int push_id(int** list, int* count, int* cap, int id)
+{
+    if (*count == *cap)
+    {
+        int grown = *cap ? *cap * 2 : 64;
+        int* p = (int*)realloc(*list, sizeof(int) * (size_t)grown);
+        if (!p) return ERR_MEMORY;
+        *list = p;
+        *cap = grown;
+    }
+    (*list)[(*count)++] = id;
+    return ERR_SUCCESS;
+}
+
+// 调用方持有 lock
+static int enqueue_locked(Daemon* d, TransferTask* task)
+{
+    if (d->queueCount == d->queueCap)
+    {
+        int cap = d->queueCap ? d->queueCap * 2 : 64;
+        TransferTask** q = (TransferTask**)realloc(d->queue, sizeof(TransferTask*) * (size_t)cap);
+        if (!q) return ERR_MEMORY;
+        d->queue = q;
+        d->queueCap = cap;
+    }
+    d->queue[d->queueCount++] = task;
+    CondVar_Signal(&d->ready);
+    return ERR_SUCCESS;
+}
+
+static int enqueue(Daemon* d, TransferTask* task)
+{
+    Mutex_Lock(&d->lock);
+    int rc = enqueue_locked(d, task);
+    Mutex_Unlock(&d->lock);
+    return rc;
+}
+
+// 从队列中移除第 i 个任务，保持其余任务的提交顺序
+static TransferTask* remove_at(Daemon* d, int i)
+{
+    TransferTask* task = d->queue[i];
+    memmove(&d->queue[i], &d->queue[i + 1], sizeof(TransferTask*) * (size_t)(d->queueCount - i - 1));
+    d->queueCount--;
+    return task;
+}
+
+static int find_queued(const Daemon* d, int id)
+{
+    for (int i = 0; i < d->queueCount; ++i)
+    {
+        if (d->queue[i]->id == id) return i;
+    }
+    return -1;
+}
+
+static int is_running(const Daemon* d, int id)
+{
+    for (int i = 0; i < d->jobs; ++i)
+    {
+        if (d->running[i] == id) return 1;
+    }
+    return 0;
+}
+
+static void worker_main(void* arg)
+{
+    Worker* w = (Worker*)arg;
+    Daemon* d = w->daemon;
+    for (;;)
+    {
+        Mutex_Lock(&d->lock);
+        while (!d->stopping && d->queueCount == 0) CondVar_Wait(&d->ready, &d->lock);
+        if (d->stopping)
+        {
+            Mutex_Unlock(&d->lock);
+            break;
+        }
+        // 优先级数值大的先运行，同优先级按提交顺序
+        int best = 0;
+        for (int i = 1; i < d->queueCount; ++i)
+        {
+            if (d->queue[i]->priority > d->queue[best]->priority) best = i;
+        }
+        TransferTask* task = remove_at(d, best);
+        d->running[w->slot] = task->id;
+        Mutex_Unlock(&d->lock);
+
+        if (RunTask(task) != 0 && task->status != TASK_ERROR)
+        {
+            // 打开、定位失败时 RunTask 不修改状态；置为异常，避免看起来仍在排队
+            task->status = TASK_ERROR;
+            TaskManager_UpdateTask(task);
+            TaskManager_Sync();
+        }
+        TaskManager_TakeStopRequest(task); // 丢弃任务结束后才到达的停止请求
+
+        Mutex_Lock(&d->lock);
+        d->running[w->slot] = 0;
+        push_id(&d->finished, &d->finishedCount, &d->finishedCap, task->id);
+        Mutex_Unlock(&d->lock);
+
+        uint64_t one = 1;
+        if (write(d->wakeFd, &one, sizeof(one)) < 0)
+        {
+            Logger_Log(LOG_WARNING, "守护进程: 无法唤醒事件循环");
+        }
+    }
+}
+
+// ---------------------------------------------------------------- 客户端输出
+
+static void client_write(Client* c, const char* data, size_t len)
+{
+    if (c->dead) return;
+    if (c->outLen + len + 1 > DAEMON_OUT_LIMIT)
+    {
+        c->dead = 1;
+        return;
+    }
+    if (c->outLen + len + 1 > c->outCap)
+    {
+        size_t cap = c->outCap ? c->outCap : 4096;
+        while (cap < c->outLen + len + 1) cap *= 2;
+        char* out = (char*)realloc(c->out, cap);
+        if (!out)
+        {
+            c->dead = 1;
+            return;
+        }
+        c->out = out;
+        c->outCap = cap;
+    }
+    memcpy(c->out + c->outLen, data, len);
+    c->outLen += len;
+    c->out[c->outLen++] = '\n';
+}
+
+static void client_printf(Client* c, const char* fmt, ...)
+{
+    char line[DAEMON_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    client_write(c, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+}
+
+static void client_error(Client* c, const char* msg)
+{
+    client_printf(c, "{\"ok\":false,\"error\":\"%s\"}", msg);
+}
+
+// 向所有订阅者推送任务事件
+static void broadcast_task(Daemon* d, const char* event, int id)
+{
+    TransferTask snap;
+    if (TaskManager_SnapshotTask(id, &snap) != ERR_SUCCESS) return;
+    char line[DAEMON_LINE_MAX];
+    int n = Cli_FormatTask(line, sizeof(line), event, &snap);
+    for (Client* c = d->clients; c; c = c->next)
+    {
+        if (c->subscribed) client_write(c, line, (size_t)n);
+    }
+}
+
+static int has_subscribers(const Daemon* d)
+{
+    for (const Client* c = d->clients; c; c = c->next)
+    {
+        if (c->subscribed) return 1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------- 命令
+
+static void cmd_add(Daemon* d, Client* c, char* args)
+{
+    char* src = args;
+    char* dest = strchr(src, '\t');
+    if (!dest || src == dest)
+    {
+        client_error(c, "usage: add<TAB>src<TAB>dest[<TAB>priority]");
+        return;
+    }
+    *dest++ = '\0';
+    char* prio = strchr(dest, '\t');
+    if (prio) *prio++ = '\0';
+
+    int id = AddTask(src, dest, prio ? atoi(prio) : 1);
+    TransferTask* task = id > 0 ? GetTaskById(id) : NULL;
+    if (!task)
+    {
+        client_printf(c, "{\"ok\":false,\"error\":\"cannot add task\",\"code\":%d}", id);
+        return;
+    }
+    if (enqueue(d, task) != ERR_SUCCESS)
+    {
+        client_error(c, "out of memory");
+        return;
+    }
+    client_printf(c, "{\"ok\":true,\"id\":%d}", id);
+    broadcast_task(d, "added", id);
+}
+
+static void cmd_list(Client* c)
+{
+    TransferTask* list = NULL;
+    int count = TaskManager_SnapshotAll(&list);
+    if (count < 0)
+    {
+        client_error(c, "out of memory");
+        return;
+    }
+    char line[DAEMON_LINE_MAX];
+    for (int i = 0; i < count; ++i)
+    {
+        int n = Cli_FormatTask(line, sizeof(line), "task", &list[i]);
+        client_write(c, line, (size_t)n);
+    }
+    free(list);
+    client_printf(c, "{\"ok\":true,\"count\":%d}", count);
+}
+
+typedef enum
+{
+    CONTROL_PAUSE,
+    CONTROL_RESUME,
+    CONTROL_CANCEL
+} ControlOp;
+
+// 暂停 / 继续 / 取消：运行中的任务交给传输线程在下一个块前处理，排队中的任务直接修改状态
+static void cmd_control(Daemon* d, Client* c, ControlOp op, int id)
+{
+    TransferTask* task = GetTaskById(id);
+    if (!task)
+    {
+        client_error(c, "task not found");
+        return;
+    }
+
+    Mutex_Lock(&d->lock);
+    if (is_running(d, id))
+    {
+        Mutex_Unlock(&d->lock);
+        if (op == CONTROL_RESUME)
+        {
+            client_error(c, "task is running");
+            return;
+        }
+        TaskManager_RequestStop(id, op == CONTROL_PAUSE ? TASK_STOP_PAUSE : TASK_STOP_CANCEL);
+        client_printf(c, "{\"ok\":true,\"id\":%d,\"pending\":true}", id); // 结束时推送 done 事件
+        return;
+    }
+
+    int queued = find_queued(d, id);
+    const char* error = NULL;
+    TaskStatus status = task->status;
+    switch (op)
+    {
+    case CONTROL_PAUSE:
+        if (queued < 0) error = "task is not queued or running";
+        else status = TASK_PAUSED;
+        break;
+    case CONTROL_CANCEL:
+        if (task->status == TASK_COMPLETED) error = "task is already completed";
+        else status = TASK_ERROR;
+        break;
+    case CONTROL_RESUME:
+        if (queued >= 0) error = "task is already queued";
+        else if (task->status == TASK_COMPLETED) error = "task is already completed";
+        else if (enqueue_locked(d, task) != ERR_SUCCESS) error = "out of memory";
+        else status = TASK_WAITING;
+        break;
+    }
+    if (!error && op != CONTROL_RESUME && queued >= 0) remove_at(d, queued);
+    // 任务不在运行也不在 (或已移出) 队列时归事件循环所有，可以直接修改；
+    // 继续的任务已重新入队，须在释放锁之前改回等待状态
+    if (!error)
+    {
+        task->status = status;
+        TaskManager_UpdateTask(task);
+    }
+    Mutex_Unlock(&d->lock);
+
+    if (error)
+    {
+        client_error(c, error);
+        return;
+    }
+    TaskManager_Sync();
+    client_printf(c, "{\"ok\":true,\"id\":%d}", id);
+    broadcast_task(d, "state", id);
+}
+
+static void handle_line(Daemon* d, Client* c, char* line)
+{
+    line[strcspn(line, "\r")] = '\0';
+    if (line[0] == '\0') return;
+
+    char* args = line + strcspn(line, " \t");
+    if (*args) *args++ = '\0';
+
+    if (strcmp(line, "add") == 0) cmd_add(d, c, args);
+    else if (strcmp(line, "list") == 0) cmd_list(c);
+    else if (strcmp(line, "pause") == 0) cmd_control(d, c, CONTROL_PAUSE, atoi(args));
+    else if (strcmp(line, "resume") == 0) cmd_control(d, c, CONTROL_RESUME, atoi(args));
+    else if (strcmp(line, "cancel") == 0) cmd_control(d, c, CONTROL_CANCEL, atoi(args));
+    else if (strcmp(line, "subscribe") == 0)
+    {
+        c->subscribed = 1;
+        client_printf(c, "{\"ok\":true}");
+    }
+    else client_error(c, "unknown command");
+}
+
+// ---------------------------------------------------------------- 事件循环
+
+static void client_close(Daemon* d, Client* c)
+{
+    epoll_ctl(d->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->prev) c->prev->next = c->next;
+    else d->clients = c->next;
+    if (c->next) c->next->prev = c->prev;
+    free(c->out);
+    free(c);
+}
+
+static void client_accept(Daemon* d)
+{
+    for (;;)
+    {
+        int fd = accept(d->listenFd, NULL, NULL);
+        if (fd < 0) return; // EAGAIN：已接受完所有排队的连接
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        Client* c = (Client*)calloc(1, sizeof(Client));
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (!c || epoll_ctl(d->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        c->next = d->clients;
+        if (d->clients) d->clients->prev = c;
+        d->clients = c;
+    }
+}
+
+static void client_read(Daemon* d, Client* c)
+{
+    for (;;)
+    {
+        ssize_t n = recv(c->fd, c->in + c->inLen, sizeof(c->in) - c->inLen, 0);
+        if (n == 0)
+        {
+            c->closing = 1;
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) c->dead = 1;
+            return;
+        }
+        c->inLen += (size_t)n;
+
+        // 逐行处理，剩余的半行留到下次
+        size_t start = 0;
+        for (size_t i = 0; i < c->inLen; ++i)
+        {
+            if (c->in[i] != '\n') continue;
+            c->in[i] = '\0';
+            handle_line(d, c, c->in + start);
+            start = i + 1;
+        }
+        memmove(c->in, c->in + start, c->inLen - start);
+        c->inLen -= start;
+        if (c->inLen == sizeof(c->in))
+        {
+            client_error(c, "line too long");
+            c->closing = 1;
+            return;
+        }
+    }
+}
+
+// 尽量写出积压；写不完时注册 EPOLLOUT，等可写再继续
+static void client_flush(Daemon* d, Client* c)
+{
+    size_t off = 0;
+    while (!c->dead && off < c->outLen)
+    {
+        ssize_t n = send(c->fd, c->out + off, c->outLen - off, MSG_NOSIGNAL);
+        if (n > 0) off += (size_t)n;
+        else if (n < 0 && errno == EINTR) continue;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        else c->dead = 1;
+    }
+    memmove(c->out, c->out + off, c->outLen - off);
+    c->outLen -= off;
+
+    // 对端关闭写端后不再关注可读，否则电平触发会不停报告 EOF
+    unsigned int events = (c->closing ? 0u : (unsigned int)EPOLLIN) | (c->outLen > 0 ? (unsigned int)EPOLLOUT : 0u);
+    if (!c->dead && events != c->events)
+    {
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.ptr = c;
+        epoll_ctl(d->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->events = events;
+    }
+}
+
+static void notify_finished(Daemon* d)
+{
+    uint64_t value;
+    if (read(d->wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) return;
+
+    Mutex_Lock(&d->lock);
+    int* ids = d->finished;
+    int count = d->finishedCount;
+    d->finished = NULL;
+    d->finishedCount = 0;
+    d->finishedCap = 0;
+    Mutex_Unlock(&d->lock);
+
+    for (int i = 0; i < count; ++i) broadcast_task(d, "done", ids[i]);
+    free(ids);
+}
+
+static void publish_progress(Daemon* d)
+{
+    int ids[DAEMON_MAX_JOBS];
+    Mutex_Lock(&d->lock);
+    memcpy(ids, d->running, sizeof(int) * (size_t)d->jobs);
+    Mutex_Unlock(&d->lock);
+
+    for (int i = 0; i < d->jobs; ++i)
+    {
+        if (ids[i] > 0) broadcast_task(d, "progress", ids[i]);
+    }
+}
+
+static int open_listener(const char* path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || chmod(path, 0600) != 0 || listen(fd, 64) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int watch(int epfd, int fd, void* tag)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = tag;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void event_loop(Daemon* d)
+{
+    struct epoll_event events[DAEMON_MAX_EVENTS];
+    uint64_t nextTick = Thread_NowNs();
+    int running = 1;
+    while (running)
+    {
+        uint64_t now = Thread_NowNs();
+        int timeout = nextTick > now ? (int)((nextTick - now) / 1000000ull) : 0;
+        int n = epoll_wait(d->epfd, events, DAEMON_MAX_EVENTS, timeout);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; ++i)
+        {
+            void* tag = events[i].data.ptr;
+            if (tag == &d->listenFd) client_accept(d);
+            else if (tag == &d->wakeFd) notify_finished(d);
+            else if (tag == &d->signalFd) running = 0;
+            else
+            {
+                Client* c = (Client*)tag;
+                if (!c->closing && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) client_read(d, c);
+            }
+        }
+
+        now = Thread_NowNs();
+        if (now >= nextTick)
+        {
+            if (has_subscribers(d)) publish_progress(d);
+            nextTick = now + DAEMON_PROGRESS_MS * 1000000ull;
+        }
+
+        for (Client* c = d->clients, *next; c; c = next)
+        {
+            next = c->next;
+            client_flush(d, c);
+            if (c->dead || (c->closing && c->outLen == 0)) client_close(d, c);
+        }
+    }
+}
+
+static void stop_workers(Daemon* d)
+{
+    int ids[DAEMON_MAX_JOBS];
+    Mutex_Lock(&d->lock);
+    d->stopping = 1;
+    CondVar_Broadcast(&d->ready);
+    memcpy(ids, d->running, sizeof(int) * (size_t)d->jobs);
+    Mutex_Unlock(&d->lock);
+
+    // 运行中的任务先暂停以保存进度，退出前再改回等待，下次启动时继续
+    for (int i = 0; i < d->jobs; ++i)
+    {
+        if (ids[i] > 0) TaskManager_RequestStop(ids[i], TASK_STOP_PAUSE);
+    }
+    for (int i = 0; i < d->jobs; ++i) Thread_Join(d->threads[i]);
+    for (int i = 0; i < d->jobs; ++i)
+    {
+        TransferTask* task = ids[i] > 0 ? GetTaskById(ids[i]) : NULL;
+        if (task && task->status == TASK_PAUSED)
+        {
+            task->status = TASK_WAITING;
+            TaskManager_UpdateTask(task);
+        }
+    }
+    TaskManager_Sync();
+}
+
+int Daemon_Run(const char* socketPath, int jobs)
+{
+    if (!socketPath) socketPath = DAEMON_DEFAULT_SOCKET;
+    if (jobs < 1) jobs = 1;
+    if (jobs > DAEMON_MAX_JOBS) jobs = DAEMON_MAX_JOBS;
+
+    Daemon* d = (Daemon*)calloc(1, sizeof(Daemon));
+    if (!d) return -1;
+    d->jobs = jobs;
+    Mutex_Init(&d->lock);
+    CondVar_Init(&d->ready);
+
+    d->listenFd = open_listener(socketPath);
+    d->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    d->signalFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    d->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    // 收到 SIGINT / SIGTERM 时唤醒事件循环，保存进度后正常退出
+    struct sigaction sa;
+    struct sigaction oldInt;
+    struct sigaction oldTerm;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sa.sa_flags = SA_RESTART; // 工作线程中被打断的读写自动重启，不会被当作 I/O 错误
+    sigemptyset(&sa.sa_mask);
+    g_signal_fd = d->signalFd;
+    sigaction(SIGINT, &sa, &oldInt);
+    sigaction(SIGTERM, &sa, &oldTerm);
+
+    int rc = -1;
+    if (d->listenFd < 0 || d->wakeFd < 0 || d->signalFd < 0 || d->epfd < 0 ||
+        watch(d->epfd, d->listenFd, &d->listenFd) != 0 || watch(d->epfd, d->wakeFd, &d->wakeFd) != 0 ||
+        watch(d->epfd, d->signalFd, &d->signalFd) != 0)
+    {
+        fprintf(stderr, "无法监听守护进程套接字: %s\n", socketPath);
+        goto cleanup;
+    }
+
+    // 上次未完成的任务重新排队；暂停的任务等待 resume
+    for (int i = 0; i < TaskManager_GetTaskCount(); ++i)
+    {
+        TransferTask* task = TaskManager_GetTaskAt(i);
+        if (task && (task->status == TASK_WAITING || task->status == TASK_RUNNING)) enqueue(d, task);
+    }
+
+    int started = 0;
+    for (int i = 0; i < jobs; ++i)
+    {
+        d->workers[started].daemon = d;
+        d->workers[started].slot = started;
+        if (Thread_Create(&d->threads[started], worker_main, &d->workers[started]) == 0) started++;
+    }
+    d->jobs = started;
+    if (started == 0) goto cleanup;
+
+    Logger_Log(LOG_INFO, "守护进程已启动: %s (%d 个工作线程，%d 个任务排队)", socketPath, started, d->queueCount);
+    fprintf(stderr, "守护进程已启动: %s\n", socketPath);
+    event_loop(d);
+    stop_workers(d);
+    Logger_Log(LOG_INFO, "守护进程已停止");
+    rc = 0;
+
+cleanup:
+    while (d->clients) client_close(d, d->clients);
+    if (d->epfd >= 0) close(d->epfd);
+    if (d->signalFd >= 0) close(d->signalFd);
+    if (d->wakeFd >= 0) close(d->wakeFd);
+    if (d->listenFd >= 0)
+    {
+        close(d->listenFd);
+        unlink(socketPath);
+    }
+    sigaction(SIGINT, &oldInt, NULL);
+    sigaction(SIGTERM, &oldTerm, NULL);
+    g_signal_fd = -1;
+    CondVar_Destroy(&d->ready);
+    Mutex_Destroy(&d->lock);
+    free(d->queue);
+    free(d->finished);
+    free(d);
+    return rc;
+}
+
+#else // !__linux__
+
+int Daemon_Run(const char* socketPath, int jobs)
+{
+    (void)socketPath;
+    (void)jobs;
+    fprintf(stderr, "守护进程模式需要 Linux (epoll)\n");
+    return -1;
+}
+
+#endif // __linux__
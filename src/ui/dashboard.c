@@ -0,0 +1,269 @@
+﻿#include "ui/Dashboard.h"
+#include "ui/ProgressBar.h"
+#include "core/TaskManager.h"
+#include "utils/Thread.h"
+#include "utils/Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#endif
+
+#define DASH_BAR_WIDTH 30
+#define DASH_NAME_BYTES 28
+#define DASH_LINE_MAX 512
+#define DASH_SPEED_ALPHA 0.3 // 速度的指数平滑系数，避免数字跳动
+
+typedef struct DashboardRow
+{
+    int id;
+    uint64_t lastOffset;
+    uint64_t lastNs;
+    double speed; // 字节/秒
+    int primed;
+} DashboardRow;
+
+struct Dashboard
+{
+    Thread thread;
+    Mutex lock;
+    CondVar wake;
+    int stopping;
+    int fps;
+    int count;
+    DashboardRow* rows;
+    int linesDrawn; // 上一帧输出的行数，下一帧先将光标上移这么多行
+    char* frame;
+    size_t frameCap;
+    size_t frameLen;
+    int frames;
+};
+
+static void frame_append(Dashboard* d, const char* fmt, ...)
+{
+    if (d->frameLen >= d->frameCap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(d->frame + d->frameLen, d->frameCap - d->frameLen, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    d->frameLen += (size_t)n < d->frameCap - d->frameLen ? (size_t)n : d->frameCap - d->frameLen - 1;
+}
+
+static const char* status_text(TaskStatus status)
+{
+    switch (status)
+    {
+    case TASK_WAITING: return "等待中";
+    case TASK_RUNNING: return "运行中";
+    case TASK_PAUSED: return "已暂停";
+    case TASK_COMPLETED: return "已完成";
+    case TASK_ERROR: return "异常";
+    }
+    return "未知";
+}
+
+// 取路径中的文件名并截断到 DASH_NAME_BYTES 字节，不截断 UTF-8 多字节字符
+static void short_name(const char* path, char* out)
+{
+    const char* name = path;
+    for (const char* p = path; *p; ++p)
+    {
+        if (*p == '/' || *p == '\\') name = p + 1;
+    }
+    size_t len = strlen(name);
+    if (len > DASH_NAME_BYTES)
+    {
+        len = DASH_NAME_BYTES;
+        while (len > 0 && ((unsigned char)name[len] & 0xC0) == 0x80) len--;
+    }
+    memcpy(out, name, len);
+    out[len] = '\0';
+}
+
+static void format_speed(double bytesPerSec, char* out, size_t size)
+{
+    if (bytesPerSec >= 1024.0 * 1024.0 * 1024.0) snprintf(out, size, "%7.2f GB/s", bytesPerSec / (1024.0 * 1024.0 * 1024.0));
+    else if (bytesPerSec >= 1024.0 * 1024.0) snprintf(out, size, "%7.2f MB/s", bytesPerSec / (1024.0 * 1024.0));
+    else snprintf(out, size, "%7.2f KB/s", bytesPerSec / 1024.0);
+}
+
+static void format_eta(uint64_t remaining, double bytesPerSec, char* out, size_t size)
+{
+    if (remaining == 0)
+    {
+        snprintf(out, size, "00:00");
+        return;
+    }
+    if (bytesPerSec < 1.0)
+    {
+        snprintf(out, size, "--:--");
+        return;
+    }
+    unsigned long long secs = (unsigned long long)((double)remaining / bytesPerSec);
+    if (secs >= 3600) snprintf(out, size, "%llu:%02llu:%02llu", secs / 3600, secs / 60 % 60, secs % 60);
+    else snprintf(out, size, "%02llu:%02llu", secs / 60, secs % 60);
+}
+
+static void render_row(Dashboard* d, DashboardRow* row, uint64_t now)
+{
+    TransferTask t;
+    if (TaskManager_SnapshotTask(row->id, &t) != 0)
+    {
+        frame_append(d, "\r\x1b[2K%4d  (任务不存在)\n", row->id);
+        return;
+    }
+
+    // 按两帧之间的偏移增量估算速度
+    if (row->primed && now > row->lastNs && t.currentOffset >= row->lastOffset)
+    {
+        double inst = (double)(t.currentOffset - row->lastOffset) * 1e9 / (double)(now - row->lastNs);
+        row->speed = row->primed > 1 ? DASH_SPEED_ALPHA * inst + (1.0 - DASH_SPEED_ALPHA) * row->speed : inst;
+        row->primed = 2;
+    }
+    else if (!row->primed)
+    {
+        row->primed = 1;
+    }
+    row->lastOffset = t.currentOffset;
+    row->lastNs = now;
+    if (t.status != TASK_RUNNING) row->speed = 0.0;
+
+    ProgressBar bar;
+    ProgressBar_Init(&bar, t.id, DASH_BAR_WIDTH);
+    ProgressBar_Update(&bar, t.totalSize > 0 ? (float)((double)t.currentOffset * 100.0 / (double)t.totalSize)
+                                             : (t.status == TASK_COMPLETED ? 100.0f : 0.0f));
+
+    char barText[DASH_LINE_MAX];
+    char speed[32];
+    char eta[32];
+    char name[DASH_NAME_BYTES + 1];
+    ProgressBar_Format(&bar, barText, sizeof(barText));
+    format_speed(row->speed, speed, sizeof(speed));
+    format_eta(t.totalSize > t.currentOffset ? t.totalSize - t.currentOffset : 0, row->speed, eta, sizeof(eta));
+    short_name(t.srcPath, name);
+
+    // \r\x1b[2K：回到行首并清除整行，再写新内容
+    frame_append(d, "\r\x1b[2K%4d %s %s  ETA %-8s %s  %s\n", t.id, barText, speed, eta, status_text(t.status),
+                 name);
+}
+
+static void render_frame(Dashboard* d)
+{
+    TRACE_BEGIN(span, "Dashboard.frame");
+    d->frameLen = 0;
+    if (d->linesDrawn > 0)
+    {
+        frame_append(d, "\x1b[%dA", d->linesDrawn); // 光标上移到上一帧的起点
+    }
+
+    uint64_t now = Thread_NowNs();
+    frame_append(d, "\r\x1b[2K  ID 进度%*s 速度           剩余     状态    文件\n", DASH_BAR_WIDTH + 5, "");
+    for (int i = 0; i < d->count; ++i)
+    {
+        render_row(d, &d->rows[i], now);
+    }
+    d->linesDrawn = d->count + 1;
+
+    fwrite(d->frame, 1, d->frameLen, stdout);
+    fflush(stdout);
+    d->frames++;
+    TRACE_END(span);
+}
+
+static void dashboard_thread(void* arg)
+{
+    Dashboard* d = (Dashboard*)arg;
+    Trace_SetThreadName("dashboard");
+    const uint64_t period = 1000000000ull / (uint64_t)d->fps;
+    uint64_t next = Thread_NowNs();
+
+    Mutex_Lock(&d->lock);
+    while (!d->stopping)
+    {
+        Mutex_Unlock(&d->lock);
+        render_frame(d);
+
+        // 固定帧率：按绝对时刻排期，绘制耗时不会累积成漂移；落后太多则直接跳到当前时刻
+        next += period;
+        uint64_t now = Thread_NowNs();
+        if (next < now) next = now;
+        Mutex_Lock(&d->lock);
+        if (!d->stopping)
+        {
+            CondVar_TimedWait(&d->wake, &d->lock, (unsigned int)((next - now) / 1000000ull));
+        }
+    }
+    Mutex_Unlock(&d->lock);
+
+    render_frame(d); // 最终状态
+}
+
+Dashboard* Dashboard_Start(const int* taskIds, int count, int fps)
+{
+    if (!taskIds || count <= 0) return NULL;
+
+    Dashboard* d = (Dashboard*)calloc(1, sizeof(Dashboard));
+    if (!d) return NULL;
+    d->rows = (DashboardRow*)calloc((size_t)count, sizeof(DashboardRow));
+    d->frameCap = (size_t)(count + 2) * DASH_LINE_MAX;
+    d->frame = (char*)malloc(d->frameCap);
+    if (!d->rows || !d->frame)
+    {
+        free(d->rows);
+        free(d->frame);
+        free(d);
+        return NULL;
+    }
+    for (int i = 0; i < count; ++i) d->rows[i].id = taskIds[i];
+    d->count = count;
+    d->fps = fps > 0 ? (fps < 120 ? fps : 120) : DASHBOARD_DEFAULT_FPS;
+
+#ifdef _WIN32
+    // 让 Windows 控制台解释 ANSI 转义序列
+    HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (h != INVALID_HANDLE_VALUE && GetConsoleMode(h, &mode))
+    {
+        SetConsoleMode(h, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
+
+    Mutex_Init(&d->lock);
+    CondVar_Init(&d->wake);
+    if (Thread_Create(&d->thread, dashboard_thread, d) != 0)
+    {
+        CondVar_Destroy(&d->wake);
+        Mutex_Destroy(&d->lock);
+        free(d->rows);
+        free(d->frame);
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+int Dashboard_Stop(Dashboard* dash)
+{
+    if (!dash) return 0;
+
+    Mutex_Lock(&dash->lock);
+    dash->stopping = 1;
+    CondVar_Signal(&dash->wake);
+    Mutex_Unlock(&dash->lock);
+    Thread_Join(dash->thread);
+
+    int frames = dash->frames;
+    CondVar_Destroy(&dash->wake);
+    Mutex_Destroy(&dash->lock);
+    free(dash->rows);
+    free(dash->frame);
+    free(dash);
+    return frames;
+}
@@ -1,7 +1,11 @@
 ﻿#include "ui/MainWindow.h"
+#include "ui/Dashboard.h"
 #include "core/TaskManager.h"     // 引入任务管理器
 #include "core/TransferEngine.h"  // 引入传输引擎
+#include "core/Metrics.h"
 #include "utils/FileUtils.h"      // 引入工具
+#include "utils/Thread.h"
+#include "data/Logger.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -125,20 +129,61 @@ static void CreateDummyFile(const char* filename, size_t sizeMB)
     UI_Print("[系统] 已创建测试文件 '%s' (%zu MB)\n", filename, sizeMB);
 }
 
-// UI 回调：进度更新
-static void _ui_progress_callback(int taskId, double percentage, double speed)
+// UI 回调：错误处理
+// 传输期间屏幕由仪表盘线程绘制，直接输出会打乱画面；错误写入日志，状态由仪表盘显示
+static void _ui_error_callback(int taskId, int errorCode, const char* msg)
 {
-    if (g_currentWindow)
-    {
-        ProgressBar_Update(&g_currentWindow->main_progress_bar, (float)percentage);
-        ProgressBar_Render(&g_currentWindow->main_progress_bar);
-    }
+    Logger_Log(LOG_ERROR, "任务 %d 错误: 代码 %d, %s", taskId, errorCode, msg ? msg : "");
 }
 
-// UI 回调：错误处理
-static void _ui_error_callback(int taskId, int errorCode, const char* msg)
+#define UI_MAX_CONCURRENT 16
+
+static void RunTaskThread(void* arg)
 {
-    UI_Print("\n[任务 %d 错误] 代码: %d, 信息: %s\n", taskId, errorCode, msg);
+    RunTask((TransferTask*)arg);
+}
+
+// 每个任务在独立线程中运行，仪表盘线程按固定帧率显示所有任务的进度；返回后所有任务均已结束
+static void RunTasksWithDashboard(const int* ids, int count)
+{
+    Thread threads[UI_MAX_CONCURRENT];
+    int started[UI_MAX_CONCURRENT];
+    int running = 0;
+
+    for (int i = 0; i < count && running < UI_MAX_CONCURRENT; ++i)
+    {
+        TransferTask* task = GetTaskById(ids[i]);
+        if (task && Thread_Create(&threads[running], RunTaskThread, task) == 0)
+        {
+            started[running++] = ids[i];
+        }
+    }
+    if (running == 0)
+    {
+        UI_Print("[警告] 没有可运行的任务。\n");
+        return;
+    }
+
+    Dashboard* dash = Dashboard_Start(started, running, DASHBOARD_DEFAULT_FPS);
+    for (int i = 0; i < running; ++i)
+    {
+        Thread_Join(threads[i]);
+    }
+    Dashboard_Stop(dash);
+
+    for (int i = 0; i < running; ++i)
+    {
+        TransferTask t;
+        if (TaskManager_SnapshotTask(started[i], &t) != 0) continue;
+        if (t.status == TASK_PAUSED)
+        {
+            UI_Print("[系统] 任务 %d 已暂停 (Offset: %llu)。\n", t.id, t.currentOffset);
+        }
+        else if (t.status == TASK_ERROR)
+        {
+            UI_Print("[系统] 任务 %d 出错，详情见 data/app.log。\n", t.id);
+        }
+    }
 }
 
 void MainWindow_RunLoop(MainWindow* win)
@@ -152,6 +197,12 @@ void MainWindow_RunLoop(MainWindow* win)
     InitTaskManager();
     InitTransferEngine();
 
+    // 运行指标：定期写入 Prometheus textfile，并可通过本地套接字随时读取
+    if (Metrics_Start("data/metrics.prom", "data/metrics.sock", 5000) != 0)
+    {
+        Logger_Log(LOG_WARNING, "指标导出线程启动失败");
+    }
+
     char inputBuffer[256];
 
     while (win->is_running)
@@ -163,6 +214,8 @@ void MainWindow_RunLoop(MainWindow* win)
         UI_Print(" 2. 添加传输任务 (加密/解密)            \n");
         UI_Print(" 3. 查看任务列表                        \n");
         UI_Print(" 4. 运行任务                           \n");
+        UI_Print(" 5. 查看历史任务                        \n");
+        UI_Print(" 6. 并发运行所有未完成任务              \n");
         UI_Print(" 0. 退出                                \n");
         UI_Print("========================================\n");
         UI_Print(" [提示] 本工具采用对称加密。\n");
@@ -298,8 +351,8 @@ void MainWindow_RunLoop(MainWindow* win)
                 {
                     UI_Print("[成功] 任务已加入队列 (ID: %d)。\n", id);
                     UI_Print("提示：请选择菜单 '4' 开始传输。\n");
-                    // 默认绑定回调
-                    SetTaskCallbacks(id, _ui_progress_callback, _ui_error_callback);
+                    // 默认绑定回调；进度由仪表盘读取快照显示，不需要逐块回调
+                    SetTaskCallbacks(id, NULL, _ui_error_callback);
                 }
                 else
                 {
@@ -309,13 +362,16 @@ void MainWindow_RunLoop(MainWindow* win)
             }
         case 3:
             {
-                int count = 0;
-                TransferTask* list = GetTaskList(&count);
+                // 读取快照而非任务本身，避免与正在运行的传输线程产生数据竞争
+                TransferTask* list = NULL;
+                int count = TaskManager_SnapshotAll(&list);
+                if (count < 0) count = 0;
                 UI_Print("\n--- 当前任务 (%d) ---\n", count);
                 for (int i = 0; i < count; i++)
                 {
+                    const TransferTask* t = &list[i];
                     const char* statusStr = "未知";
-                    switch (list[i].status)
+                    switch (t->status)
                     {
                     case TASK_WAITING: statusStr = "等待中";
                         break;
@@ -329,9 +385,10 @@ void MainWindow_RunLoop(MainWindow* win)
                         break;
                     }
                     UI_Print("ID:%d 状态:%-8s 进度:%llu/%llu 源:%s -> 目标:%s\n",
-                             list[i].id, statusStr, list[i].currentOffset, list[i].totalSize,
-                             list[i].srcPath, list[i].destPath);
+                             t->id, statusStr, t->currentOffset, t->totalSize,
+                             t->srcPath, t->destPath);
                 }
+                free(list);
                 break;
             }
         case 4:
@@ -351,7 +408,7 @@ void MainWindow_RunLoop(MainWindow* win)
                     UI_Print("[系统] 正在启动任务 %d ... \n", runId);
                     UI_Print("      >>> 按 'P' 键可暂停任务，按 Ctrl+C 强行终止 <<<\n");
 
-                    RunTask(task);
+                    RunTasksWithDashboard(&runId, 1);
 
                     if (task->status == TASK_PAUSED)
                     {
@@ -368,6 +425,45 @@ void MainWindow_RunLoop(MainWindow* win)
                 }
                 break;
             }
+        case 5:
+            {
+                // 历史记录在首次查询时才从磁盘加载
+                int count = TaskManager_GetHistoryCount();
+                UI_Print("\n--- 历史任务 (%d) ---\n", count);
+                for (int i = 0; i < count; i++)
+                {
+                    TransferTask t;
+                    if (TaskManager_GetHistoryAt(i, &t) != 0) continue;
+                    UI_Print("ID:%d 大小:%llu 源:%s -> 目标:%s\n",
+                             t.id, t.totalSize, t.srcPath, t.destPath);
+                }
+                break;
+            }
+        case 6:
+            {
+                // 收集等待中与已暂停的任务，同时运行
+                TransferTask* list = NULL;
+                int count = TaskManager_SnapshotAll(&list);
+                int ids[UI_MAX_CONCURRENT];
+                int n = 0;
+                for (int i = 0; i < count && n < UI_MAX_CONCURRENT; i++)
+                {
+                    if (list[i].status == TASK_WAITING || list[i].status == TASK_PAUSED)
+                    {
+                        ids[n++] = list[i].id;
+                    }
+                }
+                free(list);
+                if (n == 0)
+                {
+                    UI_Print("[提示] 没有未完成的任务。\n");
+                    break;
+                }
+                UI_Print("[系统] 并发运行 %d 个任务 ...\n", n);
+                RunTasksWithDashboard(ids, n);
+                UI_Print("[系统] 所有任务已结束。\n");
+                break;
+            }
         case 0:
             win->is_running = 0;
             UI_Print("正在退出程序...\n");
@@ -377,6 +473,8 @@ void MainWindow_RunLoop(MainWindow* win)
             break;
         }
     }
+    Metrics_Stop();
+    TaskManager_Shutdown();
     g_currentWindow = NULL;
 }
 
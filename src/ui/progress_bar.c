@@ -17,18 +17,33 @@ void ProgressBar_Update(ProgressBar* bar, float percent)
     bar->current_percent = percent;
 }
 
-void ProgressBar_Render(const ProgressBar* bar)
+int ProgressBar_Format(const ProgressBar* bar, char* out, size_t size)
 {
-    if (!bar) return;
+    if (!bar || !out || size == 0) return 0;
 
-    printf("\r[");
-    int pos = (int)((bar->width * bar->current_percent) / 100.0f);
-    for (int i = 0; i < bar->width; ++i)
+    // 先在栈上拼好整行，避免逐字符输出
+    char cells[256];
+    int width = bar->width < (int)sizeof(cells) ? bar->width : (int)sizeof(cells) - 1;
+    int pos = (int)((width * bar->current_percent) / 100.0f);
+    for (int i = 0; i < width; ++i)
     {
-        if (i < pos) printf("=");
-        else if (i == pos) printf(">");
-        else printf(" ");
+        if (i < pos) cells[i] = '=';
+        else if (i == pos) cells[i] = '>';
+        else cells[i] = ' ';
     }
-    printf("] %.1f%%", bar->current_percent);
+    cells[width] = '\0';
+
+    int n = snprintf(out, size, "[%s] %5.1f%%", cells, bar->current_percent);
+    if (n < 0) return 0;
+    return n < (int)size ? n : (int)size - 1;
+}
+
+void ProgressBar_Render(const ProgressBar* bar)
+{
+    if (!bar) return;
+
+    char line[300];
+    ProgressBar_Format(bar, line, sizeof(line));
+    printf("\r%s", line);
     fflush(stdout); // 强制刷新缓冲区以显示动画
 }
@@ -1,10 +1,277 @@
 ﻿// ...existing code...
 #include "utils/Algorithm.h"
+#include "utils/Thread.h"
 #include <stdint.h>
 #include <stddef.h>
 
-static uint32_t crc_table[256];
+// x86-64 上可用 PCLMULQDQ (无进位乘法) 折叠计算 CRC32，运行时检测 CPU 支持后启用
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32_HAVE_CLMUL 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRC32_TARGET_CLMUL
+#define CRC32_TARGET_VPCLMUL
+#else
+#include <cpuid.h>
+#define CRC32_TARGET_CLMUL __attribute__((target("pclmul,sse4.1")))
+#define CRC32_TARGET_VPCLMUL __attribute__((target("avx512f,vpclmulqdq,pclmul,sse4.1")))
+#endif
+#else
+#define CRC32_HAVE_CLMUL 0
+#endif
+
+#define CRC32_POLY 0xedb88320u
+#define CRC32_SLICES 16
+
+// crc_table[0] 为经典单表；crc_table[k][n] 表示字节 n 之后再跟 k 个零字节的 CRC 贡献 (slicing-by-16)
+static uint32_t crc_table[CRC32_SLICES][256];
+// x2n_table[k] = x^(2^k) mod P(x)，用于 CRC 合并时的快速幂
+static uint32_t x2n_table[32];
 static int crc_table_computed = 0;
+// 0 = 查表, 1 = PCLMULQDQ (128 位), 2 = VPCLMULQDQ (AVX-512, 512 位)
+static int crc_clmul_level = 0;
+
+// GF(2) 多项式乘法取模：返回 a(x) * b(x) mod P(x) (反射位序)
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+    return p;
+}
+
+// 返回 x^(n * 2^k) mod P(x)
+static uint32_t x2nmodp(uint64_t n, unsigned k)
+{
+    uint32_t p = (uint32_t)1 << 31; // x^0 == 1
+    while (n)
+    {
+        if (n & 1) p = multmodp(x2n_table[k & 31], p);
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+#if CRC32_HAVE_CLMUL
+// 检测可用的无进位乘法指令级别 (同时确认操作系统已启用 AVX-512 寄存器状态)
+static int detect_clmul_level(void)
+{
+    unsigned int leaf1[4] = {0}, leaf7[4] = {0};
+    uint64_t xcr0 = 0;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    int maxLeaf = regs[0];
+    __cpuid(regs, 1);
+    for (int i = 0; i < 4; ++i) leaf1[i] = (unsigned int)regs[i];
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(regs, 7, 0);
+        for (int i = 0; i < 4; ++i) leaf7[i] = (unsigned int)regs[i];
+    }
+    if (leaf1[2] & (1u << 27)) xcr0 = _xgetbv(0);
+#else
+    if (!__get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3])) return 0;
+    __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+    if (leaf1[2] & (1u << 27))
+    {
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+    }
+#endif
+    int hasClmul = (leaf1[2] & (1u << 1)) && (leaf1[2] & (1u << 19)); // PCLMULQDQ + SSE4.1
+    if (!hasClmul) return 0;
+
+    int osAvx512 = (xcr0 & 0xE6) == 0xE6; // XMM/YMM/opmask/ZMM 状态均已启用
+    int hasVpclmul = (leaf7[1] & (1u << 16)) && (leaf7[2] & (1u << 10)); // AVX512F + VPCLMULQDQ
+    return (osAvx512 && hasVpclmul) ? 2 : 1;
+}
+
+// 基于 Intel 白皮书 "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ" 的折叠算法
+// 常量为反射位序下 P(x) = 0x04C11DB7 (即 0xEDB88320) 的 x^k mod P 值
+// 输入/输出均为内部状态 (已取反)；要求 length >= 64 且为 16 的倍数
+CRC32_TARGET_CLMUL
+static uint32_t crc32_clmul_finish(__m128i x1, const uint8_t* buf, size_t length);
+
+CRC32_TARGET_CLMUL
+static uint32_t crc32_clmul(uint32_t crc, const uint8_t* buf, size_t length)
+{
+    // 折叠常量 k = (x^(D±32) mod P)' << 1，D 为折叠跨度 (位)
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL); // D = 512
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL); // D = 128
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    // 载入首个 64 字节块，并把初始 CRC 异或进最低 32 位
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = k1k2;
+    buf += 64;
+    length -= 64;
+
+    // 4 路并行折叠，每轮 64 字节
+    while (length >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        length -= 64;
+    }
+
+    // 4 个 128 位累加器折叠为 1 个
+    x0 = k3k4;
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    return crc32_clmul_finish(x1, buf, length);
+}
+
+// 单路折叠剩余的 16 字节块，并把 128 位余式约减为 32 位 CRC
+CRC32_TARGET_CLMUL
+static uint32_t crc32_clmul_finish(__m128i x1, const uint8_t* buf, size_t length)
+{
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x0 = k3k4, x2, x5;
+
+    while (length >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        length -= 16;
+    }
+
+    // 128 位 -> 64 位
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = k5k0;
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett 约减到 32 位
+    x0 = poly;
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+#if CRC32_HAVE_CLMUL
+CRC32_TARGET_VPCLMUL
+static inline __m512i fold512(__m512i z, __m512i k)
+{
+    return _mm512_xor_si512(_mm512_clmulepi64_epi128(z, k, 0x00), _mm512_clmulepi64_epi128(z, k, 0x11));
+}
+
+CRC32_TARGET_VPCLMUL
+static inline __m128i fold128(__m128i x, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+// AVX-512 版本：4 个 512 位累加器，每轮折叠 256 字节；要求 length >= 256 且为 16 的倍数
+CRC32_TARGET_VPCLMUL
+static uint32_t crc32_vpclmul(uint32_t crc, const uint8_t* buf, size_t length)
+{
+    const __m512i k2048 = _mm512_broadcast_i32x4(_mm_set_epi64x(0x01322d1430LL, 0x011542778aLL));
+    const __m512i k512 = _mm512_broadcast_i32x4(_mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL));
+    const __m128i k384 = _mm_set_epi64x(0x0174359406LL, 0x003db1ecdcLL);
+    const __m128i k256 = _mm_set_epi64x(0x015a546366LL, 0x00f1da05aaLL);
+    const __m128i k128 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+
+    __m512i z0 = _mm512_loadu_si512((const void*)(buf + 0x00));
+    __m512i z1 = _mm512_loadu_si512((const void*)(buf + 0x40));
+    __m512i z2 = _mm512_loadu_si512((const void*)(buf + 0x80));
+    __m512i z3 = _mm512_loadu_si512((const void*)(buf + 0xC0));
+    z0 = _mm512_xor_si512(z0, _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128((int)crc), 0));
+    buf += 256;
+    length -= 256;
+
+    while (length >= 256)
+    {
+        z0 = _mm512_xor_si512(fold512(z0, k2048), _mm512_loadu_si512((const void*)(buf + 0x00)));
+        z1 = _mm512_xor_si512(fold512(z1, k2048), _mm512_loadu_si512((const void*)(buf + 0x40)));
+        z2 = _mm512_xor_si512(fold512(z2, k2048), _mm512_loadu_si512((const void*)(buf + 0x80)));
+        z3 = _mm512_xor_si512(fold512(z3, k2048), _mm512_loadu_si512((const void*)(buf + 0xC0)));
+        buf += 256;
+        length -= 256;
+    }
+
+    // 4 个 512 位累加器 -> 1 个
+    z0 = _mm512_xor_si512(fold512(z0, k512), z1);
+    z0 = _mm512_xor_si512(fold512(z0, k512), z2);
+    z0 = _mm512_xor_si512(fold512(z0, k512), z3);
+
+    while (length >= 64)
+    {
+        z0 = _mm512_xor_si512(fold512(z0, k512), _mm512_loadu_si512((const void*)buf));
+        buf += 64;
+        length -= 64;
+    }
+
+    // 512 位 -> 128 位：各 128 位通道按其到末尾的距离折叠后合并
+    __m128i x1 = fold128(_mm512_extracti32x4_epi32(z0, 0), k384);
+    x1 = _mm_xor_si128(x1, fold128(_mm512_extracti32x4_epi32(z0, 1), k256));
+    x1 = _mm_xor_si128(x1, fold128(_mm512_extracti32x4_epi32(z0, 2), k128));
+    x1 = _mm_xor_si128(x1, _mm512_extracti32x4_epi32(z0, 3));
+
+    return crc32_clmul_finish(x1, buf, length);
+}
+#endif
 
 //预先计算了 0 到 255（即一个字节所有可能的值）对应的 CRC32 中间结果，并存入 crc_table 数组。
 static void make_crc_table(void)
@@ -22,8 +289,32 @@ static void make_crc_table(void)
             else
                 c = c >> 1;
         }
-        crc_table[n] = c;
+        crc_table[0][n] = c;
     }
+
+    // 派生 slicing 表：在单表结果后再推进一个零字节
+    for (n = 0; n < 256; n++)
+    {
+        c = crc_table[0][n];
+        for (k = 1; k < CRC32_SLICES; k++)
+        {
+            c = crc_table[0][c & 0xff] ^ (c >> 8);
+            crc_table[k][n] = c;
+        }
+    }
+
+    // x^1, x^2, x^4, ... 逐次平方
+    uint32_t p = (uint32_t)1 << 30; // x^1
+    x2n_table[0] = p;
+    for (n = 1; n < 32; n++)
+    {
+        x2n_table[n] = p = multmodp(p, p);
+    }
+
+#if CRC32_HAVE_CLMUL
+    crc_clmul_level = detect_clmul_level();
+#endif
+
     crc_table_computed = 1;
 }
 
@@ -36,14 +327,60 @@ void Algorithm_InitCRC32(void)
     }
 }
 
+static inline uint32_t load_le32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 内部状态 (已取反) 上的 slicing-by-16：每轮处理 16 字节，16 次独立查表可并行执行
+static uint32_t crc32_slice16(uint32_t c, const uint8_t* data, size_t length)
+{
+    while (length >= 16)
+    {
+        uint32_t w0 = c ^ load_le32(data);
+        uint32_t w1 = load_le32(data + 4);
+        uint32_t w2 = load_le32(data + 8);
+        uint32_t w3 = load_le32(data + 12);
+
+        c = crc_table[15][w0 & 0xff] ^ crc_table[14][(w0 >> 8) & 0xff] ^
+            crc_table[13][(w0 >> 16) & 0xff] ^ crc_table[12][w0 >> 24] ^
+            crc_table[11][w1 & 0xff] ^ crc_table[10][(w1 >> 8) & 0xff] ^
+            crc_table[9][(w1 >> 16) & 0xff] ^ crc_table[8][w1 >> 24] ^
+            crc_table[7][w2 & 0xff] ^ crc_table[6][(w2 >> 8) & 0xff] ^
+            crc_table[5][(w2 >> 16) & 0xff] ^ crc_table[4][w2 >> 24] ^
+            crc_table[3][w3 & 0xff] ^ crc_table[2][(w3 >> 8) & 0xff] ^
+            crc_table[1][(w3 >> 16) & 0xff] ^ crc_table[0][w3 >> 24];
+
+        data += 16;
+        length -= 16;
+    }
+
+    // 尾部逐字节
+    for (size_t n = 0; n < length; n++)
+    {
+        c = crc_table[0][(c ^ data[n]) & 0xff] ^ (c >> 8);
+    }
+    return c;
+}
+
 uint32_t Algorithm_UpdateCRC32(uint32_t currentCrc, const uint8_t* data, size_t length)
 {
     if (!crc_table_computed) Algorithm_InitCRC32();
     uint32_t c = currentCrc ^ 0xFFFFFFFF;
-    for (size_t n = 0; n < length; n++)
+#if CRC32_HAVE_CLMUL
+    // 硬件折叠处理长度为 16 字节整数倍的主体，余下尾部交给查表路径
+    if (crc_clmul_level >= 1 && length >= 64)
     {
-        c = crc_table[(c ^ data[n]) & 0xff] ^ (c >> 8);
+        size_t bulk = length & ~(size_t)15;
+        if (crc_clmul_level >= 2 && bulk >= 256)
+            c = crc32_vpclmul(c, data, bulk);
+        else
+            c = crc32_clmul(c, data, bulk);
+        data += bulk;
+        length -= bulk;
     }
+#endif
+    c = crc32_slice16(c, data, length);
     return c ^ 0xFFFFFFFF;
 }
 
@@ -52,3 +389,59 @@ uint32_t Algorithm_CalculateCRC32(const uint8_t* data, size_t length)
     return Algorithm_UpdateCRC32(0, data, length);
 }
 
+uint32_t Algorithm_CombineCRC32(uint32_t crcA, uint32_t crcB, uint64_t lenB)
+{
+    if (!crc_table_computed) Algorithm_InitCRC32();
+    // crc(A||B) = crcA * x^(8*lenB) mod P  xor  crcB
+    return multmodp(x2nmodp(lenB, 3), crcA) ^ crcB;
+}
+
+// --- 多线程 CRC：各线程计算一段，再按顺序合并 ---
+
+#define CRC32_PARALLEL_MIN_SLICE (1024 * 1024) // 每线程至少 1MB，否则线程开销得不偿失
+#define CRC32_MAX_THREADS 64
+
+typedef struct CRCSlice
+{
+    const uint8_t* data;
+    size_t length;
+    uint32_t crc;
+} CRCSlice;
+
+static void crc_slice_worker(void* arg)
+{
+    CRCSlice* slice = (CRCSlice*)arg;
+    slice->crc = Algorithm_CalculateCRC32(slice->data, slice->length);
+}
+
+uint32_t Algorithm_CalculateCRC32Parallel(const uint8_t* data, size_t length, int threads)
+{
+    if (!crc_table_computed) Algorithm_InitCRC32();
+    if (threads <= 0) threads = Thread_GetCpuCount();
+    if (threads > CRC32_MAX_THREADS) threads = CRC32_MAX_THREADS;
+    if ((size_t)threads > length / CRC32_PARALLEL_MIN_SLICE) threads = (int)(length / CRC32_PARALLEL_MIN_SLICE);
+    if (threads <= 1) return Algorithm_CalculateCRC32(data, length);
+
+    CRCSlice slices[CRC32_MAX_THREADS];
+    Thread handles[CRC32_MAX_THREADS];
+    int created[CRC32_MAX_THREADS];
+    size_t per = length / (size_t)threads;
+
+    for (int i = 0; i < threads; ++i)
+    {
+        slices[i].data = data + (size_t)i * per;
+        slices[i].length = (i == threads - 1) ? length - (size_t)i * per : per;
+        slices[i].crc = 0;
+        // 最后一段由当前线程计算；创建线程失败时也退化为当前线程计算
+        created[i] = (i < threads - 1) && Thread_Create(&handles[i], crc_slice_worker, &slices[i]) == 0;
+        if (!created[i]) crc_slice_worker(&slices[i]);
+    }
+
+    uint32_t crc = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        if (created[i]) Thread_Join(handles[i]);
+        crc = (i == 0) ? slices[0].crc : Algorithm_CombineCRC32(crc, slices[i].crc, slices[i].length);
+    }
+    return crc;
+}
@@ -0,0 +1,225 @@
+﻿#include "utils/BufferPool.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(_MSC_VER)
+#define POOL_THREAD_LOCAL __declspec(thread)
+#else
+#define POOL_THREAD_LOCAL _Thread_local
+#endif
+
+#define POOL_CLASSES 15     // BUFFER_POOL_MIN_SIZE << 0 .. << 14 (64 MB)
+#define POOL_THREAD_DEPTH 2 // idle buffers a thread keeps per size class
+
+// Idle buffers in the shared pool are chained through their first bytes
+typedef struct FreeBuffer
+{
+    struct FreeBuffer* next;
+} FreeBuffer;
+
+typedef struct ThreadCache
+{
+    void* buffers[POOL_CLASSES][POOL_THREAD_DEPTH];
+    int count[POOL_CLASSES];
+} ThreadCache;
+
+static POOL_THREAD_LOCAL ThreadCache t_cache;
+
+// The shared lists are touched once per cache miss, so a spin lock is enough and needs no initialisation
+static atomic_flag g_lock = ATOMIC_FLAG_INIT;
+static FreeBuffer* g_free[POOL_CLASSES];
+static size_t g_idle_bytes;
+
+static atomic_int g_huge = 0;
+static _Atomic uint64_t g_os_allocs = 0;
+static _Atomic uint64_t g_reuses = 0;
+static _Atomic uint64_t g_huge_allocs = 0;
+
+static void pool_lock(void)
+{
+    while (atomic_flag_test_and_set_explicit(&g_lock, memory_order_acquire))
+    {
+    }
+}
+
+static void pool_unlock(void)
+{
+    atomic_flag_clear_explicit(&g_lock, memory_order_release);
+}
+
+static size_t class_size(int k)
+{
+    return (size_t)BUFFER_POOL_MIN_SIZE << k;
+}
+
+// Size class for a request, or -1 when it is too large to cache
+static int class_of(size_t size)
+{
+    if (size > BUFFER_POOL_MAX_SIZE) return -1;
+    int k = 0;
+    while (class_size(k) < size) k++;
+    return k;
+}
+
+static void* os_alloc(size_t size)
+{
+    atomic_fetch_add_explicit(&g_os_allocs, 1, memory_order_relaxed);
+    int huge = atomic_load_explicit(&g_huge, memory_order_relaxed) && size >= BUFFER_POOL_HUGE_SIZE;
+#ifdef _WIN32
+    (void)huge; // large pages need SeLockMemoryPrivilege; plain committed pages are used instead
+    return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge)
+    {
+        // Only succeeds when huge pages have been reserved (vm.nr_hugepages)
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) atomic_fetch_add_explicit(&g_huge_allocs, 1, memory_order_relaxed);
+    }
+#endif
+    if (p == MAP_FAILED)
+    {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return NULL;
+#ifdef MADV_HUGEPAGE
+        if (huge && madvise(p, size, MADV_HUGEPAGE) == 0)
+        {
+            atomic_fetch_add_explicit(&g_huge_allocs, 1, memory_order_relaxed);
+        }
+#endif
+    }
+    return p;
+#endif
+}
+
+static void os_free(void* buffer, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+    munmap(buffer, size);
+#endif
+}
+
+// Park a buffer in the shared pool, or free it once the idle limit is reached
+static void push_shared(int k, void* buffer)
+{
+    FreeBuffer* b = (FreeBuffer*)buffer;
+    int kept = 0;
+    pool_lock();
+    if (g_idle_bytes + class_size(k) <= BUFFER_POOL_IDLE_LIMIT)
+    {
+        b->next = g_free[k];
+        g_free[k] = b;
+        g_idle_bytes += class_size(k);
+        kept = 1;
+    }
+    pool_unlock();
+    if (!kept) os_free(buffer, class_size(k));
+}
+
+void BufferPool_SetHugePages(int enabled)
+{
+    atomic_store(&g_huge, enabled ? 1 : 0);
+}
+
+void* BufferPool_Acquire(size_t size)
+{
+    if (size == 0) size = 1;
+    int k = class_of(size);
+    if (k < 0) return os_alloc(size);
+
+    ThreadCache* c = &t_cache;
+    if (c->count[k] > 0)
+    {
+        atomic_fetch_add_explicit(&g_reuses, 1, memory_order_relaxed);
+        return c->buffers[k][--c->count[k]];
+    }
+
+    pool_lock();
+    FreeBuffer* b = g_free[k];
+    if (b)
+    {
+        g_free[k] = b->next;
+        g_idle_bytes -= class_size(k);
+    }
+    pool_unlock();
+    if (b)
+    {
+        atomic_fetch_add_explicit(&g_reuses, 1, memory_order_relaxed);
+        return b;
+    }
+    return os_alloc(class_size(k));
+}
+
+void BufferPool_Release(void* buffer, size_t size)
+{
+    if (!buffer) return;
+    if (size == 0) size = 1;
+    int k = class_of(size);
+    if (k < 0)
+    {
+        os_free(buffer, size);
+        return;
+    }
+
+    ThreadCache* c = &t_cache;
+    if (c->count[k] < POOL_THREAD_DEPTH)
+    {
+        c->buffers[k][c->count[k]++] = buffer;
+        return;
+    }
+    push_shared(k, buffer);
+}
+
+void BufferPool_FlushThreadCache(void)
+{
+    ThreadCache* c = &t_cache;
+    for (int k = 0; k < POOL_CLASSES; ++k)
+    {
+        while (c->count[k] > 0) push_shared(k, c->buffers[k][--c->count[k]]);
+    }
+}
+
+void BufferPool_Trim(void)
+{
+    FreeBuffer* lists[POOL_CLASSES];
+    pool_lock();
+    for (int k = 0; k < POOL_CLASSES; ++k)
+    {
+        lists[k] = g_free[k];
+        g_free[k] = NULL;
+    }
+    g_idle_bytes = 0;
+    pool_unlock();
+
+    for (int k = 0; k < POOL_CLASSES; ++k)
+    {
+        while (lists[k])
+        {
+            FreeBuffer* next = lists[k]->next;
+            os_free(lists[k], class_size(k));
+            lists[k] = next;
+        }
+    }
+}
+
+void BufferPool_GetStats(BufferPoolStats* out)
+{
+    if (!out) return;
+    out->osAllocs = atomic_load_explicit(&g_os_allocs, memory_order_relaxed);
+    out->reuses = atomic_load_explicit(&g_reuses, memory_order_relaxed);
+    out->hugeAllocs = atomic_load_explicit(&g_huge_allocs, memory_order_relaxed);
+    pool_lock();
+    out->idleBytes = g_idle_bytes;
+    pool_unlock();
+}
@@ -97,3 +97,13 @@ uint64_t FileUtils_GetFileSize(const char* filepath)
     return 0;
 #endif
 }
+
+int FileUtils_Seek(FILE* fp, uint64_t offset)
+{
+    if (!fp) return -1;
+#ifdef _WIN32
+    return _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
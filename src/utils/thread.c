@@ -0,0 +1,185 @@
+﻿#include "utils/Thread.h"
+#include "utils/BufferPool.h"
+#include "utils/Trace.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// Heap-allocated trampoline so the caller's fn/arg survive until the thread starts
+typedef struct ThreadStart
+{
+    ThreadFunc fn;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static unsigned __stdcall thread_trampoline(void* p)
+#else
+static void* thread_trampoline(void* p)
+#endif
+{
+    ThreadStart start = *(ThreadStart*)p;
+    free(p);
+    start.fn(start.arg);
+    BufferPool_FlushThreadCache(); // hand this thread's idle buffers to other threads
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int Thread_Create(Thread* thread, ThreadFunc fn, void* arg)
+{
+    if (!thread || !fn) return -1;
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return -1;
+    start->fn = fn;
+    start->arg = arg;
+#ifdef _WIN32
+    uintptr_t h = _beginthreadex(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (h == 0)
+    {
+        free(start);
+        return -1;
+    }
+    *thread = (HANDLE)h;
+    return 0;
+#else
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0)
+    {
+        free(start);
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+void Thread_Join(Thread thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+int Thread_GetCpuCount(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+void Thread_SleepMs(unsigned int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+#endif
+}
+
+uint64_t Thread_NowNs(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, cnt;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+    return (uint64_t)((double)cnt.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#ifdef _WIN32
+
+void Mutex_Init(Mutex* m) { InitializeCriticalSection(m); }
+void Mutex_Lock(Mutex* m)
+{
+#ifdef SAFETRIX_ENABLE_TRACE
+    // Only contended acquisitions are recorded, so the trace shows where threads actually wait
+    if (TryEnterCriticalSection(m)) return;
+    TRACE_BEGIN(span, "Mutex.wait");
+    EnterCriticalSection(m);
+    TRACE_END(span);
+#else
+    EnterCriticalSection(m);
+#endif
+}
+
+void Mutex_Unlock(Mutex* m) { LeaveCriticalSection(m); }
+void Mutex_Destroy(Mutex* m) { DeleteCriticalSection(m); }
+
+void CondVar_Init(CondVar* cv) { InitializeConditionVariable(cv); }
+void CondVar_Wait(CondVar* cv, Mutex* m) { SleepConditionVariableCS(cv, m, INFINITE); }
+
+int CondVar_TimedWait(CondVar* cv, Mutex* m, unsigned int ms)
+{
+    return SleepConditionVariableCS(cv, m, ms) ? 0 : 1;
+}
+
+void CondVar_Signal(CondVar* cv) { WakeConditionVariable(cv); }
+void CondVar_Broadcast(CondVar* cv) { WakeAllConditionVariable(cv); }
+void CondVar_Destroy(CondVar* cv) { (void)cv; }
+
+#else
+
+void Mutex_Init(Mutex* m) { pthread_mutex_init(m, NULL); }
+void Mutex_Lock(Mutex* m)
+{
+#ifdef SAFETRIX_ENABLE_TRACE
+    // Only contended acquisitions are recorded, so the trace shows where threads actually wait
+    if (pthread_mutex_trylock(m) == 0) return;
+    TRACE_BEGIN(span, "Mutex.wait");
+    pthread_mutex_lock(m);
+    TRACE_END(span);
+#else
+    pthread_mutex_lock(m);
+#endif
+}
+
+void Mutex_Unlock(Mutex* m) { pthread_mutex_unlock(m); }
+void Mutex_Destroy(Mutex* m) { pthread_mutex_destroy(m); }
+
+void CondVar_Init(CondVar* cv) { pthread_cond_init(cv, NULL); }
+void CondVar_Wait(CondVar* cv, Mutex* m) { pthread_cond_wait(cv, m); }
+
+int CondVar_TimedWait(CondVar* cv, Mutex* m, unsigned int ms)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cv, m, &ts) == 0 ? 0 : 1;
+}
+
+void CondVar_Signal(CondVar* cv) { pthread_cond_signal(cv); }
+void CondVar_Broadcast(CondVar* cv) { pthread_cond_broadcast(cv); }
+void CondVar_Destroy(CondVar* cv) { pthread_cond_destroy(cv); }
+
+#endif
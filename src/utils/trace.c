@@ -0,0 +1,204 @@
+﻿#include "utils/Trace.h"
+#include "utils/FileUtils.h"
+#include "utils/Thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SAFETRIX_ENABLE_TRACE
+
+#include <stdatomic.h>
+
+#if defined(_MSC_VER)
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+#define TRACE_CHUNK_EVENTS 16384
+#define TRACE_MAX_CHUNKS 256 // ~4M spans per thread; later spans are counted as dropped
+
+typedef struct TraceEvent
+{
+    const char* name;
+    uint64_t start;
+    uint64_t dur;
+} TraceEvent;
+
+typedef struct TraceChunk
+{
+    struct TraceChunk* next;
+    int count;
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+} TraceChunk;
+
+// One buffer per thread. Buffers are never freed, so spans of finished threads can still be exported
+typedef struct TraceThread
+{
+    struct TraceThread* next;
+    int tid;
+    char name[32];
+    TraceChunk* head;
+    TraceChunk* tail;
+    int chunks;
+    uint64_t dropped;
+} TraceThread;
+
+static TraceThread* _Atomic g_threads = NULL;
+static atomic_int g_nextTid = 1;
+static TRACE_THREAD_LOCAL TraceThread* t_self = NULL;
+
+static TraceThread* current_thread(void)
+{
+    if (t_self) return t_self;
+
+    TraceThread* self = (TraceThread*)calloc(1, sizeof(TraceThread));
+    if (!self) return NULL;
+    self->tid = atomic_fetch_add(&g_nextTid, 1);
+
+    // Lock-free push onto the global list
+    TraceThread* head = atomic_load(&g_threads);
+    do
+    {
+        self->next = head;
+    }
+    while (!atomic_compare_exchange_weak(&g_threads, &head, self));
+
+    t_self = self;
+    return self;
+}
+
+TraceSpan Trace_Begin(const char* name)
+{
+    TraceSpan span;
+    span.name = name;
+    span.start = Thread_NowNs();
+    return span;
+}
+
+void Trace_End(const TraceSpan* span)
+{
+    Trace_Record(span->name, span->start, Thread_NowNs());
+}
+
+void Trace_Record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    TraceThread* self = current_thread();
+    if (!self) return;
+
+    TraceChunk* chunk = self->tail;
+    if (!chunk || chunk->count == TRACE_CHUNK_EVENTS)
+    {
+        chunk = self->chunks < TRACE_MAX_CHUNKS ? (TraceChunk*)malloc(sizeof(TraceChunk)) : NULL;
+        if (!chunk)
+        {
+            self->dropped++;
+            return;
+        }
+        chunk->next = NULL;
+        chunk->count = 0;
+        if (self->tail) self->tail->next = chunk;
+        else self->head = chunk;
+        self->tail = chunk;
+        self->chunks++;
+    }
+
+    TraceEvent* ev = &chunk->events[chunk->count++];
+    ev->name = name;
+    ev->start = startNs;
+    ev->dur = endNs > startNs ? endNs - startNs : 0;
+}
+
+void Trace_SetThreadName(const char* name)
+{
+    TraceThread* self = current_thread();
+    if (!self || !name) return;
+    strncpy(self->name, name, sizeof(self->name) - 1);
+    self->name[sizeof(self->name) - 1] = '\0';
+}
+
+int Trace_IsEnabled(void)
+{
+    return 1;
+}
+
+int Trace_WriteChrome(const char* path)
+{
+    FILE* out = FileUtils_OpenFileUTF8(path, "w");
+    if (!out) return -1;
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    int first = 1;
+    for (TraceThread* t = atomic_load(&g_threads); t; t = t->next)
+    {
+        if (t->name[0] != '\0')
+        {
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", t->tid, t->name);
+            first = 0;
+        }
+        for (TraceChunk* c = t->head; c; c = c->next)
+        {
+            for (int i = 0; i < c->count; ++i)
+            {
+                const TraceEvent* ev = &c->events[i];
+                // Timestamps are microseconds; keep nanosecond precision as fractions
+                fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"safetrix\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                        "\"ts\":%.3f,\"dur\":%.3f}",
+                        first ? "" : ",\n", ev->name, t->tid, (double)ev->start / 1000.0,
+                        (double)ev->dur / 1000.0);
+                first = 0;
+            }
+        }
+        if (t->dropped > 0)
+        {
+            fprintf(stderr, "trace: thread %d dropped %llu spans\n", t->tid, (unsigned long long)t->dropped);
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    int rc = ferror(out) ? -1 : 0;
+    fclose(out);
+    return rc;
+}
+
+#else // !SAFETRIX_ENABLE_TRACE
+
+TraceSpan Trace_Begin(const char* name)
+{
+    TraceSpan span;
+    span.name = name;
+    span.start = 0;
+    return span;
+}
+
+void Trace_End(const TraceSpan* span)
+{
+    (void)span;
+}
+
+void Trace_Record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    (void)name;
+    (void)startNs;
+    (void)endNs;
+}
+
+void Trace_SetThreadName(const char* name)
+{
+    (void)name;
+}
+
+int Trace_IsEnabled(void)
+{
+    return 0;
+}
+
+int Trace_WriteChrome(const char* path)
+{
+    (void)path;
+    return -1;
+}
+
+#endif // SAFETRIX_ENABLE_TRACE
@@ -0,0 +1,895 @@
+﻿#include "utils/TreeHash.h"
+#include "utils/BufferPool.h"
+#include "utils/FileUtils.h"
+#include "utils/Thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TREEHASH_SSE2 1
+#include <emmintrin.h>
+#else
+#define TREEHASH_SSE2 0
+#endif
+
+// 8-way AVX2 kernel, selected at runtime (GCC/Clang function multiversioning via target attribute)
+#if TREEHASH_SSE2 && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define TREEHASH_AVX2 1
+#include <immintrin.h>
+#define TREEHASH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TREEHASH_AVX2 0
+#endif
+
+#define BLOCK_LEN 64
+#define CHUNK_START 1u
+#define CHUNK_END 2u
+#define PARENT 4u
+#define ROOT 8u
+#define MAX_DEPTH 54 // 2^54 chunks covers any 64-bit length
+#define MAX_THREADS 64
+
+static const uint32_t IV[8] = {
+    0x6A09E667u, 0xBB67AE85u, 0x3C6EF372u, 0xA54FF53Au, 0x510E527Fu, 0x9B05688Cu, 0x1F83D9ABu, 0x5BE0CD19u
+};
+
+static const uint8_t MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+static inline uint32_t load32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void store32(uint8_t* p, uint32_t w)
+{
+    p[0] = (uint8_t)w;
+    p[1] = (uint8_t)(w >> 8);
+    p[2] = (uint8_t)(w >> 16);
+    p[3] = (uint8_t)(w >> 24);
+}
+
+static inline uint32_t rotr32(uint32_t w, int c)
+{
+    return (w >> c) | (w << (32 - c));
+}
+
+// ---------------------------------------------------------------------------
+// Scalar compression function
+// ---------------------------------------------------------------------------
+
+#define G(s, a, b, c, d, x, y)                      \
+    do                                              \
+    {                                               \
+        s[a] = s[a] + s[b] + (x);                   \
+        s[d] = rotr32(s[d] ^ s[a], 16);             \
+        s[c] = s[c] + s[d];                         \
+        s[b] = rotr32(s[b] ^ s[c], 12);             \
+        s[a] = s[a] + s[b] + (y);                   \
+        s[d] = rotr32(s[d] ^ s[a], 8);              \
+        s[c] = s[c] + s[d];                         \
+        s[b] = rotr32(s[b] ^ s[c], 7);              \
+    } while (0)
+
+static void compress(const uint32_t cv[8], const uint8_t block[BLOCK_LEN], uint8_t blockLen, uint64_t counter,
+                     uint8_t flags, uint32_t out[16])
+{
+    uint32_t m[16];
+    for (int i = 0; i < 16; ++i) m[i] = load32(block + 4 * i);
+
+    uint32_t s[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        (uint32_t)counter, (uint32_t)(counter >> 32), (uint32_t)blockLen, (uint32_t)flags
+    };
+
+    for (int r = 0; r < 7; ++r)
+    {
+        const uint8_t* sc = MSG_SCHEDULE[r];
+        G(s, 0, 4, 8, 12, m[sc[0]], m[sc[1]]);
+        G(s, 1, 5, 9, 13, m[sc[2]], m[sc[3]]);
+        G(s, 2, 6, 10, 14, m[sc[4]], m[sc[5]]);
+        G(s, 3, 7, 11, 15, m[sc[6]], m[sc[7]]);
+        G(s, 0, 5, 10, 15, m[sc[8]], m[sc[9]]);
+        G(s, 1, 6, 11, 12, m[sc[10]], m[sc[11]]);
+        G(s, 2, 7, 8, 13, m[sc[12]], m[sc[13]]);
+        G(s, 3, 4, 9, 14, m[sc[14]], m[sc[15]]);
+    }
+
+    for (int i = 0; i < 8; ++i)
+    {
+        out[i] = s[i] ^ s[i + 8];
+        out[i + 8] = s[i + 8] ^ cv[i];
+    }
+}
+
+// A node whose final compression has not been performed yet: it becomes either a
+// chaining value (interior node) or the root output, depending on the ROOT flag
+typedef struct Output
+{
+    uint32_t cv[8];
+    uint8_t block[BLOCK_LEN];
+    uint8_t blockLen;
+    uint64_t counter;
+    uint8_t flags;
+} Output;
+
+static void output_cv(const Output* o, uint32_t cv[8])
+{
+    uint32_t full[16];
+    compress(o->cv, o->block, o->blockLen, o->counter, o->flags, full);
+    memcpy(cv, full, 8 * sizeof(uint32_t));
+}
+
+static void output_root(const Output* o, uint8_t out[TREEHASH_OUT_LEN])
+{
+    uint32_t full[16];
+    compress(o->cv, o->block, o->blockLen, 0, (uint8_t)(o->flags | ROOT), full);
+    for (int i = 0; i < 8; ++i) store32(out + 4 * i, full[i]);
+}
+
+static void parent_output(const uint32_t left[8], const uint32_t right[8], Output* o)
+{
+    memcpy(o->cv, IV, sizeof(IV));
+    for (int i = 0; i < 8; ++i)
+    {
+        store32(o->block + 4 * i, left[i]);
+        store32(o->block + 32 + 4 * i, right[i]);
+    }
+    o->blockLen = BLOCK_LEN;
+    o->counter = 0;
+    o->flags = PARENT;
+}
+
+static void parent_cv(const uint32_t left[8], const uint32_t right[8], uint32_t cv[8])
+{
+    Output o;
+    parent_output(left, right, &o);
+    output_cv(&o, cv);
+}
+
+// Hash one chunk (1..1024 bytes; 0 only for empty input) up to its final block
+static void chunk_output(const uint8_t* input, size_t len, uint64_t counter, Output* o)
+{
+    uint32_t cv[8];
+    memcpy(cv, IV, sizeof(IV));
+    uint8_t startFlag = CHUNK_START;
+
+    while (len > BLOCK_LEN)
+    {
+        uint32_t full[16];
+        compress(cv, input, BLOCK_LEN, counter, startFlag, full);
+        memcpy(cv, full, sizeof(cv));
+        startFlag = 0;
+        input += BLOCK_LEN;
+        len -= BLOCK_LEN;
+    }
+
+    memcpy(o->cv, cv, sizeof(cv));
+    memset(o->block, 0, BLOCK_LEN);
+    memcpy(o->block, input, len);
+    o->blockLen = (uint8_t)len;
+    o->counter = counter;
+    o->flags = (uint8_t)(startFlag | CHUNK_END);
+}
+
+// ---------------------------------------------------------------------------
+// 4-way SSE2 chunk hashing: four full chunks are compressed side by side, one per lane
+// ---------------------------------------------------------------------------
+
+#if TREEHASH_SSE2
+
+static inline __m128i rotr_v(__m128i x, int c)
+{
+    return _mm_or_si128(_mm_srli_epi32(x, c), _mm_slli_epi32(x, 32 - c));
+}
+
+#define GV(a, b, c, d, x, y)                          \
+    do                                                \
+    {                                                 \
+        a = _mm_add_epi32(_mm_add_epi32(a, b), x);    \
+        d = rotr_v(_mm_xor_si128(d, a), 16);          \
+        c = _mm_add_epi32(c, d);                      \
+        b = rotr_v(_mm_xor_si128(b, c), 12);          \
+        a = _mm_add_epi32(_mm_add_epi32(a, b), y);    \
+        d = rotr_v(_mm_xor_si128(d, a), 8);           \
+        c = _mm_add_epi32(c, d);                      \
+        b = rotr_v(_mm_xor_si128(b, c), 7);           \
+    } while (0)
+
+static inline void transpose4(__m128i* a, __m128i* b, __m128i* c, __m128i* d)
+{
+    __m128i t0 = _mm_unpacklo_epi32(*a, *b);
+    __m128i t1 = _mm_unpacklo_epi32(*c, *d);
+    __m128i t2 = _mm_unpackhi_epi32(*a, *b);
+    __m128i t3 = _mm_unpackhi_epi32(*c, *d);
+    *a = _mm_unpacklo_epi64(t0, t1);
+    *b = _mm_unpackhi_epi64(t0, t1);
+    *c = _mm_unpacklo_epi64(t2, t3);
+    *d = _mm_unpackhi_epi64(t2, t3);
+}
+
+// input holds 4 consecutive full chunks; writes their chaining values
+static void hash4_chunks(const uint8_t* input, uint64_t counter, uint32_t cvs[4][8])
+{
+    __m128i h[8];
+    for (int i = 0; i < 8; ++i) h[i] = _mm_set1_epi32((int)IV[i]);
+
+    const __m128i ctrLo = _mm_set_epi32((int)(uint32_t)(counter + 3), (int)(uint32_t)(counter + 2),
+                                        (int)(uint32_t)(counter + 1), (int)(uint32_t)counter);
+    const __m128i ctrHi = _mm_set_epi32((int)(uint32_t)((counter + 3) >> 32), (int)(uint32_t)((counter + 2) >> 32),
+                                        (int)(uint32_t)((counter + 1) >> 32), (int)(uint32_t)(counter >> 32));
+    const __m128i blockLen = _mm_set1_epi32(BLOCK_LEN);
+
+    for (int b = 0; b < TREEHASH_CHUNK_LEN / BLOCK_LEN; ++b)
+    {
+        // Gather word w of block b from each chunk into lane order
+        __m128i m[16];
+        for (int q = 0; q < 4; ++q)
+        {
+            __m128i r0 = _mm_loadu_si128((const __m128i*)(input + 0 * TREEHASH_CHUNK_LEN + b * BLOCK_LEN + q * 16));
+            __m128i r1 = _mm_loadu_si128((const __m128i*)(input + 1 * TREEHASH_CHUNK_LEN + b * BLOCK_LEN + q * 16));
+            __m128i r2 = _mm_loadu_si128((const __m128i*)(input + 2 * TREEHASH_CHUNK_LEN + b * BLOCK_LEN + q * 16));
+            __m128i r3 = _mm_loadu_si128((const __m128i*)(input + 3 * TREEHASH_CHUNK_LEN + b * BLOCK_LEN + q * 16));
+            transpose4(&r0, &r1, &r2, &r3);
+            m[4 * q + 0] = r0;
+            m[4 * q + 1] = r1;
+            m[4 * q + 2] = r2;
+            m[4 * q + 3] = r3;
+        }
+
+        uint32_t flags = 0;
+        if (b == 0) flags |= CHUNK_START;
+        if (b == TREEHASH_CHUNK_LEN / BLOCK_LEN - 1) flags |= CHUNK_END;
+
+        __m128i v0 = h[0], v1 = h[1], v2 = h[2], v3 = h[3];
+        __m128i v4 = h[4], v5 = h[5], v6 = h[6], v7 = h[7];
+        __m128i v8 = _mm_set1_epi32((int)IV[0]), v9 = _mm_set1_epi32((int)IV[1]);
+        __m128i v10 = _mm_set1_epi32((int)IV[2]), v11 = _mm_set1_epi32((int)IV[3]);
+        __m128i v12 = ctrLo, v13 = ctrHi, v14 = blockLen, v15 = _mm_set1_epi32((int)flags);
+
+        for (int r = 0; r < 7; ++r)
+        {
+            const uint8_t* sc = MSG_SCHEDULE[r];
+            GV(v0, v4, v8, v12, m[sc[0]], m[sc[1]]);
+            GV(v1, v5, v9, v13, m[sc[2]], m[sc[3]]);
+            GV(v2, v6, v10, v14, m[sc[4]], m[sc[5]]);
+            GV(v3, v7, v11, v15, m[sc[6]], m[sc[7]]);
+            GV(v0, v5, v10, v15, m[sc[8]], m[sc[9]]);
+            GV(v1, v6, v11, v12, m[sc[10]], m[sc[11]]);
+            GV(v2, v7, v8, v13, m[sc[12]], m[sc[13]]);
+            GV(v3, v4, v9, v14, m[sc[14]], m[sc[15]]);
+        }
+
+        h[0] = _mm_xor_si128(v0, v8);
+        h[1] = _mm_xor_si128(v1, v9);
+        h[2] = _mm_xor_si128(v2, v10);
+        h[3] = _mm_xor_si128(v3, v11);
+        h[4] = _mm_xor_si128(v4, v12);
+        h[5] = _mm_xor_si128(v5, v13);
+        h[6] = _mm_xor_si128(v6, v14);
+        h[7] = _mm_xor_si128(v7, v15);
+    }
+
+    // Transpose lanes back to one chaining value per chunk
+    uint32_t tmp[8][4];
+    for (int i = 0; i < 8; ++i) _mm_storeu_si128((__m128i*)tmp[i], h[i]);
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        for (int i = 0; i < 8; ++i) cvs[lane][i] = tmp[i][lane];
+    }
+}
+
+#endif
+
+#if TREEHASH_AVX2
+
+TREEHASH_TARGET_AVX2
+static inline __m256i rot16_v8(__m256i x)
+{
+    const __m256i r = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                       2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    return _mm256_shuffle_epi8(x, r);
+}
+
+TREEHASH_TARGET_AVX2
+static inline __m256i rot8_v8(__m256i x)
+{
+    const __m256i r = _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+                                       1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    return _mm256_shuffle_epi8(x, r);
+}
+
+#define GV8(a, b, c, d, x, y)                                                              \
+    do                                                                                     \
+    {                                                                                      \
+        a = _mm256_add_epi32(_mm256_add_epi32(a, b), x);                                   \
+        d = rot16_v8(_mm256_xor_si256(d, a));                                              \
+        c = _mm256_add_epi32(c, d);                                                        \
+        b = _mm256_xor_si256(b, c);                                                        \
+        b = _mm256_or_si256(_mm256_srli_epi32(b, 12), _mm256_slli_epi32(b, 20));           \
+        a = _mm256_add_epi32(_mm256_add_epi32(a, b), y);                                   \
+        d = rot8_v8(_mm256_xor_si256(d, a));                                               \
+        c = _mm256_add_epi32(c, d);                                                        \
+        b = _mm256_xor_si256(b, c);                                                        \
+        b = _mm256_or_si256(_mm256_srli_epi32(b, 7), _mm256_slli_epi32(b, 25));            \
+    } while (0)
+
+// Transpose an 8x8 matrix of 32-bit words held in eight 256-bit rows
+TREEHASH_TARGET_AVX2
+static inline void transpose8(__m256i r[8])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// input holds 8 consecutive full chunks; writes their chaining values
+TREEHASH_TARGET_AVX2
+static void hash8_chunks(const uint8_t* input, uint64_t counter, uint32_t cvs[8][8])
+{
+    __m256i h[8];
+    for (int i = 0; i < 8; ++i) h[i] = _mm256_set1_epi32((int)IV[i]);
+
+    uint32_t lo[8], hi[8];
+    for (int j = 0; j < 8; ++j)
+    {
+        lo[j] = (uint32_t)(counter + (uint64_t)j);
+        hi[j] = (uint32_t)((counter + (uint64_t)j) >> 32);
+    }
+    const __m256i ctrLo = _mm256_loadu_si256((const __m256i*)lo);
+    const __m256i ctrHi = _mm256_loadu_si256((const __m256i*)hi);
+    const __m256i blockLen = _mm256_set1_epi32(BLOCK_LEN);
+
+    for (int b = 0; b < TREEHASH_CHUNK_LEN / BLOCK_LEN; ++b)
+    {
+        __m256i m[16];
+        for (int half = 0; half < 2; ++half)
+        {
+            __m256i r[8];
+            for (int j = 0; j < 8; ++j)
+            {
+                r[j] = _mm256_loadu_si256(
+                    (const __m256i*)(input + (size_t)j * TREEHASH_CHUNK_LEN + b * BLOCK_LEN + half * 32));
+            }
+            transpose8(r);
+            for (int w = 0; w < 8; ++w) m[half * 8 + w] = r[w];
+        }
+
+        uint32_t flags = 0;
+        if (b == 0) flags |= CHUNK_START;
+        if (b == TREEHASH_CHUNK_LEN / BLOCK_LEN - 1) flags |= CHUNK_END;
+
+        __m256i v0 = h[0], v1 = h[1], v2 = h[2], v3 = h[3];
+        __m256i v4 = h[4], v5 = h[5], v6 = h[6], v7 = h[7];
+        __m256i v8 = _mm256_set1_epi32((int)IV[0]), v9 = _mm256_set1_epi32((int)IV[1]);
+        __m256i v10 = _mm256_set1_epi32((int)IV[2]), v11 = _mm256_set1_epi32((int)IV[3]);
+        __m256i v12 = ctrLo, v13 = ctrHi, v14 = blockLen, v15 = _mm256_set1_epi32((int)flags);
+
+        for (int r = 0; r < 7; ++r)
+        {
+            const uint8_t* sc = MSG_SCHEDULE[r];
+            GV8(v0, v4, v8, v12, m[sc[0]], m[sc[1]]);
+            GV8(v1, v5, v9, v13, m[sc[2]], m[sc[3]]);
+            GV8(v2, v6, v10, v14, m[sc[4]], m[sc[5]]);
+            GV8(v3, v7, v11, v15, m[sc[6]], m[sc[7]]);
+            GV8(v0, v5, v10, v15, m[sc[8]], m[sc[9]]);
+            GV8(v1, v6, v11, v12, m[sc[10]], m[sc[11]]);
+            GV8(v2, v7, v8, v13, m[sc[12]], m[sc[13]]);
+            GV8(v3, v4, v9, v14, m[sc[14]], m[sc[15]]);
+        }
+
+        h[0] = _mm256_xor_si256(v0, v8);
+        h[1] = _mm256_xor_si256(v1, v9);
+        h[2] = _mm256_xor_si256(v2, v10);
+        h[3] = _mm256_xor_si256(v3, v11);
+        h[4] = _mm256_xor_si256(v4, v12);
+        h[5] = _mm256_xor_si256(v5, v13);
+        h[6] = _mm256_xor_si256(v6, v14);
+        h[7] = _mm256_xor_si256(v7, v15);
+    }
+
+    // h[i] holds word i of every chunk; transposing yields one chaining value per row
+    transpose8(h);
+    for (int lane = 0; lane < 8; ++lane) _mm256_storeu_si256((__m256i*)cvs[lane], h[lane]);
+}
+
+static int cpu_has_avx2(void)
+{
+    static int cached = -1;
+    if (cached < 0)
+    {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Subtree hashing
+// ---------------------------------------------------------------------------
+
+typedef struct CvStack
+{
+    uint32_t cv[MAX_DEPTH][8];
+    int len;
+} CvStack;
+
+// Push the chaining value of a subtree that ends after `total` units; merging completed
+// siblings eagerly (a unit is one chunk, or one leaf at the file level)
+static void cv_stack_push(CvStack* st, const uint32_t cv[8], uint64_t total)
+{
+    uint32_t cur[8];
+    memcpy(cur, cv, sizeof(cur));
+    while ((total & 1) == 0)
+    {
+        st->len--;
+        parent_cv(st->cv[st->len], cur, cur);
+        total >>= 1;
+    }
+    memcpy(st->cv[st->len], cur, sizeof(cur));
+    st->len++;
+}
+
+// Fold the stack onto the right-most node; produces the root hash or an interior chaining value
+static void cv_stack_finish(const CvStack* st, const Output* last, int isRoot, uint8_t outHash[TREEHASH_OUT_LEN],
+                            uint32_t outCv[8])
+{
+    Output o = *last;
+    for (int r = st->len - 1; r >= 0; --r)
+    {
+        uint32_t rightCv[8];
+        output_cv(&o, rightCv);
+        parent_output(st->cv[r], rightCv, &o);
+    }
+    if (isRoot) output_root(&o, outHash);
+    else output_cv(&o, outCv);
+}
+
+// Hash a chunk-aligned region starting at chunk index `counter`.
+// The region must form a subtree of the full tree (an aligned power-of-two run of chunks,
+// the trailing remainder of the input, or the whole input when isRoot is set)
+static void hash_region(const uint8_t* input, size_t len, uint64_t counter, int isRoot,
+                        uint8_t outHash[TREEHASH_OUT_LEN], uint32_t outCv[8])
+{
+    CvStack st;
+    st.len = 0;
+
+    size_t chunks = len == 0 ? 1 : (len + TREEHASH_CHUNK_LEN - 1) / TREEHASH_CHUNK_LEN;
+    size_t i = 0;
+
+    // Every chunk but the last is pushed as a chaining value; the last stays an Output
+#if TREEHASH_AVX2
+    if (cpu_has_avx2())
+    {
+        while (i + 8 < chunks)
+        {
+            uint32_t cvs[8][8];
+            hash8_chunks(input + i * TREEHASH_CHUNK_LEN, counter + i, cvs);
+            for (int k = 0; k < 8; ++k) cv_stack_push(&st, cvs[k], (uint64_t)(i + k + 1));
+            i += 8;
+        }
+    }
+#endif
+#if TREEHASH_SSE2
+    while (i + 4 < chunks)
+    {
+        uint32_t cvs[4][8];
+        hash4_chunks(input + i * TREEHASH_CHUNK_LEN, counter + i, cvs);
+        for (int k = 0; k < 4; ++k) cv_stack_push(&st, cvs[k], (uint64_t)(i + k + 1));
+        i += 4;
+    }
+#endif
+    for (; i + 1 < chunks; ++i)
+    {
+        Output o;
+        uint32_t cv[8];
+        chunk_output(input + i * TREEHASH_CHUNK_LEN, TREEHASH_CHUNK_LEN, counter + i, &o);
+        output_cv(&o, cv);
+        cv_stack_push(&st, cv, (uint64_t)(i + 1));
+    }
+
+    Output last;
+    chunk_output(input + i * TREEHASH_CHUNK_LEN, len - i * TREEHASH_CHUNK_LEN, counter + i, &last);
+    cv_stack_finish(&st, &last, isRoot, outHash, outCv);
+}
+
+void TreeHash_Hash(const uint8_t* data, size_t length, uint8_t out[TREEHASH_OUT_LEN])
+{
+    hash_region(data, length, 0, 1, out, NULL);
+}
+
+// Combine leaf chaining values (leafCount >= 2) into the root hash
+static void root_from_leaf_cvs(const uint8_t (*cvs)[TREEHASH_OUT_LEN], uint64_t leafCount,
+                               uint8_t out[TREEHASH_OUT_LEN])
+{
+    CvStack st;
+    st.len = 0;
+    for (uint64_t i = 0; i + 1 < leafCount; ++i)
+    {
+        uint32_t cv[8];
+        for (int k = 0; k < 8; ++k) cv[k] = load32(cvs[i] + 4 * k);
+        cv_stack_push(&st, cv, i + 1);
+    }
+
+    // The last leaf is already a chaining value, so pair it with the stack top to get
+    // the right-most parent Output and fold the rest of the stack onto that
+    uint32_t lastCv[8];
+    for (int k = 0; k < 8; ++k) lastCv[k] = load32(cvs[leafCount - 1] + 4 * k);
+
+    Output o;
+    st.len--;
+    parent_output(st.cv[st.len], lastCv, &o);
+    cv_stack_finish(&st, &o, 1, out, NULL);
+}
+
+// ---------------------------------------------------------------------------
+// File hashing
+// ---------------------------------------------------------------------------
+
+typedef struct LeafJob
+{
+    const char* path;
+    uint64_t fileSize;
+    uint64_t endLeaf;
+    uint8_t (*cvs)[TREEHASH_OUT_LEN];
+    atomic_uint_fast64_t next;
+    atomic_int failed;
+} LeafJob;
+
+static void leaf_worker(void* arg)
+{
+    LeafJob* job = (LeafJob*)arg;
+    FILE* fp = FileUtils_OpenFileUTF8(job->path, "rb");
+    uint8_t* buf = (uint8_t*)BufferPool_Acquire((size_t)TREEHASH_LEAF_SIZE);
+    if (!fp || !buf)
+    {
+        atomic_store(&job->failed, 1);
+        if (fp) fclose(fp);
+        BufferPool_Release(buf, (size_t)TREEHASH_LEAF_SIZE);
+        return;
+    }
+
+    for (;;)
+    {
+        uint64_t leaf = atomic_fetch_add(&job->next, 1);
+        if (leaf >= job->endLeaf || atomic_load(&job->failed)) break;
+
+        uint64_t offset = leaf * TREEHASH_LEAF_SIZE;
+        uint64_t remain = job->fileSize - offset;
+        size_t len = (size_t)(remain < TREEHASH_LEAF_SIZE ? remain : TREEHASH_LEAF_SIZE);
+
+        if (FileUtils_Seek(fp, offset) != 0 || fread(buf, 1, len, fp) != len)
+        {
+            atomic_store(&job->failed, 1);
+            break;
+        }
+
+        uint32_t cv[8];
+        hash_region(buf, len, leaf * TREEHASH_LEAF_CHUNKS, 0, NULL, cv);
+        for (int k = 0; k < 8; ++k) store32(job->cvs[leaf] + 4 * k, cv[k]);
+    }
+
+    fclose(fp);
+    BufferPool_Release(buf, (size_t)TREEHASH_LEAF_SIZE);
+}
+
+// Hash leaves [firstLeaf, endLeaf) of a file of `size` bytes into cvs
+static int hash_leaves(const char* path, uint64_t size, uint64_t firstLeaf, uint64_t endLeaf, int threads,
+                       uint8_t (*cvs)[TREEHASH_OUT_LEN])
+{
+    if (firstLeaf >= endLeaf) return 0;
+
+    LeafJob job;
+    job.path = path;
+    job.fileSize = size;
+    job.endLeaf = endLeaf;
+    job.cvs = cvs;
+    atomic_init(&job.next, firstLeaf);
+    atomic_init(&job.failed, 0);
+
+    if (threads <= 0) threads = Thread_GetCpuCount();
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if ((uint64_t)threads > endLeaf - firstLeaf) threads = (int)(endLeaf - firstLeaf);
+
+    Thread handles[MAX_THREADS];
+    int created = 0;
+    for (int i = 1; i < threads; ++i)
+    {
+        if (Thread_Create(&handles[created], leaf_worker, &job) == 0) created++;
+    }
+    leaf_worker(&job);
+    for (int i = 0; i < created; ++i) Thread_Join(handles[i]);
+
+    return atomic_load(&job.failed) ? -1 : 0;
+}
+
+int TreeHash_ComputeLeaves(const char* path, uint64_t firstLeaf, int threads, TreeHashLeaves* leaves)
+{
+    if (!path || !leaves) return -1;
+    if (!FileUtils_Exists(path)) return -1;
+
+    uint64_t size = FileUtils_GetFileSize(path);
+    uint64_t count = size == 0 ? 1 : (size + TREEHASH_LEAF_SIZE - 1) / TREEHASH_LEAF_SIZE;
+
+    if (!leaves->cvs || leaves->leafCount != count || leaves->fileSize != size)
+    {
+        // Size changed: the leaf layout is different, start over
+        free(leaves->cvs);
+        leaves->cvs = (uint8_t(*)[TREEHASH_OUT_LEN])calloc((size_t)count, TREEHASH_OUT_LEN);
+        if (!leaves->cvs)
+        {
+            leaves->leafCount = 0;
+            return -1;
+        }
+        leaves->leafCount = count;
+        leaves->fileSize = size;
+        firstLeaf = 0;
+    }
+    return hash_leaves(path, size, firstLeaf, count, threads, leaves->cvs);
+}
+
+
+int TreeHash_RootFromLeaves(const char* path, const TreeHashLeaves* leaves, uint8_t out[TREEHASH_OUT_LEN])
+{
+    if (!leaves || !leaves->cvs || leaves->leafCount == 0) return -1;
+
+    if (leaves->leafCount >= 2)
+    {
+        root_from_leaf_cvs((const uint8_t(*)[TREEHASH_OUT_LEN])leaves->cvs, leaves->leafCount, out);
+        return 0;
+    }
+
+    // A single leaf is the root itself and must be finalised with the ROOT flag
+    size_t len = (size_t)leaves->fileSize;
+    uint8_t* buf = (uint8_t*)malloc(len > 0 ? len : 1);
+    FILE* fp = FileUtils_OpenFileUTF8(path, "rb");
+    int rc = -1;
+    if (buf && fp && fread(buf, 1, len, fp) == len)
+    {
+        TreeHash_Hash(buf, len, out);
+        rc = 0;
+    }
+    if (fp) fclose(fp);
+    free(buf);
+    return rc;
+}
+
+int TreeHash_File(const char* path, int threads, uint8_t out[TREEHASH_OUT_LEN])
+{
+    TreeHashLeaves leaves;
+    memset(&leaves, 0, sizeof(leaves));
+
+    int rc = TreeHash_ComputeLeaves(path, 0, threads, &leaves);
+    if (rc == 0) rc = TreeHash_RootFromLeaves(path, &leaves, out);
+    TreeHash_FreeLeaves(&leaves);
+    return rc;
+}
+
+void TreeHash_FreeLeaves(TreeHashLeaves* leaves)
+{
+    if (!leaves) return;
+    free(leaves->cvs);
+    leaves->cvs = NULL;
+    leaves->leafCount = 0;
+    leaves->fileSize = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming
+// ---------------------------------------------------------------------------
+
+#define CHECKPOINT_MAGIC 0x564c4854u // "THLV"
+#define CHECKPOINT_HEADER 20        // magic, file size, leaf count
+
+static void store64(uint8_t* p, uint64_t v)
+{
+    store32(p, (uint32_t)v);
+    store32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t load64(const uint8_t* p)
+{
+    return (uint64_t)load32(p) | ((uint64_t)load32(p + 4) << 32);
+}
+
+// Load up to `want` leading leaf chaining values saved for a file of `size` bytes; returns how many were loaded
+static uint64_t load_checkpoint(const char* checkpoint, uint64_t size, uint64_t want, uint8_t (*cvs)[TREEHASH_OUT_LEN])
+{
+    FILE* fp = checkpoint ? FileUtils_OpenFileUTF8(checkpoint, "rb") : NULL;
+    if (!fp) return 0;
+
+    uint64_t loaded = 0;
+    uint8_t header[CHECKPOINT_HEADER];
+    if (fread(header, 1, sizeof(header), fp) == sizeof(header) && load32(header) == CHECKPOINT_MAGIC &&
+        load64(header + 4) == size)
+    {
+        loaded = load64(header + 12);
+        if (loaded > want) loaded = want;
+        loaded = fread(cvs, TREEHASH_OUT_LEN, (size_t)loaded, fp);
+    }
+    fclose(fp);
+    return loaded;
+}
+
+static void stream_hash_leaf(TreeHashStream* s, uint64_t leaf, const uint8_t* data)
+{
+    uint32_t cv[8];
+    hash_region(data, (size_t)TREEHASH_LEAF_SIZE, leaf * TREEHASH_LEAF_CHUNKS, 0, NULL, cv);
+    for (int k = 0; k < 8; ++k) store32(s->leaves.cvs[leaf] + 4 * k, cv[k]);
+    s->done = leaf + 1;
+}
+
+int TreeHash_StreamBegin(TreeHashStream* s, uint64_t size, uint64_t offset, const char* path, const char* checkpoint,
+                         int threads)
+{
+    if (!s) return -1;
+    memset(s, 0, sizeof(*s));
+
+    uint64_t count = size == 0 ? 1 : (size + TREEHASH_LEAF_SIZE - 1) / TREEHASH_LEAF_SIZE;
+    s->leaves.fileSize = size;
+    s->leaves.leafCount = count;
+    s->leaves.cvs = (uint8_t(*)[TREEHASH_OUT_LEN])calloc((size_t)count, TREEHASH_OUT_LEN);
+    s->partial = (uint8_t*)BufferPool_Acquire((size_t)TREEHASH_LEAF_SIZE);
+    if (!s->leaves.cvs || !s->partial || offset > size || (offset > 0 && !path))
+    {
+        s->failed = 1;
+        return -1;
+    }
+    if (offset == 0) return 0;
+
+    // Leaves wholly before the resume offset come from the checkpoint, or from the file when it is
+    // missing or stale; the last leaf is always finalised by TreeHash_StreamFinish
+    uint64_t first = offset / TREEHASH_LEAF_SIZE;
+    if (first >= count) first = count - 1;
+    uint64_t loaded = load_checkpoint(checkpoint, size, first, s->leaves.cvs);
+    if (hash_leaves(path, size, loaded, first, threads, s->leaves.cvs) != 0)
+    {
+        s->failed = 1;
+        return -1;
+    }
+    s->done = first;
+
+    // The part of the resume leaf that is already written is read back so the leaf can be completed
+    s->fill = (size_t)(offset - first * TREEHASH_LEAF_SIZE);
+    s->offset = offset;
+    if (s->fill > 0)
+    {
+        FILE* fp = FileUtils_OpenFileUTF8(path, "rb");
+        int ok = fp && FileUtils_Seek(fp, first * TREEHASH_LEAF_SIZE) == 0 &&
+                 fread(s->partial, 1, s->fill, fp) == s->fill;
+        if (fp) fclose(fp);
+        if (!ok)
+        {
+            s->failed = 1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void TreeHash_StreamUpdate(TreeHashStream* s, const uint8_t* data, size_t len)
+{
+    if (!s || s->failed) return;
+    if (len > s->leaves.fileSize - s->offset)
+    {
+        s->failed = 1;
+        return;
+    }
+
+    while (len > 0)
+    {
+        uint64_t leaf = s->offset / TREEHASH_LEAF_SIZE;
+        int last = leaf + 1 == s->leaves.leafCount;
+        size_t take = (size_t)TREEHASH_LEAF_SIZE - s->fill;
+        if (take > len) take = len;
+
+        if (s->fill == 0 && take == TREEHASH_LEAF_SIZE && !last)
+        {
+            // A whole leaf in the caller's buffer is hashed in place
+            stream_hash_leaf(s, leaf, data);
+        }
+        else
+        {
+            memcpy(s->partial + s->fill, data, take);
+            s->fill += take;
+            if (s->fill == TREEHASH_LEAF_SIZE && !last)
+            {
+                stream_hash_leaf(s, leaf, s->partial);
+                s->fill = 0;
+            }
+        }
+        s->offset += take;
+        data += take;
+        len -= take;
+    }
+}
+
+int TreeHash_StreamSave(const TreeHashStream* s, const char* checkpoint)
+{
+    if (!s || !s->leaves.cvs || !checkpoint) return -1;
+
+    uint8_t header[CHECKPOINT_HEADER];
+    store32(header, CHECKPOINT_MAGIC);
+    store64(header + 4, s->leaves.fileSize);
+    store64(header + 12, s->done);
+
+    FILE* fp = FileUtils_OpenFileUTF8(checkpoint, "wb");
+    if (!fp) return -1;
+    int ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header) &&
+             fwrite(s->leaves.cvs, TREEHASH_OUT_LEN, (size_t)s->done, fp) == s->done;
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : -1;
+}
+
+int TreeHash_StreamFinish(TreeHashStream* s, uint8_t out[TREEHASH_OUT_LEN])
+{
+    if (!s || s->failed || s->offset != s->leaves.fileSize) return -1;
+
+    uint64_t last = s->leaves.leafCount - 1;
+    if (last == 0)
+    {
+        hash_region(s->partial, s->fill, 0, 1, out, NULL);
+        return 0;
+    }
+
+    uint32_t cv[8];
+    hash_region(s->partial, s->fill, last * TREEHASH_LEAF_CHUNKS, 0, NULL, cv);
+    for (int k = 0; k < 8; ++k) store32(s->leaves.cvs[last] + 4 * k, cv[k]);
+    root_from_leaf_cvs((const uint8_t(*)[TREEHASH_OUT_LEN])s->leaves.cvs, s->leaves.leafCount, out);
+    return 0;
+}
+
+void TreeHash_StreamFree(TreeHashStream* s)
+{
+    if (!s) return;
+    TreeHash_FreeLeaves(&s->leaves);
+    BufferPool_Release(s->partial, (size_t)TREEHASH_LEAF_SIZE);
+    s->partial = NULL;
+}
+
+void TreeHash_ToHex(const uint8_t hash[TREEHASH_OUT_LEN], char* out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < TREEHASH_OUT_LEN; ++i)
+    {
+        out[2 * i] = digits[hash[i] >> 4];
+        out[2 * i + 1] = digits[hash[i] & 0x0f];
+    }
+    out[2 * TREEHASH_OUT_LEN] = '\0';
+}